@@ -3,6 +3,7 @@
 
 #include <vector>
 #include "ZStackFrame.h"
+#include "zcl/ZclRequestBuilder.h"
 #include <iostream>
 
 namespace ZStack
@@ -14,173 +15,105 @@ namespace ZStack
         uint8_t excpectedResponseCommand1;
     };
 
+    // Convenience wrappers around ZclRequestBuilder that hand back a
+    // ZStackFrame. For bulk work, use ZclRequestBuilder with a FrameArena
+    // directly and send the FrameViews: that path does no heap allocation.
     class AFDataRequestFactory
     {
     public:
-        static AFDataRequest readTemperature(uint16_t shortAddr)
+        static AFDataRequest readTemperature(uint16_t shortAddr, uint8_t endpoint = 0x01)
         {
             std::cout << "[Command] Asking device " << std::hex << shortAddr << " for Temperature..." << std::endl;
 
-            // Payload for "Read Attributes" (Command 0x00)
-            std::vector<uint8_t> payload;
-            payload.push_back(0x00); // Frame Control
-            payload.push_back(0x01); // Sequence
-            payload.push_back(0x00); // Command: Read Attributes
-            payload.push_back(0x00); // Attr ID Low (Measured Value)
-            payload.push_back(0x00); // Attr ID High
-
-            // Wrap in AF_DATA_REQUEST
-            std::vector<uint8_t> afPayload;
-            afPayload.push_back(shortAddr & 0xFF);
-            afPayload.push_back((shortAddr >> 8) & 0xFF);
-            afPayload.push_back(0x01); // Dst Endpoint
-            afPayload.push_back(0x01); // Src Endpoint
-            afPayload.push_back(0x02); // Cluster Low (0x0402)
-            afPayload.push_back(0x04); // Cluster High
-            afPayload.push_back(0x00); // TransID
-            afPayload.push_back(0x00); // Options
-            afPayload.push_back(0x0F); // Radius
-            afPayload.push_back(payload.size());
-            afPayload.insert(afPayload.end(), payload.begin(), payload.end());
-
-            ZStackFrame req(SREQ | AF, AF_DATA_REQUEST, afPayload);
+            // Read Attributes: Measured Value (0x0000)
+            uint8_t buffer[MAX_MT_FRAME_SIZE];
+            ZclRequestBuilder builder(buffer, sizeof(buffer));
+            ZclDestination dest{shortAddr, endpoint};
 
-            AFDataRequest afRequest;
-            afRequest.frame = req;
-            afRequest.excpectedResponseCommand0 = SRSP | AF;
-            afRequest.excpectedResponseCommand1 = AF_DATA_REQUEST;
-
-            return afRequest;
+            return wrap(builder.readAttributes(dest, TEMPERATURE_MEASUREMENT_CLUSTER, 0x01, {0x0000}));
         };
 
-        static AFDataRequest readHumidity(uint16_t shortAddr)
+        static AFDataRequest readHumidity(uint16_t shortAddr, uint8_t endpoint = 0x01)
         {
             std::cout << "[Command] Asking device " << std::hex << shortAddr << " for Humidity..." << std::endl;
 
-            std::vector<uint8_t> payload;
-
-            payload.push_back(0x00); // Frame Control
-            payload.push_back(0x01); // Sequence
-            payload.push_back(0x00); // Command: Read Attributes
-            payload.push_back(0x00); // Attr ID Low (Measured Value)
-            payload.push_back(0x00); // Attr ID High
-
-            // Wrap in AF_DATA_REQUEST
-            std::vector<uint8_t> afPayload;
-            afPayload.push_back(shortAddr & 0xFF);
-            afPayload.push_back((shortAddr >> 8) & 0xFF);
-            afPayload.push_back(0x01); // Dst Endpoint
-            afPayload.push_back(0x01); // Src Endpoint
-            afPayload.push_back(0x05); // Cluster Low (0x0402)
-            afPayload.push_back(0x04); // Cluster High
-            afPayload.push_back(0x00); // TransID
-            afPayload.push_back(0x00); // Options
-            afPayload.push_back(0x0F); // Radius
-            afPayload.push_back(payload.size());
-            afPayload.insert(afPayload.end(), payload.begin(), payload.end());
-
-            ZStackFrame req(SREQ | AF, AF_DATA_REQUEST, afPayload);
+            // Read Attributes: Measured Value (0x0000)
+            uint8_t buffer[MAX_MT_FRAME_SIZE];
+            ZclRequestBuilder builder(buffer, sizeof(buffer));
+            ZclDestination dest{shortAddr, endpoint};
 
-            AFDataRequest afRequest;
-            afRequest.frame = req;
-            afRequest.excpectedResponseCommand0 = SRSP | AF;
-            afRequest.excpectedResponseCommand1 = AF_DATA_REQUEST;
+            return wrap(builder.readAttributes(dest, HUMIDITY_MEASUREMENT_CLUSTER, 0x01, {0x0000}));
+        };
 
-            return afRequest;
+        static AFDataRequest readAttributes(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID,
+                                            const std::vector<uint16_t> &attributeIDs, uint8_t sequence)
+        {
+            uint8_t buffer[MAX_MT_FRAME_SIZE];
+            ZclRequestBuilder builder(buffer, sizeof(buffer));
+            ZclDestination dest{shortAddr, endpoint};
+
+            return wrap(builder.readAttributes(dest, clusterID, sequence, attributeIDs.data(), attributeIDs.size()));
         };
 
-        static AFDataRequest configureReporting(uint16_t shortAddr, uint16_t clusterID, uint8_t dataType)
+        // Defaults: 10 s min, 10 min max, reportable change of 20 (0.20 for Temp/Humidity)
+        static AFDataRequest configureReporting(uint16_t shortAddr, uint16_t clusterID, uint8_t dataType,
+                                                uint16_t minInterval = 10, uint16_t maxInterval = 600,
+                                                uint32_t reportableChange = 0x14, uint8_t endpoint = 0x01)
         {
             std::cout << "[Config] Sending Reporting Configuration to " << std::hex << shortAddr
                       << " for Cluster " << clusterID << "..." << std::endl;
 
-            std::vector<uint8_t> payload;
-            payload.push_back(0x00); // Frame Control
-            payload.push_back(0x11); // Sequence
-            payload.push_back(0x06); // Command: Configure Reporting
-
-            // Payload Details
-            payload.push_back(0x00);     // Direction: Reported
-            payload.push_back(0x00);     // Attr ID Low (Measured Value)
-            payload.push_back(0x00);     // Attr ID High
-            payload.push_back(dataType); // Data Type: INT16 (Temp/Humidity standard)
-
-            // Min Interval: 10 seconds (0x000A)
-            payload.push_back(0x0A);
-            payload.push_back(0x00);
-
-            // Max Interval: 10 Minutes (600s = 0x0258)
-            // Little Endian -> 58 02
-            payload.push_back(0x58);
-            payload.push_back(0x02);
-
-            // Reportable Change: 0.20 (Value 20 = 0x0014)
-            payload.push_back(0x14);
-            payload.push_back(0x00);
-
-            // Wrap in AF_DATA_REQUEST
-            std::vector<uint8_t> afPayload;
-            afPayload.push_back(shortAddr & 0xFF);
-            afPayload.push_back((shortAddr >> 8) & 0xFF);
-            afPayload.push_back(0x01);                    // Dst Endpoint
-            afPayload.push_back(0x01);                    // Src Endpoint
-            afPayload.push_back(clusterID & 0xFF);        // Cluster Low
-            afPayload.push_back((clusterID >> 8) & 0xFF); // Cluster High
-            afPayload.push_back(0x00);                    // TransID
-            afPayload.push_back(0x00);                    // Options
-            afPayload.push_back(0x0F);                    // Radius
-            afPayload.push_back(payload.size());
-            afPayload.insert(afPayload.end(), payload.begin(), payload.end());
-
-            ZStackFrame req(SREQ | AF, AF_DATA_REQUEST, afPayload);
+            uint8_t buffer[MAX_MT_FRAME_SIZE];
+            ZclRequestBuilder builder(buffer, sizeof(buffer));
+            ZclDestination dest{shortAddr, endpoint};
 
-            AFDataRequest afRequest;
-            afRequest.frame = req;
-            afRequest.excpectedResponseCommand0 = SRSP | AF;
-            afRequest.excpectedResponseCommand1 = AF_DATA_REQUEST;
+            // Measured Value (0x0000)
+            ZclReportingConfig config{0x0000, dataType, minInterval, maxInterval, reportableChange};
 
-            return afRequest;
+            return wrap(builder.configureReporting(dest, clusterID, 0x11, {config}));
         };
 
-        static AFDataRequest readReportingConfig(uint16_t shortAddr, uint16_t clusterID)
+        static AFDataRequest readReportingConfig(uint16_t shortAddr, uint16_t clusterID, uint8_t endpoint = 0x01)
         {
             std::cout << "[Audit] Asking device " << std::hex << shortAddr
                       << " for Reporting Config (Cluster " << clusterID << ")..." << std::endl;
 
-            std::vector<uint8_t> payload;
-            payload.push_back(0x00); // Frame Control
-            payload.push_back(0x12); // Sequence Number
-            payload.push_back(0x08); // Command: Read Reporting Configuration
-
-            // Payload: Which attribute do we want to check? (0x0000 Measured Value)
-            payload.push_back(0x00); // Direction: Reported
-            payload.push_back(0x00); // Attr ID Low
-            payload.push_back(0x00); // Attr ID High
-
-            // Wrap in AF_DATA_REQUEST
-            std::vector<uint8_t> afPayload;
-            afPayload.push_back(shortAddr & 0xFF);
-            afPayload.push_back((shortAddr >> 8) & 0xFF);
-            afPayload.push_back(0x01);                    // Dst Endpoint
-            afPayload.push_back(0x01);                    // Src Endpoint
-            afPayload.push_back(clusterID & 0xFF);        // Cluster Low
-            afPayload.push_back((clusterID >> 8) & 0xFF); // Cluster High
-            afPayload.push_back(0x00);                    // TransID
-            afPayload.push_back(0x00);                    // Options
-            afPayload.push_back(0x0F);                    // Radius
-            afPayload.push_back(payload.size());
-            afPayload.insert(afPayload.end(), payload.begin(), payload.end());
-
-            ZStackFrame req(SREQ | AF, AF_DATA_REQUEST, afPayload);
+            uint8_t buffer[MAX_MT_FRAME_SIZE];
+            ZclRequestBuilder builder(buffer, sizeof(buffer));
+            ZclDestination dest{shortAddr, endpoint};
+
+            // Which attribute do we want to check? (0x0000 Measured Value)
+            return wrap(builder.readReportingConfig(dest, clusterID, 0x12, {0x0000}));
+        };
+
+        // One frame for every member of a group (AF_DATA_REQUEST_EXT), e.g. On/Off Toggle for a room
+        static AFDataRequest groupCommand(uint16_t groupID, uint16_t clusterID, uint8_t commandID, uint8_t sequence = 0x13)
+        {
+            std::cout << "[Command] Group " << std::hex << groupID << " <- Cluster " << clusterID
+                      << " Command " << (int)commandID << std::endl;
 
+            uint8_t buffer[MAX_MT_FRAME_SIZE];
+            ZclRequestBuilder builder(buffer, sizeof(buffer));
+
+            return wrap(builder.clusterCommand(ZclDestination::group(groupID), clusterID, sequence, commandID));
+        };
+
+    private:
+        // Copies a serialised MT frame (SOF, LEN, CMD0, CMD1, Payload, FCS) into a ZStackFrame
+        static AFDataRequest wrap(const FrameView &view)
+        {
             AFDataRequest afRequest;
-            afRequest.frame = req;
+            if (view.valid())
+            {
+                afRequest.frame = ZStackFrame(view.data[2], view.data[3],
+                                              std::vector<uint8_t>(view.data + 4, view.data + view.size - 1));
+            }
             afRequest.excpectedResponseCommand0 = SRSP | AF;
-            afRequest.excpectedResponseCommand1 = AF_DATA_REQUEST;
+            afRequest.excpectedResponseCommand1 = view.valid() ? view.data[3] : static_cast<uint8_t>(AF_DATA_REQUEST); // _EXT for groups
 
             return afRequest;
-        };
+        }
     };
 };
 
-#endif
\ No newline at end of file
+#endif
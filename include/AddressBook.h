@@ -0,0 +1,103 @@
+#ifndef ADDRESS_BOOK_H
+#define ADDRESS_BOOK_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "ZStackFrame.h"
+#include "FrameBuffer.h"
+#include "TimerWheel.h"
+
+namespace ZStack
+{
+    // NWK address -> IEEE address (and back) for every device we have heard of.
+    //
+    // Short addresses are not stable: a device that rejoins, or whose
+    // address conflicts, comes back under a new one. The book learns from
+    // device announcements, Trust Center device indications and
+    // NWK / IEEE address responses, and when an IEEE address shows up under
+    // a new short address the old mapping is evicted and the change handler
+    // runs so owners of per-address state can move or drop it.
+    //
+    // A message from a short address we cannot place triggers one unicast
+    // IEEE_addr_req. Everyone asking about that address meanwhile shares it,
+    // and an address that did not answer is not asked about again for a
+    // while, so unknown senders never cost more than one lookup per
+    // retry interval. Timing runs on the owner's TimerWheel.
+    class AddressBook
+    {
+    public:
+        using SendFunction = std::function<void(const FrameView &)>;
+        using ChangeHandler = std::function<void(uint64_t ieee, uint16_t oldShortAddr, uint16_t newShortAddr)>;
+        using IEEECallback = std::function<void(std::optional<uint64_t> ieee)>;
+        using ShortCallback = std::function<void(std::optional<uint16_t> shortAddr)>;
+
+        AddressBook(TimerWheel &timers,
+                    SendFunction sendFunction,
+                    int responseTimeoutMs = 5000,
+                    int retryAfterMs = 60000);
+        ~AddressBook();
+
+        AddressBook(const AddressBook &) = delete;
+        AddressBook &operator=(const AddressBook &) = delete;
+
+        // Feed every received frame. AF messages from unknown senders start a lookup.
+        void handleFrame(const ZStackFrame &frame);
+
+        // Seed from a device database, or record what we learned elsewhere
+        void learn(uint16_t shortAddr, uint64_t ieee);
+
+        // Device left: its mapping goes, nothing is reported
+        void forget(uint16_t shortAddr);
+
+        std::optional<uint64_t> ieeeOf(uint16_t shortAddr) const;
+        std::optional<uint16_t> shortOf(uint64_t ieee) const;
+
+        // Cached answers run the callback right away. Otherwise one
+        // IEEE_addr_req (unicast) / NWK_addr_req (broadcast) is shared by
+        // every caller; std::nullopt if it went unanswered.
+        void resolveIEEE(uint16_t shortAddr, IEEECallback callback);
+        void resolveShort(uint64_t ieee, ShortCallback callback);
+
+        void setChangeHandler(ChangeHandler handler) { changeHandler = std::move(handler); }
+
+        size_t size() const { return ieeeByShort.size(); }
+        uint64_t lookupsSent() const { return lookups; }
+
+    private:
+        using Clock = TimerWheel::Clock;
+
+        template <typename Callback>
+        struct Lookup
+        {
+            std::vector<Callback> callbacks;
+            TimerId timer;
+        };
+
+        TimerWheel &timers;
+        SendFunction sendFunction;
+        int responseTimeoutMs;
+        int retryAfterMs;
+        ChangeHandler changeHandler;
+
+        std::unordered_map<uint16_t, uint64_t> ieeeByShort;
+        std::unordered_map<uint64_t, uint16_t> shortByIEEE;
+
+        std::map<uint16_t, Lookup<IEEECallback>> ieeeLookups;
+        std::map<uint64_t, Lookup<ShortCallback>> shortLookups;
+        std::unordered_map<uint16_t, Clock::time_point> unanswered; // Not asked again before then
+
+        uint64_t lookups = 0;
+
+        void sendIEEERequest(uint16_t shortAddr);
+        void sendNwkRequest(uint64_t ieee);
+        void addressResponse(const std::vector<uint8_t> &payload, bool ieeeRequest);
+        void completeIEEE(uint16_t shortAddr, std::optional<uint64_t> ieee);
+        void completeShort(uint64_t ieee, std::optional<uint16_t> shortAddr);
+    };
+}
+
+#endif // ADDRESS_BOOK_H
@@ -0,0 +1,89 @@
+#ifndef ATTRIBUTE_CACHE_H
+#define ATTRIBUTE_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "ZStackFrame.h"
+#include "ZclReadScheduler.h"
+
+namespace ZStack
+{
+    // Copy of one cached attribute, taken without locking
+    struct AttributeSnapshot
+    {
+        static constexpr size_t MAX_VALUE_SIZE = 48; // Fits a 32 char string attribute
+
+        uint8_t dataType;
+        uint8_t size;
+        uint8_t value[MAX_VALUE_SIZE];
+        uint64_t updatedMs; // Steady clock
+
+        ZclReadResult toResult(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID, uint16_t attributeID) const;
+    };
+
+    // Last known value of every (device, endpoint, cluster, attribute) we
+    // have heard, fed from reports and read responses.
+    //
+    // One thread writes (the client's event loop), any number of threads
+    // read. Entries live in a fixed open addressed table and never move:
+    // slots are only ever claimed, so readers probe it without locks. Each
+    // entry is guarded by a seqlock; a reader copies the value and retries
+    // if the writer got in between, so it never blocks and never sees a
+    // torn value. Values longer than MAX_VALUE_SIZE are not cached.
+    class AttributeCache
+    {
+    public:
+        // Rounded up to a power of two. Kept at most 3/4 full.
+        explicit AttributeCache(size_t capacity = 4096);
+
+        AttributeCache(const AttributeCache &) = delete;
+        AttributeCache &operator=(const AttributeCache &) = delete;
+
+        // Writer side
+        void handleFrame(const ZStackFrame &frame);
+        void update(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID, uint16_t attributeID,
+                    uint8_t dataType, const uint8_t *value, size_t size, uint64_t nowMs);
+
+        // Device left or its address moved: its values no longer apply
+        void forget(uint16_t shortAddr);
+
+        // Any thread. False if nothing (valid) is cached.
+        bool get(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID, uint16_t attributeID,
+                 AttributeSnapshot &snapshot) const;
+
+        size_t size() const { return used.load(std::memory_order_relaxed); }
+        size_t capacity() const { return mask + 1; }
+        uint64_t rejected() const { return rejectedCount.load(std::memory_order_relaxed); }
+
+        static uint64_t nowMs();
+
+    private:
+        static constexpr size_t VALUE_WORDS = AttributeSnapshot::MAX_VALUE_SIZE / 8;
+        static constexpr uint64_t OCCUPIED = 1ULL << 63;
+
+        struct Entry
+        {
+            std::atomic<uint64_t> key{0}; // OCCUPIED | packed key, 0 while free
+            std::atomic<uint32_t> sequence{0}; // Odd while the writer is inside
+            std::atomic<uint64_t> meta{0};     // valid << 16 | size << 8 | dataType
+            std::atomic<uint64_t> updatedMs{0};
+            std::atomic<uint64_t> value[VALUE_WORDS];
+        };
+
+        std::unique_ptr<Entry[]> entries;
+        size_t mask;
+        std::atomic<size_t> used{0};
+        std::atomic<uint64_t> rejectedCount{0};
+
+        static uint64_t packKey(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID, uint16_t attributeID);
+        static size_t hash(uint64_t key);
+
+        const Entry *find(uint64_t key) const;
+        Entry *claim(uint64_t key);
+        void write(Entry &entry, uint64_t meta, const uint8_t *value, size_t size, uint64_t nowMs);
+    };
+}
+
+#endif // ATTRIBUTE_CACHE_H
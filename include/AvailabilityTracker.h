@@ -0,0 +1,84 @@
+#ifndef AVAILABILITY_TRACKER_H
+#define AVAILABILITY_TRACKER_H
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+#include "TimerWheel.h"
+#include "ZStackFrame.h"
+
+namespace ZStack
+{
+    using AvailabilityHandler = std::function<void(uint16_t shortAddr, bool online)>;
+
+    // Tracks when every device was last heard from and raises online /
+    // offline events when a device misses a few of its reports.
+    //
+    // This sits on the receive path, so seen() is O(1) and never touches a
+    // timer: it stores a timestamp in a dense slot found by direct indexing
+    // on the NWK address. Each device owns one timer on the client's
+    // TimerWheel, due when it would expire if nothing more arrived. When it
+    // fires it either declares the device offline or re-arms for the time
+    // still left, so a device costs at most one timer callback per timeout.
+    class AvailabilityTracker
+    {
+    public:
+        using Clock = TimerWheel::Clock;
+
+        // A device is offline after missedReports * its report interval of silence
+        explicit AvailabilityTracker(TimerWheel &timers, int defaultIntervalMs = 600000, int missedReports = 3);
+        ~AvailabilityTracker();
+
+        AvailabilityTracker(const AvailabilityTracker &) = delete;
+        AvailabilityTracker &operator=(const AvailabilityTracker &) = delete;
+
+        // Picks the sender out of AF messages and ZDO indications / responses
+        void handleFrame(const ZStackFrame &frame);
+
+        void seen(uint16_t shortAddr);
+
+        // E.g. the max reporting interval the device was configured with
+        void setReportInterval(uint16_t shortAddr, int intervalMs);
+
+        // Stop tracking (device left, or its address moved)
+        void forget(uint16_t shortAddr);
+
+        bool isOnline(uint16_t shortAddr) const;
+        std::optional<Clock::time_point> lastSeen(uint16_t shortAddr) const;
+
+        size_t size() const { return devices.size() - freeSlots.size(); }
+        size_t onlineCount() const { return online; }
+
+        void setHandler(AvailabilityHandler availabilityHandler) { handler = std::move(availabilityHandler); }
+
+    private:
+        static constexpr uint32_t NONE = 0xFFFFFFFF;
+
+        struct Device
+        {
+            Clock::time_point lastSeen;
+            int timeoutMs;
+            TimerId timer;
+            uint16_t shortAddr;
+            bool online;
+            bool inUse;
+        };
+
+        TimerWheel &timers;
+        int defaultIntervalMs;
+        int missedReports;
+        AvailabilityHandler handler;
+
+        std::vector<uint32_t> slotByAddr; // 64k entries, NWK address -> slot
+        std::vector<Device> devices;
+        std::vector<uint32_t> freeSlots;
+        size_t online = 0;
+
+        uint32_t slotFor(uint16_t shortAddr);
+        void arm(uint32_t slot, int delayMs);
+        void expire(uint32_t slot);
+    };
+}
+
+#endif // AVAILABILITY_TRACKER_H
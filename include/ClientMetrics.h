@@ -0,0 +1,186 @@
+#ifndef CLIENT_METRICS_H
+#define CLIENT_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ZStackFrame.h"
+#include "ZStackParser.h"
+
+namespace ZStack
+{
+    struct HistogramSnapshot
+    {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sumUs = 0;
+        uint64_t maxUs = 0;
+
+        // Upper bound of the bucket holding the p-th value (p in 0..1), in us
+        uint64_t percentile(double p) const;
+    };
+
+    // Log-linear (HDR style) latency histogram in microseconds: 16 buckets
+    // per power of two, so every value is off by at most ~6%, from 1 us up
+    // to ~71 minutes in 464 buckets.
+    //
+    // One thread records, any thread may snapshot (relaxed atomics, no locks).
+    class LatencyHistogram
+    {
+    public:
+        static const int SUB_BITS = 4;
+        static const int SUB_BUCKETS = 1 << SUB_BITS;
+        static const int BUCKETS = (32 - SUB_BITS + 1) * SUB_BUCKETS;
+
+        void record(uint64_t valueUs);
+        HistogramSnapshot snapshot() const;
+
+        static size_t bucketFor(uint64_t valueUs);
+        static uint64_t bucketUpperBound(size_t bucket);
+
+    private:
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sumUs{0};
+        std::atomic<uint64_t> maxUs{0};
+    };
+
+    struct MetricsSnapshot
+    {
+        struct CommandCount
+        {
+            uint8_t cmd0;
+            uint8_t cmd1;
+            uint64_t rx;
+            uint64_t tx;
+        };
+
+        std::vector<CommandCount> commands;
+        uint64_t rxFrames = 0;
+        uint64_t txFrames = 0;
+        uint64_t txBytes = 0;
+
+        Parser::Stats parser;
+        uint64_t rpcErrors = 0;        // SRSP 0x60 0x00: the dongle rejected a command
+        uint64_t unknownSubsystem = 0; // Frames for a subsystem we do not know
+        uint64_t afConfirmFailures = 0;
+        uint64_t duplicatesDropped = 0; // Repeated AF_INCOMING_MSG (see DuplicateFilter)
+        uint64_t cachedReads = 0;       // Reads answered from the AttributeCache
+
+        uint64_t pendingRequests = 0;
+        uint64_t pendingReads = 0;
+        uint64_t inFlightReads = 0;
+        uint64_t timers = 0;
+
+        std::map<std::pair<uint8_t, uint8_t>, HistogramSnapshot> sreqLatency; // Keyed by the SREQ cmd0 / cmd1
+        HistogramSnapshot afConfirmLatency;                                  // AF_DATA_REQUEST -> AF_DATA_CONFIRM
+    };
+
+    // Counters and latency histograms for one ZStackClient.
+    //
+    // Everything is written from the client's event loop only, so updates are
+    // plain relaxed load/store pairs (no locked instructions). Readers on other
+    // threads call snapshot() / toPrometheus() without taking any lock; a
+    // snapshot may be a few events behind but is never torn per value.
+    class ClientMetrics
+    {
+    public:
+        ClientMetrics();
+        ~ClientMetrics();
+
+        ClientMetrics(const ClientMetrics &) = delete;
+        ClientMetrics &operator=(const ClientMetrics &) = delete;
+
+        // Hooks for the client (serialised frame on the way out, parsed frame on the way in)
+        void onTransmit(const uint8_t *frame, size_t size);
+        void onReceive(const ZStackFrame &frame);
+        void setParserStats(const Parser::Stats &stats);
+        void onDuplicateDropped();
+        void onCachedRead();
+        void setQueueDepths(size_t pendingRequests, size_t pendingReads, size_t inFlightReads, size_t timers);
+
+        MetricsSnapshot snapshot() const;
+
+        // Prometheus text exposition format (version 0.0.4)
+        std::string toPrometheus() const;
+
+        // Writes to path.tmp and renames, so a textfile collector never sees half a file
+        bool writePrometheusFile(const std::string &path) const;
+
+    private:
+        using CounterBlock = std::array<std::atomic<uint64_t>, 256>;
+
+        // Blocks are indexed by (type << 5 | subsystem) and allocated on first use
+        static const size_t BLOCKS = 128;
+        static const size_t COMMANDS = 32 * 256;
+
+        std::array<std::atomic<CounterBlock *>, BLOCKS> rxCounts{};
+        std::array<std::atomic<CounterBlock *>, BLOCKS> txCounts{};
+        std::unique_ptr<std::atomic<LatencyHistogram *>[]> sreqHistograms; // (subsystem << 8 | cmd1)
+        std::array<uint64_t, 256> afSentUs{};                              // By AF TransID, writer only
+        LatencyHistogram afConfirmHistogram;
+
+        // SREQs waiting for their SRSP, oldest first. The dongle answers in
+        // order, so an SRSP matches the oldest entry with the same command.
+        struct OutstandingSreq
+        {
+            uint16_t key;
+            uint64_t sentUs;
+        };
+        static const size_t MAX_OUTSTANDING = 64;
+        std::array<OutstandingSreq, MAX_OUTSTANDING> outstanding{};
+        size_t outstandingHead = 0;
+        size_t outstandingCount = 0;
+
+        std::atomic<uint64_t> rxFrames{0};
+        std::atomic<uint64_t> txFrames{0};
+        std::atomic<uint64_t> txBytes{0};
+        std::atomic<uint64_t> rpcErrors{0};
+        std::atomic<uint64_t> unknownSubsystem{0};
+        std::atomic<uint64_t> afConfirmFailures{0};
+        std::atomic<uint64_t> duplicatesDropped{0};
+        std::atomic<uint64_t> cachedReads{0};
+
+        std::atomic<uint64_t> parserFrames{0};
+        std::atomic<uint64_t> parserChecksumErrors{0};
+        std::atomic<uint64_t> parserDiscardedBytes{0};
+
+        std::atomic<uint64_t> pendingRequests{0};
+        std::atomic<uint64_t> pendingReads{0};
+        std::atomic<uint64_t> inFlightReads{0};
+        std::atomic<uint64_t> timers{0};
+
+        static void count(std::array<std::atomic<CounterBlock *>, BLOCKS> &blocks, uint8_t cmd0, uint8_t cmd1);
+        static uint64_t nowUs();
+        uint64_t takeOutstanding(uint16_t key);
+    };
+
+    // Serves ClientMetrics::toPrometheus() on a Unix domain socket: every
+    // connection gets the current text and is closed (e.g.
+    // `socat - UNIX-CONNECT:/run/zigbee.metrics`). Runs on its own thread.
+    class MetricsExporter
+    {
+    public:
+        explicit MetricsExporter(const ClientMetrics &metrics);
+        ~MetricsExporter();
+
+        bool listen(const std::string &socketPath);
+        void stop();
+
+    private:
+        const ClientMetrics &metrics;
+        std::string socketPath;
+        int listenFd;
+        std::atomic<bool> running;
+        std::thread worker;
+
+        void serve();
+    };
+}
+
+#endif // CLIENT_METRICS_H
@@ -0,0 +1,114 @@
+#ifndef COORDINATOR_MANAGER_H
+#define COORDINATOR_MANAGER_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ZStackClient.h"
+
+namespace ZStack
+{
+    struct CoordinatorConfig
+    {
+        std::string port;
+        size_t maxDevices = 200;  // Soft capacity, used to weigh the load
+        uint16_t panId = 0;       // 0 = keep whatever the dongle has in NV
+        uint32_t channelMask = 0; // 0 = keep, else e.g. 1 << 15 for channel 15
+        std::string capturePath;  // Optional serial trace
+    };
+
+    // Where a device lives: which coordinator, and its NWK address on that PAN
+    struct DeviceLocation
+    {
+        size_t coordinator;
+        uint16_t shortAddr;
+    };
+
+    // Runs several coordinators (one ZStackClient per dongle, each with its
+    // own PAN) from a single event loop, so one host is not limited to the
+    // device count and UART bandwidth of one radio.
+    //
+    // Devices are tracked by IEEE address; NWK addresses are only unique
+    // within a PAN, so lookups by NWK always name the coordinator too. The
+    // join window is only ever open on the least loaded coordinator and
+    // moves whenever a join changes which one that is.
+    class CoordinatorManager
+    {
+    public:
+        using ZdoHandler = std::function<void(size_t coordinator, const ZDOPacket::Packet &)>;
+        using AfHandler = std::function<void(size_t coordinator, const AFPacket::Packet &)>;
+        using FrameListener = std::function<void(size_t coordinator, const ZStackFrame &)>;
+
+        CoordinatorManager() = default;
+
+        CoordinatorManager(const CoordinatorManager &) = delete;
+        CoordinatorManager &operator=(const CoordinatorManager &) = delete;
+
+        // Returns the index of the new coordinator
+        size_t addCoordinator(const CoordinatorConfig &config);
+
+        // Connects and starts every coordinator. Ones that fail stay offline
+        // and never get joins; returns the number that came up.
+        size_t startAll();
+
+        // One turn of every coordinator's event loop. Waits (up to one timer
+        // tick) until any port has bytes, then reads only the ready ones, so
+        // an idle dongle never holds up the others.
+        void process();
+
+        // Opens joining on the least loaded coordinator that is up
+        void permitJoin(uint8_t durationSeconds);
+
+        size_t size() const { return coordinators.size(); }
+        ZStackClient &client(size_t coordinator) { return *coordinators[coordinator]->client; }
+        bool isUp(size_t coordinator) const { return coordinators[coordinator]->up; }
+        const std::vector<uint8_t> &coordinatorIEEE(size_t coordinator) const { return coordinators[coordinator]->ieee; }
+        size_t deviceCount(size_t coordinator) const { return coordinators[coordinator]->devices.size(); }
+
+        // Registry
+        std::optional<DeviceLocation> locate(uint64_t ieee) const;
+        uint64_t ieeeOf(size_t coordinator, uint16_t shortAddr) const; // 0 if unknown
+
+        // Seeds the registry, e.g. from a database of devices joined earlier
+        void assignDevice(uint64_t ieee, size_t coordinator, uint16_t shortAddr);
+
+        // Same handlers for every coordinator, told which one the packet came from
+        void setZdoPacketHandler(ZdoHandler handler) { zdoHandler = handler; }
+        void setAfPacketHandler(AfHandler handler) { afHandler = handler; }
+        void addFrameListener(FrameListener listener) { frameListeners.push_back(listener); }
+
+    private:
+        static constexpr int POLL_TIMEOUT_MS = 10; // The client timer wheel's resolution
+
+        struct Coordinator
+        {
+            CoordinatorConfig config;
+            std::unique_ptr<ZStackClient> client;
+            std::vector<uint8_t> ieee;
+            bool up = false;
+            std::unordered_map<uint16_t, uint64_t> devices; // NWK -> IEEE on this PAN
+        };
+
+        std::vector<std::unique_ptr<Coordinator>> coordinators;
+        std::unordered_map<uint64_t, DeviceLocation> registry;
+
+        ZdoHandler zdoHandler;
+        AfHandler afHandler;
+        std::vector<FrameListener> frameListeners;
+
+        // Current join window
+        std::optional<size_t> joinCoordinator;
+        std::chrono::steady_clock::time_point joinDeadline;
+
+        std::optional<size_t> leastLoaded() const;
+        void onZdoPacket(size_t coordinator, const ZDOPacket::Packet &packet);
+        void rebalanceJoin();
+    };
+}
+
+#endif // COORDINATOR_MANAGER_H
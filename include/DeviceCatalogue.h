@@ -0,0 +1,56 @@
+#ifndef DEVICE_CATALOGUE_H
+#define DEVICE_CATALOGUE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "zcl/ZclRequestBuilder.h"
+
+namespace ZStack
+{
+    // One server cluster of a catalogued model: bound to us, and every
+    // attribute in reporting configured in a single Configure Reporting frame
+    struct CatalogueCluster
+    {
+        uint8_t endpoint;
+        uint16_t clusterID;
+        std::vector<ZclReportingConfig> reporting;
+    };
+
+    // What a model looks like and how it should report, as identified by
+    // the Basic cluster Manufacturer Name (0x0004) and Model Identifier (0x0005)
+    struct CatalogueEntry
+    {
+        std::string manufacturer; // Empty: any manufacturer
+        std::string model;
+        std::vector<CatalogueCluster> clusters;
+    };
+
+    // Known device models and their ideal reporting setup.
+    //
+    // A catalogued device skips endpoint / descriptor discovery during its
+    // interview: one Basic read identifies it, and its bindings and
+    // reporting are applied straight from the entry (see
+    // DeviceInterviewer::setCatalogue). The built-in entries can be
+    // overridden and extended with add().
+    class DeviceCatalogue
+    {
+    public:
+        explicit DeviceCatalogue(bool builtIns = true);
+
+        // Replaces an existing entry for the same manufacturer and model
+        void add(CatalogueEntry entry);
+
+        // Exact (manufacturer, model) first, then a model-only entry
+        const CatalogueEntry *find(const std::string &manufacturer, const std::string &model) const;
+
+        size_t size() const { return entries.size(); }
+
+    private:
+        std::map<std::pair<std::string, std::string>, CatalogueEntry> entries;
+    };
+}
+
+#endif // DEVICE_CATALOGUE_H
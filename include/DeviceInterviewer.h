@@ -0,0 +1,155 @@
+#ifndef DEVICE_INTERVIEWER_H
+#define DEVICE_INTERVIEWER_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "ZStackFrame.h"
+#include "zcl/ZclRequestBuilder.h"
+#include "TimerWheel.h"
+
+namespace ZStack
+{
+    class ZStackClient;
+    class DeviceCatalogue;
+    struct CatalogueEntry;
+
+    struct EndpointDescriptor
+    {
+        uint8_t endpoint;
+        uint16_t profileID;
+        uint16_t deviceID;
+        std::vector<uint16_t> inputClusters;
+        std::vector<uint16_t> outputClusters;
+    };
+
+    // One attribute an interview configured for reporting, as configured
+    struct ReportingSetup
+    {
+        uint8_t endpoint;
+        uint16_t clusterID;
+        ZclReportingConfig config;
+    };
+
+    struct InterviewResult
+    {
+        uint16_t shortAddr;
+        uint64_t ieeeAddress;
+        bool success;
+        std::vector<EndpointDescriptor> endpoints;
+        std::vector<uint16_t> boundClusters; // Clusters bound and configured for reporting
+        uint16_t reportIntervalS = 0;        // Shortest max reporting interval configured, 0 if none
+        std::vector<ReportingSetup> reporting;
+        std::string manufacturer;            // Basic cluster, when a catalogue is in use
+        std::string model;
+        bool catalogued = false;             // Set up from the catalogue, not discovered
+    };
+
+    // Interviews freshly joined devices without ever blocking the reader:
+    //
+    //   [Basic: Manufacturer / Model -> catalogue entry]
+    //     or Active Endpoints -> Simple Descriptor (every endpoint)
+    //   -> Bind (every reportable cluster) -> Configure Reporting
+    //
+    // With a catalogue, one Basic read identifies the model and its
+    // endpoints, bindings and reporting come from the entry; discovery
+    // only runs for models it does not know. Binds, and then Configure
+    // Reporting frames (one per cluster, every attribute in it), go out
+    // together and are collected as they are answered.
+    //
+    // Each device runs its own little state machine driven by incoming
+    // frames. At most maxConcurrent devices are interviewed at once, the
+    // rest wait in a queue. Every step has a timeout (on the client's
+    // TimerWheel) and is retried a few times before the interview is given up.
+    class DeviceInterviewer
+    {
+    public:
+        using CompletionHandler = std::function<void(const InterviewResult &)>;
+
+        DeviceInterviewer(ZStackClient &client,
+                          const std::vector<uint8_t> &coordinatorIEEE,
+                          size_t maxConcurrent = 4,
+                          int stepTimeoutMs = 5000,
+                          int maxRetries = 3);
+        ~DeviceInterviewer();
+
+        // Queue a device for interview. Ignored if it is already queued or running.
+        void interview(uint16_t shortAddr, uint64_t ieeeAddress);
+
+        // Clusters that get bound and reported, with their reporting parameters
+        // (attribute, data type, intervals, reportable change).
+        void setReportingConfig(uint16_t clusterID, const ZclReportingConfig &config);
+
+        // Models to recognise from their Basic cluster (nullptr: always discover)
+        void setCatalogue(const DeviceCatalogue *deviceCatalogue) { catalogue = deviceCatalogue; }
+
+        void setCompletionHandler(CompletionHandler handler) { completionHandler = handler; }
+
+        void handleFrame(const ZStackFrame &frame);
+
+        size_t activeCount() const { return active.size(); }
+        size_t queuedCount() const { return queue.size(); }
+
+    private:
+        enum class Step
+        {
+            BASIC,
+            ACTIVE_ENDPOINTS,
+            SIMPLE_DESCRIPTOR,
+            BIND,
+            CONFIGURE_REPORTING,
+            DONE
+        };
+
+        // One cluster to bind and configure
+        struct Binding
+        {
+            uint8_t endpoint;
+            uint16_t clusterID;
+            std::vector<ZclReportingConfig> reporting;
+            uint8_t sequence = 0; // Of its outstanding Configure Reporting
+            bool configured = false;
+        };
+
+        struct Interview
+        {
+            InterviewResult result;
+            Step step;
+            std::vector<uint8_t> activeEndpoints;
+            size_t index;   // Endpoint currently being described
+            size_t answers; // Responses collected in a batched step
+            int attempts;   // Attempts for the current step
+            uint8_t sequence; // ZCL sequence of the outstanding Basic read
+            TimerId timer;  // Timeout of the current step
+            std::vector<Binding> bindings;
+        };
+
+        ZStackClient &client;
+        std::vector<uint8_t> coordinatorIEEE;
+        size_t maxConcurrent;
+        int stepTimeoutMs;
+        int maxRetries;
+        uint8_t nextSequence;
+        CompletionHandler completionHandler;
+        const DeviceCatalogue *catalogue = nullptr;
+
+        std::map<uint16_t, ZclReportingConfig> reportingConfigs;
+        std::deque<std::pair<uint16_t, uint64_t>> queue;
+        std::map<uint16_t, Interview> active; // Keyed by short address
+
+        uint8_t frameBuffer[MAX_MT_FRAME_SIZE];
+
+        void startQueued();
+        void sendStep(Interview &interview);
+        void advance(Interview &interview);
+        void identified(Interview &interview, const std::string &manufacturer, const std::string &model);
+        void configured(Interview &interview, uint16_t clusterID, uint8_t sequence, uint8_t status);
+        void timeout(uint16_t shortAddr);
+        void finish(uint16_t shortAddr, bool success);
+    };
+}
+
+#endif // DEVICE_INTERVIEWER_H
@@ -1,16 +1,23 @@
 #pragma once
+#include <cstdint>
+#include <cstdlib>
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <iomanip>
+#include <cctype>
+#include "Logger.h"
 
 struct ZigbeeDevice {
     std::string ieee;       // Unique ID (e.g., "00124B0014D8A123")
     uint16_t shortAddr;     // Network Address (e.g., 0x16C5)
     std::string name;       // Friendly Name (e.g., "Living Room Sensor")
+    uint32_t slot;          // Dense index (0, 1, 2...) for per-device state arrays
+    std::set<uint16_t> groups; // Groups cluster membership, as last reported by the device
 };
 
 class DeviceManager {
@@ -24,6 +31,12 @@ private:
     // 2. Look up by Short Address (Runtime ID)
     std::map<uint16_t, std::string> shortToIEEE;
 
+    // 3. Look up the slot by numeric IEEE (what the packet path has at hand)
+    std::map<uint64_t, uint32_t> slotByIEEE;
+
+    // 4. Group ID -> member IEEEs (the reverse of ZigbeeDevice::groups)
+    std::map<uint16_t, std::set<std::string>> membersByGroup;
+
 public:
     DeviceManager(const std::string& dbFile) : filename(dbFile) {
         load();
@@ -33,11 +46,25 @@ public:
     void addDevice(const std::string& ieee, uint16_t shortAddr) {
         // Check if we already know this device
         if (devicesByIEEE.find(ieee) == devicesByIEEE.end()) {
+            uint64_t key;
+            if (!parseHex(ieee, 16, key)) {
+                LOG_WARN << "[DeviceManager] Ignoring a device with a bad IEEE address \"" << ieee << "\"" << std::endl;
+                return;
+            }
+
             // New Device! Give it a default name.
             std::cout << "[DeviceManager] New Device Discovered: " << ieee << std::endl;
-            devicesByIEEE[ieee] = { ieee, shortAddr, "New Device" };
+            devicesByIEEE[ieee] = { ieee, shortAddr, "New Device", assignSlot(key), {} };
         } else {
             // Known Device: Just update the Short Address (it might have changed)
+            uint16_t oldShortAddr = devicesByIEEE[ieee].shortAddr;
+            if (oldShortAddr == shortAddr && shortToIEEE[shortAddr] == ieee) return; // Nothing new, skip the save
+
+            // The old address may be handed to another device: don't resolve it to this one
+            auto stale = shortToIEEE.find(oldShortAddr);
+            if (oldShortAddr != shortAddr && stale != shortToIEEE.end() && stale->second == ieee) {
+                shortToIEEE.erase(stale);
+            }
             devicesByIEEE[ieee].shortAddr = shortAddr;
         }
 
@@ -47,6 +74,11 @@ public:
         save(); // Save to disk immediately
     }
 
+    // Short address -> IEEE of every known device, e.g. to seed the client's AddressBook
+    const std::map<uint16_t, std::string>& getAddressMap() const {
+        return shortToIEEE;
+    }
+
     // Rename a device (The user feature!)
     void renameDevice(const std::string& ieee, const std::string& newName) {
         if (devicesByIEEE.find(ieee) != devicesByIEEE.end()) {
@@ -64,6 +96,58 @@ public:
         return "Unknown Device";
     }
 
+    // Slot of a device, -1 if we have never seen it. Stable while we run.
+    int getSlot(uint64_t ieee) {
+        auto it = slotByIEEE.find(ieee);
+        return it != slotByIEEE.end() ? static_cast<int>(it->second) : -1;
+    }
+
+    // Group membership cache, fed by Groups cluster responses
+    void addToGroup(const std::string& ieee, uint16_t groupID) {
+        auto it = devicesByIEEE.find(ieee);
+        if (it == devicesByIEEE.end() || !it->second.groups.insert(groupID).second) return;
+
+        membersByGroup[groupID].insert(ieee);
+        save();
+    }
+
+    void removeFromGroup(const std::string& ieee, uint16_t groupID) {
+        auto it = devicesByIEEE.find(ieee);
+        if (it == devicesByIEEE.end() || !it->second.groups.erase(groupID)) return;
+
+        membersByGroup[groupID].erase(ieee);
+        if (membersByGroup[groupID].empty()) membersByGroup.erase(groupID);
+        save();
+    }
+
+    // Full membership list (Get Group Membership answer) replaces what we had
+    void setGroups(const std::string& ieee, const std::vector<uint16_t>& groups) {
+        auto it = devicesByIEEE.find(ieee);
+        if (it == devicesByIEEE.end()) return;
+
+        std::set<uint16_t> updated(groups.begin(), groups.end());
+        if (updated == it->second.groups) return;
+
+        for (uint16_t groupID : it->second.groups) {
+            membersByGroup[groupID].erase(ieee);
+            if (membersByGroup[groupID].empty()) membersByGroup.erase(groupID);
+        }
+        for (uint16_t groupID : updated) membersByGroup[groupID].insert(ieee);
+
+        it->second.groups = updated;
+        save();
+    }
+
+    std::set<std::string> getGroupMembers(uint16_t groupID) {
+        auto it = membersByGroup.find(groupID);
+        return it != membersByGroup.end() ? it->second : std::set<std::string>();
+    }
+
+    std::set<uint16_t> getGroups(const std::string& ieee) {
+        auto it = devicesByIEEE.find(ieee);
+        return it != devicesByIEEE.end() ? it->second.groups : std::set<uint16_t>();
+    }
+
     // Lookup the IEEE using Short Address (needed for binding usually)
     std::string getIEEE(uint16_t shortAddr) {
         if (shortToIEEE.find(shortAddr) != shortToIEEE.end()) {
@@ -73,16 +157,41 @@ public:
     }
 
 private:
+    // Whole string must be hex, 1 to maxDigits digits. Never throws, unlike std::stoull.
+    static bool parseHex(const std::string& text, size_t maxDigits, uint64_t& value) {
+        if (text.empty() || text.size() > maxDigits || !std::isxdigit(static_cast<unsigned char>(text[0]))) return false;
+
+        char* end = nullptr;
+        value = std::strtoull(text.c_str(), &end, 16);
+        return end == text.c_str() + text.size();
+    }
+
+    uint32_t assignSlot(uint64_t key) {
+        auto it = slotByIEEE.find(key);
+        if (it != slotByIEEE.end()) return it->second;
+
+        uint32_t slot = static_cast<uint32_t>(slotByIEEE.size());
+        slotByIEEE[key] = slot;
+        return slot;
+    }
+
     void save() {
         std::ofstream file(filename);
         if (!file.is_open()) return;
 
         for (const auto& pair : devicesByIEEE) {
             const auto& dev = pair.second;
-            // Format: IEEE,ShortAddr,Name
+            // Format: IEEE,ShortAddr,Name[,Group;Group...]
             file << dev.ieee << "," 
                  << std::hex << dev.shortAddr << "," 
-                 << dev.name << std::endl;
+                 << dev.name;
+            if (!dev.groups.empty()) {
+                file << ",";
+                for (auto it = dev.groups.begin(); it != dev.groups.end(); ++it) {
+                    file << (it == dev.groups.begin() ? "" : ";") << std::hex << *it;
+                }
+            }
+            file << std::endl;
         }
     }
 
@@ -103,13 +212,36 @@ private:
 
             if (parts.size() >= 3) {
                 std::string ieee = parts[0];
-                // Convert Hex String back to integer
-                uint16_t shortAddr = std::stoul(parts[1], nullptr, 16); 
+                // Convert Hex Strings back to integers; a hand edited row may not be
+                uint64_t key, shortValue;
+                if (!parseHex(ieee, 16, key) || !parseHex(parts[1], 4, shortValue)) {
+                    LOG_WARN << "[DeviceManager] Skipping a row with a bad IEEE or short address: " << line << std::endl;
+                    continue;
+                }
+                uint16_t shortAddr = static_cast<uint16_t>(shortValue);
                 std::string name = parts[2];
 
+                // Optional 4th column: group IDs separated by ';'
+                std::set<uint16_t> groups;
+                if (parts.size() >= 4) {
+                    std::stringstream groupList(parts[3]);
+                    std::string groupID;
+                    while (std::getline(groupList, groupID, ';')) {
+                        if (groupID.empty()) continue;
+
+                        uint64_t value;
+                        if (parseHex(groupID, 4, value)) {
+                            groups.insert(static_cast<uint16_t>(value));
+                        } else {
+                            LOG_WARN << "[DeviceManager] " << ieee << ": ignoring bad group ID \"" << groupID << "\"" << std::endl;
+                        }
+                    }
+                }
+
                 // Store in memory
-                devicesByIEEE[ieee] = { ieee, shortAddr, name };
+                devicesByIEEE[ieee] = { ieee, shortAddr, name, assignSlot(key), groups };
                 shortToIEEE[shortAddr] = ieee;
+                for (uint16_t groupID : groups) membersByGroup[groupID].insert(ieee);
             }
         }
         std::cout << "[DeviceManager] Loaded " << devicesByIEEE.size() << " devices." << std::endl;
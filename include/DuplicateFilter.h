@@ -0,0 +1,60 @@
+#ifndef DUPLICATE_FILTER_H
+#define DUPLICATE_FILTER_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "ZStackFrame.h"
+
+namespace ZStack
+{
+    // Drops repeated AF_INCOMING_MSG frames before they are decoded.
+    //
+    // Mesh and application level retries deliver the same ZCL frame again
+    // with the same ZCL transaction sequence number. Every source keeps a
+    // tiny window of the last few (cluster, sequence, command) it sent; a
+    // frame matching one of them within windowMs is a duplicate. Sources
+    // sit in dense slots found by direct indexing on the NWK address, so a
+    // check is a handful of compares with no allocation.
+    class DuplicateFilter
+    {
+    public:
+        explicit DuplicateFilter(int windowMs = 5000);
+
+        // True if frame repeats a recent AF_INCOMING_MSG from the same source
+        bool isDuplicate(const ZStackFrame &frame);
+
+        bool isDuplicate(uint16_t shortAddr, uint16_t clusterID, uint8_t zclSequence, uint8_t zclCommand);
+
+        void setWindow(int ms) { windowMs = ms > 0 ? ms : 0; }
+        uint64_t dropped() const { return droppedCount; }
+
+    private:
+        static const size_t WAYS = 4; // Frames remembered per source
+
+        struct Entry
+        {
+            uint32_t timeMs;
+            uint16_t clusterID;
+            uint8_t sequence;
+            uint8_t command;
+            bool used;
+        };
+
+        struct Window
+        {
+            Entry entries[WAYS];
+            uint8_t next;
+        };
+
+        static constexpr uint32_t NONE = 0xFFFFFFFF;
+
+        int windowMs;
+        std::chrono::steady_clock::time_point start;
+        std::vector<uint32_t> slotByAddr; // 64k entries, NWK address -> window
+        std::vector<Window> windows;
+        uint64_t droppedCount = 0;
+    };
+}
+
+#endif // DUPLICATE_FILTER_H
@@ -0,0 +1,82 @@
+#ifndef FRAME_BUFFER_H
+#define FRAME_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ZStack
+{
+    // Largest MT frame: SOF + LEN + CMD0 + CMD1 + 250 byte payload + FCS
+    constexpr size_t MAX_MT_FRAME_SIZE = 255;
+
+    // A finished, ready-to-send MT frame living in someone else's memory
+    struct FrameView
+    {
+        const uint8_t *data;
+        size_t size;
+
+        bool valid() const { return data != nullptr && size > 0; }
+    };
+
+    // Serialises one MT frame straight into a caller supplied buffer.
+    // The checksum is folded in as bytes are written, so the frame is built
+    // in a single pass. Overflows are sticky: finish() then returns an
+    // invalid view instead of writing past the end.
+    class FrameWriter
+    {
+    public:
+        FrameWriter(uint8_t *buffer, size_t capacity);
+
+        void begin(uint8_t cmd0, uint8_t cmd1);
+
+        void u8(uint8_t value);
+        void u16(uint16_t value);
+        void u32(uint32_t value);
+        void bytes(const uint8_t *data, size_t length);
+
+        // Reserve one byte that is filled in later (e.g. a nested length)
+        size_t placeholder();
+        void patch(size_t offset, uint8_t value);
+
+        // Bytes written since begin(), i.e. the MT payload length so far
+        size_t payloadSize() const { return position - HEADER_SIZE; }
+
+        FrameView finish();
+
+        bool overflowed() const { return overflow; }
+
+    private:
+        static constexpr size_t HEADER_SIZE = 4; // SOF, LEN, CMD0, CMD1
+
+        uint8_t *buffer;
+        size_t capacity;
+        size_t position;
+        uint8_t checksum;
+        bool overflow;
+    };
+
+    // Bump allocator for frames. Build as many frames as fit, send them,
+    // then reset() and reuse the same memory for the next batch.
+    class FrameArena
+    {
+    public:
+        explicit FrameArena(size_t capacity = 16 * 1024);
+
+        // Space for one frame of up to MAX_MT_FRAME_SIZE bytes, or nullptr if full.
+        // Only the bytes passed to commit() are actually consumed.
+        uint8_t *reserve();
+        void commit(const FrameView &frame);
+
+        void reset() { offset = 0; }
+
+        size_t used() const { return offset; }
+        size_t capacity() const { return storage.size(); }
+
+    private:
+        std::vector<uint8_t> storage;
+        size_t offset;
+    };
+}
+
+#endif // FRAME_BUFFER_H
@@ -0,0 +1,83 @@
+#ifndef HANDLER_EXECUTOR_H
+#define HANDLER_EXECUTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ZStack
+{
+    // What submit() does when the shard's queue is full
+    enum class OverflowPolicy : uint8_t
+    {
+        BLOCK,       // Wait for room: the I/O thread slows down to the handlers' pace
+        DROP_NEWEST, // Throw the new job away
+        DROP_OLDEST  // Throw the oldest queued job of that shard away
+    };
+
+    // Runs packet handlers on a pool of worker threads.
+    //
+    // Each worker owns one shard: a bounded FIFO and the thread draining it.
+    // Jobs are routed by key (the source NWK address), so everything from
+    // one device runs on the same worker, in arrival order, while other
+    // devices proceed in parallel on the other workers. A slow handler only
+    // holds up the devices that share its shard.
+    class HandlerExecutor
+    {
+    public:
+        using Job = std::function<void()>;
+
+        // workers = 0: one per core
+        explicit HandlerExecutor(size_t workers = 0,
+                                 size_t queueCapacity = 256,
+                                 OverflowPolicy policy = OverflowPolicy::BLOCK);
+        ~HandlerExecutor();
+
+        HandlerExecutor(const HandlerExecutor &) = delete;
+        HandlerExecutor &operator=(const HandlerExecutor &) = delete;
+
+        // False when the job (or, with DROP_OLDEST, an older one) was dropped
+        // or the executor is stopped
+        bool submit(uint64_t key, Job job);
+
+        // Blocks until every job submitted so far has run
+        void drain();
+
+        // Runs what is queued, then joins the workers. Later submits are refused.
+        void stop();
+
+        size_t workers() const { return shards.size(); }
+        size_t queued() const;
+        uint64_t executed() const { return executedCount.load(std::memory_order_relaxed); }
+        uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+    private:
+        struct Shard
+        {
+            std::mutex mutex;
+            std::condition_variable notEmpty;
+            std::condition_variable notFull; // Also signalled when the shard goes idle
+            std::deque<Job> jobs;
+            bool busy = false;
+            std::thread worker;
+        };
+
+        std::vector<std::unique_ptr<Shard>> shards;
+        size_t queueCapacity;
+        OverflowPolicy policy;
+        std::atomic<bool> stopping{false};
+        std::atomic<uint64_t> executedCount{0};
+        std::atomic<uint64_t> droppedCount{0};
+
+        Shard &shardFor(uint64_t key);
+        void run(Shard &shard);
+    };
+}
+
+#endif // HANDLER_EXECUTOR_H
@@ -0,0 +1,144 @@
+#ifndef OTA_SERVER_H
+#define OTA_SERVER_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ZStackFrame.h"
+#include "TimerWheel.h"
+
+namespace ZStack
+{
+    class ZStackClient;
+
+    // One firmware file in the Zigbee OTA format, mapped read only
+    struct OtaImage
+    {
+        std::string path;
+        uint16_t manufacturerCode;
+        uint16_t imageType;
+        uint32_t fileVersion;
+        std::string headerString;
+        const uint8_t *data; // Whole file, header included (block offsets count from here)
+        size_t size;
+    };
+
+    // OTA Upgrade cluster (0x0019) server.
+    //
+    // Images are mmap'd once and their headers parsed and indexed by
+    // (manufacturer, image type) when they are added, so a Query Next Image
+    // is a single lookup. Image Block responses are serialised straight from
+    // the mapping into the outgoing frame; nothing is read or copied per
+    // request besides the block itself.
+    //
+    // A single upgrade is thousands of block round trips, so every transfer
+    // shares one token bucket (blocksPerSecond, burst) that bounds how much
+    // airtime OTA gets. A device asking while the bucket is empty is told
+    // WAIT_FOR_DATA with a retry time and a minimum block period that
+    // spreads the budget over the transfers in progress, so well behaved
+    // devices pace themselves from then on. Blocks go out at
+    // SendPriority::BULK.
+    class OtaServer
+    {
+    public:
+        using ProgressHandler = std::function<void(uint16_t shortAddr, const OtaImage &image, uint32_t offset)>;
+        using CompletionHandler = std::function<void(uint16_t shortAddr, const OtaImage &image, bool success)>;
+
+        OtaServer(ZStackClient &client,
+                  double blocksPerSecond = 20.0,
+                  size_t burst = 5,
+                  uint8_t maxBlockSize = 64);
+        ~OtaServer();
+
+        OtaServer(const OtaServer &) = delete;
+        OtaServer &operator=(const OtaServer &) = delete;
+
+        // Maps the file and indexes its header. A newer version of the same
+        // manufacturer / image type replaces the older one for new queries.
+        bool addImage(const std::string &path);
+
+        // Adds every *.ota / *.zigbee file in directory. Returns how many were added.
+        size_t loadDirectory(const std::string &directory);
+
+        // Image Notify: asks the device to query now instead of at its next poll
+        void notify(uint16_t shortAddr, uint8_t endpoint = 0x01);
+
+        void handleFrame(const ZStackFrame &frame);
+
+        void setProgressHandler(ProgressHandler handler) { progressHandler = std::move(handler); }
+        void setCompletionHandler(CompletionHandler handler) { completionHandler = std::move(handler); }
+
+        size_t images() const { return index.size(); }
+        size_t activeTransfers() const;
+        uint64_t blocksServed() const { return servedCount; }
+        uint64_t blocksDeferred() const { return deferredCount; }
+
+    private:
+        using Clock = TimerWheel::Clock;
+
+        static constexpr uint32_t OTA_MAGIC = 0x0BEEF11E;
+        static constexpr size_t OTA_MIN_HEADER = 56;
+        static constexpr int TRANSFER_IDLE_MS = 5 * 60 * 1000;
+
+        struct Mapping
+        {
+            OtaImage image;
+            void *address;
+            size_t length;
+        };
+
+        struct Transfer
+        {
+            const OtaImage *image;
+            uint32_t offset = 0;
+            Clock::time_point lastRequest;
+        };
+
+        struct Request
+        {
+            uint16_t shortAddr;
+            uint8_t srcEndpoint;
+            uint8_t dstEndpoint;
+            uint8_t sequence;
+            const uint8_t *payload;
+            size_t length;
+        };
+
+        ZStackClient &client;
+        double blocksPerSecond;
+        double burst;
+        uint8_t maxBlockSize;
+        uint8_t nextSequence = 0x40;
+
+        // Token bucket
+        double tokens;
+        Clock::time_point refilled;
+
+        std::vector<std::unique_ptr<Mapping>> mappings;
+        std::unordered_map<uint32_t, const OtaImage *> index; // manufacturer << 16 | image type, newest version
+        std::map<uint16_t, Transfer> transfers;
+
+        uint64_t servedCount = 0;
+        uint64_t deferredCount = 0;
+
+        ProgressHandler progressHandler;
+        CompletionHandler completionHandler;
+
+        const OtaImage *find(uint16_t manufacturerCode, uint16_t imageType) const;
+        bool takeToken(Clock::time_point now);
+        uint32_t waitSeconds() const;
+        uint16_t minBlockPeriodMs(Clock::time_point now) const;
+
+        void queryNextImage(const Request &request);
+        void imageBlock(const Request &request);
+        void upgradeEnd(const Request &request);
+        void respond(const Request &request, uint8_t commandID, const uint8_t *header, size_t headerLength,
+                     const uint8_t *data = nullptr, size_t dataLength = 0);
+    };
+}
+
+#endif // OTA_SERVER_H
@@ -0,0 +1,95 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+#include "FrameBuffer.h"
+#include "ZStackFrame.h"
+
+namespace ZStack
+{
+    enum class SendPriority : uint8_t
+    {
+        INTERACTIVE = 0, // Someone is waiting: light switches, scene changes, blocking calls
+        NORMAL = 1,      // Reads, polling, everyday requests
+        BULK = 2         // Interviews, topology sweeps, maintenance
+    };
+
+    // Outbound frames between the client and the serial port.
+    //
+    // The coordinator only has room for a few commands at a time, so at most
+    // inFlightBudget frames are outstanding: an SREQ until its SRSP, an AF
+    // data request until its AF_DATA_CONFIRM. When the budget is full,
+    // frames wait in one FIFO per priority class and leave by smooth
+    // weighted round robin (16 : 4 : 1 by default), so interactive traffic
+    // overtakes a bulk backlog without ever starving it. Bulk frames also
+    // leave bulkReserve slots free, so an interactive frame finds room
+    // right away. With nothing queued and room in the budget, a frame is
+    // written straight through without being copied.
+    class OutboundQueue
+    {
+    public:
+        using Writer = std::function<void(const uint8_t *data, size_t size)>;
+
+        explicit OutboundQueue(Writer writer,
+                               size_t inFlightBudget = 4,
+                               size_t bulkReserve = 1,
+                               int responseTimeoutMs = 3000);
+
+        void push(const uint8_t *data, size_t size, SendPriority priority);
+
+        // Frees budget on SRSP / AF_DATA_CONFIRM / RPC errors
+        void onReceive(const ZStackFrame &frame);
+
+        // Sends what the budget allows and expires lost responses
+        void pump();
+
+        void setWeights(int interactive, int normal, int bulk);
+
+        size_t queued() const;
+        size_t queued(SendPriority priority) const { return queues[static_cast<size_t>(priority)].size(); }
+        size_t inFlight() const { return outstanding.size(); }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+        static constexpr size_t CLASSES = 3;
+
+        struct Slot
+        {
+            uint8_t data[MAX_MT_FRAME_SIZE];
+            uint8_t size;
+        };
+
+        struct Outstanding
+        {
+            uint8_t cmd0;
+            uint8_t cmd1;
+            int16_t transID; // AF data requests waiting for their confirm, -1 otherwise
+            bool confirming; // SRSP seen, waiting for AF_DATA_CONFIRM
+            Clock::time_point deadline;
+        };
+
+        Writer writer;
+        size_t inFlightBudget;
+        size_t bulkReserve;
+        Clock::duration responseTimeout;
+
+        std::vector<Slot> pool; // Frame copies, reused through freeSlots
+        std::vector<uint32_t> freeSlots;
+        std::deque<uint32_t> queues[CLASSES];
+        int weights[CLASSES] = {16, 4, 1};
+        int credits[CLASSES] = {0, 0, 0};
+
+        std::vector<Outstanding> outstanding;
+
+        bool eligible(size_t priorityClass) const;
+        int pick();
+        void write(const uint8_t *data, size_t size);
+        void expire(Clock::time_point now);
+    };
+}
+
+#endif // OUTBOUND_QUEUE_H
@@ -0,0 +1,65 @@
+#ifndef READING_FILTER_H
+#define READING_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ZStack
+{
+    // When a reading is worth storing. A reading passes when it is the
+    // first one, when it moved by at least `deadband` since the last stored
+    // value (and minIntervalMs has passed since then), or when nothing was
+    // stored for heartbeatMs.
+    struct FilterRule
+    {
+        double deadband = 0.0; // 0 = any change
+        int minIntervalMs = 0;
+        int heartbeatMs = 0;   // 0 = never store an unchanged value again
+    };
+
+    // Change / deadband / heartbeat filter in front of persistence.
+    //
+    // Rules are per (cluster, attribute); the state is one flat array with
+    // MAX_ATTRIBUTES entries per device, indexed by the device's slot (see
+    // DeviceManager::getSlot), so a check is an index computation and a
+    // couple of compares. Attributes without a rule always pass.
+    class ReadingFilter
+    {
+    public:
+        static const size_t MAX_ATTRIBUTES = 8;
+
+        // Returns false if MAX_ATTRIBUTES rules already exist
+        bool setRule(uint16_t clusterID, uint16_t attributeID, const FilterRule &rule);
+
+        // True if the reading should be stored
+        bool accept(uint32_t deviceSlot, uint16_t clusterID, uint16_t attributeID, double value, uint64_t timestampMs);
+
+        // Forget what was stored for a device (e.g. its slot got reused)
+        void reset(uint32_t deviceSlot);
+
+        uint64_t passed() const { return passedCount; }
+        uint64_t suppressed() const { return suppressedCount; }
+
+    private:
+        struct Rule
+        {
+            uint32_t key; // cluster << 16 | attribute
+            FilterRule rule;
+        };
+
+        struct State
+        {
+            double lastValue;
+            uint64_t lastStoredMs;
+            bool stored;
+        };
+
+        std::vector<Rule> rules; // Column = position in this list
+        std::vector<State> states; // deviceSlot * MAX_ATTRIBUTES + column
+        uint64_t passedCount = 0;
+        uint64_t suppressedCount = 0;
+    };
+}
+
+#endif // READING_FILTER_H
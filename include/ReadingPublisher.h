@@ -0,0 +1,34 @@
+#ifndef READING_PUBLISHER_H
+#define READING_PUBLISHER_H
+
+#include <string>
+#include "ReadingRing.h"
+#include "af/AFPacketParser.h"
+
+namespace ZStack
+{
+    // Attribute used for button presses, which are commands and carry no attribute
+    static const uint16_t READING_ATTRIBUTE_COMMAND = 0xFFFF;
+
+    // Turns decoded AF readings into ReadingRecords and publishes them on a
+    // shared memory ring (see ReadingRingReader for the consumer side).
+    class ReadingPublisher
+    {
+    public:
+        bool open(const std::string &name, size_t capacity = 65536) { return ring.open(name, capacity); }
+        bool isOpen() const { return ring.isOpen(); }
+
+        // Publishes the reading carried by msg (if any). ieee is 0 when unknown.
+        bool publish(const AFPacket::IncomingMessage &msg, uint64_t ieee);
+
+        uint64_t published() const { return ring.published(); }
+
+        // Fills in cluster / attribute / value; false for reading types with no record form
+        static bool toRecord(const AFPacket::IncomingMessage &msg, uint64_t ieee, ReadingRecord &record);
+
+    private:
+        ReadingRingWriter ring;
+    };
+}
+
+#endif // READING_PUBLISHER_H
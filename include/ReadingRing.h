@@ -0,0 +1,113 @@
+#ifndef READING_RING_H
+#define READING_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ZStack
+{
+    // One decoded reading as it goes over shared memory. Fixed size, no pointers.
+    struct ReadingRecord
+    {
+        uint64_t timestampUs; // Wall clock, microseconds since the epoch
+        uint64_t ieee;        // 0 if the device is not known yet
+        double value;         // Scaled (e.g. 21.53 for 21.53 C)
+        uint16_t shortAddr;
+        uint16_t clusterID;
+        uint16_t attributeID;
+        uint8_t endpoint;
+        uint8_t kind; // AFPacket::DeviceType
+    };
+
+    static_assert(sizeof(ReadingRecord) == 32, "ReadingRecord is part of the shared memory layout");
+
+    // Shared memory layout (/dev/shm/<name>):
+    //
+    //   RingHeader | RingSlot[capacity]
+    //
+    // Single writer, any number of readers, no locks and no broker. Each slot
+    // carries its own sequence number (a per-slot seqlock): odd while the
+    // writer is filling it, 2 * index + 2 once record `index` is complete.
+    // Readers copy the record out and re-check the sequence; if it moved, the
+    // writer lapped them and they skip ahead.
+    struct RingHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t capacity; // Power of two
+        uint64_t slotSize;
+        std::atomic<uint64_t> writeIndex; // Index of the next record to be written
+        std::atomic<uint64_t> epoch;      // Bumped whenever the layout is (re)initialised
+    };
+
+    struct alignas(64) RingSlot
+    {
+        static const size_t WORDS = sizeof(ReadingRecord) / sizeof(uint64_t);
+
+        std::atomic<uint64_t> sequence;
+        std::atomic<uint64_t> words[WORDS]; // The record, word by word so copies are race free
+    };
+
+    class ReadingRingWriter
+    {
+    public:
+        ReadingRingWriter() = default;
+        ~ReadingRingWriter() { close(); }
+
+        ReadingRingWriter(const ReadingRingWriter &) = delete;
+        ReadingRingWriter &operator=(const ReadingRingWriter &) = delete;
+
+        // Creates (or re-attaches to) /dev/shm/<name>. An existing ring with the
+        // same capacity keeps its index, so readers survive a driver restart.
+        bool open(const std::string &name, size_t capacity = 65536);
+        void close();
+        bool isOpen() const { return header != nullptr; }
+
+        void publish(const ReadingRecord &record);
+
+        uint64_t published() const;
+
+    private:
+        RingHeader *header = nullptr;
+        RingSlot *slots = nullptr;
+        size_t mappedSize = 0;
+        uint64_t mask = 0;
+    };
+
+    class ReadingRingReader
+    {
+    public:
+        ReadingRingReader() = default;
+        ~ReadingRingReader() { close(); }
+
+        ReadingRingReader(const ReadingRingReader &) = delete;
+        ReadingRingReader &operator=(const ReadingRingReader &) = delete;
+
+        // Maps the ring read-only. By default reading starts with the next
+        // record published; fromOldest starts at the oldest one still in the ring.
+        bool open(const std::string &name, bool fromOldest = false);
+        void close();
+
+        // Copies the next record out. False when caught up with the writer.
+        bool next(ReadingRecord &record);
+
+        // Records overwritten before this reader got to them
+        uint64_t dropped() const { return droppedCount; }
+
+        // The writer re-initialised the ring (different capacity): reopen
+        bool stale() const;
+
+    private:
+        const RingHeader *header = nullptr;
+        const RingSlot *slots = nullptr;
+        size_t mappedSize = 0;
+        uint64_t mask = 0;
+        uint64_t readIndex = 0;
+        uint64_t epoch = 0;
+        uint64_t droppedCount = 0;
+    };
+}
+
+#endif // READING_RING_H
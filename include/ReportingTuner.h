@@ -0,0 +1,122 @@
+#ifndef REPORTING_TUNER_H
+#define REPORTING_TUNER_H
+
+#include <chrono>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include "ZStackFrame.h"
+#include "FrameBuffer.h"
+#include "TimerWheel.h"
+#include "zcl/ZclRequestBuilder.h"
+
+namespace ZStack
+{
+    class ZStackClient;
+    class SleepyMailbox;
+
+    // Keeps attribute reporting under a network wide airtime budget.
+    //
+    // Every AF message received counts against a frames per second budget,
+    // measured over a window of evaluateMs. Each tracked attribute keeps its
+    // own report rate and how much its value moves (a smoothed standard
+    // deviation, in units of its reportable change).
+    //
+    // Over budget, the calmest attributes are slowed first: each step
+    // doubles their min interval and reportable change, until the expected
+    // savings cover the excess. Well under budget, slowed attributes get
+    // their freshness back, busiest first. The max interval is never
+    // touched (availability tracking relies on it), clusters marked user
+    // visible are never slowed, and discrete attributes (on/off, enums)
+    // only report on change and are left alone.
+    //
+    // Reconfigurations go through the SleepyMailbox when there is one, so
+    // battery devices get them when they wake up; an attribute is left
+    // alone until its last change is answered or the mailbox gives up on
+    // it. Its mail must not be delivered after the tuner is gone.
+    class ReportingTuner
+    {
+    public:
+        ReportingTuner(ZStackClient &client,
+                       double budgetFramesPerSecond = 5.0,
+                       int evaluateMs = 5 * 60 * 1000,
+                       SleepyMailbox *mailbox = nullptr,
+                       int maxLevel = 4);
+        ~ReportingTuner();
+
+        ReportingTuner(const ReportingTuner &) = delete;
+        ReportingTuner &operator=(const ReportingTuner &) = delete;
+
+        // An attribute was configured for reporting with config (e.g. by an
+        // interview): the baseline it is slowed from and restored to
+        void track(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID, const ZclReportingConfig &config);
+
+        // Someone is looking at it: back to (and kept at) the baseline
+        void setVisible(uint16_t shortAddr, uint16_t clusterID, bool visible = true);
+
+        // Device left or its address moved
+        void forget(uint16_t shortAddr);
+
+        void handleFrame(const ZStackFrame &frame);
+
+        // Close the current window and rebalance now (the timer does this every evaluateMs)
+        void evaluate();
+
+        double measuredFramesPerSecond() const { return measuredRate; }
+        double budget() const { return budgetRate; }
+        size_t tracked() const { return streams.size(); }
+        uint64_t reconfigurations() const { return reconfigured; }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Stream
+        {
+            uint16_t shortAddr;
+            uint8_t endpoint;
+            uint16_t clusterID;
+            ZclReportingConfig base;
+            int level = 0;         // Applied: min interval and reportable change x 2^level
+            int pendingLevel = -1; // Sent, not answered yet
+            uint8_t sequence = 0;
+            bool delivered = false; // The pending change reached the device
+            Clock::time_point deliveredAt{};
+            bool fixed = false;    // Device refused a change, left as it is
+            uint32_t reports = 0;  // This window
+            double rate = 0.0;     // Reports per second, smoothed over windows
+            bool sampled = false;
+            double mean = 0.0;
+            double variance = 0.0;
+
+            double activity() const;
+        };
+
+        ZStackClient &client;
+        SleepyMailbox *mailbox;
+        double budgetRate;
+        int maxLevel;
+
+        std::unordered_map<uint64_t, Stream> streams;
+        std::set<std::pair<uint16_t, uint16_t>> visible; // (shortAddr, clusterID)
+
+        Clock::time_point windowStart;
+        uint64_t frames = 0; // This window
+        double measuredRate = 0.0;
+        uint64_t reconfigured = 0;
+        uint8_t nextSequence = 0xC0;
+        TimerId timer = INVALID_TIMER;
+
+        uint8_t frameBuffer[MAX_MT_FRAME_SIZE];
+
+        static uint64_t key(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID, uint16_t attributeID);
+
+        bool isVisible(const Stream &stream) const;
+        void sample(Stream &stream, uint8_t dataType, const std::vector<uint8_t> &value);
+        void configured(uint16_t shortAddr, uint16_t clusterID, uint8_t sequence, uint8_t status);
+        void delivered(uint64_t streamKey, uint8_t sequence, bool ok);
+        void apply(Stream &stream, int level);
+    };
+}
+
+#endif // REPORTING_TUNER_H
@@ -3,6 +3,8 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include "SerialTrace.h"
 
 class SerialPort {
 public:
@@ -18,14 +20,25 @@ public:
     
     // Send raw bytes (for the Z-Stack protocol)
     int writeBytes(const std::vector<unsigned char>& data);
+    int writeBytes(const unsigned char* data, size_t size);
     
     // Read raw bytes
     int readBytes(std::vector<unsigned char>& buffer);
 
+    // For poll()ing several ports at once; -1 while closed
+    int getFileDescriptor() const { return fileDescriptor; }
+
+    // Record every byte read or written to a timestamped trace file
+    // (see SerialTrace.h), for replaying field problems later.
+    bool startCapture(const std::string& tracePath);
+    void stopCapture();
+    void flushCapture();
+
 private:
     std::string portName;
     int fileDescriptor; // The ID Linux gives the open file
     bool isConnected;
+    std::unique_ptr<ZStack::TraceWriter> capture;
     
     // Helper to configure termios (Baud rate, Parity, etc.)
     bool configureTermios(); 
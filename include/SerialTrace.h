@@ -0,0 +1,81 @@
+#ifndef SERIAL_TRACE_H
+#define SERIAL_TRACE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ZStack
+{
+    enum class TraceDirection : uint8_t
+    {
+        RX = 0, // Dongle -> host
+        TX = 1  // Host -> dongle
+    };
+
+    struct TraceRecord
+    {
+        TraceDirection direction;
+        uint64_t timestampUs; // Since the start of the capture
+        std::vector<uint8_t> data;
+    };
+
+    // Compact binary trace of raw serial traffic.
+    //
+    //   Header:  "ZSTR" | version (1) | reserved (3) | wall clock at start, us since epoch (8, LE)
+    //   Record:  direction (1) | delta us since previous record (varint) | length (varint) | bytes
+    //
+    // Reports are ~30 bytes on the wire, so a record costs 3-4 bytes of overhead.
+    // The file is flushed every FLUSH_RECORDS records or FLUSH_INTERVAL_US,
+    // whichever comes first, so a crash loses at most the last second.
+    class TraceWriter
+    {
+    public:
+        TraceWriter() = default;
+        ~TraceWriter() { close(); }
+
+        bool open(const std::string &path);
+        void close();
+        bool isOpen() const { return file.is_open(); }
+
+        void record(TraceDirection direction, const uint8_t *data, size_t size);
+
+        // Pushes buffered records to disk; also meant for a periodic timer,
+        // since a quiet port would otherwise keep its last records buffered
+        void flush();
+
+        static constexpr size_t FLUSH_RECORDS = 64;
+        static constexpr uint64_t FLUSH_INTERVAL_US = 1000000;
+
+    private:
+        std::ofstream file;
+        uint64_t startUs = 0;
+        uint64_t lastUs = 0;
+        uint64_t flushedUs = 0;
+        size_t unflushed = 0; // Records written since the last flush
+
+        void writeVarint(uint64_t value);
+    };
+
+    class TraceReader
+    {
+    public:
+        bool open(const std::string &path);
+
+        // False at the end of the trace (or on a truncated record)
+        bool next(TraceRecord &record);
+
+        uint64_t startWallClockUs() const { return startUs; }
+
+    private:
+        std::ifstream file;
+        uint64_t startUs = 0;
+        uint64_t currentUs = 0;
+
+        bool readVarint(uint64_t &value);
+    };
+}
+
+#endif // SERIAL_TRACE_H
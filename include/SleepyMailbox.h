@@ -0,0 +1,130 @@
+#ifndef SLEEPY_MAILBOX_H
+#define SLEEPY_MAILBOX_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <optional>
+#include "ZStackFrame.h"
+#include "FrameBuffer.h"
+#include "TimerWheel.h"
+
+namespace ZStack
+{
+    class ZStackClient;
+
+    // Holds commands for battery powered end devices until they can hear them.
+    //
+    // A sleepy device only picks up its messages when it polls its parent,
+    // and the parent drops them after ~7.7 s, so a command sent at a random
+    // time mostly fails. Instead, commands wait in a per-device mailbox and
+    // go out back to back when the device shows signs of life: any frame
+    // from it, or a Poll Control check-in (answered with "start fast
+    // polling" while mail is waiting, and Fast Poll Stop once it is all
+    // delivered).
+    //
+    // The mailbox also learns how often each device wakes up (the gap
+    // between bursts of traffic, smoothed) and sends a little before the
+    // next expected wake, so the parent already holds the command when
+    // the device polls. A delivery that fails (device asleep again) goes
+    // back to the front of the mailbox. Everything runs on the client's
+    // TimerWheel.
+    class SleepyMailbox
+    {
+    public:
+        // delivered = AF_DATA_CONFIRM success; false once attempts or time ran out
+        using ResultHandler = std::function<void(bool delivered)>;
+
+        SleepyMailbox(ZStackClient &client,
+                      int awakeWindowMs = 2000,
+                      int expiryMs = 6 * 3600 * 1000,
+                      size_t maxPerDevice = 16,
+                      int maxAttempts = 3);
+        ~SleepyMailbox();
+
+        // Devices not marked sleepy get their commands right away
+        void setSleepy(uint16_t shortAddr, bool sleepy = true);
+        bool isSleepy(uint16_t shortAddr) const;
+
+        // Queue an AF data request (e.g. from AFDataRequestFactory or
+        // ZclRequestBuilder) for shortAddr. When the mailbox is full the
+        // oldest command is dropped.
+        void post(uint16_t shortAddr, const ZStackFrame &frame, ResultHandler handler = nullptr);
+        void post(uint16_t shortAddr, const FrameView &frame, ResultHandler handler = nullptr);
+
+        void handleFrame(const ZStackFrame &frame);
+
+        // Device left or its address moved: its mail is dropped (reported as not delivered)
+        void forget(uint16_t shortAddr);
+
+        size_t pending() const;
+        size_t pending(uint16_t shortAddr) const;
+
+        // Learned wake up interval, once two have been seen
+        std::optional<int> wakeInterval(uint16_t shortAddr) const;
+
+        // How long we ask a checked-in device to keep fast polling
+        void setFastPollTimeout(uint16_t quarterSeconds) { fastPollQuarterSeconds = quarterSeconds; }
+
+    private:
+        using Clock = TimerWheel::Clock;
+
+        // Sent this long before the expected wake, inside the parent's indirect timeout
+        static constexpr int WAKE_LEAD_MS = 3000;
+        static constexpr int CONFIRM_TIMEOUT_MS = 10000;
+
+        struct Item
+        {
+            ZStackFrame frame;
+            ResultHandler handler;
+            Clock::time_point expires;
+            int attempts;
+        };
+
+        struct Device
+        {
+            bool sleepy = false;
+            std::deque<Item> mail;
+            Clock::time_point lastHeard{};
+            Clock::time_point lastWake{};
+            int intervalMs = 0; // Smoothed wake interval, 0 until learned
+            int wakesSeen = 0;
+            bool fastPolling = false;
+            uint8_t endpoint = 0x01; // Poll Control endpoint, from its last check-in
+            TimerId wakeTimer = INVALID_TIMER;
+            size_t inFlight = 0;
+        };
+
+        struct InFlight
+        {
+            uint16_t shortAddr;
+            Item item;
+            uint8_t transID; // Handed out by the client
+        };
+
+        ZStackClient &client;
+        int awakeWindowMs;
+        int expiryMs;
+        size_t maxPerDevice;
+        int maxAttempts;
+        uint16_t fastPollQuarterSeconds = 40;
+        uint32_t nextDelivery = 0;
+        uint8_t nextSequence = 0x60;
+
+        std::map<uint16_t, Device> devices;
+        std::map<uint32_t, InFlight> inFlight; // By delivery, each send of an item is a new one
+
+        bool awake(const Device &device, Clock::time_point now) const;
+        void heard(uint16_t shortAddr, Clock::time_point now);
+        void checkIn(uint16_t shortAddr, uint8_t endpoint, uint8_t sequence);
+        void flush(uint16_t shortAddr);
+        void deliver(uint16_t shortAddr, Item item);
+        void confirmed(uint32_t delivery, uint8_t status);
+        void finish(uint16_t shortAddr, InFlight entry, bool delivered);
+        void scheduleWake(uint16_t shortAddr);
+        void stopFastPoll(uint16_t shortAddr);
+    };
+}
+
+#endif // SLEEPY_MAILBOX_H
@@ -0,0 +1,190 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "TimerWheel.h"
+
+namespace ZStack
+{
+    template <typename T>
+    class Task;
+
+    namespace detail
+    {
+        struct PromiseBase
+        {
+            std::coroutine_handle<> continuation;
+            std::exception_ptr error;
+
+            // Whoever co_awaited us carries on right away (symmetric transfer)
+            struct FinalAwaiter
+            {
+                bool await_ready() noexcept { return false; }
+
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+                {
+                    auto next = handle.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            FinalAwaiter final_suspend() noexcept { return {}; }
+            void unhandled_exception() { error = std::current_exception(); }
+        };
+
+        template <typename T>
+        struct Promise : PromiseBase
+        {
+            std::optional<T> value;
+
+            Task<T> get_return_object();
+            void return_value(T result) { value = std::move(result); }
+
+            T take()
+            {
+                if (error)
+                    std::rethrow_exception(error);
+                return std::move(*value);
+            }
+        };
+
+        template <>
+        struct Promise<void> : PromiseBase
+        {
+            Task<void> get_return_object();
+            void return_void() {}
+
+            void take()
+            {
+                if (error)
+                    std::rethrow_exception(error);
+            }
+        };
+    }
+
+    // Lazily started coroutine returning T.
+    //
+    // Nothing runs until the task is co_awaited (or started by
+    // ZStackClient::spawn / runUntilComplete). Suspension points are the
+    // client's awaitables - request(), waitFor(), sleep() - which park the
+    // coroutine in the same pending request / TimerWheel structures the
+    // callback API uses. It is resumed from process() on the event loop
+    // thread, so any number of procedures interleave on one thread without
+    // locks, each costing one coroutine frame.
+    template <typename T = void>
+    class Task
+    {
+    public:
+        using promise_type = detail::Promise<T>;
+
+        Task() = default;
+        explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+        Task(Task &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (handle)
+                    handle.destroy();
+                handle = std::exchange(other.handle, {});
+            }
+            return *this;
+        }
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            if (handle)
+                handle.destroy();
+        }
+
+        bool done() const { return !handle || handle.done(); }
+
+        // Runs until the first suspension point. For top level tasks only.
+        void start()
+        {
+            if (handle && !handle.done())
+                handle.resume();
+        }
+
+        // Result of a finished task; rethrows what the coroutine threw
+        T result() { return handle.promise().take(); }
+
+        auto operator co_await() && noexcept
+        {
+            struct Awaiter
+            {
+                std::coroutine_handle<promise_type> handle;
+
+                bool await_ready() const noexcept { return !handle || handle.done(); }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    handle.promise().continuation = awaiting;
+                    return handle;
+                }
+
+                T await_resume() { return handle.promise().take(); }
+            };
+
+            return Awaiter{handle};
+        }
+
+    private:
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    namespace detail
+    {
+        template <typename T>
+        Task<T> Promise<T>::get_return_object()
+        {
+            return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> Promise<void>::get_return_object()
+        {
+            return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+        }
+
+        // Fire and forget wrapper: starts eagerly and frees its own frame
+        // when the wrapped task finishes (see ZStackClient::spawn)
+        struct Detached
+        {
+            struct promise_type
+            {
+                Detached get_return_object() noexcept { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() noexcept {}
+                void unhandled_exception() noexcept { std::terminate(); }
+            };
+        };
+    }
+
+    // co_await sleep(timers, ms): resumes from the TimerWheel once ms have passed
+    struct SleepAwaitable
+    {
+        TimerWheel &timers;
+        int delayMs;
+
+        bool await_ready() const noexcept { return delayMs <= 0; }
+        void await_suspend(std::coroutine_handle<> handle) { timers.schedule(delayMs, [handle]() { handle.resume(); }); }
+        void await_resume() const noexcept {}
+    };
+
+    inline SleepAwaitable sleep(TimerWheel &timers, int delayMs)
+    {
+        return SleepAwaitable{timers, delayMs};
+    }
+}
+
+#endif // TASK_H
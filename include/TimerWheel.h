@@ -0,0 +1,90 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace ZStack
+{
+    using TimerId = uint64_t;
+    constexpr TimerId INVALID_TIMER = 0;
+
+    // Hierarchical timing wheel (4 levels x 64 slots).
+    //
+    // Timers live in a pool and are chained into per-slot intrusive lists,
+    // so schedule() and cancel() are O(1) no matter how many timers exist.
+    // Far-away timers sit on the coarser levels and cascade down as time
+    // gets closer. Timers beyond the wheel's range (2^24 ticks, ~46 h at
+    // 10 ms) wait on an overflow list that is re-filed once per turn of
+    // the top level. Nothing runs on its own thread: the owner calls advance()
+    // from its event loop and callbacks run right there.
+    class TimerWheel
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Callback = std::function<void()>;
+
+        explicit TimerWheel(int resolutionMs = 10);
+
+        TimerId schedule(int delayMs, Callback callback);
+        TimerId schedulePeriodic(int intervalMs, Callback callback);
+
+        // Returns false if the timer already fired or was cancelled
+        bool cancel(TimerId id);
+
+        // Fires everything that is due at 'now'
+        void advance(Clock::time_point now = Clock::now());
+
+        size_t size() const { return activeTimers; }
+
+    private:
+        static constexpr int LEVELS = 4;
+        static constexpr int SLOT_BITS = 6;
+        static constexpr uint32_t SLOTS = 1 << SLOT_BITS;
+        static constexpr uint32_t SLOT_MASK = SLOTS - 1;
+        static constexpr uint32_t NONE = 0xFFFFFFFF;
+        static constexpr uint64_t RANGE = static_cast<uint64_t>(1) << (SLOT_BITS * LEVELS);
+
+        struct Node
+        {
+            uint32_t next;
+            uint32_t prev;
+            uint32_t generation;
+            bool active;
+            uint64_t expires;     // In ticks
+            uint64_t periodTicks; // 0 = one shot
+            Callback callback;
+        };
+
+        Clock::time_point start;
+        Clock::duration resolution;
+        uint64_t currentTick;
+        size_t activeTimers;
+
+        // Slot list heads come first in the pool, followed by the "firing",
+        // overflow and scratch list heads, followed by the timers themselves.
+        std::vector<Node> pool;
+        uint32_t freeList;
+        uint32_t firingHead;
+        uint32_t overflowHead;
+        uint32_t scratchHead;
+
+        uint64_t tickAt(Clock::time_point time) const;
+        uint64_t ticksFor(int delayMs) const;
+
+        TimerId add(uint64_t expires, uint64_t periodTicks, Callback callback);
+        void insert(uint32_t index);
+        void link(uint32_t head, uint32_t index);
+        void unlink(uint32_t index);
+        void release(uint32_t index);
+        void splice(uint32_t fromHead, uint32_t toHead);
+
+        void refile(uint32_t head);
+        void cascade(int level);
+        void processTick();
+    };
+}
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,191 @@
+#ifndef TOPOLOGY_SCANNER_H
+#define TOPOLOGY_SCANNER_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "ZStackFrame.h"
+#include "TimerWheel.h"
+#include "zdo/ZDOPacketParser.h"
+
+namespace ZStack
+{
+    class ZStackClient;
+
+    struct TopologyNode
+    {
+        uint64_t ieeeAddress;
+        uint8_t deviceType; // 0 = Coordinator, 1 = Router, 2 = End Device, 3 = Unknown
+        uint8_t depth;
+        uint64_t updatedMs;
+    };
+
+    // "from" reported "to" in its neighbor table, heard with this LQI
+    struct TopologyLink
+    {
+        uint16_t from;
+        uint16_t to;
+        uint8_t lqi;
+        uint8_t relationship;
+        uint64_t updatedMs;
+    };
+
+    // Mesh view built from neighbor and routing tables.
+    //
+    // Links and routes are keyed (source << 16 | other) in ordered maps, so
+    // everything one router reported is a contiguous range. A sweep only
+    // touches what it hears about: entries are upserted page by page, and
+    // once a router's whole table is in, its entries from older sweeps are
+    // dropped. Readers always see a complete (if slightly old) picture.
+    class TopologyGraph
+    {
+    public:
+        void addNode(uint16_t shortAddr, uint64_t ieeeAddress, uint8_t deviceType, uint8_t depth, uint64_t nowMs);
+        void updateNeighbor(uint16_t source, const ZDOPacket::NeighborEntry &entry, uint32_t generation, uint64_t nowMs);
+        void updateRoute(uint16_t source, const ZDOPacket::RouteEntry &entry, uint32_t generation);
+
+        // Source finished reporting for this generation: forget the rest
+        void pruneLinks(uint16_t source, uint32_t generation);
+        void pruneRoutes(uint16_t source, uint32_t generation);
+
+        // Next hop source uses towards destination, 0xFFFF if unknown
+        uint16_t nextHop(uint16_t source, uint16_t destination) const;
+
+        std::vector<TopologyLink> links() const;
+        std::vector<TopologyLink> weakLinks(uint8_t lqiThreshold) const;
+        const std::map<uint16_t, TopologyNode> &nodes() const { return nodeMap; }
+        size_t linkCount() const { return linkMap.size(); }
+        size_t routeCount() const { return routeMap.size(); }
+
+        // Graphviz digraph; edges coloured by LQI
+        std::string toDot() const;
+
+    private:
+        struct Link
+        {
+            uint8_t lqi;
+            uint8_t relationship;
+            uint64_t updatedMs;
+            uint32_t generation;
+        };
+
+        struct Route
+        {
+            uint16_t nextHop;
+            uint8_t status;
+            uint32_t generation;
+        };
+
+        std::map<uint16_t, TopologyNode> nodeMap;
+        std::map<uint32_t, Link> linkMap;   // from << 16 | to
+        std::map<uint32_t, Route> routeMap; // source << 16 | destination
+
+        static uint32_t key(uint16_t a, uint16_t b) { return (static_cast<uint32_t>(a) << 16) | b; }
+    };
+
+    // Walks the mesh with Mgmt_Lqi_req / Mgmt_Rtg_req.
+    //
+    // A sweep starts at the coordinator and follows every router it finds
+    // in a neighbor table (breadth first). Tables arrive in pages; the next
+    // page is requested until the router's whole table is in. At most
+    // maxConcurrent requests are outstanding, consecutive requests are at
+    // least requestGapMs apart, and nothing is sent while the network is
+    // busy with reports (more than busyFramesPerSecond AF_INCOMING_MSG in
+    // the last second), so discovery never competes with real traffic.
+    // Timeouts and pacing all run on the client's TimerWheel.
+    class TopologyScanner
+    {
+    public:
+        using CompletionHandler = std::function<void(const TopologyGraph &)>;
+
+        TopologyScanner(ZStackClient &client,
+                        size_t maxConcurrent = 2,
+                        int requestGapMs = 500,
+                        int timeoutMs = 5000,
+                        int maxRetries = 2);
+        ~TopologyScanner();
+
+        // Start a sweep. Ignored while one is running.
+        void sweep();
+
+        // Sweep every intervalMs (the first one after intervalMs)
+        void schedulePeriodic(int intervalMs);
+
+        void setBusyThreshold(size_t framesPerSecond) { busyFramesPerSecond = framesPerSecond; }
+        void setCompletionHandler(CompletionHandler handler) { completionHandler = handler; }
+
+        void handleFrame(const ZStackFrame &frame);
+
+        const TopologyGraph &graph() const { return topology; }
+        bool running() const { return sweeping; }
+        uint32_t sweeps() const { return generation; }
+
+    private:
+        enum class Table : uint8_t
+        {
+            NEIGHBORS,
+            ROUTES
+        };
+
+        struct Job
+        {
+            uint16_t shortAddr;
+            Table table;
+            uint8_t startIndex;
+            int attempts;
+        };
+
+        struct InFlight
+        {
+            Job job;
+            TimerId timer;
+        };
+
+        ZStackClient &client;
+        size_t maxConcurrent;
+        int requestGapMs;
+        int timeoutMs;
+        int maxRetries;
+        size_t busyFramesPerSecond = 20;
+        CompletionHandler completionHandler;
+
+        TopologyGraph topology;
+        uint32_t generation = 0;
+        bool sweeping = false;
+
+        std::deque<Job> queue;
+        std::map<uint32_t, InFlight> inFlight; // shortAddr << 1 | table
+        std::set<uint16_t> visited;            // Routers queued this sweep
+
+        TimerId pumpTimer = INVALID_TIMER;
+        TimerId periodicTimer = INVALID_TIMER;
+        std::chrono::steady_clock::time_point start;
+        uint64_t lastRequestMs = 0;
+
+        // AF_INCOMING_MSG count for the current and the previous second
+        uint64_t trafficSecond = 0;
+        size_t trafficThisSecond = 0;
+        size_t trafficLastSecond = 0;
+
+        uint64_t nowMs() const;
+        bool busy(uint64_t now) const;
+        void queueRouter(uint16_t shortAddr);
+        void pump();
+        void timeout(uint32_t key);
+        void finishIfDone();
+        void handleNeighbors(const ZDOPacket::MgmtLqiResponse &rsp);
+        void handleRoutes(const ZDOPacket::MgmtRtgResponse &rsp);
+
+        static uint32_t jobKey(uint16_t shortAddr, Table table)
+        {
+            return (static_cast<uint32_t>(shortAddr) << 1) | static_cast<uint32_t>(table);
+        }
+    };
+}
+
+#endif // TOPOLOGY_SCANNER_H
@@ -1,15 +1,29 @@
 #ifndef ZSTACK_CLIENT_H
 #define ZSTACK_CLIENT_H
 
+#include <exception>
 #include <string>
 #include <optional>
 #include <memory>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
 #include <iomanip>
 #include "SerialPort.h"
 #include "ZStackParser.h"
 #include "ZStackProtocol.h"
 #include "AFDataRequest.h"
+#include "ZclReadScheduler.h"
+#include "TimerWheel.h"
+#include "Task.h"
+#include "ClientMetrics.h"
+#include "AvailabilityTracker.h"
+#include "DuplicateFilter.h"
+#include "AttributeCache.h"
+#include "AddressBook.h"
+#include "OutboundQueue.h"
+#include "HandlerExecutor.h"
 #include "zdo/ZDOPacketParser.h"
 #include "af/AFPacketParser.h"
 
@@ -31,7 +45,32 @@ namespace ZStack {
         uint8_t state;
     };
 
+    class ZStackClient;
+
+    // co_await client.request(...) / client.waitFor(...): std::nullopt on timeout
+    class FrameAwaitable {
+        public:
+            FrameAwaitable(ZStackClient& client, std::optional<ZStackFrame> request,
+                           uint8_t expectedCmd0, uint8_t expectedCmd1, int timeoutMs)
+                : client(client), request(std::move(request)),
+                  expectedCmd0(expectedCmd0), expectedCmd1(expectedCmd1), timeoutMs(timeoutMs) {}
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle);
+            std::optional<ZStackFrame> await_resume() { return std::move(result); }
+
+        private:
+            ZStackClient& client;
+            std::optional<ZStackFrame> request; // Nothing to send for waitFor()
+            uint8_t expectedCmd0;
+            uint8_t expectedCmd1;
+            int timeoutMs;
+            std::optional<ZStackFrame> result;
+    };
+
     class ZStackClient {
+        friend class FrameAwaitable;
+
         public:
             ZStackClient(const std::string& portName);
             ~ZStackClient();
@@ -39,21 +78,42 @@ namespace ZStack {
             bool connect();
             void close();
 
+            // Records all serial traffic to a trace file (see SerialTrace.h),
+            // flushed at least once a second even when the port is quiet
+            bool startCapture(const std::string& tracePath);
+
             std::optional<SysVersion> getSystemVersion(int timeoutMs = 5000);
 
             void bindDevice(
                 uint16_t targetShortAddr, 
                 const std::vector<uint8_t>& targetIEEE,
                 uint16_t clusterID, 
-                const std::vector<uint8_t>& myIEEE
+                const std::vector<uint8_t>& myIEEE,
+                uint8_t sourceEndpoint = 0x01
             );
             bool registerEndpoint();
             void process();
+
+            // For callers multiplexing several clients with poll(): the port's
+            // descriptor (-1 while closed), and a turn of the event loop that
+            // only reads when poll() said the port is readable, so it never blocks
+            int pollDescriptor() const;
+            void process(bool readable);
             void permitJoin(uint8_t durationSeconds);
+
+            // Writes an NV configuration item (ZB_WRITE_CONFIGURATION), e.g.
+            // ZCD_NV_PANID before the network is formed
+            bool writeConfiguration(uint8_t configID, const std::vector<uint8_t>& value);
             std::optional<DeviceState> getDeviceState();
             bool startNetwork();
             void reset();
 
+            // Brings the dongle up as quickly as possible. If it is already a
+            // running coordinator with our endpoint registered (e.g. after a
+            // service restart) this takes a couple of round trips; only
+            // otherwise does it reset and (re)start the network.
+            bool startup(bool forceReset = false);
+
             std::optional<ZStackFrame> sendAndWait(
                 const ZStackFrame& request,
                 uint8_t expectedCmd0,
@@ -61,6 +121,91 @@ namespace ZStack {
                 int timeoutMs = 1000
             );
 
+            // Non-blocking counterpart of sendAndWait: the handler runs from
+            // process() with the response, or with std::nullopt on timeout.
+            void request(
+                const ZStackFrame& request,
+                uint8_t expectedCmd0,
+                uint8_t expectedCmd1,
+                int timeoutMs,
+                std::function<void(const std::optional<ZStackFrame>&)> handler
+            );
+
+            // Keeps the event loop (reads, handlers, timers) running for a while.
+            // Use this instead of sleeping.
+            //
+            // This and every other blocking call (sendAndWait, startup, ...) pump
+            // the loop themselves, so they must not be called from a handler,
+            // timer or task running on it: they fail right away with an error.
+            // Handlers use request() / spawn() and co_await instead.
+            void runFor(int durationMs);
+
+            // Coroutine counterparts, for procedures written as Task<T>:
+            //   auto ack = co_await client.request(req, SRSP | ZDO, ZDO_STARTUP_FROM_APP, 3000);
+            //   auto ind = co_await client.waitFor(AREQ | ZDO, ZDO_STATE_CHANGE_IND, 5000);
+            //   co_await client.sleep(500);
+            // They suspend instead of pumping, so many procedures share one thread.
+            FrameAwaitable request(
+                const ZStackFrame& request,
+                uint8_t expectedCmd0,
+                uint8_t expectedCmd1,
+                int timeoutMs = 1000
+            ) {
+                return FrameAwaitable(*this, request, expectedCmd0, expectedCmd1, timeoutMs);
+            }
+
+            FrameAwaitable waitFor(uint8_t expectedCmd0, uint8_t expectedCmd1, int timeoutMs = 1000) {
+                return FrameAwaitable(*this, std::nullopt, expectedCmd0, expectedCmd1, timeoutMs);
+            }
+
+            SleepAwaitable sleep(int durationMs) { return ZStack::sleep(timerWheel, durationMs); }
+
+            // Runs a task on the event loop in the background. It owns itself
+            // and goes away when it finishes; exceptions are logged.
+            void spawn(Task<void> task);
+
+            // Blocking bridge: keeps the event loop going until task is done.
+            // Like runFor(), never from a handler, timer or task on the loop:
+            // there is no result to fail with, so it logs and terminates, in
+            // every build. Tasks co_await each other instead.
+            template <typename T>
+            T runUntilComplete(Task<T> task) {
+                if (reentered("runUntilComplete")) {
+                    std::terminate();
+                }
+
+                task.start();
+                while (!task.done()) {
+                    pumpOnce();
+                }
+                return task.result();
+            }
+
+            size_t spawnedTasks() const { return runningTasks; }
+
+            // Coroutine versions of the blocking procedures above
+            Task<bool> startNetworkAsync();
+            Task<std::optional<DeviceState>> getDeviceStateAsync();
+
+            // Timeouts, back-offs and periodic jobs, driven by process()
+            TimerWheel& timers() { return timerWheel; }
+
+            // Frame counters, latency histograms and queue depths. Safe to
+            // snapshot / export from other threads.
+            const ClientMetrics& metrics() const { return clientMetrics; }
+
+            // Last-seen time and online / offline events per NWK address,
+            // fed from every received frame
+            AvailabilityTracker& availability() { return availabilityTracker; }
+
+            // Short <-> IEEE address of every device heard of. Senders we
+            // cannot place are looked up once; moved devices are reported.
+            AddressBook& addresses() { return addressBook; }
+            const AddressBook& addresses() const { return addressBook; }
+
+            // Repeated AF_INCOMING_MSG frames are dropped here before decoding
+            DuplicateFilter& duplicates() { return duplicateFilter; }
+
             static std::string ieeeToString(const std::vector<uint8_t>& ieeeBytes) {
                 std::stringstream ss;
                 ss << std::hex << std::setfill('0');
@@ -81,6 +226,24 @@ namespace ZStack {
                 afPacketHandler = handler;
             }
 
+            // Runs the AF / ZDO packet handlers on executor's worker threads
+            // instead of the I/O thread, sharded by source NWK address so each
+            // device's packets stay in order. nullptr (the default) runs them
+            // inline. Handlers on the executor must not touch the client
+            // directly: post() what needs doing back to the event loop.
+            void setHandlerExecutor(HandlerExecutor* executor) {
+                handlerExecutor = executor;
+            }
+
+            // Queues work for the event loop; runs from process(). Safe from any thread.
+            void post(std::function<void()> work);
+
+            // Raw frame tap for library components (interviews, schedulers...).
+            // Listeners see every frame before it is parsed and dispatched.
+            void addFrameListener(std::function<void(const ZStackFrame&)> listener) {
+                frameListeners.push_back(listener);
+            }
+
             void fetchActiveEndpoints(
                 uint16_t targetShortAddr
             );
@@ -90,19 +253,199 @@ namespace ZStack {
                 uint8_t endpoint
             );
 
+            // Mgmt_Lqi_req / Mgmt_Rtg_req: one page of a router's neighbor or
+            // routing table, starting at startIndex
+            void fetchNeighborTable(
+                uint16_t targetShortAddr,
+                uint8_t startIndex
+            );
+
+            void fetchRoutingTable(
+                uint16_t targetShortAddr,
+                uint8_t startIndex
+            );
+
+            // Groups cluster (0x0004) on one endpoint of a device. Answers arrive
+            // as AFPacket::GroupsResponse through the AF packet handler.
+            void addGroup(uint16_t targetShortAddr, uint8_t endpoint, uint16_t groupID, const std::string& name = "");
+            void removeGroup(uint16_t targetShortAddr, uint8_t endpoint, uint16_t groupID);
+            void viewGroup(uint16_t targetShortAddr, uint8_t endpoint, uint16_t groupID);
+            void getGroupMembership(uint16_t targetShortAddr, uint8_t endpoint);
+
+            // One AF_DATA_REQUEST_EXT reaching every member of a group, or every
+            // device behind a broadcast address (e.g. On/Off for a whole room)
+            void sendGroupCommand(
+                uint16_t groupID,
+                uint16_t clusterID,
+                uint8_t commandID,
+                const std::vector<uint8_t>& payload = {}
+            );
+
+            void sendBroadcastCommand(
+                uint16_t clusterID,
+                uint8_t commandID,
+                const std::vector<uint8_t>& payload = {},
+                uint16_t broadcastAddr = BROADCAST_RX_ON_WHEN_IDLE
+            );
+
+            // Feeds raw bytes from somewhere other than the serial port (e.g. a
+            // replayed trace) through the parser and the normal dispatch path.
+            void ingestBytes(const uint8_t* data, size_t size);
+
+            // Sends a frame serialised by ZclRequestBuilder / FrameWriter as-is,
+            // except that AF data requests get their TransID from the client:
+            // one counter for every sender, so no two requests in flight share one.
+            void send(const FrameView& frame);
+            void send(const FrameView& frame, SendPriority priority);
+
+            // AF data request whose AF_DATA_CONFIRM comes back to onConfirm
+            // (its Status), or std::nullopt if none arrived within timeoutMs.
+            // Returns the TransID it went out with; -1 (and onConfirm never
+            // runs) if it is not a valid AF data request.
+            using AfConfirmHandler = std::function<void(std::optional<uint8_t> status)>;
+            int send(const FrameView& frame, AfConfirmHandler onConfirm, int timeoutMs = 10000);
+
+            // The owner of onConfirm is going away
+            void cancelConfirm(uint8_t transID);
+
+            // Priority of everything sent without an explicit one (see
+            // ScopedSendPriority). Returns the previous value.
+            SendPriority setSendPriority(SendPriority priority) {
+                return std::exchange(sendPriority, priority);
+            }
+
+            // In-flight budget and priority classes in front of the serial port
+            OutboundQueue& outbound() { return outboundQueue; }
+
+            // Coalesced ZCL attribute read. Concurrent reads of the same
+            // (device, endpoint, cluster) share one Read Attributes frame.
+            void readAttribute(
+                uint16_t targetShortAddr,
+                uint8_t endpoint,
+                uint16_t clusterID,
+                uint16_t attributeID,
+                ZclReadCallback callback
+            );
+
+            // Read-through: answered right away (before returning) from the
+            // attribute cache when the cached value is at most maxAgeMs old (0:
+            // always the air), otherwise a coalesced air read as above.
+            void readAttribute(
+                uint16_t targetShortAddr,
+                uint8_t endpoint,
+                uint16_t clusterID,
+                uint16_t attributeID,
+                int maxAgeMs,
+                ZclReadCallback callback
+            );
+
+            // Last known attribute values from reports and read responses.
+            // get() is lock free and safe from any thread.
+            AttributeCache& attributes() { return attributeCache; }
+            const AttributeCache& attributes() const { return attributeCache; }
+
+            // Reads an attribute every intervalMs through the coalescing scheduler.
+            // Cancel with timers().cancel(id).
+            TimerId pollAttribute(
+                uint16_t targetShortAddr,
+                uint8_t endpoint,
+                uint16_t clusterID,
+                uint16_t attributeID,
+                int intervalMs,
+                ZclReadCallback callback
+            );
+
         private:
+            struct PendingRequest {
+                uint8_t cmd0;
+                uint8_t cmd1;
+                std::function<void(const std::optional<ZStackFrame>&)> handler;
+                TimerId timer;
+            };
+
+            struct AfConfirm {
+                AfConfirmHandler handler;
+                TimerId timer;
+            };
+
+            // A blocking waitForFrame() in progress
+            struct SyncWait {
+                uint8_t cmd0;
+                uint8_t cmd1;
+                std::optional<ZStackFrame> result;
+            };
+
             std::function<void(const ZDOPacket::Packet&)> zdoPacketHandler;
             std::function<void(const AFPacket::Packet&)> afPacketHandler;
+            std::vector<std::function<void(const ZStackFrame&)>> frameListeners;
+            HandlerExecutor* handlerExecutor = nullptr;
+            std::mutex postedMutex;
+            std::vector<std::function<void()>> posted;
             std::unique_ptr<SerialPort> serialPort;
             Parser parser;
+            TimerWheel timerWheel;
+            ClientMetrics clientMetrics;
+            AvailabilityTracker availabilityTracker;
+            DuplicateFilter duplicateFilter;
+            AttributeCache attributeCache;
+            AddressBook addressBook;
+            OutboundQueue outboundQueue;
+            SendPriority sendPriority = SendPriority::NORMAL;
+            ZclReadScheduler readScheduler;
+            std::map<uint32_t, PendingRequest> pendingRequests;
+            uint32_t nextRequestId = 1;
+            uint8_t nextZclSequence = 0xC0; // Group management and group / broadcast commands
+            uint8_t nextTransID = 0x01;     // AF TransID of every data request sent
+            std::map<uint8_t, AfConfirm> afConfirms; // By TransID
+            size_t runningTasks = 0;
+            bool pumping = false; // Inside pumpOnce(): handlers, timers and tasks are running
+            TimerId captureFlushTimer = INVALID_TIMER;
+
+            // Registers interest in the next (cmd0, cmd1) frame without sending anything
+            void expect(
+                uint8_t expectedCmd0,
+                uint8_t expectedCmd1,
+                int timeoutMs,
+                std::function<void(const std::optional<ZStackFrame>&)> handler
+            );
+
+            static detail::Detached runDetached(ZStackClient* client, Task<void> task);
+            SyncWait* activeWait = nullptr;
 
             std::optional<ZStackFrame> waitForFrame(uint8_t expectedCmd0, 
                                                 uint8_t expectedCmd1, 
                                                 int timeoutMs);
             
+            // One turn of the event loop: read, parse, dispatch, fire timers
+            void pumpOnce(bool readPort = true);
+
+            // Logs and returns true when a blocking call is made from inside pumpOnce()
+            bool reentered(const char* caller) const;
+            void runPosted();
+            void dispatchFrame(const ZStackFrame& frame);
             void routeFrameToParser(const ZStackFrame& frame);
+
+            bool isEndpointRegistered(uint8_t endpoint);
             
             void send(const ZStackFrame& request);
+            int transmit(const uint8_t* data, size_t size, AfConfirmHandler onConfirm = nullptr, int timeoutMs = 0);
+            void afConfirmed(const ZStackFrame& frame);
+    };
+
+    // Everything the client sends while this is alive goes out at priority,
+    // e.g. a component doing maintenance marks its sends BULK.
+    class ScopedSendPriority {
+        public:
+            ScopedSendPriority(ZStackClient& client, SendPriority priority)
+                : client(client), previous(client.setSendPriority(priority)) {}
+            ~ScopedSendPriority() { client.setSendPriority(previous); }
+
+            ScopedSendPriority(const ScopedSendPriority&) = delete;
+            ScopedSendPriority& operator=(const ScopedSendPriority&) = delete;
+
+        private:
+            ZStackClient& client;
+            SendPriority previous;
     };
 }
 
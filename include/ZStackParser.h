@@ -9,11 +9,19 @@ namespace ZStack {
 
     class Parser {
         public:
+            struct Stats {
+                uint64_t frames = 0;         // Frames with a valid checksum
+                uint64_t checksumErrors = 0; // Frames dropped on a bad FCS
+                uint64_t discardedBytes = 0; // Noise skipped while waiting for 0xFE
+            };
+
             Parser();
 
             // Attempts to parse a Z-Stack frame from the given byte stream.
             // Returns an optional ZStackFrame if parsing is successful.
             std::optional<ZStackFrame> parseByte(uint8_t byte);
+
+            const Stats& stats() const { return counters; }
         
         private:
             enum class State {
@@ -33,6 +41,8 @@ namespace ZStack {
             std::vector<uint8_t> incomingPayload;
 
             uint8_t calculateChecksum;
+
+            Stats counters;
     };
 }
 
@@ -6,6 +6,7 @@
 #include <string>
 #include <sstream>
 #include <iomanip>
+#include <vector>
 
 namespace ZStack
 {
@@ -32,6 +33,13 @@ namespace ZStack
         UTIL = 0x07  // Utilities
     };
 
+    // CMD0 = type | subsystem (e.g. SREQ | ZDO). Spelled out because C++20
+    // deprecates mixing two different enums with the built-in operator.
+    constexpr uint8_t operator|(CommandType type, Subsystem subsystem)
+    {
+        return static_cast<uint8_t>(static_cast<uint8_t>(type) | static_cast<uint8_t>(subsystem));
+    }
+
     // --- 3. Specific Command IDs (CMD1) ---
 
     // SYS Subsystem Commands
@@ -49,9 +57,29 @@ namespace ZStack
     {
         AF_REGISTER = 0x00,
         AF_DATA_REQUEST = 0x01, // The "Send Message" command
+        AF_DATA_REQUEST_EXT = 0x02, // Same, with group / broadcast / 64-bit addressing
+        AF_DATA_CONFIRM = 0x80, // (Incoming) Status, Endpoint, TransID of a data request
         AF_INCOMING_MSG = 0x81  // (Incoming) Message Received
     };
 
+    // DstAddrMode of AF_DATA_REQUEST_EXT
+    enum AFAddrMode : uint8_t
+    {
+        AF_ADDR_NOT_PRESENT = 0x00, // Use the bindings of the source endpoint
+        AF_ADDR_GROUP = 0x01,
+        AF_ADDR_16BIT = 0x02,
+        AF_ADDR_64BIT = 0x03,
+        AF_ADDR_BROADCAST = 0x0F
+    };
+
+    // Broadcast destinations
+    enum BroadcastAddress : uint16_t
+    {
+        BROADCAST_ALL = 0xFFFF,             // Every device, sleepy ones included
+        BROADCAST_RX_ON_WHEN_IDLE = 0xFFFD, // Everything that is not asleep
+        BROADCAST_ROUTERS = 0xFFFC          // Routers and the coordinator
+    };
+
     enum ZDOCommandID : uint8_t
     {
         ZDO_STARTUP_FROM_APP = 0x40,     // Start the network
@@ -61,6 +89,11 @@ namespace ZStack
         ZDO_END_DEVICE_ANNCE_IND = 0xC1, // (Incoming) A new device has joined
         ZDO_TC_DEV_IND = 0xCA,            // (Incoming) A new device is trying to join securely (with a link key)
 
+        ZDO_NWK_ADDR_REQ = 0x00,  // Short address of an IEEE address (broadcast)
+        ZDO_NWK_ADDR_RSP = 0x80,
+        ZDO_IEEE_ADDR_REQ = 0x01, // IEEE address of a short address (unicast)
+        ZDO_IEEE_ADDR_RSP = 0x81,
+
         ZDO_BIND_REQ = 0x21, // Create a binding
         ZDO_BIND_RSP = 0xA1,
 
@@ -68,7 +101,22 @@ namespace ZStack
         ZDO_ACTIVE_EP_RSP = 0x85, // Response Active Endpoints
 
         ZDO_SIMPLE_DESC_REQ = 0x04, // Request Simple Descriptor
-        ZDO_SIMPLE_DESC_RSP = 0x84
+        ZDO_SIMPLE_DESC_RSP = 0x84,
+
+        ZDO_MGMT_LQI_REQ = 0x31, // Neighbor table of a router (paged)
+        ZDO_MGMT_LQI_RSP = 0xB1,
+        ZDO_MGMT_RTG_REQ = 0x32, // Routing table of a router (paged)
+        ZDO_MGMT_RTG_RSP = 0xB2
+    };
+
+    // Device state reported by UTIL_GET_DEVICE_INFO / ZDO_STATE_CHANGE_IND
+    enum DeviceStateCode : uint8_t
+    {
+        DEV_HOLD = 0x00,
+        DEV_INIT = 0x01,
+        DEV_NWK_DISC = 0x02,
+        DEV_NWK_JOINING = 0x03,
+        DEV_ZB_COORD = 0x09
     };
 
     enum UtilCommandID : uint8_t
@@ -76,6 +124,19 @@ namespace ZStack
         UTIL_GET_DEVICE_INFO = 0x00
     };
 
+    // SAPI Subsystem Commands
+    enum SapiCommandID : uint8_t
+    {
+        ZB_WRITE_CONFIGURATION = 0x05 // Write an NV configuration item
+    };
+
+    // NV configuration items (ZB_WRITE_CONFIGURATION)
+    enum NvConfigID : uint8_t
+    {
+        ZCD_NV_PANID = 0x83,  // Used the next time the network is formed
+        ZCD_NV_CHANLIST = 0x84 // Channel bitmask (bit 11..26)
+    };
+
     enum ZCLCommandID : uint8_t
     {
         ZCL_READ_ATTRIB_REQ = 0x00,
@@ -84,14 +145,84 @@ namespace ZStack
         ZCL_WRITE_ATTRIB_RSP = 0x03,
         ZCL_CONFIG_REPORTING_REQ = 0x06,
         ZCL_CONFIG_REPORTING_RSP = 0x07,
+        ZCL_READ_REPORTING_CONFIG_REQ = 0x08,
+        ZCL_READ_REPORTING_CONFIG_RSP = 0x09,
         ZCL_REPORT_ATTRIB = 0x0A,
         ZCL_DEFAULT_RSP = 0x0B,
         ZCL_DISCOVER_ATTRIBS_REQ = 0x0C,
         ZCL_DISCOVER_ATTRIBS_RSP = 0x0D
     };
 
+    // Groups cluster (0x0004) commands. Requests and their responses share the ID.
+    enum ZclGroupsCommandID : uint8_t
+    {
+        ZCL_GROUPS_ADD = 0x00,
+        ZCL_GROUPS_VIEW = 0x01,
+        ZCL_GROUPS_GET_MEMBERSHIP = 0x02,
+        ZCL_GROUPS_REMOVE = 0x03,
+        ZCL_GROUPS_REMOVE_ALL = 0x04
+    };
+
+    // Poll Control cluster (0x0020). The device (server) checks in, we answer.
+    enum ZclPollControlCommandID : uint8_t
+    {
+        ZCL_POLL_CHECK_IN = 0x00,     // Server -> client
+        ZCL_POLL_CHECK_IN_RSP = 0x00, // Client -> server: StartFastPolling, FastPollTimeout (quarter seconds)
+        ZCL_POLL_FAST_POLL_STOP = 0x01
+    };
+
+    // Basic cluster (0x0000) attributes that identify a device
+    enum ZclBasicAttributeID : uint16_t
+    {
+        ZCL_BASIC_MANUFACTURER_NAME = 0x0004,
+        ZCL_BASIC_MODEL_IDENTIFIER = 0x0005
+    };
+
+    // OTA Upgrade cluster (0x0019). We are the server, devices the clients.
+    enum ZclOtaCommandID : uint8_t
+    {
+        ZCL_OTA_IMAGE_NOTIFY = 0x00,
+        ZCL_OTA_QUERY_NEXT_IMAGE_REQ = 0x01,
+        ZCL_OTA_QUERY_NEXT_IMAGE_RSP = 0x02,
+        ZCL_OTA_IMAGE_BLOCK_REQ = 0x03,
+        ZCL_OTA_IMAGE_PAGE_REQ = 0x04,
+        ZCL_OTA_IMAGE_BLOCK_RSP = 0x05,
+        ZCL_OTA_UPGRADE_END_REQ = 0x06,
+        ZCL_OTA_UPGRADE_END_RSP = 0x07
+    };
+
+    // ZCL status codes used by the OTA Upgrade cluster
+    enum ZclOtaStatus : uint8_t
+    {
+        ZCL_OTA_SUCCESS = 0x00,
+        ZCL_OTA_ABORT = 0x95,
+        ZCL_OTA_INVALID_IMAGE = 0x96,
+        ZCL_OTA_WAIT_FOR_DATA = 0x97,
+        ZCL_OTA_NO_IMAGE_AVAILABLE = 0x98
+    };
+
+    enum ZCLDataType : uint8_t
+    {
+        ZCL_BOOLEAN = 0x10,
+        ZCL_BITMAP8 = 0x18,
+        ZCL_BITMAP16 = 0x19,
+        ZCL_UINT8 = 0x20,
+        ZCL_UINT16 = 0x21,
+        ZCL_UINT32 = 0x23,
+        ZCL_INT8 = 0x28,
+        ZCL_INT16 = 0x29,
+        ZCL_INT32 = 0x2B,
+        ZCL_ENUM8 = 0x30,
+        ZCL_SINGLE = 0x39,
+        ZCL_CHAR_STRING = 0x42
+    };
+
     enum ClusterID : uint16_t
     {
+        BASIC_CLUSTER = 0x0000,
+        GROUPS_CLUSTER = 0x0004,
+        OTA_UPGRADE_CLUSTER = 0x0019,
+        POLL_CONTROL_CLUSTER = 0x0020,
         ON_OFF_CLUSTER = 0x0006,
         LEVEL_CONTROL_CLUSTER = 0x0008,
         COLOR_CONTROL_CLUSTER = 0x0300,
@@ -114,6 +245,8 @@ namespace ZStack
             {ZCL_WRITE_ATTRIB_RSP, "ZCL_WRITE_ATTRIB_RSP"},
             {ZCL_CONFIG_REPORTING_REQ, "ZCL_CONFIG_REPORTING_REQ"},
             {ZCL_CONFIG_REPORTING_RSP, "ZCL_CONFIG_REPORTING_RSP"},
+            {ZCL_READ_REPORTING_CONFIG_REQ, "ZCL_READ_REPORTING_CONFIG_REQ"},
+            {ZCL_READ_REPORTING_CONFIG_RSP, "ZCL_READ_REPORTING_CONFIG_RSP"},
             {ZCL_REPORT_ATTRIB, "ZCL_REPORT_ATTRIB"},
             {ZCL_DEFAULT_RSP, "ZCL_DEFAULT_RSP"},
             {ZCL_DISCOVER_ATTRIBS_REQ, "ZCL_DISCOVER_ATTRIBS_REQ"},
@@ -121,6 +254,10 @@ namespace ZStack
 
     const std::map<uint16_t, std::string> clusterNameMap =
         {
+            {BASIC_CLUSTER, "Basic Cluster"},
+            {GROUPS_CLUSTER, "Groups Cluster"},
+            {OTA_UPGRADE_CLUSTER, "OTA Upgrade Cluster"},
+            {POLL_CONTROL_CLUSTER, "Poll Control Cluster"},
             {ON_OFF_CLUSTER, "On/Off Cluster"},
             {LEVEL_CONTROL_CLUSTER, "Level Control Cluster"},
             {COLOR_CONTROL_CLUSTER, "Color Control Cluster"},
@@ -139,6 +276,7 @@ namespace ZStack
         // AF Commands
         {AF_REGISTER, "AF_REGISTER"},
         {AF_DATA_REQUEST, "AF_DATA_REQUEST"},
+        {AF_DATA_REQUEST_EXT, "AF_DATA_REQUEST_EXT"},
         {AF_INCOMING_MSG, "AF_INCOMING_MSG"},
 
         // ZDO Commands
@@ -182,6 +320,8 @@ namespace ZStack
                 return "AF_REGISTER";
             case 0x01:
                 return "AF_DATA_REQUEST";
+            case 0x02:
+                return "AF_DATA_REQUEST_EXT";
             case 0x80:
                 return "AF_DATA_CONFIRM"; // <--- This is what you were seeing!
             case 0x81:
@@ -206,6 +346,14 @@ namespace ZStack
                 return "ZDO_BIND_REQ";
             case 0x22:
                 return "ZDO_UNBIND_REQ";
+            case 0x31:
+                return "ZDO_MGMT_LQI_REQ";
+            case 0x32:
+                return "ZDO_MGMT_RTG_REQ";
+            case 0xB1:
+                return "ZDO_MGMT_LQI_RSP";
+            case 0xB2:
+                return "ZDO_MGMT_RTG_RSP";
             case 0x36:
                 return "ZDO_MGMT_PERMIT_JOIN_REQ"; // "Permit Join"
             case 0x40:
@@ -215,11 +363,22 @@ namespace ZStack
             case 0xCA:
                 return "ZDO_TC_DEV_IND"; // "Trust Center: New Device"
             case 0x80:
+                return "ZDO_NWK_ADDR_RSP";
+            case 0x81:
+                return "ZDO_IEEE_ADDR_RSP";
+            case 0xC0:
                 return "ZDO_STATE_CHANGE_IND"; // "Network State Changed"
             }
         }
 
-        // 4. UTIL COMMANDS
+        // 4. SAPI COMMANDS
+        if ((cmd0 & 0x1F) == 0x06)
+        {
+            if (cmd1 == 0x05)
+                return "ZB_WRITE_CONFIGURATION";
+        }
+
+        // 5. UTIL COMMANDS
         if ((cmd0 & 0x1F) == 0x07)
         {
             if (cmd1 == 0x00)
@@ -230,6 +389,87 @@ namespace ZStack
         return "UNKNOWN (" + toHex(cmd0, 2) + ", " + toHex(cmd1, 2) + ")";
     }
 
+    // Returns the length of a value of the given ZCL Data Type,
+    // -1 for variable length types (first byte is the length), 0 if unknown
+    inline int getZCLDataTypeLength(uint8_t dataType)
+    {
+        switch (dataType)
+        {
+        case 0x08: // Data8
+        case 0x10: // Boolean
+        case 0x18: // Bitmap8
+        case 0x20: // Uint8
+        case 0x28: // Int8
+        case 0x30: // Enum8
+            return 1;
+        case 0x09: // Data16
+        case 0x19: // Bitmap16
+        case 0x21: // Uint16
+        case 0x29: // Int16
+        case 0x31: // Enum16
+            return 2;
+        case 0x22: // Uint24
+        case 0x2A: // Int24
+            return 3;
+        case 0x1B: // Bitmap32
+        case 0x23: // Uint32
+        case 0x2B: // Int32
+        case 0x39: // Single Precision Float
+            return 4;
+        case 0x25: // Uint48
+            return 6;
+        case 0xF0: // IEEE Address
+            return 8;
+        case 0x41: // Octet String
+        case 0x42: // Char String
+            return -1;
+        default:
+            return 0;
+        }
+    }
+
+    // Discrete types (booleans, bitmaps, enums) have no Reportable Change field
+    // in Configure Reporting; analog ones (integers, floats) do.
+    inline bool isZCLAnalogDataType(uint8_t dataType)
+    {
+        return (dataType >= 0x20 && dataType <= 0x2F) || (dataType >= 0x38 && dataType <= 0x3A) ||
+               (dataType >= 0xE0 && dataType <= 0xE2);
+    }
+
+    // The device a ZDO AREQ (cmd1) came from, false if the frame does not
+    // name one. Most responses and TC_DEV_IND start with SrcAddr, but
+    // NWK_addr_rsp / IEEE_addr_rsp are Status, IEEE(8), NwkAddr(2) and a
+    // device announcement's new address follows SrcAddr.
+    inline bool getZDOSourceAddress(uint8_t cmd1, const std::vector<uint8_t> &p, uint16_t &shortAddr)
+    {
+        if (cmd1 == ZDO_NWK_ADDR_RSP || cmd1 == ZDO_IEEE_ADDR_RSP)
+        {
+            // On failure NwkAddr only echoes the question
+            if (p.size() < 11 || p[0] != 0x00)
+                return false;
+            shortAddr = p[9] | (p[10] << 8);
+            return true;
+        }
+
+        if (cmd1 == ZDO_END_DEVICE_ANNCE_IND)
+        {
+            if (p.size() < 4)
+                return false;
+            shortAddr = p[2] | (p[3] << 8);
+            return true;
+        }
+
+        if ((cmd1 > ZDO_IEEE_ADDR_RSP && cmd1 < 0xC0) || cmd1 == ZDO_TC_DEV_IND)
+        {
+            if (p.size() < 2)
+                return false;
+            shortAddr = p[0] | (p[1] << 8);
+            return true;
+        }
+
+        return false;
+    }
+
     inline std::string getZCLCommandName(uint8_t cmdId)
     {
         auto it = zclCommandNameMap.find(cmdId);
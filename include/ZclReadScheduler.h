@@ -0,0 +1,99 @@
+#ifndef ZCL_READ_SCHEDULER_H
+#define ZCL_READ_SCHEDULER_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+#include "ZStackFrame.h"
+#include "FrameBuffer.h"
+#include "TimerWheel.h"
+
+namespace ZStack
+{
+    // ZCL status used when a read never got an answer
+    constexpr uint8_t ZCL_STATUS_TIMEOUT = 0x94;
+
+    struct ZclReadResult
+    {
+        uint16_t shortAddr;
+        uint8_t endpoint;
+        uint16_t clusterID;
+        uint16_t attributeID;
+        uint8_t status; // 0x00 = Success, anything else is a ZCL status code
+        uint8_t dataType;
+        std::vector<uint8_t> value;
+    };
+
+    using ZclReadCallback = std::function<void(const ZclReadResult &)>;
+
+    // Sits in front of the AF send path for ZCL Read Attributes.
+    //
+    // Reads for the same (device, endpoint, cluster) that arrive within the
+    // coalescing window are merged into one multi-attribute frame, and a read
+    // for an attribute that is already pending or in flight just waits for the
+    // existing request. The response is fanned out to every waiter.
+    // Unanswered reads are retried with exponential back-off before the
+    // waiters are told about the timeout. All timing runs on the owner's
+    // TimerWheel.
+    class ZclReadScheduler
+    {
+    public:
+        using SendFunction = std::function<void(const FrameView &)>;
+
+        ZclReadScheduler(TimerWheel &timers,
+                         SendFunction sendFunction,
+                         int coalesceWindowMs = 50,
+                         int responseTimeoutMs = 10000,
+                         int maxRetries = 2,
+                         int retryBackoffMs = 1000);
+        ~ZclReadScheduler();
+
+        void read(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID,
+                  uint16_t attributeID, ZclReadCallback callback);
+
+        // Feed every incoming frame. Returns true if it answered one of our reads.
+        bool handleFrame(const ZStackFrame &frame);
+
+        size_t pendingCount() const { return pending.size(); }
+        size_t inFlightCount() const { return inFlight.size(); }
+
+    private:
+        // Up to this many attribute IDs go into one Read Attributes frame
+        static constexpr size_t MAX_ATTRIBUTES_PER_FRAME = 16;
+
+        struct Batch
+        {
+            uint16_t shortAddr;
+            uint8_t endpoint;
+            uint16_t clusterID;
+            uint8_t sequence;
+            int attempts;
+            TimerId timer; // Flush timer while pending, response timeout while in flight
+            std::map<uint16_t, std::vector<ZclReadCallback>> waiters;
+        };
+
+        TimerWheel &timers;
+        SendFunction sendFunction;
+        int coalesceWindowMs;
+        int responseTimeoutMs;
+        int maxRetries;
+        int retryBackoffMs;
+        uint8_t nextSequence;
+        uint8_t frameBuffer[MAX_MT_FRAME_SIZE];
+
+        // Keyed by (shortAddr, endpoint, cluster)
+        std::map<uint64_t, Batch> pending;
+        // Keyed by (shortAddr, endpoint, cluster, sequence)
+        std::map<uint64_t, Batch> inFlight;
+
+        static uint64_t makeKey(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID);
+
+        void flush(std::map<uint64_t, Batch>::iterator it);
+        void timeout(uint64_t inFlightKey);
+        void complete(Batch &batch, uint16_t attributeID, const ZclReadResult &result);
+        void fail(Batch &batch, uint8_t status);
+    };
+}
+
+#endif // ZCL_READ_SCHEDULER_H
@@ -1,6 +1,7 @@
 #ifndef AF_PACKET_PARSER_H
 #define AF_PACKET_PARSER_H
 #include "ZStackFrame.h"
+#include <memory>
 
 namespace AFPacket {
     enum AFResponseType : uint8_t {
@@ -15,6 +16,7 @@ namespace AFPacket {
         SWITCH_DEVICE = 0x05,
         POWER_CONSUMPTION_DEVICE = 0x06,
         INSTANTANEOUS_POWER_CONSUMPTION_CLUSTER = 0x07,
+        GROUPS_RESPONSE = 0x08,
     };
 
     struct Packet {
@@ -65,9 +67,23 @@ namespace AFPacket {
             this->type = ACTION_PRESS;
         }
     };
+
+    // Answer of the Groups cluster (Add / View / Get Membership / Remove Group).
+    // Get Membership fills capacity and groups; the others status and groups[0].
+    struct GroupsResponse: public DeviceReading {
+        uint16_t shortAddr;
+        uint8_t command;
+        uint8_t status;
+        uint8_t capacity;
+        std::vector<uint16_t> groups;
+        GroupsResponse() {
+            this->type = GROUPS_RESPONSE;
+        }
+    };
     
     struct IncomingMessage : public Packet {
         uint16_t srcAddress;
+        uint8_t srcEndpoint;
         uint16_t clusterID;
         std::unique_ptr<DeviceReading> deviceReading;
         IncomingMessage() {
@@ -75,7 +91,20 @@ namespace AFPacket {
         }
     };
 
+    // One entry of a ZCL attribute list (Read Attributes Response or Report Attributes).
+    // For failed reads only attributeID and status are filled in.
+    struct AttributeRecord {
+        uint16_t attributeID;
+        uint8_t status;
+        uint8_t dataType;
+        std::vector<uint8_t> value;
+    };
+
     std::unique_ptr<AFPacket::Packet> parseZStackFrame(const ZStack::ZStackFrame& frame);
+
+    // Decodes every attribute record of a ZCL Read Attributes Response (0x01)
+    // or Report Attributes (0x0A) carried in an AF_INCOMING_MSG payload.
+    std::vector<AttributeRecord> parseAttributeRecords(uint8_t zclCmd, const std::vector<uint8_t>& p);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,127 @@
+#ifndef ZCL_REQUEST_BUILDER_H
+#define ZCL_REQUEST_BUILDER_H
+
+#include <cstdint>
+#include <initializer_list>
+#include "../FrameBuffer.h"
+
+namespace ZStack
+{
+    // Where an AF_DATA_REQUEST goes and how it travels.
+    // Anything but a plain short address goes out as AF_DATA_REQUEST_EXT.
+    struct ZclDestination
+    {
+        uint16_t shortAddr;         // Short address, group ID or broadcast address (see addrMode)
+        uint8_t endpoint = 0x01;    // Endpoint on the device
+        uint8_t srcEndpoint = 0x01; // Our endpoint (see registerEndpoint)
+        uint8_t radius = 0x0F;
+        uint8_t options = 0x00;
+        uint8_t addrMode = 0x02;    // AFAddrMode, AF_ADDR_16BIT
+
+        // Every member of a group (the endpoint is implied by the membership)
+        static ZclDestination group(uint16_t groupID, uint8_t srcEndpoint = 0x01)
+        {
+            return {groupID, 0xFF, srcEndpoint, 0x0F, 0x00, 0x01};
+        }
+
+        // 0xFFFF all devices, 0xFFFD rx-on-when-idle, 0xFFFC routers
+        static ZclDestination broadcast(uint16_t address = 0xFFFD, uint8_t endpoint = 0xFF, uint8_t srcEndpoint = 0x01)
+        {
+            return {address, endpoint, srcEndpoint, 0x0F, 0x00, 0x0F};
+        }
+    };
+
+    // One attribute record of a Configure Reporting command
+    struct ZclReportingConfig
+    {
+        uint16_t attributeID;
+        uint8_t dataType;
+        uint16_t minInterval;      // Seconds
+        uint16_t maxInterval;      // Seconds
+        uint32_t reportableChange; // Only sent for analog data types
+    };
+
+    // One attribute record of a Write Attributes command.
+    // value points at the raw little endian value; for strings it
+    // starts with the length byte.
+    struct ZclAttributeWrite
+    {
+        uint16_t attributeID;
+        uint8_t dataType;
+        const uint8_t *value;
+        size_t length;
+    };
+
+    // Builds complete MT AF_DATA_REQUEST frames carrying a ZCL command.
+    //
+    // Each call serialises the MT header, AF header and ZCL frame in one pass
+    // straight into the target memory: either a single caller owned buffer
+    // (reused on every call) or the next free slot of a FrameArena. No heap
+    // allocation happens per command. An invalid FrameView is returned when
+    // the frame doesn't fit.
+    class ZclRequestBuilder
+    {
+    public:
+        ZclRequestBuilder(uint8_t *buffer, size_t capacity);
+        explicit ZclRequestBuilder(FrameArena &arena);
+
+        FrameView readAttributes(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                 const uint16_t *attributeIDs, size_t count);
+        FrameView readAttributes(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                 std::initializer_list<uint16_t> attributeIDs);
+
+        FrameView writeAttributes(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                  const ZclAttributeWrite *writes, size_t count);
+
+        FrameView configureReporting(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                     const ZclReportingConfig *configs, size_t count);
+        FrameView configureReporting(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                     std::initializer_list<ZclReportingConfig> configs);
+
+        FrameView readReportingConfig(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                      const uint16_t *attributeIDs, size_t count);
+        FrameView readReportingConfig(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                      std::initializer_list<uint16_t> attributeIDs);
+
+        // Cluster specific command (e.g. On/Off Toggle), client to server
+        FrameView clusterCommand(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                 uint8_t commandID, const uint8_t *payload = nullptr, size_t length = 0);
+
+        // Cluster specific response, server to client, for clusters we serve
+        // (e.g. OTA Upgrade). header and data are written back to back, so
+        // bulk data goes into the frame straight from wherever it lives.
+        FrameView clusterResponse(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                  uint8_t commandID, const uint8_t *header, size_t headerLength,
+                                  const uint8_t *data = nullptr, size_t dataLength = 0);
+
+        // Groups cluster (0x0004). Send to a single device: membership is per endpoint.
+        FrameView addGroup(const ZclDestination &dest, uint8_t sequence, uint16_t groupID, const char *name = "");
+        FrameView viewGroup(const ZclDestination &dest, uint8_t sequence, uint16_t groupID);
+        FrameView removeGroup(const ZclDestination &dest, uint8_t sequence, uint16_t groupID);
+        // An empty list asks for every group the endpoint is in
+        FrameView getGroupMembership(const ZclDestination &dest, uint8_t sequence,
+                                     const uint16_t *groupIDs = nullptr, size_t count = 0);
+
+    private:
+        // ZCL Frame Control bits
+        static constexpr uint8_t FRAME_TYPE_GLOBAL = 0x00;
+        static constexpr uint8_t FRAME_TYPE_CLUSTER = 0x01;
+        static constexpr uint8_t SERVER_TO_CLIENT = 0x08;
+        static constexpr uint8_t DISABLE_DEFAULT_RSP = 0x10;
+
+        uint8_t *buffer;
+        size_t capacity;
+        FrameArena *arena;
+        bool extended; // The frame being built is AF_DATA_REQUEST_EXT (2 byte Len)
+
+        // Opens the frame: MT + AF header and the ZCL header. Returns the
+        // offset of the AF "Len" field so end() can patch it.
+        size_t begin(FrameWriter &writer, const ZclDestination &dest, uint16_t clusterID,
+                     uint8_t sequence, uint8_t frameControl, uint8_t commandID);
+        FrameView end(FrameWriter &writer, size_t afLengthOffset);
+
+        uint8_t *target(size_t &available);
+    };
+}
+
+#endif // ZCL_REQUEST_BUILDER_H
@@ -1,5 +1,7 @@
 #ifndef ZDO_PACKET_PARSER_H
 #define ZDO_PACKET_PARSER_H
+#include <memory>
+#include <vector>
 #include "../ZStackFrame.h"
 
 namespace ZDOPacket {
@@ -9,7 +11,11 @@ namespace ZDOPacket {
         ACTIVE_ENDPOINTS = 0x03,
         BIND_RESPONSE = 0x04,
         BIND_REQ_RESPONSE = 0x05,
-        PERMIT_JOIN_REQ_RESPONSE = 0x06
+        PERMIT_JOIN_REQ_RESPONSE = 0x06,
+        MGMT_LQI_RESPONSE = 0x07,
+        MGMT_RTG_RESPONSE = 0x08,
+        TC_DEVICE_INDICATION = 0x09,
+        ADDRESS_RESPONSE = 0x0A
     };
 
     struct Packet {
@@ -21,14 +27,40 @@ namespace ZDOPacket {
         uint16_t networkAddress;
         uint16_t srcAddress;
         uint64_t ieeeAddress;
+        uint8_t capabilities; // MAC capability flags, bit 3 = receiver on when idle
+        bool rxOnWhenIdle() const { return capabilities & 0x08; }
         DeviceAnnouncementResponse() {
             this->type = DEVICE_ANNOUNCEMENT;
         }
     };
 
+    // ZDO_TC_DEV_IND: the Trust Center let a device in (first join or rejoin),
+    // possibly under a new short address
+    struct TrustCenterDeviceIndication : public Packet {
+        uint16_t networkAddress;
+        uint64_t ieeeAddress;
+        uint16_t parentAddress;
+        TrustCenterDeviceIndication() {
+            this->type = TC_DEVICE_INDICATION;
+        }
+    };
+
+    // Answer to NWK_addr_req / IEEE_addr_req. On failure the address that
+    // was asked about is echoed and the other one is meaningless.
+    struct AddressResponse : public Packet {
+        uint8_t status;
+        uint64_t ieeeAddress;
+        uint16_t networkAddress;
+        bool ieeeRequest; // Answer to IEEE_addr_req (else NWK_addr_req)
+        AddressResponse() {
+            this->type = ADDRESS_RESPONSE;
+        }
+    };
+
     // Response for Simple Descriptor Request Packet
     struct DeviceDescriptionResponse : public Packet {
         uint16_t sourceAddress;
+        uint8_t status;
         uint16_t networkAddress;
         uint8_t endpoint;
         uint16_t profileID;
@@ -44,6 +76,7 @@ namespace ZDOPacket {
     struct DeviceActiveEndpointResponse : public Packet {
         uint16_t networkAddress;
         uint16_t srcAddress;
+        uint8_t status;
         std::vector<uint8_t> activeEndpoints;
         DeviceActiveEndpointResponse() {
             this->type = ACTIVE_ENDPOINTS;
@@ -70,6 +103,50 @@ namespace ZDOPacket {
         }
     };
 
+    // One neighbor table entry of a Mgmt_Lqi_rsp
+    struct NeighborEntry {
+        uint64_t extendedPanId;
+        uint64_t ieeeAddress;
+        uint16_t networkAddress;
+        uint8_t deviceType;    // 0 = Coordinator, 1 = Router, 2 = End Device
+        uint8_t rxOnWhenIdle;
+        uint8_t relationship;  // 0 = Parent, 1 = Child, 2 = Sibling, 3 = None, 4 = Previous child
+        uint8_t permitJoining;
+        uint8_t depth;
+        uint8_t lqi;
+    };
+
+    // Response for Mgmt_Lqi_req: one page of the neighbor table of srcAddress
+    struct MgmtLqiResponse : public Packet {
+        uint16_t srcAddress;
+        uint8_t status;
+        uint8_t totalEntries;
+        uint8_t startIndex;
+        std::vector<NeighborEntry> neighbors;
+        MgmtLqiResponse() {
+            this->type = MGMT_LQI_RESPONSE;
+        }
+    };
+
+    // One routing table entry of a Mgmt_Rtg_rsp
+    struct RouteEntry {
+        uint16_t destination;
+        uint8_t status;        // 0 = Active, 1 = Discovery underway, 2 = Discovery failed, 3 = Inactive
+        uint16_t nextHop;
+    };
+
+    // Response for Mgmt_Rtg_req: one page of the routing table of srcAddress
+    struct MgmtRtgResponse : public Packet {
+        uint16_t srcAddress;
+        uint8_t status;
+        uint8_t totalEntries;
+        uint8_t startIndex;
+        std::vector<RouteEntry> routes;
+        MgmtRtgResponse() {
+            this->type = MGMT_RTG_RESPONSE;
+        }
+    };
+
     std::unique_ptr<ZDOPacket::Packet> parseZStackFrame(const ZStack::ZStackFrame& frame);
 };
 
@@ -0,0 +1,299 @@
+#include "AddressBook.h"
+#include "ZStackProtocol.h"
+#include "Logger.h"
+
+namespace ZStack
+{
+    namespace
+    {
+        uint64_t readIEEE(const std::vector<uint8_t> &p, size_t offset)
+        {
+            uint64_t ieee = 0;
+            for (int i = 7; i >= 0; i--)
+                ieee = (ieee << 8) | p[offset + i];
+            return ieee;
+        }
+    }
+
+    AddressBook::AddressBook(TimerWheel &timers, SendFunction sendFunction, int responseTimeoutMs, int retryAfterMs)
+        : timers(timers),
+          sendFunction(std::move(sendFunction)),
+          responseTimeoutMs(responseTimeoutMs),
+          retryAfterMs(retryAfterMs)
+    {
+    }
+
+    AddressBook::~AddressBook()
+    {
+        for (auto &entry : ieeeLookups)
+            timers.cancel(entry.second.timer);
+        for (auto &entry : shortLookups)
+            timers.cancel(entry.second.timer);
+    }
+
+    std::optional<uint64_t> AddressBook::ieeeOf(uint16_t shortAddr) const
+    {
+        auto it = ieeeByShort.find(shortAddr);
+        if (it == ieeeByShort.end())
+            return std::nullopt;
+        return it->second;
+    }
+
+    std::optional<uint16_t> AddressBook::shortOf(uint64_t ieee) const
+    {
+        auto it = shortByIEEE.find(ieee);
+        if (it == shortByIEEE.end())
+            return std::nullopt;
+        return it->second;
+    }
+
+    void AddressBook::learn(uint16_t shortAddr, uint64_t ieee)
+    {
+        unanswered.erase(shortAddr);
+
+        // 1. Someone else had this short address before: that mapping is stale
+        auto previousOwner = ieeeByShort.find(shortAddr);
+        if (previousOwner != ieeeByShort.end() && previousOwner->second != ieee)
+        {
+            LOG_DEBUG << "[Address] 0x" << std::hex << shortAddr << " moved from " << previousOwner->second << " to "
+                      << ieee << std::dec << std::endl;
+            shortByIEEE.erase(previousOwner->second);
+        }
+
+        // 2. This device was known under another short address: evict and report it
+        auto known = shortByIEEE.find(ieee);
+        std::optional<uint16_t> oldShortAddr;
+        if (known != shortByIEEE.end() && known->second != shortAddr)
+        {
+            oldShortAddr = known->second;
+            ieeeByShort.erase(known->second);
+        }
+
+        ieeeByShort[shortAddr] = ieee;
+        shortByIEEE[ieee] = shortAddr;
+
+        // 3. Anyone waiting on either lookup gets the answer now
+        if (ieeeLookups.count(shortAddr))
+            completeIEEE(shortAddr, ieee);
+        if (shortLookups.count(ieee))
+            completeShort(ieee, shortAddr);
+
+        if (oldShortAddr)
+        {
+            LOG_INFO << "[Address] " << std::hex << ieee << " changed short address 0x" << *oldShortAddr << " -> 0x"
+                     << shortAddr << std::dec << std::endl;
+            if (changeHandler)
+                changeHandler(ieee, *oldShortAddr, shortAddr);
+        }
+    }
+
+    void AddressBook::forget(uint16_t shortAddr)
+    {
+        auto it = ieeeByShort.find(shortAddr);
+        if (it == ieeeByShort.end())
+            return;
+
+        shortByIEEE.erase(it->second);
+        ieeeByShort.erase(it);
+    }
+
+    void AddressBook::resolveIEEE(uint16_t shortAddr, IEEECallback callback)
+    {
+        // 1. Known: answer right away
+        auto it = ieeeByShort.find(shortAddr);
+        if (it != ieeeByShort.end())
+        {
+            if (callback)
+                callback(it->second);
+            return;
+        }
+
+        // 2. Already being asked: wait for that answer
+        auto pending = ieeeLookups.find(shortAddr);
+        if (pending != ieeeLookups.end())
+        {
+            if (callback)
+                pending->second.callbacks.push_back(std::move(callback));
+            return;
+        }
+
+        // 3. Asked recently and nobody answered: don't flood the mesh
+        auto silent = unanswered.find(shortAddr);
+        if (silent != unanswered.end())
+        {
+            if (Clock::now() < silent->second)
+            {
+                if (callback)
+                    callback(std::nullopt);
+                return;
+            }
+            unanswered.erase(silent);
+        }
+
+        Lookup<IEEECallback> &lookup = ieeeLookups[shortAddr];
+        if (callback)
+            lookup.callbacks.push_back(std::move(callback));
+        lookup.timer = timers.schedule(responseTimeoutMs, [this, shortAddr]() {
+            unanswered[shortAddr] = Clock::now() + std::chrono::milliseconds(retryAfterMs);
+            completeIEEE(shortAddr, std::nullopt);
+        });
+
+        sendIEEERequest(shortAddr);
+    }
+
+    void AddressBook::resolveShort(uint64_t ieee, ShortCallback callback)
+    {
+        auto it = shortByIEEE.find(ieee);
+        if (it != shortByIEEE.end())
+        {
+            if (callback)
+                callback(it->second);
+            return;
+        }
+
+        auto pending = shortLookups.find(ieee);
+        if (pending != shortLookups.end())
+        {
+            if (callback)
+                pending->second.callbacks.push_back(std::move(callback));
+            return;
+        }
+
+        Lookup<ShortCallback> &lookup = shortLookups[ieee];
+        if (callback)
+            lookup.callbacks.push_back(std::move(callback));
+        lookup.timer = timers.schedule(responseTimeoutMs, [this, ieee]() { completeShort(ieee, std::nullopt); });
+
+        sendNwkRequest(ieee);
+    }
+
+    void AddressBook::completeIEEE(uint16_t shortAddr, std::optional<uint64_t> ieee)
+    {
+        auto it = ieeeLookups.find(shortAddr);
+        if (it == ieeeLookups.end())
+            return;
+
+        // Out of the map first: a callback may start another lookup
+        Lookup<IEEECallback> lookup = std::move(it->second);
+        ieeeLookups.erase(it);
+        timers.cancel(lookup.timer);
+
+        for (auto &callback : lookup.callbacks)
+            callback(ieee);
+    }
+
+    void AddressBook::completeShort(uint64_t ieee, std::optional<uint16_t> shortAddr)
+    {
+        auto it = shortLookups.find(ieee);
+        if (it == shortLookups.end())
+            return;
+
+        Lookup<ShortCallback> lookup = std::move(it->second);
+        shortLookups.erase(it);
+        timers.cancel(lookup.timer);
+
+        for (auto &callback : lookup.callbacks)
+            callback(shortAddr);
+    }
+
+    void AddressBook::sendIEEERequest(uint16_t shortAddr)
+    {
+        LOG_DEBUG << "[Address] IEEE_addr_req for 0x" << std::hex << shortAddr << std::dec << std::endl;
+
+        // ShortAddr(2), ReqType (0 = single device), StartIndex
+        uint8_t buffer[16];
+        FrameWriter writer(buffer, sizeof(buffer));
+        writer.begin(SREQ | ZDO, ZDO_IEEE_ADDR_REQ);
+        writer.u16(shortAddr);
+        writer.u8(0x00);
+        writer.u8(0x00);
+        sendFunction(writer.finish());
+        lookups++;
+    }
+
+    void AddressBook::sendNwkRequest(uint64_t ieee)
+    {
+        LOG_DEBUG << "[Address] NWK_addr_req for " << std::hex << ieee << std::dec << std::endl;
+
+        // IEEEAddress(8), ReqType, StartIndex. Z-Stack broadcasts it.
+        uint8_t buffer[20];
+        FrameWriter writer(buffer, sizeof(buffer));
+        writer.begin(SREQ | ZDO, ZDO_NWK_ADDR_REQ);
+        writer.u32(static_cast<uint32_t>(ieee));
+        writer.u32(static_cast<uint32_t>(ieee >> 32));
+        writer.u8(0x00);
+        writer.u8(0x00);
+        sendFunction(writer.finish());
+        lookups++;
+    }
+
+    void AddressBook::addressResponse(const std::vector<uint8_t> &p, bool ieeeRequest)
+    {
+        // Status, IEEEAddr(8), NwkAddr(2), StartIndex, NumAssocDev, AssocDevList
+        if (p.size() < 11)
+            return;
+
+        uint8_t status = p[0];
+        uint64_t ieee = readIEEE(p, 1);
+        uint16_t shortAddr = p[9] | (p[10] << 8);
+
+        if (status == 0x00)
+        {
+            learn(shortAddr, ieee);
+            return;
+        }
+
+        // Failures echo what was asked about
+        if (ieeeRequest)
+        {
+            unanswered[shortAddr] = Clock::now() + std::chrono::milliseconds(retryAfterMs);
+            completeIEEE(shortAddr, std::nullopt);
+        }
+        else
+        {
+            completeShort(ieee, std::nullopt);
+        }
+    }
+
+    void AddressBook::handleFrame(const ZStackFrame &frame)
+    {
+        const auto &p = frame.getPayload();
+
+        if (frame.getCommand0() == (AREQ | AF))
+        {
+            // AF_INCOMING_MSG: Group(2), Cluster(2), SrcAddr(2)...
+            if (frame.getCommand1() != AF_INCOMING_MSG || p.size() < 6)
+                return;
+
+            uint16_t srcAddr = p[4] | (p[5] << 8);
+            if (ieeeByShort.find(srcAddr) == ieeeByShort.end())
+                resolveIEEE(srcAddr, nullptr);
+            return;
+        }
+
+        if (frame.getCommand0() != (AREQ | ZDO))
+            return;
+
+        switch (frame.getCommand1())
+        {
+        case ZDO_END_DEVICE_ANNCE_IND:
+            // SrcAddr(2), NwkAddr(2), IEEEAddr(8), Capabilities
+            if (p.size() >= 12)
+                learn(p[2] | (p[3] << 8), readIEEE(p, 4));
+            break;
+        case ZDO_TC_DEV_IND:
+            // SrcNwkAddr(2), ExtAddr(8), ParentAddr(2)
+            if (p.size() >= 10)
+                learn(p[0] | (p[1] << 8), readIEEE(p, 2));
+            break;
+        case ZDO_NWK_ADDR_RSP:
+            addressResponse(p, false);
+            break;
+        case ZDO_IEEE_ADDR_RSP:
+            addressResponse(p, true);
+            break;
+        default:
+            break;
+        }
+    }
+}
@@ -0,0 +1,205 @@
+#include "AttributeCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "ZStackProtocol.h"
+#include "af/AFPacketParser.h"
+
+namespace ZStack
+{
+    ZclReadResult AttributeSnapshot::toResult(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID,
+                                              uint16_t attributeID) const
+    {
+        ZclReadResult result;
+        result.shortAddr = shortAddr;
+        result.endpoint = endpoint;
+        result.clusterID = clusterID;
+        result.attributeID = attributeID;
+        result.status = 0x00;
+        result.dataType = dataType;
+        result.value.assign(value, value + size);
+        return result;
+    }
+
+    AttributeCache::AttributeCache(size_t capacity)
+    {
+        size_t rounded = 16;
+        while (rounded < capacity)
+            rounded <<= 1;
+
+        entries.reset(new Entry[rounded]);
+        mask = rounded - 1;
+    }
+
+    uint64_t AttributeCache::nowMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    uint64_t AttributeCache::packKey(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID, uint16_t attributeID)
+    {
+        return OCCUPIED | (static_cast<uint64_t>(shortAddr) << 40) | (static_cast<uint64_t>(endpoint) << 32) |
+               (static_cast<uint64_t>(clusterID) << 16) | attributeID;
+    }
+
+    size_t AttributeCache::hash(uint64_t key)
+    {
+        key ^= key >> 29;
+        key *= 0xBF58476D1CE4E5B9ULL;
+        key ^= key >> 32;
+        return static_cast<size_t>(key);
+    }
+
+    const AttributeCache::Entry *AttributeCache::find(uint64_t key) const
+    {
+        // Linear probing; slots are never released, so a free one ends the chain
+        for (size_t i = hash(key) & mask, probes = 0; probes <= mask; i = (i + 1) & mask, probes++)
+        {
+            uint64_t stored = entries[i].key.load(std::memory_order_acquire);
+            if (stored == key)
+                return &entries[i];
+            if (stored == 0)
+                return nullptr;
+        }
+        return nullptr;
+    }
+
+    AttributeCache::Entry *AttributeCache::claim(uint64_t key)
+    {
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask)
+        {
+            uint64_t stored = entries[i].key.load(std::memory_order_relaxed);
+            if (stored == key)
+                return &entries[i];
+            if (stored != 0)
+                continue;
+
+            // Keep probe chains short: stop taking new keys at 3/4
+            if (used.load(std::memory_order_relaxed) + 1 > (mask + 1) / 4 * 3)
+                return nullptr;
+
+            used.fetch_add(1, std::memory_order_relaxed);
+            entries[i].key.store(key, std::memory_order_release);
+            return &entries[i];
+        }
+    }
+
+    void AttributeCache::write(Entry &entry, uint64_t meta, const uint8_t *value, size_t size, uint64_t nowMs)
+    {
+        // Seqlock: odd while writing, readers retry if it moved under them
+        uint32_t sequence = entry.sequence.load(std::memory_order_relaxed);
+        entry.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        entry.meta.store(meta, std::memory_order_relaxed);
+        entry.updatedMs.store(nowMs, std::memory_order_relaxed);
+        for (size_t word = 0; word < VALUE_WORDS && word * 8 < size; word++)
+        {
+            uint64_t bits = 0;
+            std::memcpy(&bits, value + word * 8, std::min<size_t>(8, size - word * 8));
+            entry.value[word].store(bits, std::memory_order_relaxed);
+        }
+
+        entry.sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    void AttributeCache::update(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID, uint16_t attributeID,
+                                uint8_t dataType, const uint8_t *value, size_t size, uint64_t nowMs)
+    {
+        if (size > AttributeSnapshot::MAX_VALUE_SIZE)
+        {
+            rejectedCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        Entry *entry = claim(packKey(shortAddr, endpoint, clusterID, attributeID));
+        if (entry == nullptr)
+        {
+            rejectedCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        write(*entry, (1ULL << 16) | (static_cast<uint64_t>(size) << 8) | dataType, value, size, nowMs);
+    }
+
+    void AttributeCache::forget(uint16_t shortAddr)
+    {
+        // Rare (leave / address change): a scan is fine. The slots stay claimed.
+        for (size_t i = 0; i <= mask; i++)
+        {
+            uint64_t key = entries[i].key.load(std::memory_order_relaxed);
+            if (key != 0 && ((key >> 40) & 0xFFFF) == shortAddr &&
+                entries[i].meta.load(std::memory_order_relaxed) != 0)
+            {
+                write(entries[i], 0, nullptr, 0, 0);
+            }
+        }
+    }
+
+    bool AttributeCache::get(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID, uint16_t attributeID,
+                             AttributeSnapshot &snapshot) const
+    {
+        const Entry *entry = find(packKey(shortAddr, endpoint, clusterID, attributeID));
+        if (entry == nullptr)
+            return false;
+
+        uint64_t words[VALUE_WORDS];
+        uint64_t meta;
+        while (true)
+        {
+            uint32_t before = entry->sequence.load(std::memory_order_acquire);
+            if (before & 1)
+                continue; // Writer inside
+
+            meta = entry->meta.load(std::memory_order_relaxed);
+            snapshot.updatedMs = entry->updatedMs.load(std::memory_order_relaxed);
+            for (size_t word = 0; word < VALUE_WORDS; word++)
+                words[word] = entry->value[word].load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (entry->sequence.load(std::memory_order_relaxed) == before)
+                break;
+        }
+
+        if ((meta >> 16) == 0)
+            return false; // Forgotten
+
+        snapshot.dataType = meta & 0xFF;
+        snapshot.size = (meta >> 8) & 0xFF;
+        std::memcpy(snapshot.value, words, snapshot.size);
+        return true;
+    }
+
+    void AttributeCache::handleFrame(const ZStackFrame &frame)
+    {
+        if (frame.getCommand0() != (AREQ | AF) || frame.getCommand1() != AF_INCOMING_MSG)
+            return;
+
+        const auto &p = frame.getPayload();
+
+        // AF_INCOMING_MSG header (17) + ZCL header (3)
+        if (p.size() < 20)
+            return;
+
+        // Profile wide, not manufacturer specific (that header is 2 bytes longer)
+        uint8_t zclCmd = p[19];
+        if ((p[17] & 0x07) != 0x00 || (zclCmd != ZCL_READ_ATTRIB_RSP && zclCmd != ZCL_REPORT_ATTRIB))
+            return;
+
+        uint16_t clusterID = p[2] | (p[3] << 8);
+        uint16_t srcAddr = p[4] | (p[5] << 8);
+        uint8_t srcEndpoint = p[6];
+        uint64_t now = nowMs();
+
+        for (const auto &record : AFPacket::parseAttributeRecords(zclCmd, p))
+        {
+            if (record.status != 0x00)
+                continue;
+
+            update(srcAddr, srcEndpoint, clusterID, record.attributeID, record.dataType, record.value.data(),
+                   record.value.size(), now);
+        }
+    }
+}
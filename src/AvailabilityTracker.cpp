@@ -0,0 +1,177 @@
+#include "AvailabilityTracker.h"
+#include <algorithm>
+#include <iomanip>
+#include "Logger.h"
+#include "ZStackProtocol.h"
+
+namespace ZStack
+{
+    AvailabilityTracker::AvailabilityTracker(TimerWheel &timers, int defaultIntervalMs, int missedReports)
+        : timers(timers),
+          defaultIntervalMs(defaultIntervalMs),
+          missedReports(missedReports > 0 ? missedReports : 1),
+          slotByAddr(0x10000, NONE)
+    {
+    }
+
+    AvailabilityTracker::~AvailabilityTracker()
+    {
+        for (auto &device : devices)
+        {
+            if (device.inUse)
+                timers.cancel(device.timer);
+        }
+    }
+
+    void AvailabilityTracker::handleFrame(const ZStackFrame &frame)
+    {
+        const auto &p = frame.getPayload();
+        uint8_t cmd0 = frame.getCommand0();
+        uint8_t cmd1 = frame.getCommand1();
+
+        uint16_t shortAddr;
+        if (cmd0 == (AREQ | AF) && cmd1 == AF_INCOMING_MSG && p.size() > 5)
+        {
+            // Group(2) Cluster(2) SrcAddr(2) ...
+            shortAddr = p[4] | (p[5] << 8);
+        }
+        else if (cmd0 != (AREQ | ZDO) || !getZDOSourceAddress(cmd1, p, shortAddr))
+        {
+            // Of the ZDO frames, responses, announcements (the new address)
+            // and TC_DEV_IND name their sender
+            return;
+        }
+
+        // The coordinator answering for itself says nothing about the network
+        if (shortAddr != 0x0000)
+            seen(shortAddr);
+    }
+
+    uint32_t AvailabilityTracker::slotFor(uint16_t shortAddr)
+    {
+        uint32_t slot;
+        if (!freeSlots.empty())
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            slot = static_cast<uint32_t>(devices.size());
+            devices.emplace_back();
+        }
+
+        Device &device = devices[slot];
+        device.shortAddr = shortAddr;
+        device.timeoutMs = defaultIntervalMs * missedReports;
+        device.timer = INVALID_TIMER;
+        device.online = false;
+        device.inUse = true;
+
+        slotByAddr[shortAddr] = slot;
+        return slot;
+    }
+
+    void AvailabilityTracker::seen(uint16_t shortAddr)
+    {
+        uint32_t slot = slotByAddr[shortAddr];
+        if (slot == NONE)
+            slot = slotFor(shortAddr);
+
+        Device &device = devices[slot];
+        device.lastSeen = Clock::now();
+
+        if (device.online)
+            return; // The common case: one store and done
+
+        // Back (or new): the timer only runs while the device is online
+        device.online = true;
+        online++;
+        arm(slot, device.timeoutMs);
+
+        LOG_DEBUG << "[Availability] 0x" << std::hex << shortAddr << std::dec << " online" << std::endl;
+        if (handler)
+            handler(shortAddr, true);
+    }
+
+    void AvailabilityTracker::arm(uint32_t slot, int delayMs)
+    {
+        Device &device = devices[slot];
+        timers.cancel(device.timer);
+        device.timer = timers.schedule(delayMs, [this, slot]() { expire(slot); });
+    }
+
+    void AvailabilityTracker::expire(uint32_t slot)
+    {
+        Device &device = devices[slot];
+        device.timer = INVALID_TIMER;
+
+        // 1. Heard from it since the timer was set: wait for the rest
+        auto silentMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - device.lastSeen).count();
+        if (silentMs < device.timeoutMs)
+        {
+            arm(slot, static_cast<int>(device.timeoutMs - silentMs));
+            return;
+        }
+
+        // 2. Missed too many reports
+        device.online = false;
+        online--;
+
+        LOG_INFO << "[Availability] 0x" << std::hex << device.shortAddr << std::dec << " offline (silent for "
+                 << silentMs / 1000 << " s)" << std::endl;
+        if (handler)
+            handler(device.shortAddr, false);
+    }
+
+    void AvailabilityTracker::setReportInterval(uint16_t shortAddr, int intervalMs)
+    {
+        if (intervalMs <= 0)
+            return;
+
+        uint32_t slot = slotByAddr[shortAddr];
+        if (slot == NONE)
+            slot = slotFor(shortAddr);
+
+        Device &device = devices[slot];
+        device.timeoutMs = intervalMs * missedReports;
+
+        // Re-arm against the new timeout, counting from the last frame
+        if (device.online)
+        {
+            auto silentMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - device.lastSeen).count();
+            arm(slot, static_cast<int>(std::max<long long>(0, device.timeoutMs - silentMs)));
+        }
+    }
+
+    void AvailabilityTracker::forget(uint16_t shortAddr)
+    {
+        uint32_t slot = slotByAddr[shortAddr];
+        if (slot == NONE)
+            return;
+
+        Device &device = devices[slot];
+        timers.cancel(device.timer);
+        if (device.online)
+            online--;
+        device.inUse = false;
+        device.online = false;
+
+        slotByAddr[shortAddr] = NONE;
+        freeSlots.push_back(slot);
+    }
+
+    bool AvailabilityTracker::isOnline(uint16_t shortAddr) const
+    {
+        uint32_t slot = slotByAddr[shortAddr];
+        return slot != NONE && devices[slot].online;
+    }
+
+    std::optional<AvailabilityTracker::Clock::time_point> AvailabilityTracker::lastSeen(uint16_t shortAddr) const
+    {
+        uint32_t slot = slotByAddr[shortAddr];
+        if (slot == NONE)
+            return std::nullopt;
+        return devices[slot].lastSeen;
+    }
+}
@@ -0,0 +1,525 @@
+#include "ClientMetrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Logger.h"
+
+namespace ZStack
+{
+    namespace
+    {
+        // Single writer: a relaxed load/store is enough and avoids a locked add
+        inline void bump(std::atomic<uint64_t> &counter, uint64_t amount = 1)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        inline uint64_t get(const std::atomic<uint64_t> &counter)
+        {
+            return counter.load(std::memory_order_relaxed);
+        }
+
+        inline size_t blockIndex(uint8_t cmd0)
+        {
+            // Type (SREQ/AREQ/SRSP) in bits 5-6, subsystem in bits 0-4
+            return (((cmd0 >> 5) & 0x03) << 5) | (cmd0 & 0x1F);
+        }
+
+        inline uint8_t blockCmd0(size_t index)
+        {
+            return static_cast<uint8_t>(((index >> 5) << 5) | (index & 0x1F));
+        }
+
+        // Prometheus buckets (seconds) derived from the fine-grained histogram
+        const double EXPORT_BUCKETS[] = {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+                                         0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0};
+
+        void writeHistogram(std::ostringstream &out, const std::string &name, const std::string &labels,
+                            const HistogramSnapshot &histogram)
+        {
+            std::string prefix = labels.empty() ? "{" : "{" + labels + ",";
+
+            uint64_t cumulative = 0;
+            size_t bucket = 0;
+            for (double bound : EXPORT_BUCKETS)
+            {
+                uint64_t boundUs = static_cast<uint64_t>(bound * 1e6);
+                while (bucket < histogram.buckets.size() && LatencyHistogram::bucketUpperBound(bucket) <= boundUs)
+                    cumulative += histogram.buckets[bucket++];
+
+                out << name << "_bucket" << prefix << "le=\"" << bound << "\"} " << cumulative << "\n";
+            }
+            out << name << "_bucket" << prefix << "le=\"+Inf\"} " << histogram.count << "\n";
+            out << name << "_sum" << (labels.empty() ? "" : "{" + labels + "}") << " " << histogram.sumUs / 1e6 << "\n";
+            out << name << "_count" << (labels.empty() ? "" : "{" + labels + "}") << " " << histogram.count << "\n";
+        }
+    }
+
+    // ---------------------------------------------------------------- Histogram
+
+    size_t LatencyHistogram::bucketFor(uint64_t valueUs)
+    {
+        if (valueUs < SUB_BUCKETS)
+            return static_cast<size_t>(valueUs);
+
+        int msb = 63 - __builtin_clzll(valueUs);
+        if (msb > 31)
+            return BUCKETS - 1;
+
+        int shift = msb - SUB_BITS;
+        return static_cast<size_t>((shift + 1) * SUB_BUCKETS + ((valueUs >> shift) - SUB_BUCKETS));
+    }
+
+    uint64_t LatencyHistogram::bucketUpperBound(size_t bucket)
+    {
+        if (bucket < SUB_BUCKETS)
+            return bucket;
+
+        int shift = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+        uint64_t sub = (bucket % SUB_BUCKETS) + SUB_BUCKETS;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    void LatencyHistogram::record(uint64_t valueUs)
+    {
+        bump(buckets[bucketFor(valueUs)]);
+        bump(count);
+        bump(sumUs, valueUs);
+        if (valueUs > get(maxUs))
+            maxUs.store(valueUs, std::memory_order_relaxed);
+    }
+
+    HistogramSnapshot LatencyHistogram::snapshot() const
+    {
+        HistogramSnapshot snapshot;
+        snapshot.buckets.resize(BUCKETS);
+
+        uint64_t total = 0;
+        for (size_t i = 0; i < BUCKETS; i++)
+        {
+            snapshot.buckets[i] = get(buckets[i]);
+            total += snapshot.buckets[i];
+        }
+
+        // Buckets are read one by one while the writer carries on: keep count
+        // consistent with what we actually saw
+        snapshot.count = total;
+        snapshot.sumUs = get(sumUs);
+        snapshot.maxUs = get(maxUs);
+        return snapshot;
+    }
+
+    uint64_t HistogramSnapshot::percentile(double p) const
+    {
+        if (count == 0)
+            return 0;
+
+        uint64_t rank = static_cast<uint64_t>(p * count);
+        if (rank >= count)
+            rank = count - 1;
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); i++)
+        {
+            seen += buckets[i];
+            if (seen > rank)
+                return std::min(LatencyHistogram::bucketUpperBound(i), maxUs);
+        }
+        return maxUs;
+    }
+
+    // ---------------------------------------------------------------- Metrics
+
+    ClientMetrics::ClientMetrics()
+        : sreqHistograms(new std::atomic<LatencyHistogram *>[COMMANDS])
+    {
+        for (size_t i = 0; i < COMMANDS; i++)
+            sreqHistograms[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ClientMetrics::~ClientMetrics()
+    {
+        for (auto &block : rxCounts)
+            delete block.load();
+        for (auto &block : txCounts)
+            delete block.load();
+        for (size_t i = 0; i < COMMANDS; i++)
+            delete sreqHistograms[i].load();
+    }
+
+    uint64_t ClientMetrics::nowUs()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    void ClientMetrics::count(std::array<std::atomic<CounterBlock *>, BLOCKS> &blocks, uint8_t cmd0, uint8_t cmd1)
+    {
+        auto &slot = blocks[blockIndex(cmd0)];
+        CounterBlock *block = slot.load(std::memory_order_relaxed);
+        if (!block)
+        {
+            // Published with release so readers never see an uninitialised block
+            block = new CounterBlock{};
+            slot.store(block, std::memory_order_release);
+        }
+        bump((*block)[cmd1]);
+    }
+
+    void ClientMetrics::onTransmit(const uint8_t *frame, size_t size)
+    {
+        // SOF, LEN, CMD0, CMD1, payload..., FCS
+        if (size < 5)
+            return;
+
+        uint8_t cmd0 = frame[2];
+        uint8_t cmd1 = frame[3];
+        const uint8_t *payload = frame + 4;
+        size_t length = frame[1];
+
+        count(txCounts, cmd0, cmd1);
+        bump(txFrames);
+        bump(txBytes, size);
+
+        // 1. SREQs are answered by an SRSP with the same subsystem / command.
+        //    If the queue is full the oldest entry has been lost anyway.
+        if ((cmd0 & 0xE0) == SREQ)
+        {
+            if (outstandingCount == MAX_OUTSTANDING)
+            {
+                outstandingHead = (outstandingHead + 1) % MAX_OUTSTANDING;
+                outstandingCount--;
+            }
+            size_t tail = (outstandingHead + outstandingCount) % MAX_OUTSTANDING;
+            outstanding[tail] = {static_cast<uint16_t>(((cmd0 & 0x1F) << 8) | cmd1), nowUs()};
+            outstandingCount++;
+        }
+
+        // 2. AF data requests are confirmed by TransID
+        if (cmd0 == (SREQ | AF) && cmd1 == AF_DATA_REQUEST && length >= 7)
+            afSentUs[payload[6]] = nowUs();
+        else if (cmd0 == (SREQ | AF) && cmd1 == AF_DATA_REQUEST_EXT && length >= 16)
+            afSentUs[payload[15]] = nowUs(); // After mode, 8 byte address, endpoint, PAN, src endpoint, cluster
+    }
+
+    void ClientMetrics::onReceive(const ZStackFrame &frame)
+    {
+        uint8_t cmd0 = frame.getCommand0();
+        uint8_t cmd1 = frame.getCommand1();
+        const auto &payload = frame.getPayload();
+
+        count(rxCounts, cmd0, cmd1);
+        bump(rxFrames);
+
+        uint8_t subsystem = cmd0 & 0x1F;
+
+        // 1. RPC error: [ErrorCode][Cmd0][Cmd1] of the command that was refused
+        if ((cmd0 & 0xE0) == SRSP && subsystem == 0x00)
+        {
+            bump(rpcErrors);
+            if (payload.size() >= 3)
+                takeOutstanding(static_cast<uint16_t>(((payload[1] & 0x1F) << 8) | payload[2]));
+            return;
+        }
+
+        if (subsystem == 0x00 || subsystem > UTIL)
+            bump(unknownSubsystem);
+
+        // 2. SREQ -> SRSP round trip
+        if ((cmd0 & 0xE0) == SRSP)
+        {
+            uint16_t key = static_cast<uint16_t>((subsystem << 8) | cmd1);
+            uint64_t sent = takeOutstanding(key);
+            if (sent != 0)
+            {
+                LatencyHistogram *histogram = sreqHistograms[key].load(std::memory_order_relaxed);
+                if (!histogram)
+                {
+                    histogram = new LatencyHistogram();
+                    sreqHistograms[key].store(histogram, std::memory_order_release);
+                }
+                histogram->record(nowUs() - sent);
+            }
+            return;
+        }
+
+        // 3. AF_DATA_CONFIRM: [Status][Endpoint][TransID]
+        if (cmd0 == (AREQ | AF) && cmd1 == AF_DATA_CONFIRM && payload.size() >= 3)
+        {
+            uint64_t sent = afSentUs[payload[2]];
+            if (sent != 0)
+            {
+                afSentUs[payload[2]] = 0;
+                afConfirmHistogram.record(nowUs() - sent);
+            }
+            if (payload[0] != 0x00)
+                bump(afConfirmFailures);
+        }
+    }
+
+    uint64_t ClientMetrics::takeOutstanding(uint16_t key)
+    {
+        // Anything older than the match never got its answer: drop it
+        for (size_t i = 0; i < outstandingCount; i++)
+        {
+            const OutstandingSreq &entry = outstanding[(outstandingHead + i) % MAX_OUTSTANDING];
+            if (entry.key != key)
+                continue;
+
+            uint64_t sent = entry.sentUs;
+            outstandingHead = (outstandingHead + i + 1) % MAX_OUTSTANDING;
+            outstandingCount -= i + 1;
+            return sent;
+        }
+        return 0;
+    }
+
+    void ClientMetrics::setParserStats(const Parser::Stats &stats)
+    {
+        parserFrames.store(stats.frames, std::memory_order_relaxed);
+        parserChecksumErrors.store(stats.checksumErrors, std::memory_order_relaxed);
+        parserDiscardedBytes.store(stats.discardedBytes, std::memory_order_relaxed);
+    }
+
+    void ClientMetrics::onDuplicateDropped()
+    {
+        bump(duplicatesDropped);
+    }
+
+    void ClientMetrics::onCachedRead()
+    {
+        bump(cachedReads);
+    }
+
+    void ClientMetrics::setQueueDepths(size_t pending, size_t reads, size_t inFlight, size_t timerCount)
+    {
+        pendingRequests.store(pending, std::memory_order_relaxed);
+        pendingReads.store(reads, std::memory_order_relaxed);
+        inFlightReads.store(inFlight, std::memory_order_relaxed);
+        timers.store(timerCount, std::memory_order_relaxed);
+    }
+
+    MetricsSnapshot ClientMetrics::snapshot() const
+    {
+        MetricsSnapshot snapshot;
+
+        for (size_t index = 0; index < BLOCKS; index++)
+        {
+            const CounterBlock *rx = rxCounts[index].load(std::memory_order_acquire);
+            const CounterBlock *tx = txCounts[index].load(std::memory_order_acquire);
+            if (!rx && !tx)
+                continue;
+
+            for (size_t cmd1 = 0; cmd1 < 256; cmd1++)
+            {
+                uint64_t rxCount = rx ? get((*rx)[cmd1]) : 0;
+                uint64_t txCount = tx ? get((*tx)[cmd1]) : 0;
+                if (rxCount || txCount)
+                    snapshot.commands.push_back({blockCmd0(index), static_cast<uint8_t>(cmd1), rxCount, txCount});
+            }
+        }
+
+        snapshot.rxFrames = get(rxFrames);
+        snapshot.txFrames = get(txFrames);
+        snapshot.txBytes = get(txBytes);
+        snapshot.parser.frames = get(parserFrames);
+        snapshot.parser.checksumErrors = get(parserChecksumErrors);
+        snapshot.parser.discardedBytes = get(parserDiscardedBytes);
+        snapshot.rpcErrors = get(rpcErrors);
+        snapshot.unknownSubsystem = get(unknownSubsystem);
+        snapshot.afConfirmFailures = get(afConfirmFailures);
+        snapshot.duplicatesDropped = get(duplicatesDropped);
+        snapshot.cachedReads = get(cachedReads);
+        snapshot.pendingRequests = get(pendingRequests);
+        snapshot.pendingReads = get(pendingReads);
+        snapshot.inFlightReads = get(inFlightReads);
+        snapshot.timers = get(timers);
+
+        for (size_t key = 0; key < COMMANDS; key++)
+        {
+            const LatencyHistogram *histogram = sreqHistograms[key].load(std::memory_order_acquire);
+            if (histogram)
+            {
+                uint8_t cmd0 = static_cast<uint8_t>(SREQ | (key >> 8));
+                snapshot.sreqLatency[{cmd0, static_cast<uint8_t>(key & 0xFF)}] = histogram->snapshot();
+            }
+        }
+        snapshot.afConfirmLatency = afConfirmHistogram.snapshot();
+
+        return snapshot;
+    }
+
+    std::string ClientMetrics::toPrometheus() const
+    {
+        MetricsSnapshot s = snapshot();
+        std::ostringstream out;
+
+        out << "# HELP zstack_frames_total MT frames by direction and command\n"
+            << "# TYPE zstack_frames_total counter\n";
+        for (const auto &command : s.commands)
+        {
+            std::string labels = "cmd0=\"" + toHex(command.cmd0) + "\",cmd1=\"" + toHex(command.cmd1) +
+                                 "\",name=\"" + getCommandName(command.cmd0, command.cmd1) + "\"";
+            if (command.rx)
+                out << "zstack_frames_total{direction=\"rx\"," << labels << "} " << command.rx << "\n";
+            if (command.tx)
+                out << "zstack_frames_total{direction=\"tx\"," << labels << "} " << command.tx << "\n";
+        }
+
+        out << "# HELP zstack_tx_bytes_total Bytes written to the serial port\n"
+            << "# TYPE zstack_tx_bytes_total counter\n"
+            << "zstack_tx_bytes_total " << s.txBytes << "\n"
+            << "# HELP zstack_parser_frames_total Frames with a valid checksum\n"
+            << "# TYPE zstack_parser_frames_total counter\n"
+            << "zstack_parser_frames_total " << s.parser.frames << "\n"
+            << "# HELP zstack_parser_checksum_errors_total Frames dropped on a bad FCS\n"
+            << "# TYPE zstack_parser_checksum_errors_total counter\n"
+            << "zstack_parser_checksum_errors_total " << s.parser.checksumErrors << "\n"
+            << "# HELP zstack_parser_discarded_bytes_total Bytes skipped while looking for a start of frame\n"
+            << "# TYPE zstack_parser_discarded_bytes_total counter\n"
+            << "zstack_parser_discarded_bytes_total " << s.parser.discardedBytes << "\n"
+            << "# HELP zstack_rpc_errors_total Commands rejected by the dongle\n"
+            << "# TYPE zstack_rpc_errors_total counter\n"
+            << "zstack_rpc_errors_total " << s.rpcErrors << "\n"
+            << "# HELP zstack_unknown_subsystem_frames_total Frames for an unknown MT subsystem\n"
+            << "# TYPE zstack_unknown_subsystem_frames_total counter\n"
+            << "zstack_unknown_subsystem_frames_total " << s.unknownSubsystem << "\n"
+            << "# HELP zstack_af_confirm_failures_total AF_DATA_CONFIRM with a non-zero status\n"
+            << "# TYPE zstack_af_confirm_failures_total counter\n"
+            << "zstack_af_confirm_failures_total " << s.afConfirmFailures << "\n"
+            << "# HELP zstack_duplicate_frames_total Repeated AF_INCOMING_MSG dropped before decoding\n"
+            << "# TYPE zstack_duplicate_frames_total counter\n"
+            << "zstack_duplicate_frames_total " << s.duplicatesDropped << "\n"
+            << "# HELP zstack_cached_reads_total Attribute reads answered from the cache instead of the air\n"
+            << "# TYPE zstack_cached_reads_total counter\n"
+            << "zstack_cached_reads_total " << s.cachedReads << "\n";
+
+        out << "# HELP zstack_queue_depth Outstanding work in the client\n"
+            << "# TYPE zstack_queue_depth gauge\n"
+            << "zstack_queue_depth{queue=\"pending_requests\"} " << s.pendingRequests << "\n"
+            << "zstack_queue_depth{queue=\"pending_reads\"} " << s.pendingReads << "\n"
+            << "zstack_queue_depth{queue=\"in_flight_reads\"} " << s.inFlightReads << "\n"
+            << "zstack_queue_depth{queue=\"timers\"} " << s.timers << "\n";
+
+        out << "# HELP zstack_sreq_latency_seconds SREQ to SRSP round trip\n"
+            << "# TYPE zstack_sreq_latency_seconds histogram\n";
+        for (const auto &entry : s.sreqLatency)
+        {
+            std::string labels = "command=\"" + getCommandName(entry.first.first, entry.first.second) + "\"";
+            writeHistogram(out, "zstack_sreq_latency_seconds", labels, entry.second);
+        }
+
+        out << "# HELP zstack_af_confirm_latency_seconds AF_DATA_REQUEST to AF_DATA_CONFIRM\n"
+            << "# TYPE zstack_af_confirm_latency_seconds histogram\n";
+        writeHistogram(out, "zstack_af_confirm_latency_seconds", "", s.afConfirmLatency);
+
+        return out.str();
+    }
+
+    bool ClientMetrics::writePrometheusFile(const std::string &path) const
+    {
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::trunc);
+            if (!file.is_open())
+                return false;
+            file << toPrometheus();
+        }
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    // ---------------------------------------------------------------- Exporter
+
+    MetricsExporter::MetricsExporter(const ClientMetrics &metrics)
+        : metrics(metrics), listenFd(-1), running(false)
+    {
+    }
+
+    MetricsExporter::~MetricsExporter()
+    {
+        stop();
+    }
+
+    bool MetricsExporter::listen(const std::string &path)
+    {
+        stop();
+
+        struct sockaddr_un address;
+        if (path.size() >= sizeof(address.sun_path))
+            return false;
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0)
+            return false;
+
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+        unlink(path.c_str());
+        if (bind(listenFd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd, 4) != 0)
+        {
+            LOG_ERROR << "[Metrics] Unable to listen on " << path << ": " << strerror(errno) << std::endl;
+            ::close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+
+        socketPath = path;
+        running = true;
+        worker = std::thread(&MetricsExporter::serve, this);
+
+        LOG_INFO << "[Metrics] Serving on " << path << std::endl;
+        return true;
+    }
+
+    void MetricsExporter::stop()
+    {
+        running = false;
+        if (worker.joinable())
+            worker.join();
+
+        if (listenFd >= 0)
+        {
+            ::close(listenFd);
+            listenFd = -1;
+            unlink(socketPath.c_str());
+        }
+    }
+
+    void MetricsExporter::serve()
+    {
+        while (running)
+        {
+            // Wake up now and then to notice stop()
+            struct pollfd pfd = {listenFd, POLLIN, 0};
+            if (poll(&pfd, 1, 200) <= 0)
+                continue;
+
+            int client = accept(listenFd, nullptr, nullptr);
+            if (client < 0)
+                continue;
+
+            std::string text = metrics.toPrometheus();
+            size_t sent = 0;
+            while (sent < text.size())
+            {
+                ssize_t n = send(client, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0)
+                    break;
+                sent += n;
+            }
+            ::close(client);
+        }
+    }
+}
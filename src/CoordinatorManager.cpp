@@ -0,0 +1,281 @@
+#include "CoordinatorManager.h"
+#include <algorithm>
+#include <poll.h>
+#include "Logger.h"
+
+namespace ZStack
+{
+    size_t CoordinatorManager::addCoordinator(const CoordinatorConfig &config)
+    {
+        size_t index = coordinators.size();
+
+        auto coordinator = std::make_unique<Coordinator>();
+        coordinator->config = config;
+        coordinator->client = std::make_unique<ZStackClient>(config.port);
+
+        // Everything a client receives goes through the manager first, so the
+        // registry is up to date before the application sees the packet
+        coordinator->client->setZdoPacketHandler([this, index](const ZDOPacket::Packet &packet) {
+            onZdoPacket(index, packet);
+        });
+        coordinator->client->setAfPacketHandler([this, index](const AFPacket::Packet &packet) {
+            if (afHandler)
+                afHandler(index, packet);
+        });
+        coordinator->client->addFrameListener([this, index](const ZStackFrame &frame) {
+            for (auto &listener : frameListeners)
+                listener(index, frame);
+        });
+
+        coordinators.push_back(std::move(coordinator));
+        return index;
+    }
+
+    size_t CoordinatorManager::startAll()
+    {
+        size_t started = 0;
+
+        for (size_t i = 0; i < coordinators.size(); i++)
+        {
+            Coordinator &coordinator = *coordinators[i];
+            ZStackClient &client = *coordinator.client;
+
+            if (!client.connect())
+            {
+                LOG_ERROR << "[Coordinators] #" << i << " (" << coordinator.config.port << ") failed to connect" << std::endl;
+                continue;
+            }
+
+            if (!coordinator.config.capturePath.empty())
+                client.startCapture(coordinator.config.capturePath);
+
+            // 1. Network parameters, only used when the dongle forms a new network
+            if (coordinator.config.panId != 0)
+            {
+                uint16_t pan = coordinator.config.panId;
+                client.writeConfiguration(ZCD_NV_PANID, {static_cast<uint8_t>(pan & 0xFF), static_cast<uint8_t>(pan >> 8)});
+            }
+            if (coordinator.config.channelMask != 0)
+            {
+                uint32_t mask = coordinator.config.channelMask;
+                client.writeConfiguration(ZCD_NV_CHANLIST, {static_cast<uint8_t>(mask & 0xFF), static_cast<uint8_t>((mask >> 8) & 0xFF),
+                                                            static_cast<uint8_t>((mask >> 16) & 0xFF), static_cast<uint8_t>(mask >> 24)});
+            }
+
+            // 2. Start (warm when possible) and learn who it is
+            if (!client.startup())
+            {
+                LOG_ERROR << "[Coordinators] #" << i << " (" << coordinator.config.port << ") failed to start" << std::endl;
+                continue;
+            }
+
+            auto state = client.getDeviceState();
+            if (state)
+                coordinator.ieee = state->iEEE_address;
+
+            coordinator.up = true;
+            started++;
+
+            LOG_INFO << "[Coordinators] #" << i << " up on " << coordinator.config.port
+                     << (state ? " (IEEE " + ZStackClient::ieeeToString(state->iEEE_address) + ")" : "") << std::endl;
+        }
+
+        return started;
+    }
+
+    void CoordinatorManager::process()
+    {
+        // 1. Wait for any port to be readable, at most one timer wheel tick.
+        //    A blocking read per client would let each idle port stall the rest.
+        std::vector<pollfd> ports;
+        std::vector<ZStackClient *> clients;
+        for (auto &coordinator : coordinators)
+        {
+            if (!coordinator->up)
+                continue;
+            ports.push_back({coordinator->client->pollDescriptor(), POLLIN, 0});
+            clients.push_back(coordinator->client.get());
+        }
+
+        // (With no coordinator up this just sleeps the tick.)
+        if (poll(ports.data(), ports.size(), POLL_TIMEOUT_MS) < 0)
+        {
+            for (auto &port : ports)
+                port.revents = 0; // Interrupted: just a turn without reads
+        }
+
+        // 2. Everyone gets a turn (timers, posted work, queued sends); only ready ports are read
+        for (size_t i = 0; i < clients.size(); i++)
+            clients[i]->process(ports[i].revents != 0);
+
+        if (joinCoordinator && std::chrono::steady_clock::now() >= joinDeadline)
+            joinCoordinator.reset();
+    }
+
+    std::optional<size_t> CoordinatorManager::leastLoaded() const
+    {
+        std::optional<size_t> best;
+
+        for (size_t i = 0; i < coordinators.size(); i++)
+        {
+            const Coordinator &candidate = *coordinators[i];
+            if (!candidate.up)
+                continue;
+
+            if (!best)
+            {
+                best = i;
+                continue;
+            }
+
+            // Compare devices / capacity without dividing
+            const Coordinator &current = *coordinators[*best];
+            size_t candidateCapacity = std::max<size_t>(candidate.config.maxDevices, 1);
+            size_t currentCapacity = std::max<size_t>(current.config.maxDevices, 1);
+            if (candidate.devices.size() * currentCapacity < current.devices.size() * candidateCapacity)
+                best = i;
+        }
+
+        return best;
+    }
+
+    void CoordinatorManager::permitJoin(uint8_t durationSeconds)
+    {
+        // 1. Closing: only the coordinator holding the window has it open
+        if (durationSeconds == 0)
+        {
+            if (joinCoordinator)
+                coordinators[*joinCoordinator]->client->permitJoin(0);
+            joinCoordinator.reset();
+            return;
+        }
+
+        auto target = leastLoaded();
+        if (!target)
+        {
+            LOG_WARN << "[Coordinators] No coordinator is up, cannot permit joins" << std::endl;
+            return;
+        }
+
+        if (joinCoordinator && *joinCoordinator != *target)
+            coordinators[*joinCoordinator]->client->permitJoin(0);
+
+        // 2. 255 keeps it open until closed again
+        joinDeadline = durationSeconds == 0xFF ? std::chrono::steady_clock::time_point::max()
+                                               : std::chrono::steady_clock::now() + std::chrono::seconds(durationSeconds);
+        joinCoordinator = target;
+        coordinators[*target]->client->permitJoin(durationSeconds);
+
+        LOG_INFO << "[Coordinators] Joining open on #" << *target << " (" << coordinators[*target]->devices.size()
+                 << " devices) for " << (int)durationSeconds << " s" << std::endl;
+    }
+
+    void CoordinatorManager::rebalanceJoin()
+    {
+        if (!joinCoordinator)
+            return;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= joinDeadline)
+        {
+            joinCoordinator.reset();
+            return;
+        }
+
+        auto target = leastLoaded();
+        if (!target || *target == *joinCoordinator)
+            return;
+
+        // Hand the rest of the window over to the coordinator that is now the least loaded
+        uint8_t remaining = 0xFF;
+        if (joinDeadline != std::chrono::steady_clock::time_point::max())
+        {
+            auto seconds = std::chrono::duration_cast<std::chrono::seconds>(joinDeadline - now).count();
+            remaining = static_cast<uint8_t>(std::max<long long>(1, std::min<long long>(254, seconds)));
+        }
+
+        coordinators[*joinCoordinator]->client->permitJoin(0);
+        coordinators[*target]->client->permitJoin(remaining);
+
+        LOG_INFO << "[Coordinators] Join window moved from #" << *joinCoordinator << " to #" << *target << std::endl;
+        joinCoordinator = target;
+    }
+
+    std::optional<DeviceLocation> CoordinatorManager::locate(uint64_t ieee) const
+    {
+        auto it = registry.find(ieee);
+        if (it == registry.end())
+            return std::nullopt;
+        return it->second;
+    }
+
+    uint64_t CoordinatorManager::ieeeOf(size_t coordinator, uint16_t shortAddr) const
+    {
+        if (coordinator >= coordinators.size())
+            return 0;
+
+        const auto &devices = coordinators[coordinator]->devices;
+        auto it = devices.find(shortAddr);
+        if (it != devices.end())
+            return it->second;
+
+        // Not announced to us: the client looks unknown senders up on its own
+        return coordinators[coordinator]->client->addresses().ieeeOf(shortAddr).value_or(0);
+    }
+
+    void CoordinatorManager::assignDevice(uint64_t ieee, size_t coordinator, uint16_t shortAddr)
+    {
+        if (coordinator >= coordinators.size())
+            return;
+
+        // 1. Forget where it was before (rejoined elsewhere, or got a new NWK address)
+        auto previous = registry.find(ieee);
+        if (previous != registry.end())
+        {
+            auto &oldDevices = coordinators[previous->second.coordinator]->devices;
+            auto entry = oldDevices.find(previous->second.shortAddr);
+            if (entry != oldDevices.end() && entry->second == ieee)
+                oldDevices.erase(entry);
+
+            if (previous->second.coordinator != coordinator)
+            {
+                LOG_INFO << "[Coordinators] Device " << std::hex << ieee << " moved from #" << std::dec
+                         << previous->second.coordinator << " to #" << coordinator << std::endl;
+            }
+        }
+
+        // 2. Whoever had this NWK address on this PAN before no longer does
+        auto &devices = coordinators[coordinator]->devices;
+        auto stale = devices.find(shortAddr);
+        if (stale != devices.end() && stale->second != ieee)
+            registry.erase(stale->second);
+
+        devices[shortAddr] = ieee;
+        registry[ieee] = {coordinator, shortAddr};
+    }
+
+    void CoordinatorManager::onZdoPacket(size_t coordinator, const ZDOPacket::Packet &packet)
+    {
+        if (packet.type == ZDOPacket::DEVICE_ANNOUNCEMENT)
+        {
+            const auto &announce = static_cast<const ZDOPacket::DeviceAnnouncementResponse &>(packet);
+            assignDevice(announce.ieeeAddress, coordinator, announce.networkAddress);
+            rebalanceJoin();
+        }
+        else if (packet.type == ZDOPacket::TC_DEVICE_INDICATION)
+        {
+            // Joins and rejoins through the Trust Center, new short address included
+            const auto &indication = static_cast<const ZDOPacket::TrustCenterDeviceIndication &>(packet);
+            assignDevice(indication.ieeeAddress, coordinator, indication.networkAddress);
+        }
+        else if (packet.type == ZDOPacket::ADDRESS_RESPONSE)
+        {
+            const auto &response = static_cast<const ZDOPacket::AddressResponse &>(packet);
+            if (response.status == 0x00)
+                assignDevice(response.ieeeAddress, coordinator, response.networkAddress);
+        }
+
+        if (zdoHandler)
+            zdoHandler(coordinator, packet);
+    }
+}
@@ -0,0 +1,50 @@
+#include "DeviceCatalogue.h"
+#include "ZStackProtocol.h"
+
+namespace ZStack
+{
+    namespace
+    {
+        // BatteryPercentageRemaining (0x0021), half percent steps: hourly at most, twice a day at least
+        const ZclReportingConfig BATTERY_PERCENTAGE = {0x0021, ZCL_UINT8, 3600, 43200, 2};
+    }
+
+    DeviceCatalogue::DeviceCatalogue(bool builtIns)
+    {
+        if (!builtIns)
+            return;
+
+        // SONOFF SNZB-02 temperature / humidity sensor. Temperature moves
+        // slowly: 0.2 C or every hour, never more than twice a minute.
+        add({"eWeLink",
+             "TH01",
+             {{0x01, TEMPERATURE_MEASUREMENT_CLUSTER, {{0x0000, ZCL_INT16, 30, 3600, 20}}},
+              {0x01, HUMIDITY_MEASUREMENT_CLUSTER, {{0x0000, ZCL_UINT16, 30, 3600, 100}}},
+              {0x01, BATTERY_LEVEL_CLUSTER, {BATTERY_PERCENTAGE}}}});
+
+        // SONOFF SNZB-01 button: presses arrive as commands, only the battery reports
+        add({"eWeLink", "WB01", {{0x01, BATTERY_LEVEL_CLUSTER, {BATTERY_PERCENTAGE}}}});
+
+        // SONOFF ZBMINI switch: state changes right away
+        add({"SONOFF", "01MINIZB", {{0x01, ON_OFF_CLUSTER, {{0x0000, ZCL_BOOLEAN, 0, 600, 0}}}}});
+
+        // IKEA TRADFRI outlet
+        add({"IKEA of Sweden",
+             "TRADFRI control outlet",
+             {{0x01, ON_OFF_CLUSTER, {{0x0000, ZCL_BOOLEAN, 0, 600, 0}}}}});
+    }
+
+    void DeviceCatalogue::add(CatalogueEntry entry)
+    {
+        auto key = std::make_pair(entry.manufacturer, entry.model);
+        entries[key] = std::move(entry);
+    }
+
+    const CatalogueEntry *DeviceCatalogue::find(const std::string &manufacturer, const std::string &model) const
+    {
+        auto it = entries.find({manufacturer, model});
+        if (it == entries.end())
+            it = entries.find({std::string(), model});
+        return it != entries.end() ? &it->second : nullptr;
+    }
+}
@@ -0,0 +1,424 @@
+#include "DeviceInterviewer.h"
+#include <algorithm>
+#include <iomanip>
+#include "ZStackClient.h"
+#include "DeviceCatalogue.h"
+#include "zdo/ZDOPacketParser.h"
+#include "af/AFPacketParser.h"
+#include "Logger.h"
+
+namespace ZStack
+{
+    DeviceInterviewer::DeviceInterviewer(ZStackClient &client,
+                                         const std::vector<uint8_t> &coordinatorIEEE,
+                                         size_t maxConcurrent,
+                                         int stepTimeoutMs,
+                                         int maxRetries)
+        : client(client),
+          coordinatorIEEE(coordinatorIEEE),
+          maxConcurrent(maxConcurrent),
+          stepTimeoutMs(stepTimeoutMs),
+          maxRetries(maxRetries),
+          nextSequence(0x80)
+    {
+        // Defaults match AFDataRequestFactory::configureReporting
+        reportingConfigs[TEMPERATURE_MEASUREMENT_CLUSTER] = {0x0000, ZCL_INT16, 10, 600, 20};
+        reportingConfigs[HUMIDITY_MEASUREMENT_CLUSTER] = {0x0000, ZCL_UINT16, 10, 600, 20};
+        reportingConfigs[ON_OFF_CLUSTER] = {0x0000, ZCL_BOOLEAN, 0, 600, 0};
+    }
+
+    DeviceInterviewer::~DeviceInterviewer()
+    {
+        for (auto &entry : active)
+            client.timers().cancel(entry.second.timer);
+    }
+
+    void DeviceInterviewer::setReportingConfig(uint16_t clusterID, const ZclReportingConfig &config)
+    {
+        reportingConfigs[clusterID] = config;
+    }
+
+    void DeviceInterviewer::interview(uint16_t shortAddr, uint64_t ieeeAddress)
+    {
+        if (active.count(shortAddr))
+            return;
+
+        for (const auto &queued : queue)
+        {
+            if (queued.first == shortAddr)
+                return;
+        }
+
+        LOG_INFO << "[Interview] Queued 0x" << std::hex << shortAddr << std::endl;
+        queue.emplace_back(shortAddr, ieeeAddress);
+        startQueued();
+    }
+
+    void DeviceInterviewer::startQueued()
+    {
+        while (active.size() < maxConcurrent && !queue.empty())
+        {
+            auto next = queue.front();
+            queue.pop_front();
+
+            Interview interview;
+            interview.result.shortAddr = next.first;
+            interview.result.ieeeAddress = next.second;
+            interview.result.success = false;
+            interview.step = catalogue ? Step::BASIC : Step::ACTIVE_ENDPOINTS;
+            interview.index = 0;
+            interview.answers = 0;
+            interview.attempts = 0;
+            interview.sequence = 0;
+            interview.timer = INVALID_TIMER;
+
+            LOG_INFO << "[Interview] Starting 0x" << std::hex << next.first << std::endl;
+
+            auto &started = active.emplace(next.first, std::move(interview)).first->second;
+            advance(started);
+        }
+    }
+
+    void DeviceInterviewer::advance(Interview &interview)
+    {
+        interview.attempts = 0;
+        interview.answers = 0;
+        sendStep(interview);
+    }
+
+    void DeviceInterviewer::sendStep(Interview &interview)
+    {
+        uint16_t shortAddr = interview.result.shortAddr;
+
+        // Interviews are background work: never ahead of someone's light switch
+        ScopedSendPriority bulk(client, SendPriority::BULK);
+
+        interview.attempts++;
+        client.timers().cancel(interview.timer);
+        interview.timer = client.timers().schedule(stepTimeoutMs, [this, shortAddr]() { timeout(shortAddr); });
+
+        switch (interview.step)
+        {
+        case Step::BASIC:
+        {
+            interview.sequence = nextSequence++;
+
+            ZclRequestBuilder builder(frameBuffer, sizeof(frameBuffer));
+            ZclDestination dest{shortAddr, 0x01};
+            client.send(builder.readAttributes(dest, BASIC_CLUSTER, interview.sequence,
+                                               {ZCL_BASIC_MANUFACTURER_NAME, ZCL_BASIC_MODEL_IDENTIFIER}));
+            break;
+        }
+
+        case Step::ACTIVE_ENDPOINTS:
+            client.fetchActiveEndpoints(shortAddr);
+            break;
+
+        case Step::SIMPLE_DESCRIPTOR:
+            client.fetchSimpleDescriptor(shortAddr, interview.activeEndpoints[interview.index]);
+            break;
+
+        case Step::BIND:
+        {
+            // IEEE goes on the air Little Endian
+            std::vector<uint8_t> ieee;
+            for (int i = 0; i < 8; i++)
+                ieee.push_back((interview.result.ieeeAddress >> (8 * i)) & 0xFF);
+
+            // All at once. Bind responses don't say which cluster they are
+            // for, so a retry sends every one again (binding twice is harmless).
+            interview.answers = 0;
+            for (const auto &binding : interview.bindings)
+                client.bindDevice(shortAddr, ieee, binding.clusterID, coordinatorIEEE, binding.endpoint);
+            break;
+        }
+
+        case Step::CONFIGURE_REPORTING:
+        {
+            // One frame per cluster, every attribute in it; retries only resend the unanswered
+            for (auto &binding : interview.bindings)
+            {
+                if (binding.configured)
+                    continue;
+
+                binding.sequence = nextSequence++;
+
+                ZclRequestBuilder builder(frameBuffer, sizeof(frameBuffer));
+                ZclDestination dest{shortAddr, binding.endpoint};
+                client.send(builder.configureReporting(dest, binding.clusterID, binding.sequence,
+                                                       binding.reporting.data(), binding.reporting.size()));
+            }
+            break;
+        }
+
+        case Step::DONE:
+            break;
+        }
+    }
+
+    void DeviceInterviewer::handleFrame(const ZStackFrame &frame)
+    {
+        if (active.empty())
+            return;
+
+        uint8_t cmd0 = frame.getCommand0();
+        uint8_t cmd1 = frame.getCommand1();
+
+        // 1. ZDO answers (Active EP / Simple Descriptor / Bind)
+        if (cmd0 == (AREQ | ZDO) &&
+            (cmd1 == ZDO_ACTIVE_EP_RSP || cmd1 == ZDO_SIMPLE_DESC_RSP || cmd1 == ZDO_BIND_RSP))
+        {
+            auto packet = ZDOPacket::parseZStackFrame(frame);
+            if (!packet)
+                return;
+
+            if (packet->type == ZDOPacket::ACTIVE_ENDPOINTS)
+            {
+                auto &rsp = static_cast<const ZDOPacket::DeviceActiveEndpointResponse &>(*packet);
+                auto it = active.find(rsp.networkAddress);
+                if (it == active.end() || it->second.step != Step::ACTIVE_ENDPOINTS || rsp.status != 0x00)
+                    return;
+
+                auto &interview = it->second;
+                interview.activeEndpoints = rsp.activeEndpoints;
+                interview.index = 0;
+
+                if (interview.activeEndpoints.empty())
+                {
+                    finish(rsp.networkAddress, true);
+                    return;
+                }
+
+                interview.step = Step::SIMPLE_DESCRIPTOR;
+                advance(interview);
+            }
+            else if (packet->type == ZDOPacket::DEVICE_DESCRIPTION)
+            {
+                auto &rsp = static_cast<const ZDOPacket::DeviceDescriptionResponse &>(*packet);
+                auto it = active.find(rsp.networkAddress);
+                if (it == active.end() || it->second.step != Step::SIMPLE_DESCRIPTOR || rsp.status != 0x00)
+                    return;
+
+                auto &interview = it->second;
+                if (rsp.endpoint != interview.activeEndpoints[interview.index])
+                    return;
+
+                interview.result.endpoints.push_back(
+                    {rsp.endpoint, rsp.profileID, rsp.deviceID, rsp.inputClusters, rsp.outputClusters});
+
+                // Every reportable server cluster gets bound
+                for (uint16_t cluster : rsp.inputClusters)
+                {
+                    auto config = reportingConfigs.find(cluster);
+                    if (config != reportingConfigs.end())
+                        interview.bindings.push_back({rsp.endpoint, cluster, {config->second}});
+                }
+
+                // 2. Next endpoint, or move on to binding
+                interview.index++;
+                if (interview.index >= interview.activeEndpoints.size())
+                {
+                    if (interview.bindings.empty())
+                    {
+                        finish(rsp.networkAddress, true);
+                        return;
+                    }
+                    interview.step = Step::BIND;
+                    interview.index = 0;
+                }
+                advance(interview);
+            }
+            else if (packet->type == ZDOPacket::BIND_RESPONSE)
+            {
+                auto &rsp = static_cast<const ZDOPacket::BindRequestResponse &>(*packet);
+                auto it = active.find(rsp.srcAddress);
+                if (it == active.end() || it->second.step != Step::BIND)
+                    return;
+
+                auto &interview = it->second;
+                if (!rsp.success)
+                    LOG_WARN << "[Interview] A bind was refused by 0x" << std::hex << rsp.srcAddress << std::endl;
+
+                if (++interview.answers >= interview.bindings.size())
+                {
+                    interview.step = Step::CONFIGURE_REPORTING;
+                    advance(interview);
+                }
+            }
+            return;
+        }
+
+        // 2. ZCL: Basic read and Configure Reporting responses
+        if (cmd0 == (AREQ | AF) && cmd1 == AF_INCOMING_MSG)
+        {
+            const auto &p = frame.getPayload();
+            if (p.size() < 21)
+                return;
+
+            uint16_t clusterID = p[2] | (p[3] << 8);
+            uint16_t srcAddr = p[4] | (p[5] << 8);
+            uint8_t sequence = p[18];
+            uint8_t zclCmd = p[19];
+
+            auto it = active.find(srcAddr);
+            if (it == active.end())
+                return;
+
+            auto &interview = it->second;
+            if (zclCmd == ZCL_READ_ATTRIB_RSP && clusterID == BASIC_CLUSTER && interview.step == Step::BASIC &&
+                sequence == interview.sequence)
+            {
+                std::string names[2];
+                for (const auto &record : AFPacket::parseAttributeRecords(zclCmd, p))
+                {
+                    if (record.status != 0x00 || record.dataType != ZCL_CHAR_STRING || record.value.empty())
+                        continue;
+
+                    // Length byte first; some devices pad with NULs or spaces
+                    std::string text(record.value.begin() + 1, record.value.end());
+                    text.erase(text.find_last_not_of(std::string(" \0", 2)) + 1);
+
+                    if (record.attributeID == ZCL_BASIC_MANUFACTURER_NAME)
+                        names[0] = text;
+                    else if (record.attributeID == ZCL_BASIC_MODEL_IDENTIFIER)
+                        names[1] = text;
+                }
+                identified(interview, names[0], names[1]);
+            }
+            else if (zclCmd == ZCL_CONFIG_REPORTING_RSP && interview.step == Step::CONFIGURE_REPORTING)
+            {
+                configured(interview, clusterID, sequence, p[20]);
+            }
+        }
+    }
+
+    void DeviceInterviewer::identified(Interview &interview, const std::string &manufacturer, const std::string &model)
+    {
+        uint16_t shortAddr = interview.result.shortAddr;
+        interview.result.manufacturer = manufacturer;
+        interview.result.model = model;
+
+        const CatalogueEntry *entry = catalogue ? catalogue->find(manufacturer, model) : nullptr;
+        if (entry == nullptr)
+        {
+            LOG_INFO << "[Interview] 0x" << std::hex << shortAddr << " is \"" << manufacturer << "\" / \"" << model
+                     << "\", not catalogued: discovering" << std::endl;
+            interview.step = Step::ACTIVE_ENDPOINTS;
+            advance(interview);
+            return;
+        }
+
+        LOG_INFO << "[Interview] 0x" << std::hex << shortAddr << " is catalogued as \"" << entry->manufacturer
+                 << "\" / \"" << entry->model << "\"" << std::endl;
+
+        // The entry stands in for Active Endpoints + Simple Descriptors
+        interview.result.catalogued = true;
+        for (const auto &cluster : entry->clusters)
+        {
+            auto endpoint = std::find_if(interview.result.endpoints.begin(), interview.result.endpoints.end(),
+                                         [&](const EndpointDescriptor &d) { return d.endpoint == cluster.endpoint; });
+            if (endpoint == interview.result.endpoints.end())
+            {
+                interview.result.endpoints.push_back({cluster.endpoint, 0x0104, 0x0000, {}, {}});
+                endpoint = interview.result.endpoints.end() - 1;
+            }
+            endpoint->inputClusters.push_back(cluster.clusterID);
+
+            if (!cluster.reporting.empty())
+                interview.bindings.push_back({cluster.endpoint, cluster.clusterID, cluster.reporting});
+        }
+
+        if (interview.bindings.empty())
+        {
+            finish(shortAddr, true);
+            return;
+        }
+
+        interview.step = Step::BIND;
+        advance(interview);
+    }
+
+    void DeviceInterviewer::configured(Interview &interview, uint16_t clusterID, uint8_t sequence, uint8_t status)
+    {
+        uint16_t shortAddr = interview.result.shortAddr;
+
+        auto binding = std::find_if(interview.bindings.begin(), interview.bindings.end(), [&](const Binding &b) {
+            return !b.configured && b.clusterID == clusterID && b.sequence == sequence;
+        });
+        if (binding == interview.bindings.end())
+            return;
+
+        binding->configured = true;
+
+        // One "all good" record, or a record per attribute that was refused
+        if (status == 0x00)
+        {
+            interview.result.boundClusters.push_back(clusterID);
+
+            for (const auto &config : binding->reporting)
+            {
+                interview.result.reporting.push_back({binding->endpoint, clusterID, config});
+                if (interview.result.reportIntervalS == 0 || config.maxInterval < interview.result.reportIntervalS)
+                    interview.result.reportIntervalS = config.maxInterval;
+            }
+        }
+        else
+        {
+            LOG_WARN << "[Interview] Reporting config for cluster 0x" << std::hex << clusterID
+                     << " refused by 0x" << shortAddr << " (Status 0x" << (int)status << ")" << std::endl;
+        }
+
+        if (++interview.answers >= interview.bindings.size())
+            finish(shortAddr, true);
+    }
+
+    void DeviceInterviewer::timeout(uint16_t shortAddr)
+    {
+        auto it = active.find(shortAddr);
+        if (it == active.end())
+            return;
+
+        auto &interview = it->second;
+        interview.timer = INVALID_TIMER;
+
+        // No Basic answer (or no Basic cluster on endpoint 1): find out the long way
+        if (interview.step == Step::BASIC && interview.attempts >= 2)
+        {
+            LOG_DEBUG << "[Interview] No Basic cluster answer from 0x" << std::hex << shortAddr << ", discovering"
+                      << std::endl;
+            interview.step = Step::ACTIVE_ENDPOINTS;
+            advance(interview);
+            return;
+        }
+
+        if (interview.attempts > maxRetries)
+        {
+            LOG_WARN << "[Interview] Giving up on 0x" << std::hex << shortAddr << std::endl;
+            finish(shortAddr, false);
+            return;
+        }
+
+        LOG_DEBUG << "[Interview] Step timed out for 0x" << std::hex << shortAddr << ", retrying" << std::endl;
+        sendStep(interview);
+    }
+
+    void DeviceInterviewer::finish(uint16_t shortAddr, bool success)
+    {
+        auto it = active.find(shortAddr);
+        if (it == active.end())
+            return;
+
+        client.timers().cancel(it->second.timer);
+
+        InterviewResult result = std::move(it->second.result);
+        result.success = success;
+        active.erase(it);
+
+        LOG_INFO << "[Interview] 0x" << std::hex << shortAddr << (success ? " complete" : " failed") << std::endl;
+
+        if (completionHandler)
+            completionHandler(result);
+
+        startQueued();
+    }
+}
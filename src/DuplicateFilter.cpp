@@ -0,0 +1,61 @@
+#include "DuplicateFilter.h"
+#include "ZStackProtocol.h"
+
+namespace ZStack
+{
+    DuplicateFilter::DuplicateFilter(int windowMs)
+        : windowMs(windowMs > 0 ? windowMs : 0),
+          start(std::chrono::steady_clock::now()),
+          slotByAddr(0x10000, NONE)
+    {
+    }
+
+    bool DuplicateFilter::isDuplicate(const ZStackFrame &frame)
+    {
+        if (frame.getCommand0() != (AREQ | AF) || frame.getCommand1() != AF_INCOMING_MSG)
+            return false;
+
+        // Cluster [2-3], SrcAddr [4-5], ZCL frame control [17], then an
+        // optional manufacturer code (2), the sequence and the command
+        const auto &p = frame.getPayload();
+        if (p.size() < 20)
+            return false;
+
+        size_t sequenceOffset = (p[17] & 0x04) ? 20 : 18;
+        if (p.size() < sequenceOffset + 2)
+            return false;
+
+        return isDuplicate(p[4] | (p[5] << 8), p[2] | (p[3] << 8), p[sequenceOffset], p[sequenceOffset + 1]);
+    }
+
+    bool DuplicateFilter::isDuplicate(uint16_t shortAddr, uint16_t clusterID, uint8_t zclSequence, uint8_t zclCommand)
+    {
+        uint32_t nowMs = static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+
+        uint32_t slot = slotByAddr[shortAddr];
+        if (slot == NONE)
+        {
+            slot = static_cast<uint32_t>(windows.size());
+            windows.push_back(Window{});
+            slotByAddr[shortAddr] = slot;
+        }
+
+        // 1. Seen recently?
+        Window &window = windows[slot];
+        for (const Entry &entry : window.entries)
+        {
+            if (entry.used && entry.sequence == zclSequence && entry.clusterID == clusterID &&
+                entry.command == zclCommand && nowMs - entry.timeMs <= static_cast<uint32_t>(windowMs))
+            {
+                droppedCount++;
+                return true;
+            }
+        }
+
+        // 2. No: remember it, overwriting the oldest
+        window.entries[window.next] = {nowMs, clusterID, zclSequence, zclCommand, true};
+        window.next = (window.next + 1) % WAYS;
+        return false;
+    }
+}
@@ -0,0 +1,121 @@
+#include "FrameBuffer.h"
+
+namespace ZStack
+{
+    FrameWriter::FrameWriter(uint8_t *buffer, size_t capacity)
+        : buffer(buffer), capacity(capacity), position(0), checksum(0), overflow(buffer == nullptr)
+    {
+    }
+
+    void FrameWriter::begin(uint8_t cmd0, uint8_t cmd1)
+    {
+        position = 0;
+        checksum = 0;
+        overflow = (buffer == nullptr || capacity < HEADER_SIZE + 1);
+
+        if (overflow)
+            return;
+
+        buffer[0] = 0xFE; // Start byte
+        buffer[1] = 0x00; // Length, patched in finish()
+        buffer[2] = cmd0;
+        buffer[3] = cmd1;
+        checksum = cmd0 ^ cmd1;
+        position = HEADER_SIZE;
+    }
+
+    void FrameWriter::u8(uint8_t value)
+    {
+        // Keep one byte free for the FCS
+        if (overflow || position + 1 >= capacity)
+        {
+            overflow = true;
+            return;
+        }
+
+        buffer[position++] = value;
+        checksum ^= value;
+    }
+
+    void FrameWriter::u16(uint16_t value)
+    {
+        u8(value & 0xFF);
+        u8((value >> 8) & 0xFF);
+    }
+
+    void FrameWriter::u32(uint32_t value)
+    {
+        u16(value & 0xFFFF);
+        u16((value >> 16) & 0xFFFF);
+    }
+
+    void FrameWriter::bytes(const uint8_t *data, size_t length)
+    {
+        if (overflow || position + length >= capacity)
+        {
+            overflow = true;
+            return;
+        }
+
+        for (size_t i = 0; i < length; i++)
+        {
+            buffer[position + i] = data[i];
+            checksum ^= data[i];
+        }
+        position += length;
+    }
+
+    size_t FrameWriter::placeholder()
+    {
+        size_t offset = position;
+        // Written as zero so it doesn't disturb the running checksum
+        u8(0x00);
+        return offset;
+    }
+
+    void FrameWriter::patch(size_t offset, uint8_t value)
+    {
+        if (overflow || offset >= position)
+            return;
+
+        checksum ^= buffer[offset];
+        buffer[offset] = value;
+        checksum ^= value;
+    }
+
+    FrameView FrameWriter::finish()
+    {
+        size_t length = payloadSize();
+
+        if (overflow || length > 250)
+        {
+            overflow = true;
+            return FrameView{nullptr, 0};
+        }
+
+        buffer[1] = static_cast<uint8_t>(length);
+        buffer[position] = checksum ^ static_cast<uint8_t>(length);
+
+        return FrameView{buffer, position + 1};
+    }
+
+    FrameArena::FrameArena(size_t capacity) : storage(capacity), offset(0)
+    {
+    }
+
+    uint8_t *FrameArena::reserve()
+    {
+        if (offset + MAX_MT_FRAME_SIZE > storage.size())
+            return nullptr;
+
+        return storage.data() + offset;
+    }
+
+    void FrameArena::commit(const FrameView &frame)
+    {
+        if (frame.valid() && frame.data == storage.data() + offset)
+        {
+            offset += frame.size;
+        }
+    }
+}
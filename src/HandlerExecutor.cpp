@@ -0,0 +1,155 @@
+#include "HandlerExecutor.h"
+#include <algorithm>
+#include <exception>
+#include "Logger.h"
+
+namespace ZStack
+{
+    HandlerExecutor::HandlerExecutor(size_t workers, size_t queueCapacity, OverflowPolicy policy)
+        : queueCapacity(std::max<size_t>(queueCapacity, 1)), policy(policy)
+    {
+        if (workers == 0)
+            workers = std::max(std::thread::hardware_concurrency(), 1u);
+
+        shards.reserve(workers);
+        for (size_t i = 0; i < workers; i++)
+            shards.push_back(std::make_unique<Shard>());
+
+        // Threads start once every shard exists
+        for (auto &shard : shards)
+            shard->worker = std::thread(&HandlerExecutor::run, this, std::ref(*shard));
+    }
+
+    HandlerExecutor::~HandlerExecutor()
+    {
+        stop();
+    }
+
+    HandlerExecutor::Shard &HandlerExecutor::shardFor(uint64_t key)
+    {
+        // NWK addresses are handed out in runs: mix before picking a shard
+        key ^= key >> 33;
+        key *= 0xFF51AFD7ED558CCDULL;
+        key ^= key >> 33;
+        return *shards[key % shards.size()];
+    }
+
+    bool HandlerExecutor::submit(uint64_t key, Job job)
+    {
+        if (stopping.load(std::memory_order_acquire))
+            return false;
+
+        Shard &shard = shardFor(key);
+        bool accepted = true;
+        {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+
+            if (shard.jobs.size() >= queueCapacity)
+            {
+                switch (policy)
+                {
+                case OverflowPolicy::BLOCK:
+                    // 1. Backpressure: wait for the worker to make room
+                    shard.notFull.wait(lock, [&]() {
+                        return shard.jobs.size() < queueCapacity || stopping.load(std::memory_order_acquire);
+                    });
+                    if (stopping.load(std::memory_order_acquire))
+                        return false;
+                    break;
+                case OverflowPolicy::DROP_NEWEST:
+                    // 2. Keep what is queued, lose this one
+                    droppedCount.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                case OverflowPolicy::DROP_OLDEST:
+                    // 3. Keep the freshest state, lose the stalest
+                    shard.jobs.pop_front();
+                    droppedCount.fetch_add(1, std::memory_order_relaxed);
+                    accepted = false;
+                    break;
+                }
+            }
+
+            shard.jobs.push_back(std::move(job));
+        }
+        shard.notEmpty.notify_one();
+        return accepted;
+    }
+
+    void HandlerExecutor::run(Shard &shard)
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        while (true)
+        {
+            shard.notEmpty.wait(lock, [&]() { return !shard.jobs.empty() || stopping.load(std::memory_order_acquire); });
+            if (shard.jobs.empty())
+                return; // Stopping and nothing left
+
+            Job job = std::move(shard.jobs.front());
+            shard.jobs.pop_front();
+            shard.busy = true;
+            lock.unlock();
+            shard.notFull.notify_all();
+
+            try
+            {
+                job();
+            }
+            catch (const std::exception &e)
+            {
+                LOG_ERROR << "Packet handler threw: " << e.what() << std::endl;
+            }
+            catch (...)
+            {
+                LOG_ERROR << "Packet handler threw an unknown exception" << std::endl;
+            }
+            executedCount.fetch_add(1, std::memory_order_relaxed);
+
+            lock.lock();
+            shard.busy = false;
+            if (shard.jobs.empty())
+                shard.notFull.notify_all(); // drain() waits for this
+        }
+    }
+
+    void HandlerExecutor::drain()
+    {
+        for (auto &shard : shards)
+        {
+            std::unique_lock<std::mutex> lock(shard->mutex);
+            shard->notFull.wait(lock, [&]() { return shard->jobs.empty() && !shard->busy; });
+        }
+    }
+
+    void HandlerExecutor::stop()
+    {
+        if (stopping.exchange(true, std::memory_order_acq_rel))
+            return;
+
+        for (auto &shard : shards)
+        {
+            {
+                // Taken so no worker misses the flag between its check and its wait
+                std::lock_guard<std::mutex> lock(shard->mutex);
+            }
+            shard->notEmpty.notify_all();
+            shard->notFull.notify_all();
+        }
+
+        for (auto &shard : shards)
+        {
+            if (shard->worker.joinable())
+                shard->worker.join();
+        }
+    }
+
+    size_t HandlerExecutor::queued() const
+    {
+        size_t total = 0;
+        for (const auto &shard : shards)
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total += shard->jobs.size();
+        }
+        return total;
+    }
+}
@@ -0,0 +1,401 @@
+#include "OtaServer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ZStackClient.h"
+#include "ZStackProtocol.h"
+#include "zcl/ZclRequestBuilder.h"
+#include "Logger.h"
+
+namespace ZStack
+{
+    namespace
+    {
+        uint16_t read16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+        uint32_t read32(const uint8_t *p)
+        {
+            return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+        }
+
+        uint8_t *put16(uint8_t *p, uint16_t value)
+        {
+            p[0] = value & 0xFF;
+            p[1] = value >> 8;
+            return p + 2;
+        }
+
+        uint8_t *put32(uint8_t *p, uint32_t value)
+        {
+            for (int i = 0; i < 4; i++)
+                p[i] = (value >> (8 * i)) & 0xFF;
+            return p + 4;
+        }
+
+        // manufacturer(2), image type(2), file version(4): leads most OTA payloads
+        uint8_t *putImageID(uint8_t *p, const OtaImage &image)
+        {
+            p = put16(p, image.manufacturerCode);
+            p = put16(p, image.imageType);
+            return put32(p, image.fileVersion);
+        }
+    }
+
+    OtaServer::OtaServer(ZStackClient &client, double blocksPerSecond, size_t burst, uint8_t maxBlockSize)
+        : client(client),
+          blocksPerSecond(std::max(blocksPerSecond, 0.1)),
+          burst(static_cast<double>(std::max<size_t>(burst, 1))),
+          // Keeps a block response inside one unfragmented AF frame
+          maxBlockSize(std::clamp<uint8_t>(maxBlockSize, 16, 64)),
+          tokens(static_cast<double>(std::max<size_t>(burst, 1))),
+          refilled(Clock::now())
+    {
+    }
+
+    OtaServer::~OtaServer()
+    {
+        for (auto &mapping : mappings)
+            munmap(mapping->address, mapping->length);
+    }
+
+    bool OtaServer::addImage(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            LOG_ERROR << "[OTA] Cannot open " << path << std::endl;
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(OTA_MIN_HEADER))
+        {
+            LOG_ERROR << "[OTA] " << path << " is too short for an OTA header" << std::endl;
+            close(fd);
+            return false;
+        }
+
+        size_t length = static_cast<size_t>(info.st_size);
+        void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // The mapping keeps the file
+        if (address == MAP_FAILED)
+        {
+            LOG_ERROR << "[OTA] Cannot map " << path << std::endl;
+            return false;
+        }
+
+        // Devices fetch the whole file in small pieces: fault it in up front
+        madvise(address, length, MADV_WILLNEED);
+
+        // 1. Parse the header once; block requests only use the index below
+        const uint8_t *p = static_cast<const uint8_t *>(address);
+        uint16_t headerLength = read16(p + 6);
+        uint32_t totalSize = read32(p + 52);
+        if (read32(p) != OTA_MAGIC || headerLength < OTA_MIN_HEADER || totalSize != length)
+        {
+            LOG_ERROR << "[OTA] " << path << " is not a valid OTA image" << std::endl;
+            munmap(address, length);
+            return false;
+        }
+
+        auto mapping = std::make_unique<Mapping>();
+        mapping->address = address;
+        mapping->length = length;
+
+        OtaImage &image = mapping->image;
+        image.path = path;
+        image.manufacturerCode = read16(p + 10);
+        image.imageType = read16(p + 12);
+        image.fileVersion = read32(p + 14);
+        const char *text = reinterpret_cast<const char *>(p + 20);
+        image.headerString.assign(text, strnlen(text, 32));
+        image.data = p;
+        image.size = length;
+
+        // 2. Newest version wins. Older mappings stay: transfers may still use them.
+        uint32_t key = (static_cast<uint32_t>(image.manufacturerCode) << 16) | image.imageType;
+        auto it = index.find(key);
+        if (it == index.end() || it->second->fileVersion < image.fileVersion)
+            index[key] = &image;
+
+        LOG_INFO << "[OTA] Image " << path << " manufacturer 0x" << std::hex << image.manufacturerCode << " type 0x"
+                 << image.imageType << " version 0x" << image.fileVersion << std::dec << " (" << length
+                 << " bytes)" << std::endl;
+
+        mappings.push_back(std::move(mapping));
+        return true;
+    }
+
+    size_t OtaServer::loadDirectory(const std::string &directory)
+    {
+        std::error_code error;
+        std::filesystem::directory_iterator it(directory, error);
+        if (error)
+            return 0;
+
+        size_t added = 0;
+        for (const auto &entry : it)
+        {
+            auto extension = entry.path().extension();
+            if (entry.is_regular_file() && (extension == ".ota" || extension == ".zigbee") &&
+                addImage(entry.path().string()))
+            {
+                added++;
+            }
+        }
+        return added;
+    }
+
+    const OtaImage *OtaServer::find(uint16_t manufacturerCode, uint16_t imageType) const
+    {
+        auto it = index.find((static_cast<uint32_t>(manufacturerCode) << 16) | imageType);
+        return it != index.end() ? it->second : nullptr;
+    }
+
+    size_t OtaServer::activeTransfers() const
+    {
+        return transfers.size();
+    }
+
+    bool OtaServer::takeToken(Clock::time_point now)
+    {
+        double elapsed = std::chrono::duration<double>(now - refilled).count();
+        tokens = std::min(burst, tokens + elapsed * blocksPerSecond);
+        refilled = now;
+
+        if (tokens < 1.0)
+            return false;
+
+        tokens -= 1.0;
+        return true;
+    }
+
+    uint32_t OtaServer::waitSeconds() const
+    {
+        // Until a token is back, plus one round for everybody else waiting
+        double seconds = (1.0 - tokens + transfers.size()) / blocksPerSecond;
+        return std::max<uint32_t>(1, static_cast<uint32_t>(std::ceil(seconds)));
+    }
+
+    uint16_t OtaServer::minBlockPeriodMs(Clock::time_point now) const
+    {
+        // Each transfer in progress gets an equal slice of the budget
+        size_t active = 0;
+        for (const auto &entry : transfers)
+        {
+            if (now - entry.second.lastRequest < std::chrono::seconds(30))
+                active++;
+        }
+
+        double period = 1000.0 * std::max<size_t>(active, 1) / blocksPerSecond;
+        return static_cast<uint16_t>(std::min(period, 60000.0));
+    }
+
+    void OtaServer::notify(uint16_t shortAddr, uint8_t endpoint)
+    {
+        // Payload type 0 (jitter only), jitter 100: always query
+        uint8_t payload[] = {0x00, 100};
+
+        uint8_t buffer[64];
+        ZclRequestBuilder builder(buffer, sizeof(buffer));
+        ZclDestination dest{shortAddr, endpoint};
+        client.send(builder.clusterResponse(dest, OTA_UPGRADE_CLUSTER, nextSequence++, ZCL_OTA_IMAGE_NOTIFY, payload,
+                                            sizeof(payload)));
+    }
+
+    void OtaServer::handleFrame(const ZStackFrame &frame)
+    {
+        if (frame.getCommand0() != (AREQ | AF) || frame.getCommand1() != AF_INCOMING_MSG)
+            return;
+
+        const auto &p = frame.getPayload();
+        if (p.size() < 20 || (p[2] | (p[3] << 8)) != OTA_UPGRADE_CLUSTER)
+            return;
+
+        // Cluster specific, client to server, not manufacturer specific
+        if ((p[17] & 0x0F) != 0x01)
+            return;
+
+        Request request{static_cast<uint16_t>(p[4] | (p[5] << 8)), p[6], p[7], p[18], p.data() + 20, p.size() - 20};
+
+        // Don't trust the outer size past what the AF length field says
+        size_t zclLength = p[16];
+        request.length = std::min(request.length, zclLength >= 3 ? zclLength - 3 : 0);
+
+        switch (p[19])
+        {
+        case ZCL_OTA_QUERY_NEXT_IMAGE_REQ:
+            queryNextImage(request);
+            break;
+        case ZCL_OTA_IMAGE_BLOCK_REQ:
+            imageBlock(request);
+            break;
+        case ZCL_OTA_UPGRADE_END_REQ:
+            upgradeEnd(request);
+            break;
+        case ZCL_OTA_IMAGE_PAGE_REQ:
+            // Optional for servers; devices fall back to block requests
+            LOG_DEBUG << "[OTA] Ignoring Image Page Request from 0x" << std::hex << request.shortAddr << std::dec
+                      << std::endl;
+            break;
+        default:
+            break;
+        }
+    }
+
+    void OtaServer::queryNextImage(const Request &request)
+    {
+        // FieldControl, Manufacturer(2), ImageType(2), CurrentVersion(4) [, HardwareVersion(2)]
+        if (request.length < 9)
+            return;
+
+        uint16_t manufacturerCode = read16(request.payload + 1);
+        uint16_t imageType = read16(request.payload + 3);
+        uint32_t currentVersion = read32(request.payload + 5);
+
+        const OtaImage *image = find(manufacturerCode, imageType);
+        if (image == nullptr || image->fileVersion <= currentVersion)
+        {
+            uint8_t status = ZCL_OTA_NO_IMAGE_AVAILABLE;
+            respond(request, ZCL_OTA_QUERY_NEXT_IMAGE_RSP, &status, 1);
+            return;
+        }
+
+        LOG_INFO << "[OTA] 0x" << std::hex << request.shortAddr << " offered version 0x" << image->fileVersion
+                 << " (running 0x" << currentVersion << ")" << std::dec << std::endl;
+
+        transfers[request.shortAddr] = Transfer{image, 0, Clock::now()};
+
+        // Status, Manufacturer(2), ImageType(2), FileVersion(4), ImageSize(4)
+        uint8_t header[13];
+        header[0] = ZCL_OTA_SUCCESS;
+        put32(putImageID(header + 1, *image), static_cast<uint32_t>(image->size));
+        respond(request, ZCL_OTA_QUERY_NEXT_IMAGE_RSP, header, sizeof(header));
+    }
+
+    void OtaServer::imageBlock(const Request &request)
+    {
+        // FieldControl, Manufacturer(2), ImageType(2), FileVersion(4), FileOffset(4), MaxDataSize
+        if (request.length < 14)
+            return;
+
+        uint16_t manufacturerCode = read16(request.payload + 1);
+        uint16_t imageType = read16(request.payload + 3);
+        uint32_t fileVersion = read32(request.payload + 5);
+        uint32_t offset = read32(request.payload + 9);
+        uint8_t maxDataSize = request.payload[13];
+        auto now = Clock::now();
+
+        // 1. Usually the image this device was offered; otherwise look it up
+        Transfer &transfer = transfers[request.shortAddr];
+        const OtaImage *image = transfer.image;
+        if (image == nullptr || image->manufacturerCode != manufacturerCode || image->imageType != imageType ||
+            image->fileVersion != fileVersion)
+        {
+            image = nullptr;
+            for (const auto &mapping : mappings)
+            {
+                const OtaImage &candidate = mapping->image;
+                if (candidate.manufacturerCode == manufacturerCode && candidate.imageType == imageType &&
+                    candidate.fileVersion == fileVersion)
+                {
+                    image = &candidate;
+                    break;
+                }
+            }
+            transfer.image = image;
+        }
+        transfer.lastRequest = now;
+
+        if (image == nullptr || offset >= image->size)
+        {
+            uint8_t status = ZCL_OTA_ABORT;
+            respond(request, ZCL_OTA_IMAGE_BLOCK_RSP, &status, 1);
+            transfers.erase(request.shortAddr);
+            return;
+        }
+
+        // 2. Over the airtime budget: come back later
+        if (!takeToken(now))
+        {
+            deferredCount++;
+
+            // Status, CurrentTime(4), RequestTime(4), MinimumBlockPeriod(2).
+            // CurrentTime 0 makes RequestTime an offset in seconds.
+            uint8_t header[11];
+            header[0] = ZCL_OTA_WAIT_FOR_DATA;
+            uint8_t *p = put32(header + 1, 0);
+            p = put32(p, waitSeconds());
+            put16(p, minBlockPeriodMs(now));
+            respond(request, ZCL_OTA_IMAGE_BLOCK_RSP, header, sizeof(header));
+            return;
+        }
+
+        // 3. The block itself goes into the frame straight from the mapping
+        size_t dataSize = std::min<size_t>({maxDataSize, maxBlockSize, image->size - offset});
+
+        // Status, Manufacturer(2), ImageType(2), FileVersion(4), FileOffset(4), DataSize
+        uint8_t header[14];
+        header[0] = ZCL_OTA_SUCCESS;
+        uint8_t *p = put32(putImageID(header + 1, *image), offset);
+        *p = static_cast<uint8_t>(dataSize);
+        respond(request, ZCL_OTA_IMAGE_BLOCK_RSP, header, sizeof(header), image->data + offset, dataSize);
+
+        servedCount++;
+        transfer.offset = offset + dataSize;
+        if (progressHandler)
+            progressHandler(request.shortAddr, *image, transfer.offset);
+
+        // 4. Forget transfers whose devices went quiet (left, gave up, rebooted)
+        for (auto it = transfers.begin(); it != transfers.end();)
+        {
+            if (now - it->second.lastRequest > std::chrono::milliseconds(TRANSFER_IDLE_MS))
+                it = transfers.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    void OtaServer::upgradeEnd(const Request &request)
+    {
+        // Status, Manufacturer(2), ImageType(2), FileVersion(4)
+        if (request.length < 9)
+            return;
+
+        uint8_t status = request.payload[0];
+        auto it = transfers.find(request.shortAddr);
+        const OtaImage *image = it != transfers.end() ? it->second.image : nullptr;
+        if (it != transfers.end())
+            transfers.erase(it);
+
+        LOG_INFO << "[OTA] 0x" << std::hex << request.shortAddr << " finished, status 0x" << (int)status << std::dec
+                 << std::endl;
+
+        if (status == ZCL_OTA_SUCCESS)
+        {
+            // Manufacturer(2), ImageType(2), FileVersion(4), CurrentTime(4), UpgradeTime(4): 0/0 = now
+            uint8_t header[16] = {};
+            std::copy(request.payload + 1, request.payload + 9, header);
+            respond(request, ZCL_OTA_UPGRADE_END_RSP, header, sizeof(header));
+        }
+
+        if (completionHandler && image != nullptr)
+            completionHandler(request.shortAddr, *image, status == ZCL_OTA_SUCCESS);
+    }
+
+    void OtaServer::respond(const Request &request, uint8_t commandID, const uint8_t *header, size_t headerLength,
+                            const uint8_t *data, size_t dataLength)
+    {
+        uint8_t buffer[160];
+        ZclRequestBuilder builder(buffer, sizeof(buffer));
+        ZclDestination dest{request.shortAddr, request.srcEndpoint, request.dstEndpoint};
+        client.send(builder.clusterResponse(dest, OTA_UPGRADE_CLUSTER, request.sequence, commandID, header,
+                                            headerLength, data, dataLength),
+                    SendPriority::BULK);
+    }
+}
@@ -0,0 +1,200 @@
+#include "OutboundQueue.h"
+#include <algorithm>
+#include <cstring>
+#include "ZStackProtocol.h"
+
+namespace ZStack
+{
+    OutboundQueue::OutboundQueue(Writer writer, size_t inFlightBudget, size_t bulkReserve, int responseTimeoutMs)
+        : writer(std::move(writer)),
+          inFlightBudget(std::max<size_t>(inFlightBudget, 1)),
+          bulkReserve(std::min(bulkReserve, std::max<size_t>(inFlightBudget, 1) - 1)),
+          responseTimeout(std::chrono::milliseconds(responseTimeoutMs))
+    {
+        outstanding.reserve(this->inFlightBudget);
+    }
+
+    void OutboundQueue::setWeights(int interactive, int normal, int bulk)
+    {
+        weights[0] = std::max(interactive, 1);
+        weights[1] = std::max(normal, 1);
+        weights[2] = std::max(bulk, 1);
+    }
+
+    size_t OutboundQueue::queued() const
+    {
+        return queues[0].size() + queues[1].size() + queues[2].size();
+    }
+
+    bool OutboundQueue::eligible(size_t priorityClass) const
+    {
+        size_t limit = priorityClass == static_cast<size_t>(SendPriority::BULK) ? inFlightBudget - bulkReserve
+                                                                                : inFlightBudget;
+        return !queues[priorityClass].empty() && outstanding.size() < limit;
+    }
+
+    void OutboundQueue::push(const uint8_t *data, size_t size, SendPriority priority)
+    {
+        if (size < 4 || size > MAX_MT_FRAME_SIZE)
+            return;
+
+        size_t priorityClass = static_cast<size_t>(priority);
+
+        // 1. Fast path: nothing waiting and room in the budget
+        if (queued() == 0 && outstanding.size() < inFlightBudget &&
+            (priority != SendPriority::BULK || outstanding.size() < inFlightBudget - bulkReserve))
+        {
+            write(data, size);
+            return;
+        }
+
+        // 2. Otherwise copy it into a pooled slot and queue it
+        uint32_t slot;
+        if (!freeSlots.empty())
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            slot = static_cast<uint32_t>(pool.size());
+            pool.emplace_back();
+        }
+
+        std::memcpy(pool[slot].data, data, size);
+        pool[slot].size = static_cast<uint8_t>(size);
+        queues[priorityClass].push_back(slot);
+
+        pump();
+    }
+
+    int OutboundQueue::pick()
+    {
+        // Smooth weighted round robin over the classes that may send now
+        int best = -1;
+        int total = 0;
+        for (size_t c = 0; c < CLASSES; c++)
+        {
+            if (!eligible(c))
+                continue;
+
+            credits[c] += weights[c];
+            total += weights[c];
+            if (best < 0 || credits[c] > credits[best])
+                best = static_cast<int>(c);
+        }
+
+        if (best >= 0)
+            credits[best] -= total;
+        return best;
+    }
+
+    void OutboundQueue::pump()
+    {
+        expire(Clock::now());
+
+        int priorityClass;
+        while ((priorityClass = pick()) >= 0)
+        {
+            uint32_t slot = queues[priorityClass].front();
+            queues[priorityClass].pop_front();
+
+            write(pool[slot].data, pool[slot].size);
+            freeSlots.push_back(slot);
+        }
+
+        // Idle classes don't bank credit
+        for (size_t c = 0; c < CLASSES; c++)
+        {
+            if (queues[c].empty())
+                credits[c] = 0;
+        }
+    }
+
+    void OutboundQueue::write(const uint8_t *data, size_t size)
+    {
+        // SOF, LEN, CMD0, CMD1, Payload, FCS
+        uint8_t cmd0 = data[2];
+        uint8_t cmd1 = data[3];
+
+        if ((cmd0 & 0xE0) == SREQ)
+        {
+            bool afData = cmd0 == (SREQ | AF) && (cmd1 == AF_DATA_REQUEST || cmd1 == AF_DATA_REQUEST_EXT);
+            size_t transIDOffset = 4 + (cmd1 == AF_DATA_REQUEST ? 6 : 15);
+
+            Outstanding entry;
+            entry.cmd0 = cmd0;
+            entry.cmd1 = cmd1;
+            entry.transID = afData && transIDOffset < size - 1 ? data[transIDOffset] : -1;
+            entry.confirming = false;
+            entry.deadline = Clock::now() + responseTimeout;
+            outstanding.push_back(entry);
+        }
+
+        writer(data, size);
+    }
+
+    void OutboundQueue::onReceive(const ZStackFrame &frame)
+    {
+        if (outstanding.empty())
+            return;
+
+        uint8_t cmd0 = frame.getCommand0();
+        uint8_t cmd1 = frame.getCommand1();
+        const auto &payload = frame.getPayload();
+
+        // 1. SRSP: the oldest matching SREQ is answered
+        if ((cmd0 & 0xE0) == SRSP)
+        {
+            uint8_t requestCmd0 = SREQ | (cmd0 & 0x1F);
+            uint8_t requestCmd1 = cmd1;
+
+            // RPC error: [ErrorCode][Cmd0][Cmd1] of the refused command
+            if ((cmd0 & 0x1F) == 0x00 && payload.size() >= 3)
+            {
+                requestCmd0 = payload[1];
+                requestCmd1 = payload[2];
+            }
+
+            for (auto it = outstanding.begin(); it != outstanding.end(); ++it)
+            {
+                if (it->cmd0 != requestCmd0 || it->cmd1 != requestCmd1 || it->confirming)
+                    continue;
+
+                // A successful AF data request holds its slot until the confirm
+                bool accepted = !payload.empty() && payload[0] == 0x00 && (cmd0 & 0x1F) != 0x00;
+                if (it->transID >= 0 && accepted)
+                    it->confirming = true;
+                else
+                    outstanding.erase(it);
+                break;
+            }
+        }
+        // 2. AF_DATA_CONFIRM: [Status][Endpoint][TransID]
+        else if (cmd0 == (AREQ | AF) && cmd1 == AF_DATA_CONFIRM && payload.size() >= 3)
+        {
+            for (auto it = outstanding.begin(); it != outstanding.end(); ++it)
+            {
+                if (it->confirming && it->transID == payload[2])
+                {
+                    outstanding.erase(it);
+                    break;
+                }
+            }
+        }
+        else
+        {
+            return;
+        }
+
+        pump();
+    }
+
+    void OutboundQueue::expire(Clock::time_point now)
+    {
+        // Lost SRSP / confirm: don't let it hold the budget forever
+        outstanding.erase(std::remove_if(outstanding.begin(), outstanding.end(),
+                                         [now](const Outstanding &entry) { return entry.deadline <= now; }),
+                          outstanding.end());
+    }
+}
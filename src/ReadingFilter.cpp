@@ -0,0 +1,83 @@
+#include "ReadingFilter.h"
+#include <cmath>
+
+namespace ZStack
+{
+    bool ReadingFilter::setRule(uint16_t clusterID, uint16_t attributeID, const FilterRule &rule)
+    {
+        uint32_t key = (static_cast<uint32_t>(clusterID) << 16) | attributeID;
+        for (auto &existing : rules)
+        {
+            if (existing.key == key)
+            {
+                existing.rule = rule;
+                return true;
+            }
+        }
+
+        if (rules.size() >= MAX_ATTRIBUTES)
+            return false;
+
+        rules.push_back({key, rule});
+        return true;
+    }
+
+    bool ReadingFilter::accept(uint32_t deviceSlot, uint16_t clusterID, uint16_t attributeID, double value, uint64_t timestampMs)
+    {
+        // 1. Which column? A handful of rules, a linear scan is the fastest lookup
+        uint32_t key = (static_cast<uint32_t>(clusterID) << 16) | attributeID;
+        size_t column = 0;
+        while (column < rules.size() && rules[column].key != key)
+            column++;
+
+        if (column == rules.size())
+        {
+            passedCount++;
+            return true;
+        }
+
+        size_t index = static_cast<size_t>(deviceSlot) * MAX_ATTRIBUTES + column;
+        if (index >= states.size())
+            states.resize((static_cast<size_t>(deviceSlot) + 1) * MAX_ATTRIBUTES, State{0.0, 0, false});
+
+        // 2. Change beyond the deadband (rate limited), or heartbeat due?
+        State &state = states[index];
+        const FilterRule &rule = rules[column].rule;
+        uint64_t elapsedMs = timestampMs >= state.lastStoredMs ? timestampMs - state.lastStoredMs : 0;
+
+        bool store;
+        if (!state.stored)
+        {
+            store = true;
+        }
+        else if (rule.heartbeatMs > 0 && elapsedMs >= static_cast<uint64_t>(rule.heartbeatMs))
+        {
+            store = true;
+        }
+        else
+        {
+            double change = std::fabs(value - state.lastValue);
+            bool changed = rule.deadband > 0 ? change >= rule.deadband : change > 0;
+            store = changed && elapsedMs >= static_cast<uint64_t>(rule.minIntervalMs);
+        }
+
+        if (!store)
+        {
+            suppressedCount++;
+            return false;
+        }
+
+        state.lastValue = value;
+        state.lastStoredMs = timestampMs;
+        state.stored = true;
+        passedCount++;
+        return true;
+    }
+
+    void ReadingFilter::reset(uint32_t deviceSlot)
+    {
+        size_t first = static_cast<size_t>(deviceSlot) * MAX_ATTRIBUTES;
+        for (size_t i = first; i < first + MAX_ATTRIBUTES && i < states.size(); i++)
+            states[i].stored = false;
+    }
+}
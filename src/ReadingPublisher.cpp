@@ -0,0 +1,63 @@
+#include "ReadingPublisher.h"
+#include <chrono>
+#include "ZStackProtocol.h"
+
+namespace ZStack
+{
+    bool ReadingPublisher::toRecord(const AFPacket::IncomingMessage &msg, uint64_t ieee, ReadingRecord &record)
+    {
+        if (!msg.deviceReading)
+            return false;
+
+        record = ReadingRecord{};
+        record.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::system_clock::now().time_since_epoch())
+                                 .count();
+        record.ieee = ieee;
+        record.shortAddr = msg.srcAddress;
+        record.endpoint = msg.srcEndpoint;
+        record.kind = msg.deviceReading->type;
+
+        const AFPacket::DeviceReading &reading = *msg.deviceReading;
+        switch (reading.type)
+        {
+        case AFPacket::TEMPERATURE_SENSOR:
+            record.clusterID = ClusterID::TEMPERATURE_MEASUREMENT_CLUSTER;
+            record.attributeID = 0x0000;
+            record.value = static_cast<const AFPacket::TemperatureReading &>(reading).temperatureReading;
+            return true;
+        case AFPacket::HUMIDITY_SENSOR:
+            record.clusterID = ClusterID::HUMIDITY_MEASUREMENT_CLUSTER;
+            record.attributeID = 0x0000;
+            record.value = static_cast<const AFPacket::HumidityReading &>(reading).humidityReading;
+            return true;
+        case AFPacket::BATTERY_SENSOR:
+            record.clusterID = ClusterID::BATTERY_LEVEL_CLUSTER;
+            record.attributeID = 0x0021; // Battery Percentage Remaining
+            record.value = static_cast<const AFPacket::BatteryReading &>(reading).batteryLevelReading;
+            return true;
+        case AFPacket::SWITCH_DEVICE:
+            record.clusterID = ClusterID::ON_OFF_CLUSTER;
+            record.attributeID = 0x0000;
+            record.value = static_cast<const AFPacket::OnOffReading &>(reading).isOn ? 1.0 : 0.0;
+            return true;
+        case AFPacket::ACTION_PRESS:
+            record.clusterID = ClusterID::ON_OFF_CLUSTER;
+            record.attributeID = READING_ATTRIBUTE_COMMAND;
+            record.value = 1.0;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool ReadingPublisher::publish(const AFPacket::IncomingMessage &msg, uint64_t ieee)
+    {
+        ReadingRecord record;
+        if (!ring.isOpen() || !toRecord(msg, ieee, record))
+            return false;
+
+        ring.publish(record);
+        return true;
+    }
+}
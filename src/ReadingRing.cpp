@@ -0,0 +1,242 @@
+#include "ReadingRing.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Logger.h"
+
+namespace ZStack
+{
+    namespace
+    {
+        const uint32_t RING_MAGIC = 0x5A524E47; // "ZRNG"
+        const uint32_t RING_VERSION = 1;
+
+        // The header gets a cache line of its own
+        const size_t HEADER_SIZE = 64;
+        static_assert(sizeof(RingHeader) <= HEADER_SIZE, "RingHeader outgrew its cache line");
+
+        std::string shmName(const std::string &name)
+        {
+            return name.empty() || name[0] == '/' ? name : "/" + name;
+        }
+
+        size_t ringSize(uint64_t capacity)
+        {
+            return HEADER_SIZE + capacity * sizeof(RingSlot);
+        }
+    }
+
+    // ---------------------------------------------------------------- Writer
+
+    bool ReadingRingWriter::open(const std::string &name, size_t capacity)
+    {
+        close();
+
+        // 1. Round up to a power of two so the slot is index & mask
+        uint64_t rounded = 1;
+        while (rounded < capacity)
+            rounded <<= 1;
+
+        int fd = shm_open(shmName(name).c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            LOG_ERROR << "[Ring] Unable to open " << name << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        size_t size = ringSize(rounded);
+        struct stat info;
+        bool reuse = fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) == size;
+
+        if (!reuse && ftruncate(fd, size) != 0)
+        {
+            LOG_ERROR << "[Ring] Unable to size " << name << ": " << strerror(errno) << std::endl;
+            ::close(fd);
+            return false;
+        }
+
+        void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED)
+        {
+            LOG_ERROR << "[Ring] Unable to map " << name << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        header = static_cast<RingHeader *>(memory);
+        slots = reinterpret_cast<RingSlot *>(static_cast<uint8_t *>(memory) + HEADER_SIZE);
+        mappedSize = size;
+        mask = rounded - 1;
+
+        // 2. Same layout from a previous run: carry on from where it stopped
+        reuse = reuse && header->magic == RING_MAGIC && header->version == RING_VERSION &&
+                header->capacity == rounded && header->slotSize == sizeof(RingSlot);
+
+        if (!reuse)
+        {
+            uint64_t epoch = header->magic == RING_MAGIC ? header->epoch.load() + 1 : 1;
+
+            std::memset(memory, 0, size);
+            header->version = RING_VERSION;
+            header->capacity = rounded;
+            header->slotSize = sizeof(RingSlot);
+            header->writeIndex.store(0, std::memory_order_relaxed);
+            header->epoch.store(epoch, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            header->magic = RING_MAGIC;
+        }
+
+        LOG_INFO << "[Ring] Publishing readings to /dev/shm" << shmName(name) << " (" << rounded << " slots"
+                 << (reuse ? ", resumed" : "") << ")" << std::endl;
+        return true;
+    }
+
+    void ReadingRingWriter::close()
+    {
+        if (header)
+        {
+            munmap(header, mappedSize);
+            header = nullptr;
+            slots = nullptr;
+        }
+    }
+
+    void ReadingRingWriter::publish(const ReadingRecord &record)
+    {
+        if (!header)
+            return;
+
+        uint64_t index = header->writeIndex.load(std::memory_order_relaxed);
+        RingSlot &slot = slots[index & mask];
+
+        // 1. Odd: being written. Readers that see this (or see it change) retry / skip.
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        uint64_t words[RingSlot::WORDS];
+        std::memcpy(words, &record, sizeof(record));
+        for (size_t i = 0; i < RingSlot::WORDS; i++)
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+
+        // 2. Even: record `index` is complete
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        header->writeIndex.store(index + 1, std::memory_order_release);
+    }
+
+    uint64_t ReadingRingWriter::published() const
+    {
+        return header ? header->writeIndex.load(std::memory_order_relaxed) : 0;
+    }
+
+    // ---------------------------------------------------------------- Reader
+
+    bool ReadingRingReader::open(const std::string &name, bool fromOldest)
+    {
+        close();
+
+        int fd = shm_open(shmName(name).c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < HEADER_SIZE)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        size_t size = info.st_size;
+        void *memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED)
+            return false;
+
+        const RingHeader *candidate = static_cast<const RingHeader *>(memory);
+        if (candidate->magic != RING_MAGIC || candidate->version != RING_VERSION ||
+            candidate->slotSize != sizeof(RingSlot) || ringSize(candidate->capacity) != size)
+        {
+            munmap(memory, size);
+            return false;
+        }
+
+        header = candidate;
+        slots = reinterpret_cast<const RingSlot *>(static_cast<const uint8_t *>(memory) + HEADER_SIZE);
+        mappedSize = size;
+        mask = header->capacity - 1;
+        epoch = header->epoch.load(std::memory_order_acquire);
+        droppedCount = 0;
+
+        uint64_t head = header->writeIndex.load(std::memory_order_acquire);
+        readIndex = fromOldest && head > header->capacity ? head - header->capacity : (fromOldest ? 0 : head);
+        return true;
+    }
+
+    void ReadingRingReader::close()
+    {
+        if (header)
+        {
+            munmap(const_cast<RingHeader *>(header), mappedSize);
+            header = nullptr;
+            slots = nullptr;
+        }
+    }
+
+    bool ReadingRingReader::stale() const
+    {
+        return header && header->epoch.load(std::memory_order_relaxed) != epoch;
+    }
+
+    bool ReadingRingReader::next(ReadingRecord &record)
+    {
+        if (!header)
+            return false;
+
+        for (;;)
+        {
+            uint64_t head = header->writeIndex.load(std::memory_order_acquire);
+            if (readIndex >= head)
+                return false;
+
+            // 1. Lapped already? Jump to the oldest record that can still be there.
+            if (head - readIndex > header->capacity)
+            {
+                droppedCount += head - header->capacity - readIndex;
+                readIndex = head - header->capacity;
+            }
+
+            const RingSlot &slot = slots[readIndex & mask];
+            uint64_t expected = 2 * readIndex + 2;
+
+            uint64_t before = slot.sequence.load(std::memory_order_acquire);
+            if (before != expected)
+            {
+                // Overwritten by a newer lap (or being overwritten right now)
+                if (before < expected)
+                    return false; // Ring was re-initialised under us, see stale()
+                droppedCount++;
+                readIndex++;
+                continue;
+            }
+
+            uint64_t words[RingSlot::WORDS];
+            for (size_t i = 0; i < RingSlot::WORDS; i++)
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+
+            // 2. Still the same record after the copy? Then it is not torn.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != before)
+            {
+                droppedCount++;
+                readIndex++;
+                continue;
+            }
+
+            std::memcpy(&record, words, sizeof(record));
+            readIndex++;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,347 @@
+#include "ReportingTuner.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "ZStackClient.h"
+#include "ZStackProtocol.h"
+#include "SleepyMailbox.h"
+#include "af/AFPacketParser.h"
+#include "Logger.h"
+
+namespace ZStack
+{
+    namespace
+    {
+        // Smoothing of the per attribute value statistics (per report) and rates (per window)
+        constexpr double VALUE_ALPHA = 0.1;
+        constexpr double RATE_ALPHA = 0.5;
+
+        // Rebalance only outside [RELAX_BELOW, 1] x budget, and never relax above RELAX_TARGET
+        constexpr double RELAX_BELOW = 0.5;
+        constexpr double RELAX_TARGET = 0.8;
+
+        // A delivered Configure Reporting should be answered while the device is still awake
+        constexpr auto RESPONSE_TIMEOUT = std::chrono::seconds(60);
+
+        // Integer attributes only; floats and the rest have no activity figure
+        bool decodeInteger(uint8_t dataType, const std::vector<uint8_t> &value, double &result)
+        {
+            bool isUnsigned = dataType >= 0x20 && dataType <= 0x27;
+            bool isSigned = dataType >= 0x28 && dataType <= 0x2F;
+            if ((!isUnsigned && !isSigned) || value.empty() || value.size() > 8)
+                return false;
+
+            uint64_t raw = 0;
+            for (size_t i = 0; i < value.size(); i++)
+                raw |= static_cast<uint64_t>(value[i]) << (8 * i);
+
+            if (isSigned && value.size() < 8 && (raw >> (8 * value.size() - 1)) & 1)
+                raw |= ~0ULL << (8 * value.size()); // Sign extend
+
+            result = isSigned ? static_cast<double>(static_cast<int64_t>(raw)) : static_cast<double>(raw);
+            return true;
+        }
+    }
+
+    double ReportingTuner::Stream::activity() const
+    {
+        // Wandering by one reportable change is "1"
+        double step = base.reportableChange > 0 ? base.reportableChange : 1.0;
+        return std::sqrt(variance) / step;
+    }
+
+    ReportingTuner::ReportingTuner(ZStackClient &client,
+                                   double budgetFramesPerSecond,
+                                   int evaluateMs,
+                                   SleepyMailbox *mailbox,
+                                   int maxLevel)
+        : client(client),
+          mailbox(mailbox),
+          budgetRate(budgetFramesPerSecond),
+          maxLevel(maxLevel),
+          windowStart(Clock::now())
+    {
+        timer = client.timers().schedulePeriodic(evaluateMs, [this]() { evaluate(); });
+    }
+
+    ReportingTuner::~ReportingTuner()
+    {
+        client.timers().cancel(timer);
+    }
+
+    uint64_t ReportingTuner::key(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID, uint16_t attributeID)
+    {
+        return (static_cast<uint64_t>(shortAddr) << 40) | (static_cast<uint64_t>(endpoint) << 32) |
+               (static_cast<uint64_t>(clusterID) << 16) | attributeID;
+    }
+
+    void ReportingTuner::track(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID, const ZclReportingConfig &config)
+    {
+        // Re-interviewed: the device is back at this config, whatever we had told it
+        Stream &stream = streams[key(shortAddr, endpoint, clusterID, config.attributeID)];
+        stream = Stream();
+        stream.shortAddr = shortAddr;
+        stream.endpoint = endpoint;
+        stream.clusterID = clusterID;
+        stream.base = config;
+    }
+
+    void ReportingTuner::setVisible(uint16_t shortAddr, uint16_t clusterID, bool isVisibleNow)
+    {
+        if (isVisibleNow)
+            visible.insert({shortAddr, clusterID});
+        else
+            visible.erase({shortAddr, clusterID});
+    }
+
+    bool ReportingTuner::isVisible(const Stream &stream) const
+    {
+        return visible.count({stream.shortAddr, stream.clusterID}) > 0;
+    }
+
+    void ReportingTuner::forget(uint16_t shortAddr)
+    {
+        for (auto it = streams.begin(); it != streams.end();)
+        {
+            if (it->second.shortAddr == shortAddr)
+                it = streams.erase(it);
+            else
+                ++it;
+        }
+
+        visible.erase(visible.lower_bound({shortAddr, 0}), visible.upper_bound({shortAddr, 0xFFFF}));
+    }
+
+    void ReportingTuner::handleFrame(const ZStackFrame &frame)
+    {
+        if (frame.getCommand0() != (AREQ | AF) || frame.getCommand1() != AF_INCOMING_MSG)
+            return;
+
+        // Everything heard costs airtime, tunable or not
+        frames++;
+
+        const auto &p = frame.getPayload();
+        // Global, no manufacturer code: the command is at [19]
+        if (p.size() < 20 || (p[17] & 0x07) != 0x00)
+            return;
+
+        uint16_t clusterID = p[2] | (p[3] << 8);
+        uint16_t srcAddr = p[4] | (p[5] << 8);
+        uint8_t srcEndpoint = p[6];
+        uint8_t zclCmd = p[19];
+
+        if (zclCmd == ZCL_REPORT_ATTRIB)
+        {
+            if (streams.empty())
+                return;
+
+            for (const auto &record : AFPacket::parseAttributeRecords(zclCmd, p))
+            {
+                auto it = streams.find(key(srcAddr, srcEndpoint, clusterID, record.attributeID));
+                if (it == streams.end())
+                    continue;
+
+                it->second.reports++;
+                sample(it->second, record.dataType, record.value);
+            }
+        }
+        else if (zclCmd == ZCL_CONFIG_REPORTING_RSP && p.size() >= 21)
+        {
+            configured(srcAddr, clusterID, p[18], p[20]);
+        }
+    }
+
+    void ReportingTuner::sample(Stream &stream, uint8_t dataType, const std::vector<uint8_t> &value)
+    {
+        double x;
+        if (!decodeInteger(dataType, value, x))
+            return;
+
+        if (!stream.sampled)
+        {
+            stream.sampled = true;
+            stream.mean = x;
+            return;
+        }
+
+        // Exponentially weighted mean and variance
+        double diff = x - stream.mean;
+        stream.mean += VALUE_ALPHA * diff;
+        stream.variance = (1.0 - VALUE_ALPHA) * (stream.variance + VALUE_ALPHA * diff * diff);
+    }
+
+    void ReportingTuner::configured(uint16_t shortAddr, uint16_t clusterID, uint8_t sequence, uint8_t status)
+    {
+        for (auto &entry : streams)
+        {
+            Stream &stream = entry.second;
+            if (stream.pendingLevel < 0 || stream.shortAddr != shortAddr || stream.clusterID != clusterID ||
+                stream.sequence != sequence)
+            {
+                continue;
+            }
+
+            if (status == 0x00)
+            {
+                stream.level = stream.pendingLevel;
+            }
+            else
+            {
+                LOG_WARN << "[Tuner] 0x" << std::hex << shortAddr << " refused reporting change for cluster 0x"
+                         << clusterID << " (Status 0x" << (int)status << "), leaving it alone" << std::endl;
+                stream.fixed = true;
+            }
+            stream.pendingLevel = -1;
+            return;
+        }
+    }
+
+    void ReportingTuner::apply(Stream &stream, int level)
+    {
+        ZclReportingConfig config = stream.base;
+
+        // Min interval and reportable change scale together; max interval stays
+        uint32_t minInterval = std::max<uint32_t>(stream.base.minInterval, 1) << level;
+        config.minInterval = static_cast<uint16_t>(std::min<uint32_t>(minInterval, stream.base.maxInterval));
+
+        uint64_t change = static_cast<uint64_t>(stream.base.reportableChange) << level;
+        int length = getZCLDataTypeLength(stream.base.dataType);
+        uint64_t limit = length > 0 && length < 4 ? (1ULL << (8 * length - 1)) - 1 : 0x7FFFFFFF;
+        config.reportableChange = static_cast<uint32_t>(std::min(change, limit));
+
+        stream.sequence = nextSequence++;
+        stream.pendingLevel = level;
+        stream.delivered = false;
+
+        LOG_DEBUG << "[Tuner] 0x" << std::hex << stream.shortAddr << " cluster 0x" << stream.clusterID << std::dec
+                  << " -> level " << level << " (min " << config.minInterval << " s, change "
+                  << config.reportableChange << ")" << std::endl;
+
+        // Never ahead of real commands
+        ScopedSendPriority bulk(client, SendPriority::BULK);
+
+        ZclRequestBuilder builder(frameBuffer, sizeof(frameBuffer));
+        ZclDestination dest{stream.shortAddr, stream.endpoint};
+        FrameView request = builder.configureReporting(dest, stream.clusterID, stream.sequence, {config});
+
+        // Pending until the device answers, or the mailbox gives up on it
+        if (mailbox)
+        {
+            uint64_t streamKey = key(stream.shortAddr, stream.endpoint, stream.clusterID, stream.base.attributeID);
+            uint8_t sequence = stream.sequence;
+            mailbox->post(stream.shortAddr, request,
+                          [this, streamKey, sequence](bool ok) { delivered(streamKey, sequence, ok); });
+        }
+        else
+        {
+            client.send(request);
+            stream.delivered = true;
+            stream.deliveredAt = Clock::now();
+        }
+
+        reconfigured++;
+    }
+
+    void ReportingTuner::delivered(uint64_t streamKey, uint8_t sequence, bool ok)
+    {
+        auto it = streams.find(streamKey);
+        if (it == streams.end() || it->second.pendingLevel < 0 || it->second.sequence != sequence)
+            return;
+
+        Stream &stream = it->second;
+        if (ok)
+        {
+            stream.delivered = true;
+            stream.deliveredAt = Clock::now();
+        }
+        else
+        {
+            // Never reached it: free to try again
+            stream.pendingLevel = -1;
+        }
+    }
+
+    void ReportingTuner::evaluate()
+    {
+        // 1. Close the window
+        auto now = Clock::now();
+        double seconds = std::chrono::duration<double>(now - windowStart).count();
+        windowStart = now;
+        if (seconds <= 0.0)
+            return;
+
+        measuredRate = frames / seconds;
+        frames = 0;
+
+        std::vector<Stream *> tunable;
+        for (auto &entry : streams)
+        {
+            Stream &stream = entry.second;
+            double windowRate = stream.reports / seconds;
+            stream.rate = stream.rate == 0.0 ? windowRate : RATE_ALPHA * windowRate + (1.0 - RATE_ALPHA) * stream.rate;
+            stream.reports = 0;
+
+            // Delivered long ago but never answered: the answer got lost, it may go again.
+            // Undelivered ones wait for the device to wake up, however long that takes.
+            if (stream.pendingLevel >= 0 && stream.delivered && now - stream.deliveredAt > RESPONSE_TIMEOUT)
+                stream.pendingLevel = -1;
+
+            if (stream.fixed || stream.pendingLevel >= 0 || !isZCLAnalogDataType(stream.base.dataType))
+                continue;
+
+            // 2. Someone is watching: straight back to the baseline
+            if (isVisible(stream))
+            {
+                if (stream.level > 0)
+                    apply(stream, 0);
+                continue;
+            }
+
+            tunable.push_back(&stream);
+        }
+
+        LOG_DEBUG << "[Tuner] " << measuredRate << " frames/s against a budget of " << budgetRate << ", "
+                  << tunable.size() << " tunable attribute(s)" << std::endl;
+
+        // 3. Over budget: slow the calmest attributes until the excess is covered.
+        //    One step halves an attribute's reports (roughly).
+        if (measuredRate > budgetRate)
+        {
+            std::sort(tunable.begin(), tunable.end(),
+                      [](const Stream *a, const Stream *b) { return a->activity() < b->activity(); });
+
+            double excess = measuredRate - budgetRate;
+            for (Stream *stream : tunable)
+            {
+                if (excess <= 0.0)
+                    break;
+                if (stream->level >= maxLevel || stream->rate <= 0.0)
+                    continue;
+
+                excess -= stream->rate / 2.0;
+                apply(*stream, stream->level + 1);
+            }
+
+            if (excess > 0.0)
+            {
+                LOG_WARN << "[Tuner] Still " << excess << " frames/s over budget after this round" << std::endl;
+            }
+        }
+        // 4. Plenty of room: speed the busiest slowed attributes back up, as far as the room goes
+        else if (measuredRate < budgetRate * RELAX_BELOW)
+        {
+            std::sort(tunable.begin(), tunable.end(),
+                      [](const Stream *a, const Stream *b) { return a->activity() > b->activity(); });
+
+            double room = budgetRate * RELAX_TARGET - measuredRate;
+            for (Stream *stream : tunable)
+            {
+                if (stream->level == 0 || stream->rate > room)
+                    continue;
+
+                room -= stream->rate;
+                apply(*stream, stream->level - 1);
+            }
+        }
+    }
+}
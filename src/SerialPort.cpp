@@ -12,6 +12,7 @@ SerialPort::SerialPort(const std::string& portName)
 
 SerialPort::~SerialPort() {
     closePort();
+    stopCapture();
 }
 
 bool SerialPort::openPort() {
@@ -87,8 +88,17 @@ bool SerialPort::configureTermios() {
 }
 
 int SerialPort::writeBytes(const std::vector<unsigned char>& data) {
+    return writeBytes(data.data(), data.size());
+}
+
+int SerialPort::writeBytes(const unsigned char* data, size_t size) {
     if (!isConnected) return -1;
-    return write(fileDescriptor, data.data(), data.size());
+
+    int written = write(fileDescriptor, data, size);
+    if (capture && written > 0) {
+        capture->record(ZStack::TraceDirection::TX, data, written);
+    }
+    return written;
 }
 
 int SerialPort::readBytes(std::vector<unsigned char>& buffer) {
@@ -101,6 +111,29 @@ int SerialPort::readBytes(std::vector<unsigned char>& buffer) {
     
     if (num_bytes > 0) {
         buffer.assign(temp_buf, temp_buf + num_bytes);
+
+        if (capture) {
+            capture->record(ZStack::TraceDirection::RX, temp_buf, num_bytes);
+        }
     }
     return num_bytes;
+}
+
+bool SerialPort::startCapture(const std::string& tracePath) {
+    auto writer = std::make_unique<ZStack::TraceWriter>();
+    if (!writer->open(tracePath)) {
+        return false;
+    }
+    capture = std::move(writer);
+    return true;
+}
+
+void SerialPort::stopCapture() {
+    capture.reset();
+}
+
+void SerialPort::flushCapture() {
+    if (capture) {
+        capture->flush();
+    }
 }
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "SerialTrace.h"
+#include <chrono>
+#include <cstring>
+#include "Logger.h"
+
+namespace ZStack
+{
+    namespace
+    {
+        const char TRACE_MAGIC[4] = {'Z', 'S', 'T', 'R'};
+        const uint8_t TRACE_VERSION = 1;
+
+        uint64_t nowUs()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+    }
+
+    bool TraceWriter::open(const std::string &path)
+    {
+        close();
+
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            LOG_ERROR << "[Trace] Unable to open " << path << std::endl;
+            return false;
+        }
+
+        uint64_t wallClock = std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::system_clock::now().time_since_epoch())
+                                 .count();
+
+        uint8_t header[16] = {};
+        std::memcpy(header, TRACE_MAGIC, 4);
+        header[4] = TRACE_VERSION;
+        for (int i = 0; i < 8; i++)
+            header[8 + i] = (wallClock >> (8 * i)) & 0xFF;
+        file.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+        startUs = nowUs();
+        lastUs = startUs;
+        flushedUs = startUs;
+        unflushed = 0;
+
+        LOG_INFO << "[Trace] Capturing serial traffic to " << path << std::endl;
+        return true;
+    }
+
+    void TraceWriter::close()
+    {
+        if (file.is_open())
+        {
+            file.flush();
+            file.close();
+        }
+    }
+
+    void TraceWriter::flush()
+    {
+        if (file.is_open() && unflushed > 0)
+            file.flush();
+
+        unflushed = 0;
+        flushedUs = nowUs();
+    }
+
+    void TraceWriter::writeVarint(uint64_t value)
+    {
+        // LEB128: 7 bits per byte, high bit set while more follow
+        uint8_t bytes[10];
+        size_t count = 0;
+        do
+        {
+            uint8_t byte = value & 0x7F;
+            value >>= 7;
+            bytes[count++] = byte | (value ? 0x80 : 0x00);
+        } while (value);
+
+        file.write(reinterpret_cast<const char *>(bytes), count);
+    }
+
+    void TraceWriter::record(TraceDirection direction, const uint8_t *data, size_t size)
+    {
+        if (!file.is_open() || size == 0)
+            return;
+
+        uint64_t now = nowUs();
+
+        file.put(static_cast<char>(direction));
+        writeVarint(now - lastUs);
+        writeVarint(size);
+        file.write(reinterpret_cast<const char *>(data), size);
+
+        lastUs = now;
+
+        if (++unflushed >= FLUSH_RECORDS || now - flushedUs >= FLUSH_INTERVAL_US)
+            flush();
+    }
+
+    bool TraceReader::open(const std::string &path)
+    {
+        file.open(path, std::ios::binary);
+        if (!file.is_open())
+        {
+            LOG_ERROR << "[Trace] Unable to open " << path << std::endl;
+            return false;
+        }
+
+        uint8_t header[16];
+        if (!file.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+            std::memcmp(header, TRACE_MAGIC, 4) != 0 || header[4] != TRACE_VERSION)
+        {
+            LOG_ERROR << "[Trace] " << path << " is not a serial trace" << std::endl;
+            file.close();
+            return false;
+        }
+
+        startUs = 0;
+        for (int i = 0; i < 8; i++)
+            startUs |= static_cast<uint64_t>(header[8 + i]) << (8 * i);
+
+        currentUs = 0;
+        return true;
+    }
+
+    bool TraceReader::readVarint(uint64_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            int byte = file.get();
+            if (byte == EOF)
+                return false;
+
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool TraceReader::next(TraceRecord &record)
+    {
+        if (!file.is_open())
+            return false;
+
+        int direction = file.get();
+        if (direction == EOF)
+            return false;
+
+        uint64_t delta = 0;
+        uint64_t size = 0;
+        if (!readVarint(delta) || !readVarint(size) || size > (1u << 20))
+            return false;
+
+        currentUs += delta;
+
+        record.direction = static_cast<TraceDirection>(direction);
+        record.timestampUs = currentUs;
+        record.data.resize(size);
+        return static_cast<bool>(file.read(reinterpret_cast<char *>(record.data.data()), size));
+    }
+}
@@ -0,0 +1,363 @@
+#include "SleepyMailbox.h"
+#include <algorithm>
+#include <vector>
+#include "ZStackClient.h"
+#include "ZStackProtocol.h"
+#include "zcl/ZclRequestBuilder.h"
+#include "Logger.h"
+
+namespace ZStack
+{
+    namespace
+    {
+        // Only AF data requests are confirmed, so only they can be held
+        bool isDataRequest(const ZStackFrame &frame)
+        {
+            if (frame.getCommand0() != (SREQ | AF))
+                return false;
+            if (frame.getCommand1() == AF_DATA_REQUEST)
+                return frame.getPayload().size() > 6; // DstAddr(2), DstEp, SrcEp, Cluster(2), TransID
+            if (frame.getCommand1() == AF_DATA_REQUEST_EXT)
+                return frame.getPayload().size() > 15; // AddrMode, DstAddr(8), DstEp, PanID(2), SrcEp, Cluster(2), TransID
+            return false;
+        }
+
+        void sendFrame(ZStackClient &client, const ZStackFrame &frame)
+        {
+            auto bytes = frame.toSerialBytes();
+            client.send(FrameView{bytes.data(), bytes.size()});
+        }
+    }
+
+    SleepyMailbox::SleepyMailbox(ZStackClient &client, int awakeWindowMs, int expiryMs, size_t maxPerDevice,
+                                 int maxAttempts)
+        : client(client),
+          awakeWindowMs(awakeWindowMs),
+          expiryMs(expiryMs),
+          maxPerDevice(std::max<size_t>(maxPerDevice, 1)),
+          maxAttempts(std::max(maxAttempts, 1))
+    {
+    }
+
+    SleepyMailbox::~SleepyMailbox()
+    {
+        for (auto &entry : devices)
+            client.timers().cancel(entry.second.wakeTimer);
+        for (auto &entry : inFlight)
+            client.cancelConfirm(entry.second.transID);
+    }
+
+    void SleepyMailbox::setSleepy(uint16_t shortAddr, bool sleepy)
+    {
+        devices[shortAddr].sleepy = sleepy;
+        if (!sleepy)
+            flush(shortAddr);
+    }
+
+    bool SleepyMailbox::isSleepy(uint16_t shortAddr) const
+    {
+        auto it = devices.find(shortAddr);
+        return it != devices.end() && it->second.sleepy;
+    }
+
+    size_t SleepyMailbox::pending() const
+    {
+        size_t total = 0;
+        for (const auto &entry : devices)
+            total += entry.second.mail.size();
+        return total;
+    }
+
+    size_t SleepyMailbox::pending(uint16_t shortAddr) const
+    {
+        auto it = devices.find(shortAddr);
+        return it != devices.end() ? it->second.mail.size() : 0;
+    }
+
+    std::optional<int> SleepyMailbox::wakeInterval(uint16_t shortAddr) const
+    {
+        auto it = devices.find(shortAddr);
+        if (it == devices.end() || it->second.intervalMs == 0)
+            return std::nullopt;
+        return it->second.intervalMs;
+    }
+
+    bool SleepyMailbox::awake(const Device &device, Clock::time_point now) const
+    {
+        return device.fastPolling || now - device.lastHeard < std::chrono::milliseconds(awakeWindowMs);
+    }
+
+    void SleepyMailbox::post(uint16_t shortAddr, const FrameView &frame, ResultHandler handler)
+    {
+        if (!frame.valid() || frame.size < 5)
+            return;
+
+        // SOF, LEN, CMD0, CMD1, Payload, FCS
+        post(shortAddr,
+             ZStackFrame(frame.data[2], frame.data[3], std::vector<uint8_t>(frame.data + 4, frame.data + frame.size - 1)),
+             std::move(handler));
+    }
+
+    void SleepyMailbox::post(uint16_t shortAddr, const ZStackFrame &frame, ResultHandler handler)
+    {
+        if (!isDataRequest(frame))
+        {
+            // Nothing to confirm: not ours to hold
+            LOG_WARN << "[Mailbox] Not an AF data request, sent as is" << std::endl;
+            sendFrame(client, frame);
+            return;
+        }
+
+        auto now = Clock::now();
+        Device &device = devices[shortAddr];
+
+        Item item{frame, std::move(handler), now + std::chrono::milliseconds(expiryMs), 0};
+
+        // 1. Mains powered, or listening right now: straight out (behind older mail)
+        if (!device.sleepy || awake(device, now))
+        {
+            device.mail.push_back(std::move(item));
+            flush(shortAddr);
+            return;
+        }
+
+        // 2. Asleep: wait for it, dropping the oldest if the box is full
+        if (device.mail.size() >= maxPerDevice)
+        {
+            Item dropped = std::move(device.mail.front());
+            device.mail.pop_front();
+            LOG_WARN << "[Mailbox] 0x" << std::hex << shortAddr << std::dec << " mailbox full, oldest dropped"
+                     << std::endl;
+            if (dropped.handler)
+                dropped.handler(false);
+        }
+
+        device.mail.push_back(std::move(item));
+        scheduleWake(shortAddr);
+    }
+
+    void SleepyMailbox::handleFrame(const ZStackFrame &frame)
+    {
+        const auto &p = frame.getPayload();
+        uint8_t cmd0 = frame.getCommand0();
+        uint8_t cmd1 = frame.getCommand1();
+
+        // 1. Anything from the device says it's awake (confirms come back through the client)
+        uint16_t shortAddr;
+        if (cmd0 == (AREQ | AF) && cmd1 == AF_INCOMING_MSG && p.size() > 5)
+        {
+            shortAddr = p[4] | (p[5] << 8);
+        }
+        else if (cmd0 != (AREQ | ZDO) || !getZDOSourceAddress(cmd1, p, shortAddr))
+        {
+            return;
+        }
+
+        if (devices.find(shortAddr) == devices.end())
+            return;
+
+        // 2. Poll Control check-in: cluster specific, server -> client, command 0x00
+        if (cmd1 == AF_INCOMING_MSG && p.size() >= 20 && (p[2] | (p[3] << 8)) == POLL_CONTROL_CLUSTER &&
+            (p[17] & 0x0B) == 0x09 && p[19] == ZCL_POLL_CHECK_IN)
+        {
+            checkIn(shortAddr, p[6], p[18]);
+        }
+
+        heard(shortAddr, Clock::now());
+    }
+
+    void SleepyMailbox::heard(uint16_t shortAddr, Clock::time_point now)
+    {
+        Device &device = devices[shortAddr];
+
+        // A new burst of traffic after a quiet spell is a wake up
+        if (now - device.lastHeard >= std::chrono::milliseconds(awakeWindowMs))
+        {
+            if (device.wakesSeen > 0)
+            {
+                int interval = static_cast<int>(
+                    std::chrono::duration_cast<std::chrono::milliseconds>(now - device.lastWake).count());
+                device.intervalMs = device.intervalMs == 0 ? interval : (3 * device.intervalMs + interval) / 4;
+            }
+            device.wakesSeen++;
+            device.lastWake = now;
+        }
+        device.lastHeard = now;
+
+        flush(shortAddr);
+    }
+
+    void SleepyMailbox::checkIn(uint16_t shortAddr, uint8_t endpoint, uint8_t sequence)
+    {
+        Device &device = devices[shortAddr];
+        device.endpoint = endpoint;
+
+        // Stay awake for us only if there is something to pick up
+        bool fastPoll = !device.mail.empty();
+        uint8_t payload[3] = {static_cast<uint8_t>(fastPoll ? 0x01 : 0x00),
+                              static_cast<uint8_t>(fastPollQuarterSeconds & 0xFF),
+                              static_cast<uint8_t>(fastPollQuarterSeconds >> 8)};
+
+        uint8_t buffer[MAX_MT_FRAME_SIZE];
+        ZclRequestBuilder builder(buffer, sizeof(buffer));
+        ZclDestination dest{shortAddr, endpoint};
+        client.send(builder.clusterCommand(dest, POLL_CONTROL_CLUSTER, sequence, ZCL_POLL_CHECK_IN_RSP, payload,
+                                           sizeof(payload)));
+
+        device.fastPolling = fastPoll;
+        LOG_DEBUG << "[Mailbox] 0x" << std::hex << shortAddr << std::dec << " checked in, " << device.mail.size()
+                  << " command(s) waiting" << std::endl;
+    }
+
+    void SleepyMailbox::stopFastPoll(uint16_t shortAddr)
+    {
+        Device &device = devices[shortAddr];
+        device.fastPolling = false;
+
+        uint8_t buffer[MAX_MT_FRAME_SIZE];
+        ZclRequestBuilder builder(buffer, sizeof(buffer));
+        ZclDestination dest{shortAddr, device.endpoint};
+        client.send(builder.clusterCommand(dest, POLL_CONTROL_CLUSTER, nextSequence++, ZCL_POLL_FAST_POLL_STOP));
+    }
+
+    void SleepyMailbox::flush(uint16_t shortAddr)
+    {
+        Device &device = devices[shortAddr];
+        client.timers().cancel(device.wakeTimer);
+        device.wakeTimer = INVALID_TIMER;
+
+        auto now = Clock::now();
+        while (!device.mail.empty())
+        {
+            Item item = std::move(device.mail.front());
+            device.mail.pop_front();
+
+            if (item.expires <= now)
+            {
+                if (item.handler)
+                    item.handler(false);
+                continue;
+            }
+            deliver(shortAddr, std::move(item));
+        }
+    }
+
+    void SleepyMailbox::deliver(uint16_t shortAddr, Item item)
+    {
+        item.attempts++;
+
+        // The client hands out the TransID and brings its confirm back here.
+        // No confirm in time counts as MAC_TRANSACTION_EXPIRED.
+        uint32_t delivery = nextDelivery++;
+        auto bytes = item.frame.toSerialBytes();
+        int transID = client.send(
+            FrameView{bytes.data(), bytes.size()},
+            [this, delivery](std::optional<uint8_t> status) { confirmed(delivery, status.value_or(0xF0)); },
+            CONFIRM_TIMEOUT_MS);
+        if (transID < 0)
+        {
+            if (item.handler)
+                item.handler(false);
+            return;
+        }
+
+        devices[shortAddr].inFlight++;
+        inFlight[delivery] = InFlight{shortAddr, std::move(item), static_cast<uint8_t>(transID)};
+    }
+
+    void SleepyMailbox::confirmed(uint32_t delivery, uint8_t status)
+    {
+        auto it = inFlight.find(delivery);
+        if (it == inFlight.end())
+            return;
+
+        InFlight entry = std::move(it->second);
+        inFlight.erase(it);
+
+        uint16_t shortAddr = entry.shortAddr;
+        Device &device = devices[shortAddr];
+        device.inFlight--;
+
+        if (status == 0x00)
+        {
+            finish(shortAddr, std::move(entry), true);
+            return;
+        }
+
+        // Missed it (asleep again): back to the front of the line for its next wake
+        if (entry.item.attempts < maxAttempts && entry.item.expires > Clock::now() && device.sleepy)
+        {
+            LOG_DEBUG << "[Mailbox] 0x" << std::hex << shortAddr << " missed a command (status 0x" << (int)status
+                      << std::dec << "), kept for its next wake" << std::endl;
+            device.lastHeard = Clock::time_point{};
+            device.fastPolling = false;
+            device.mail.push_front(std::move(entry.item));
+            scheduleWake(shortAddr);
+            return;
+        }
+
+        finish(shortAddr, std::move(entry), false);
+    }
+
+    void SleepyMailbox::finish(uint16_t shortAddr, InFlight entry, bool delivered)
+    {
+        Device &device = devices[shortAddr];
+        if (device.fastPolling && device.inFlight == 0 && device.mail.empty())
+            stopFastPoll(shortAddr);
+
+        if (entry.item.handler)
+            entry.item.handler(delivered);
+    }
+
+    void SleepyMailbox::scheduleWake(uint16_t shortAddr)
+    {
+        Device &device = devices[shortAddr];
+        if (device.mail.empty() || device.intervalMs == 0 || device.wakeTimer != INVALID_TIMER)
+            return;
+
+        // Next expected wake, skipping the ones we already missed
+        auto now = Clock::now();
+        auto interval = std::chrono::milliseconds(device.intervalMs);
+        auto lead = std::chrono::milliseconds(std::min(WAKE_LEAD_MS, device.intervalMs / 2));
+        auto next = device.lastWake + interval;
+        while (next - lead <= now)
+            next += interval;
+
+        int delayMs = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(next - lead - now).count());
+        device.wakeTimer = client.timers().schedule(delayMs, [this, shortAddr]() {
+            devices[shortAddr].wakeTimer = INVALID_TIMER;
+            flush(shortAddr);
+        });
+    }
+
+    void SleepyMailbox::forget(uint16_t shortAddr)
+    {
+        auto it = devices.find(shortAddr);
+        if (it == devices.end())
+            return;
+
+        std::vector<ResultHandler> dropped;
+        client.timers().cancel(it->second.wakeTimer);
+        for (auto &item : it->second.mail)
+            dropped.push_back(std::move(item.handler));
+        devices.erase(it);
+
+        for (auto entry = inFlight.begin(); entry != inFlight.end();)
+        {
+            if (entry->second.shortAddr != shortAddr)
+            {
+                ++entry;
+                continue;
+            }
+            client.cancelConfirm(entry->second.transID);
+            dropped.push_back(std::move(entry->second.item.handler));
+            entry = inFlight.erase(entry);
+        }
+
+        for (auto &handler : dropped)
+        {
+            if (handler)
+                handler(false);
+        }
+    }
+}
@@ -0,0 +1,259 @@
+#include "TimerWheel.h"
+
+namespace ZStack
+{
+    TimerWheel::TimerWheel(int resolutionMs)
+        : start(Clock::now()),
+          resolution(std::chrono::milliseconds(resolutionMs > 0 ? resolutionMs : 1)),
+          currentTick(0),
+          activeTimers(0),
+          freeList(NONE)
+    {
+        // One list head per slot plus the firing, overflow and scratch list heads, each pointing at itself
+        uint32_t heads = LEVELS * SLOTS + 3;
+        pool.resize(heads);
+        for (uint32_t i = 0; i < heads; i++)
+        {
+            pool[i].next = i;
+            pool[i].prev = i;
+            pool[i].generation = 0;
+            pool[i].active = false;
+        }
+        firingHead = LEVELS * SLOTS;
+        overflowHead = firingHead + 1;
+        scratchHead = firingHead + 2;
+    }
+
+    uint64_t TimerWheel::tickAt(Clock::time_point time) const
+    {
+        if (time <= start)
+            return 0;
+        return static_cast<uint64_t>((time - start) / resolution);
+    }
+
+    uint64_t TimerWheel::ticksFor(int delayMs) const
+    {
+        auto delay = std::chrono::milliseconds(delayMs > 0 ? delayMs : 0);
+        // Round up, and never less than one tick
+        uint64_t ticks = static_cast<uint64_t>((delay + resolution - Clock::duration(1)) / resolution);
+        return ticks > 0 ? ticks : 1;
+    }
+
+    TimerId TimerWheel::schedule(int delayMs, Callback callback)
+    {
+        uint64_t now = tickAt(Clock::now());
+        if (now < currentTick)
+            now = currentTick;
+        return add(now + ticksFor(delayMs), 0, std::move(callback));
+    }
+
+    TimerId TimerWheel::schedulePeriodic(int intervalMs, Callback callback)
+    {
+        uint64_t now = tickAt(Clock::now());
+        if (now < currentTick)
+            now = currentTick;
+        uint64_t period = ticksFor(intervalMs);
+        return add(now + period, period, std::move(callback));
+    }
+
+    TimerId TimerWheel::add(uint64_t expires, uint64_t periodTicks, Callback callback)
+    {
+        uint32_t index;
+        if (freeList != NONE)
+        {
+            index = freeList;
+            freeList = pool[index].next;
+        }
+        else
+        {
+            index = static_cast<uint32_t>(pool.size());
+            pool.emplace_back();
+            pool[index].generation = 1;
+        }
+
+        Node &node = pool[index];
+        node.active = true;
+        node.expires = expires;
+        node.periodTicks = periodTicks;
+        node.callback = std::move(callback);
+
+        insert(index);
+        activeTimers++;
+
+        return (static_cast<TimerId>(node.generation) << 32) | index;
+    }
+
+    bool TimerWheel::cancel(TimerId id)
+    {
+        uint32_t index = static_cast<uint32_t>(id & 0xFFFFFFFF);
+        uint32_t generation = static_cast<uint32_t>(id >> 32);
+
+        if (index <= scratchHead || index >= pool.size())
+            return false;
+
+        Node &node = pool[index];
+        if (!node.active || node.generation != generation)
+            return false;
+
+        unlink(index);
+        release(index);
+        return true;
+    }
+
+    void TimerWheel::insert(uint32_t index)
+    {
+        Node &node = pool[index];
+
+        // Overdue timers are due now. Only processTick() files timers for the
+        // current tick (add() is always at least one ahead), before it takes
+        // the level 0 slot, so they still fire on this tick: a timer cascaded
+        // onto a coarse level boundary is not held back by one.
+        if (node.expires < currentTick)
+            node.expires = currentTick;
+
+        uint64_t delta = node.expires - currentTick;
+
+        // Out of the wheel's reach: the top level slot would come round before it is due
+        if (delta >= RANGE)
+        {
+            link(overflowHead, index);
+            return;
+        }
+
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (static_cast<uint64_t>(1) << (SLOT_BITS * (level + 1))))
+            level++;
+
+        uint32_t slot = (node.expires >> (SLOT_BITS * level)) & SLOT_MASK;
+        link(level * SLOTS + slot, index);
+    }
+
+    void TimerWheel::link(uint32_t head, uint32_t index)
+    {
+        // Append at the tail so timers due on the same tick fire in order
+        uint32_t tail = pool[head].prev;
+        pool[index].next = head;
+        pool[index].prev = tail;
+        pool[tail].next = index;
+        pool[head].prev = index;
+    }
+
+    void TimerWheel::unlink(uint32_t index)
+    {
+        Node &node = pool[index];
+        pool[node.prev].next = node.next;
+        pool[node.next].prev = node.prev;
+        node.next = index;
+        node.prev = index;
+    }
+
+    void TimerWheel::release(uint32_t index)
+    {
+        Node &node = pool[index];
+        node.active = false;
+        node.generation++;
+        node.callback = nullptr;
+        node.next = freeList;
+        freeList = index;
+        activeTimers--;
+    }
+
+    void TimerWheel::splice(uint32_t fromHead, uint32_t toHead)
+    {
+        if (pool[fromHead].next == fromHead)
+            return;
+
+        uint32_t first = pool[fromHead].next;
+        uint32_t last = pool[fromHead].prev;
+        uint32_t tail = pool[toHead].prev;
+
+        pool[tail].next = first;
+        pool[first].prev = tail;
+        pool[last].next = toHead;
+        pool[toHead].prev = last;
+
+        pool[fromHead].next = fromHead;
+        pool[fromHead].prev = fromHead;
+    }
+
+    void TimerWheel::refile(uint32_t head)
+    {
+        // Detach the list first: a timer may well land back on the same head
+        splice(head, scratchHead);
+
+        while (pool[scratchHead].next != scratchHead)
+        {
+            uint32_t index = pool[scratchHead].next;
+            unlink(index);
+            insert(index);
+        }
+    }
+
+    void TimerWheel::cascade(int level)
+    {
+        uint32_t slot = (currentTick >> (SLOT_BITS * level)) & SLOT_MASK;
+
+        // Re-file everything from this coarse slot onto the finer levels
+        refile(level * SLOTS + slot);
+    }
+
+    void TimerWheel::processTick()
+    {
+        // 1. Entering a new block of a coarser level: pull its timers down
+        int highest = 0;
+        while (highest < LEVELS - 1 &&
+               (currentTick & ((static_cast<uint64_t>(1) << (SLOT_BITS * (highest + 1))) - 1)) == 0)
+            highest++;
+
+        // Once per turn of the top level, overflow timers that came in range join the wheel
+        if ((currentTick & (RANGE - 1)) == 0)
+            refile(overflowHead);
+
+        for (int level = highest; level >= 1; level--)
+            cascade(level);
+
+        // 2. Fire the level 0 slot. Move it aside first so callbacks can
+        //    schedule and cancel freely while we walk it.
+        splice(currentTick & SLOT_MASK, firingHead);
+
+        while (pool[firingHead].next != firingHead)
+        {
+            uint32_t index = pool[firingHead].next;
+            unlink(index);
+
+            Node &node = pool[index];
+            if (node.expires > currentTick)
+            {
+                insert(index);
+                continue;
+            }
+
+            if (node.periodTicks > 0)
+            {
+                node.expires = currentTick + node.periodTicks;
+                insert(index);
+
+                // Copy: the callback may cancel its own timer
+                Callback callback = node.callback;
+                callback();
+            }
+            else
+            {
+                Callback callback = std::move(node.callback);
+                release(index);
+                callback();
+            }
+        }
+    }
+
+    void TimerWheel::advance(Clock::time_point now)
+    {
+        uint64_t target = tickAt(now);
+
+        while (currentTick < target)
+        {
+            currentTick++;
+            processTick();
+        }
+    }
+}
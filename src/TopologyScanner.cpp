@@ -0,0 +1,361 @@
+#include "TopologyScanner.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include "ZStackClient.h"
+#include "Logger.h"
+
+namespace ZStack
+{
+    // ---- TopologyGraph ----
+
+    void TopologyGraph::addNode(uint16_t shortAddr, uint64_t ieeeAddress, uint8_t deviceType, uint8_t depth, uint64_t nowMs)
+    {
+        nodeMap[shortAddr] = {ieeeAddress, deviceType, depth, nowMs};
+    }
+
+    void TopologyGraph::updateNeighbor(uint16_t source, const ZDOPacket::NeighborEntry &entry, uint32_t generation, uint64_t nowMs)
+    {
+        addNode(entry.networkAddress, entry.ieeeAddress, entry.deviceType, entry.depth, nowMs);
+        linkMap[key(source, entry.networkAddress)] = {entry.lqi, entry.relationship, nowMs, generation};
+    }
+
+    void TopologyGraph::updateRoute(uint16_t source, const ZDOPacket::RouteEntry &entry, uint32_t generation)
+    {
+        routeMap[key(source, entry.destination)] = {entry.nextHop, entry.status, generation};
+    }
+
+    void TopologyGraph::pruneLinks(uint16_t source, uint32_t generation)
+    {
+        auto it = linkMap.lower_bound(key(source, 0));
+        while (it != linkMap.end() && (it->first >> 16) == source)
+        {
+            if (it->second.generation != generation)
+                it = linkMap.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    void TopologyGraph::pruneRoutes(uint16_t source, uint32_t generation)
+    {
+        auto it = routeMap.lower_bound(key(source, 0));
+        while (it != routeMap.end() && (it->first >> 16) == source)
+        {
+            if (it->second.generation != generation)
+                it = routeMap.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    uint16_t TopologyGraph::nextHop(uint16_t source, uint16_t destination) const
+    {
+        auto it = routeMap.find(key(source, destination));
+        return it == routeMap.end() ? 0xFFFF : it->second.nextHop;
+    }
+
+    std::vector<TopologyLink> TopologyGraph::links() const
+    {
+        std::vector<TopologyLink> result;
+        result.reserve(linkMap.size());
+        for (const auto &entry : linkMap)
+        {
+            result.push_back({static_cast<uint16_t>(entry.first >> 16), static_cast<uint16_t>(entry.first & 0xFFFF),
+                              entry.second.lqi, entry.second.relationship, entry.second.updatedMs});
+        }
+        return result;
+    }
+
+    std::vector<TopologyLink> TopologyGraph::weakLinks(uint8_t lqiThreshold) const
+    {
+        std::vector<TopologyLink> result = links();
+        result.erase(std::remove_if(result.begin(), result.end(),
+                                    [lqiThreshold](const TopologyLink &link) { return link.lqi >= lqiThreshold; }),
+                     result.end());
+        std::sort(result.begin(), result.end(),
+                  [](const TopologyLink &a, const TopologyLink &b) { return a.lqi < b.lqi; });
+        return result;
+    }
+
+    std::string TopologyGraph::toDot() const
+    {
+        static const char *SHAPES[] = {"doubleoctagon", "box", "ellipse", "plaintext"};
+
+        std::ostringstream out;
+        out << "digraph zigbee {\n";
+
+        for (const auto &entry : nodeMap)
+        {
+            out << "  \"0x" << std::hex << std::setw(4) << std::setfill('0') << entry.first << "\" [shape="
+                << SHAPES[std::min<uint8_t>(entry.second.deviceType, 3)] << ", label=\"0x" << std::setw(4)
+                << entry.first << "\\n" << std::setw(16) << entry.second.ieeeAddress << "\"];\n";
+        }
+
+        for (const auto &entry : linkMap)
+        {
+            uint8_t lqi = entry.second.lqi;
+            const char *color = lqi < 80 ? "red" : lqi < 150 ? "orange" : "darkgreen";
+            out << "  \"0x" << std::hex << std::setw(4) << std::setfill('0') << (entry.first >> 16) << "\" -> \"0x"
+                << std::setw(4) << (entry.first & 0xFFFF) << "\" [label=\"" << std::dec << (int)lqi
+                << "\", color=" << color << "];\n";
+        }
+
+        out << "}\n";
+        return out.str();
+    }
+
+    // ---- TopologyScanner ----
+
+    TopologyScanner::TopologyScanner(ZStackClient &client,
+                                     size_t maxConcurrent,
+                                     int requestGapMs,
+                                     int timeoutMs,
+                                     int maxRetries)
+        : client(client),
+          maxConcurrent(std::max<size_t>(maxConcurrent, 1)),
+          requestGapMs(requestGapMs),
+          timeoutMs(timeoutMs),
+          maxRetries(maxRetries),
+          start(std::chrono::steady_clock::now())
+    {
+    }
+
+    TopologyScanner::~TopologyScanner()
+    {
+        for (auto &entry : inFlight)
+            client.timers().cancel(entry.second.timer);
+        client.timers().cancel(pumpTimer);
+        client.timers().cancel(periodicTimer);
+    }
+
+    uint64_t TopologyScanner::nowMs() const
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool TopologyScanner::busy(uint64_t now) const
+    {
+        uint64_t second = now / 1000;
+        size_t current = second == trafficSecond ? trafficThisSecond : 0;
+        size_t previous = second == trafficSecond ? trafficLastSecond
+                        : second == trafficSecond + 1 ? trafficThisSecond : 0;
+        return std::max(current, previous) > busyFramesPerSecond;
+    }
+
+    void TopologyScanner::sweep()
+    {
+        if (sweeping)
+            return;
+
+        sweeping = true;
+        generation++;
+        visited.clear();
+
+        LOG_INFO << "[Topology] Sweep " << std::dec << generation << " started" << std::endl;
+
+        // The coordinator is always 0x0000 and always a router
+        if (!topology.nodes().count(0x0000))
+            topology.addNode(0x0000, 0, 0, 0, nowMs());
+        queueRouter(0x0000);
+        pump();
+    }
+
+    void TopologyScanner::schedulePeriodic(int intervalMs)
+    {
+        client.timers().cancel(periodicTimer);
+        periodicTimer = client.timers().schedulePeriodic(intervalMs, [this]() { sweep(); });
+    }
+
+    void TopologyScanner::queueRouter(uint16_t shortAddr)
+    {
+        if (!visited.insert(shortAddr).second)
+            return;
+
+        queue.push_back({shortAddr, Table::NEIGHBORS, 0, 0});
+        queue.push_back({shortAddr, Table::ROUTES, 0, 0});
+    }
+
+    void TopologyScanner::pump()
+    {
+        if (pumpTimer != INVALID_TIMER)
+            return; // Already waiting for the next send slot
+
+        while (inFlight.size() < maxConcurrent)
+        {
+            // 1. One table page per router and table at a time: a job whose
+            //    key is in flight stays queued until that page is answered
+            auto next = std::find_if(queue.begin(), queue.end(), [this](const Job &job)
+            {
+                return !inFlight.count(jobKey(job.shortAddr, job.table));
+            });
+            if (next == queue.end())
+                break;
+
+            // 2. Paced and polite: wait for the gap, back off while reports flow
+            uint64_t now = nowMs();
+            int waitMs = 0;
+            if (busy(now))
+                waitMs = 1000;
+            else if (lastRequestMs != 0 && now - lastRequestMs < static_cast<uint64_t>(requestGapMs))
+                waitMs = static_cast<int>(requestGapMs - (now - lastRequestMs));
+
+            if (waitMs > 0)
+            {
+                pumpTimer = client.timers().schedule(waitMs, [this]()
+                {
+                    pumpTimer = INVALID_TIMER;
+                    pump();
+                });
+                return;
+            }
+
+            Job job = *next;
+            queue.erase(next);
+
+            uint32_t key = jobKey(job.shortAddr, job.table);
+            job.attempts++;
+            TimerId timer = client.timers().schedule(timeoutMs, [this, key]() { timeout(key); });
+            inFlight[key] = {job, timer};
+            lastRequestMs = now;
+
+            ScopedSendPriority bulk(client, SendPriority::BULK);
+            if (job.table == Table::NEIGHBORS)
+                client.fetchNeighborTable(job.shortAddr, job.startIndex);
+            else
+                client.fetchRoutingTable(job.shortAddr, job.startIndex);
+        }
+
+        finishIfDone();
+    }
+
+    void TopologyScanner::timeout(uint32_t key)
+    {
+        auto it = inFlight.find(key);
+        if (it == inFlight.end())
+            return;
+
+        Job job = it->second.job;
+        inFlight.erase(it);
+
+        if (job.attempts <= maxRetries)
+        {
+            // Retry before anything else queued
+            queue.push_front(job);
+        }
+        else
+        {
+            LOG_WARN << "[Topology] 0x" << std::hex << job.shortAddr << " did not answer its "
+                     << (job.table == Table::NEIGHBORS ? "neighbor" : "routing") << " table request" << std::endl;
+        }
+
+        pump();
+    }
+
+    void TopologyScanner::finishIfDone()
+    {
+        if (!sweeping || !queue.empty() || !inFlight.empty())
+            return;
+
+        sweeping = false;
+        LOG_INFO << "[Topology] Sweep " << std::dec << generation << " done: " << topology.nodes().size()
+                 << " nodes, " << topology.linkCount() << " links, " << topology.routeCount() << " routes" << std::endl;
+
+        if (completionHandler)
+            completionHandler(topology);
+    }
+
+    void TopologyScanner::handleFrame(const ZStackFrame &frame)
+    {
+        uint8_t cmd0 = frame.getCommand0();
+        uint8_t cmd1 = frame.getCommand1();
+
+        // 1. Report traffic, for the busy check
+        if (cmd0 == (AREQ | AF) && cmd1 == AF_INCOMING_MSG)
+        {
+            uint64_t second = nowMs() / 1000;
+            if (second != trafficSecond)
+            {
+                trafficLastSecond = second == trafficSecond + 1 ? trafficThisSecond : 0;
+                trafficThisSecond = 0;
+                trafficSecond = second;
+            }
+            trafficThisSecond++;
+            return;
+        }
+
+        // 2. Table pages
+        if (inFlight.empty() || cmd0 != (AREQ | ZDO) || (cmd1 != ZDO_MGMT_LQI_RSP && cmd1 != ZDO_MGMT_RTG_RSP))
+            return;
+
+        auto packet = ZDOPacket::parseZStackFrame(frame);
+        if (!packet)
+            return;
+
+        if (packet->type == ZDOPacket::MGMT_LQI_RESPONSE)
+            handleNeighbors(static_cast<const ZDOPacket::MgmtLqiResponse &>(*packet));
+        else if (packet->type == ZDOPacket::MGMT_RTG_RESPONSE)
+            handleRoutes(static_cast<const ZDOPacket::MgmtRtgResponse &>(*packet));
+
+        pump();
+    }
+
+    void TopologyScanner::handleNeighbors(const ZDOPacket::MgmtLqiResponse &rsp)
+    {
+        auto it = inFlight.find(jobKey(rsp.srcAddress, Table::NEIGHBORS));
+        if (it == inFlight.end())
+            return;
+
+        client.timers().cancel(it->second.timer);
+        inFlight.erase(it);
+
+        if (rsp.status != 0x00)
+        {
+            LOG_DEBUG << "[Topology] 0x" << std::hex << rsp.srcAddress << " has no neighbor table (status 0x"
+                      << (int)rsp.status << ")" << std::endl;
+            return;
+        }
+
+        uint64_t now = nowMs();
+        for (const auto &neighbor : rsp.neighbors)
+        {
+            if (neighbor.networkAddress >= 0xFFF8)
+                continue; // Not (yet) addressable
+
+            topology.updateNeighbor(rsp.srcAddress, neighbor, generation, now);
+
+            // Routers have tables of their own
+            if (neighbor.deviceType <= 1)
+                queueRouter(neighbor.networkAddress);
+        }
+
+        // Another page, or the table is complete
+        size_t next = static_cast<size_t>(rsp.startIndex) + rsp.neighbors.size();
+        if (!rsp.neighbors.empty() && next < rsp.totalEntries)
+            queue.push_front({rsp.srcAddress, Table::NEIGHBORS, static_cast<uint8_t>(next), 0});
+        else
+            topology.pruneLinks(rsp.srcAddress, generation);
+    }
+
+    void TopologyScanner::handleRoutes(const ZDOPacket::MgmtRtgResponse &rsp)
+    {
+        auto it = inFlight.find(jobKey(rsp.srcAddress, Table::ROUTES));
+        if (it == inFlight.end())
+            return;
+
+        client.timers().cancel(it->second.timer);
+        inFlight.erase(it);
+
+        if (rsp.status != 0x00)
+            return;
+
+        for (const auto &route : rsp.routes)
+            topology.updateRoute(rsp.srcAddress, route, generation);
+
+        size_t next = static_cast<size_t>(rsp.startIndex) + rsp.routes.size();
+        if (!rsp.routes.empty() && next < rsp.totalEntries)
+            queue.push_front({rsp.srcAddress, Table::ROUTES, static_cast<uint8_t>(next), 0});
+        else
+            topology.pruneRoutes(rsp.srcAddress, generation);
+    }
+}
@@ -3,6 +3,7 @@
 #include <iomanip>
 #include <thread>
 #include <chrono>
+#include <cstring>
 #include "zdo/ZDOPacketParser.h"
 #include "af/AFPacketParser.h"
 #include "Logger.h"
@@ -10,6 +11,13 @@
 namespace ZStack
 {
     ZStackClient::ZStackClient(const std::string &portName)
+        : availabilityTracker(timerWheel),
+          addressBook(timerWheel, [this](const FrameView &frame) { send(frame); }),
+          outboundQueue([this](const uint8_t *data, size_t size) {
+              clientMetrics.onTransmit(data, size);
+              serialPort->writeBytes(data, size);
+          }),
+          readScheduler(timerWheel, [this](const FrameView &frame) { send(frame); })
     {
         serialPort = std::make_unique<SerialPort>(portName);
         zdoPacketHandler = nullptr;
@@ -31,43 +39,42 @@ namespace ZStack
         serialPort->closePort();
     }
 
+    bool ZStackClient::startCapture(const std::string &tracePath)
+    {
+        if (!serialPort->startCapture(tracePath))
+            return false;
+
+        if (captureFlushTimer == INVALID_TIMER)
+        {
+            int intervalMs = static_cast<int>(TraceWriter::FLUSH_INTERVAL_US / 1000);
+            captureFlushTimer = timerWheel.schedulePeriodic(intervalMs, [this]() { serialPort->flushCapture(); });
+        }
+        return true;
+    }
+
     std::optional<ZStackFrame> ZStackClient::waitForFrame(uint8_t expectedCmd0,
                                                           uint8_t expectedCmd1,
                                                           int timeoutMs)
     {
+        if (reentered("waitForFrame"))
+            return std::nullopt;
+
         auto startTime = std::chrono::steady_clock::now();
-        std::vector<uint8_t> buffer;
 
-        while (std::chrono::steady_clock::now() - startTime < std::chrono::milliseconds(timeoutMs))
-        {
-            int bytes = serialPort->readBytes(buffer);
+        // Everything else that arrives meanwhile is dispatched as usual,
+        // and timers keep firing, so nothing stalls while we wait.
+        SyncWait wait{expectedCmd0, expectedCmd1, std::nullopt};
+        SyncWait *outerWait = activeWait;
+        activeWait = &wait;
 
-            if (bytes > 0)
-            {
-                for (uint8_t byte : buffer)
-                {
-                    // Parse every byte
-                    auto result = parser.parseByte(byte);
-
-                    if (result.has_value())
-                    {
-                        ZStackFrame frame = result.value();
-
-                        // DEBUG: Print what we found so we aren't flying blind
-                        LOG_DEBUG << "[DEBUG] Rx: " << "Length: " << std::hex << std::setw(2) << (int)frame.getPayload().size() << " Cmd0: " << (int)frame.getCommand0()
-                                  << " Cmd1: " << (int)frame.getCommand1() << std::endl;
-
-                        if (frame.getCommand0() == expectedCmd0 &&
-                            frame.getCommand1() == expectedCmd1)
-                        {
-                            return frame;
-                        }
-                    }
-                }
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        while (!wait.result &&
+               std::chrono::steady_clock::now() - startTime < std::chrono::milliseconds(timeoutMs))
+        {
+            pumpOnce();
         }
-        return std::nullopt; // Timeout
+
+        activeWait = outerWait;
+        return wait.result; // std::nullopt on Timeout
     }
 
     std::optional<ZStackFrame> ZStackClient::sendAndWait(
@@ -76,17 +83,207 @@ namespace ZStack
         uint8_t expectedCmd1,
         int timeoutMs)
     {
-        serialPort->writeBytes(request.toSerialBytes());
+        // The caller is blocked on this one
+        ScopedSendPriority scope(*this, SendPriority::INTERACTIVE);
+        send(request);
 
         // Wait
         return waitForFrame(expectedCmd0, expectedCmd1, timeoutMs);
     }
 
+    void ZStackClient::request(
+        const ZStackFrame &request,
+        uint8_t expectedCmd0,
+        uint8_t expectedCmd1,
+        int timeoutMs,
+        std::function<void(const std::optional<ZStackFrame> &)> handler)
+    {
+        expect(expectedCmd0, expectedCmd1, timeoutMs, std::move(handler));
+        send(request);
+    }
+
+    void ZStackClient::expect(
+        uint8_t expectedCmd0,
+        uint8_t expectedCmd1,
+        int timeoutMs,
+        std::function<void(const std::optional<ZStackFrame> &)> handler)
+    {
+        uint32_t id = nextRequestId++;
+
+        PendingRequest pending;
+        pending.cmd0 = expectedCmd0;
+        pending.cmd1 = expectedCmd1;
+        pending.handler = std::move(handler);
+        pending.timer = timerWheel.schedule(timeoutMs, [this, id]() {
+            auto it = pendingRequests.find(id);
+            if (it == pendingRequests.end())
+                return;
+
+            LOG_DEBUG << "Request timed out waiting for "
+                      << getCommandName(it->second.cmd0, it->second.cmd1) << std::endl;
+
+            auto expired = std::move(it->second.handler);
+            pendingRequests.erase(it);
+
+            if (expired)
+                expired(std::nullopt);
+        });
+
+        pendingRequests.emplace(id, std::move(pending));
+    }
+
+    void FrameAwaitable::await_suspend(std::coroutine_handle<> handle)
+    {
+        // Resumed from dispatchFrame() or the timeout, i.e. from process()
+        client.expect(expectedCmd0, expectedCmd1, timeoutMs, [this, handle](const std::optional<ZStackFrame> &frame) {
+            result = frame;
+            handle.resume();
+        });
+
+        if (request)
+            client.send(*request);
+    }
+
+    void ZStackClient::spawn(Task<void> task)
+    {
+        runDetached(this, std::move(task));
+    }
+
+    detail::Detached ZStackClient::runDetached(ZStackClient *client, Task<void> task)
+    {
+        client->runningTasks++;
+        try
+        {
+            co_await std::move(task);
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR << "Background task failed: " << e.what() << std::endl;
+        }
+        client->runningTasks--;
+    }
+
+    void ZStackClient::runFor(int durationMs)
+    {
+        if (reentered("runFor"))
+            return;
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        while (std::chrono::steady_clock::now() - startTime < std::chrono::milliseconds(durationMs))
+        {
+            pumpOnce();
+        }
+    }
+
     void ZStackClient::send(
         const ZStackFrame &request
     )
     {
-        serialPort->writeBytes(request.toSerialBytes());
+        auto bytes = request.toSerialBytes();
+        transmit(bytes.data(), bytes.size());
+    }
+
+    int ZStackClient::transmit(const uint8_t *data, size_t size, AfConfirmHandler onConfirm, int timeoutMs)
+    {
+        // SOF, LEN, CMD0, CMD1, Payload, FCS
+        size_t offset = 0;
+        if (size >= 5 && data[2] == (SREQ | AF) && data[3] == AF_DATA_REQUEST)
+            offset = 4 + 6; // DstAddr(2), DstEp, SrcEp, Cluster(2), TransID
+        else if (size >= 5 && data[2] == (SREQ | AF) && data[3] == AF_DATA_REQUEST_EXT)
+            offset = 4 + 15; // AddrMode, DstAddr(8), DstEp, PanID(2), SrcEp, Cluster(2), TransID
+
+        if (offset == 0 || offset >= size - 1 || size > MAX_MT_FRAME_SIZE)
+        {
+            if (onConfirm)
+                LOG_WARN << "Not an AF data request, nothing will confirm it" << std::endl;
+
+            // Written right away unless the coordinator's budget is used up
+            outboundQueue.push(data, size, sendPriority);
+            return -1;
+        }
+
+        // 1. Our TransID, skipping the ones still waiting for their confirm
+        uint8_t transID = nextTransID++;
+        for (int tries = 0; afConfirms.count(transID) && tries < 256; tries++)
+            transID = nextTransID++;
+
+        uint8_t frame[MAX_MT_FRAME_SIZE];
+        std::memcpy(frame, data, size);
+        frame[size - 1] ^= frame[offset] ^ transID; // FCS is a plain XOR
+        frame[offset] = transID;
+
+        // 2. Someone wants to hear how it went
+        if (onConfirm)
+        {
+            TimerId timer = timerWheel.schedule(timeoutMs, [this, transID]() {
+                auto it = afConfirms.find(transID);
+                if (it == afConfirms.end())
+                    return;
+                auto handler = std::move(it->second.handler);
+                afConfirms.erase(it);
+                handler(std::nullopt);
+            });
+            afConfirms[transID] = AfConfirm{std::move(onConfirm), timer};
+        }
+
+        outboundQueue.push(frame, size, sendPriority);
+        return transID;
+    }
+
+    void ZStackClient::cancelConfirm(uint8_t transID)
+    {
+        auto it = afConfirms.find(transID);
+        if (it == afConfirms.end())
+            return;
+
+        timerWheel.cancel(it->second.timer);
+        afConfirms.erase(it);
+    }
+
+    void ZStackClient::afConfirmed(const ZStackFrame &frame)
+    {
+        // Status, Endpoint, TransID
+        const auto &payload = frame.getPayload();
+        if (payload.size() < 3)
+            return;
+
+        auto it = afConfirms.find(payload[2]);
+        if (it == afConfirms.end())
+            return;
+
+        auto handler = std::move(it->second.handler);
+        timerWheel.cancel(it->second.timer);
+        afConfirms.erase(it);
+        handler(payload[0]);
+    }
+
+    void ZStackClient::send(const FrameView &frame)
+    {
+        if (!frame.valid())
+        {
+            LOG_WARN << "Dropping invalid frame (did it overflow?)" << std::endl;
+            return;
+        }
+
+        transmit(frame.data, frame.size);
+    }
+
+    void ZStackClient::send(const FrameView &frame, SendPriority priority)
+    {
+        ScopedSendPriority scope(*this, priority);
+        send(frame);
+    }
+
+    int ZStackClient::send(const FrameView &frame, AfConfirmHandler onConfirm, int timeoutMs)
+    {
+        if (!frame.valid())
+        {
+            LOG_WARN << "Dropping invalid frame (did it overflow?)" << std::endl;
+            return -1;
+        }
+
+        return transmit(frame.data, frame.size, std::move(onConfirm), timeoutMs);
     }
 
     std::optional<SysVersion> ZStackClient::getSystemVersion(int timeoutMs)
@@ -127,9 +324,17 @@ namespace ZStack
     }
 
     bool ZStackClient::startNetwork()
+    {
+        if (reentered("startNetwork"))
+            return false;
+
+        return runUntilComplete(startNetworkAsync());
+    }
+
+    Task<bool> ZStackClient::startNetworkAsync()
     {
         // 1. Give the bus a moment to breathe after the previous command
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        co_await sleep(100);
 
         // 2. Construct the Payload (Start Delay = 100ms)
         std::vector<uint8_t> payload = {0x64, 0x00};
@@ -143,7 +348,7 @@ namespace ZStack
             LOG_DEBUG << "Attempt " << attempt << " to start network." << std::endl;
 
             // 3. Send Command & Wait for ACK
-            auto ack = sendAndWait(req, SRSP | ZDO, ZDO_STARTUP_FROM_APP, 3000);
+            auto ack = co_await request(req, SRSP | ZDO, ZDO_STARTUP_FROM_APP, 3000);
 
             if (ack)
             {
@@ -154,7 +359,7 @@ namespace ZStack
             else
             {
                 LOG_DEBUG << "No ACK received, retrying..." << std::endl;
-                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+                co_await sleep(500);
             }
         }
 
@@ -162,42 +367,115 @@ namespace ZStack
         if (!commandAccepted)
         {
             LOG_DEBUG << "Failed to accept start network command" << std::endl;
-            return false;
+            co_return false;
         }
 
         LOG_DEBUG << "Waiting for State Change..." << std::endl;
 
         // 3. Try waiting for the Event (Fast path)
-        auto stateMsg = waitForFrame(AREQ | ZDO, ZDO_STATE_CHANGE_IND, 5000);
+        auto stateMsg = co_await waitFor(AREQ | ZDO, ZDO_STATE_CHANGE_IND, 5000);
 
         if (stateMsg)
         {
             uint8_t state = stateMsg->getPayload()[0];
-            if (state == 0x09)
+            if (state == DEV_ZB_COORD)
             {
                 LOG_DEBUG << "Network Started! (Event: Coordinator)" << std::endl;
-                return true;
+                co_return true;
             }
         }
 
         // 4. FALLBACK: Event lost? Poll status directly.
         LOG_DEBUG << "Event timeout. Polling device state..." << std::endl;
-        auto state = getDeviceState();
+        auto state = co_await getDeviceStateAsync();
 
         if (state)
         {
-            LOG_DEBUG << "Polled State: 0x" << std::hex << state->state << std::endl;
-            if (state->state == 0x09)
+            LOG_DEBUG << "Polled State: 0x" << std::hex << (int)state->state << std::endl;
+            if (state->state == DEV_ZB_COORD)
             {
                 LOG_DEBUG << "Network Started! (Polled: Coordinator)" << std::endl;
-                return true;
+                co_return true;
             }
         }
 
+        co_return false;
+    }
+
+    bool ZStackClient::startup(bool forceReset)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        // 1. Warm path: is the dongle already up and running our network?
+        if (!forceReset)
+        {
+            auto version = getSystemVersion(1000);
+            auto state = version ? getDeviceState() : std::nullopt;
+
+            if (state && state->state == DEV_ZB_COORD)
+            {
+                if (isEndpointRegistered(0x01) || registerEndpoint())
+                {
+                    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - startTime);
+                    LOG_INFO << "Warm start: coordinator already running (" << std::dec << elapsed.count() << " ms)" << std::endl;
+                    return true;
+                }
+            }
+
+            LOG_INFO << "Warm start not possible, doing a full start" << std::endl;
+        }
+
+        // 2. Cold path: reset, register, form/resume the network
+        reset();
+
+        if (!registerEndpoint())
+            return false;
+
+        bool started = startNetwork();
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startTime);
+        LOG_INFO << "Cold start " << (started ? "complete" : "failed") << " (" << std::dec << elapsed.count() << " ms)" << std::endl;
+
+        return started;
+    }
+
+    bool ZStackClient::isEndpointRegistered(uint8_t endpoint)
+    {
+        // Ask the coordinator (0x0000) for its own active endpoints
+        std::vector<uint8_t> payload = {0x00, 0x00, 0x00, 0x00};
+        ZStackFrame req(SREQ | ZDO, ZDO_ACTIVE_EP_REQ, payload);
+
+        auto rsp = sendAndWait(req, AREQ | ZDO, ZDO_ACTIVE_EP_RSP, 1000);
+        if (!rsp)
+            return false;
+
+        auto packet = ZDOPacket::parseZStackFrame(*rsp);
+        if (!packet || packet->type != ZDOPacket::ACTIVE_ENDPOINTS)
+            return false;
+
+        const auto &activeEp = static_cast<const ZDOPacket::DeviceActiveEndpointResponse &>(*packet);
+        if (activeEp.status != 0x00)
+            return false;
+
+        for (uint8_t active : activeEp.activeEndpoints)
+        {
+            if (active == endpoint)
+                return true;
+        }
         return false;
     }
 
     std::optional<DeviceState> ZStackClient::getDeviceState()
+    {
+        if (reentered("getDeviceState"))
+            return std::nullopt;
+
+        return runUntilComplete(getDeviceStateAsync());
+    }
+
+    Task<std::optional<DeviceState>> ZStackClient::getDeviceStateAsync()
     {
         LOG_DEBUG << "Getting Device State..." << std::endl;
 
@@ -205,12 +483,13 @@ namespace ZStack
         // This asks the dongle: "Tell me everything about your state"
         ZStackFrame req(SREQ | UTIL, UTIL_GET_DEVICE_INFO);
 
-        auto resp = sendAndWait(req, SRSP | UTIL, UTIL_GET_DEVICE_INFO);
-
-        auto payload = resp->getPayload();
+        auto resp = co_await request(req, SRSP | UTIL, UTIL_GET_DEVICE_INFO);
 
-        if (resp && resp->getPayload().size() > 8)
+        // Status(1) IEEE(8) ShortAddr(2) DeviceType(1) DeviceState(1) ...
+        if (resp && resp->getPayload().size() >= 13)
         {
+            const auto &payload = resp->getPayload();
+
             DeviceState state;
 
             std::vector<uint8_t> ieee_addr;
@@ -229,17 +508,15 @@ namespace ZStack
             state.state = payload[12];
 
             LOG_DEBUG << "Device State Info:" << std::endl;
-            LOG_DEBUG << "  IEEE Address: " << std::endl;
-            for (int i = 7; i >= 0; i--)
-                printf(" %02X", state.iEEE_address[i]);
+            LOG_DEBUG << "  IEEE Address: " << ieeeToString(state.iEEE_address) << std::endl;
             LOG_DEBUG << "  Short Address: 0x" << std::hex << std::setw(4) << std::setfill('0') << state.short_address << std::endl;
-            LOG_DEBUG << "  Device Type: 0x" << std::hex << state.device_type << std::endl;
-            LOG_DEBUG << "  State: 0x" << std::hex << state.state << std::endl;
+            LOG_DEBUG << "  Device Type: 0x" << std::hex << (int)state.device_type << std::endl;
+            LOG_DEBUG << "  State: 0x" << std::hex << (int)state.state << std::endl;
 
-            return state;
+            co_return state;
         }
 
-        return std::nullopt;
+        co_return std::nullopt;
     }
 
     // Add to your ZStackClient class
@@ -271,30 +548,199 @@ namespace ZStack
         send(req);
     }
 
+    bool ZStackClient::writeConfiguration(uint8_t configID, const std::vector<uint8_t> &value)
+    {
+        // ConfigId(1) Len(1) Value(Len)
+        std::vector<uint8_t> payload = {configID, static_cast<uint8_t>(value.size())};
+        payload.insert(payload.end(), value.begin(), value.end());
+
+        ZStackFrame req(SREQ | SAPI, ZB_WRITE_CONFIGURATION, payload);
+        auto rsp = sendAndWait(req, SRSP | SAPI, ZB_WRITE_CONFIGURATION);
+
+        if (!rsp || rsp->getPayload().empty() || rsp->getPayload()[0] != 0x00)
+        {
+            LOG_WARN << "Failed to write configuration item 0x" << std::hex << (int)configID << std::dec << std::endl;
+            return false;
+        }
+        return true;
+    }
+
     void ZStackClient::process()
-    {        
+    {
+        pumpOnce();
+    }
+
+    int ZStackClient::pollDescriptor() const
+    {
+        return serialPort->getFileDescriptor();
+    }
+
+    void ZStackClient::process(bool readable)
+    {
+        pumpOnce(readable);
+    }
+
+    bool ZStackClient::reentered(const char *caller) const
+    {
+        if (!pumping)
+            return false;
+
+        LOG_ERROR << "[Client] " << caller << "() called from a handler, timer or task on the event loop; "
+                  << "it would pump the loop re-entrantly. Use request() / spawn() and co_await instead." << std::endl;
+        return true;
+    }
+
+    void ZStackClient::pumpOnce(bool readPort)
+    {
+        // Everything below runs handlers; none of them may pump again
+        pumping = true;
+
         std::vector<uint8_t> buffer;
 
-        // 1. Read available bytes (Non-blocking)
-        int bytes = serialPort->readBytes(buffer);
+        // 1. Read available bytes (waits up to the port's VTIME when there are none)
+        int bytes = readPort ? serialPort->readBytes(buffer) : 0;
 
         if (bytes > 0)
         {
-            for (uint8_t byte : buffer)
+            // 2. Parse and dispatch whatever they complete
+            ingestBytes(buffer.data(), buffer.size());
+        }
+        else if (bytes < 0)
+        {
+            // Port not open: don't spin
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        // 3. Fire due timers (timeouts, retries, coalesced reads, polling)
+        timerWheel.advance();
+
+        // 4. Work handed back by handlers running on the executor
+        runPosted();
+
+        // 5. Whatever the coordinator has room for now
+        outboundQueue.pump();
+
+        clientMetrics.setQueueDepths(pendingRequests.size(), readScheduler.pendingCount(),
+                                     readScheduler.inFlightCount(), timerWheel.size());
+
+        pumping = false;
+    }
+
+    void ZStackClient::post(std::function<void()> work)
+    {
+        std::lock_guard<std::mutex> lock(postedMutex);
+        posted.push_back(std::move(work));
+    }
+
+    void ZStackClient::runPosted()
+    {
+        std::vector<std::function<void()>> work;
+        {
+            std::lock_guard<std::mutex> lock(postedMutex);
+            if (posted.empty())
+                return;
+            work.swap(posted);
+        }
+
+        for (auto &item : work)
+            item();
+    }
+
+    void ZStackClient::ingestBytes(const uint8_t *data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            auto result = parser.parseByte(data[i]);
+
+            // Did we finish a packet?
+            if (result.has_value())
             {
-                auto result = parser.parseByte(byte);
+                LOG_DEBUG << "[DEBUG] Rx: " << "Length: " << std::hex << std::setw(2) << (int)result->getPayload().size()
+                          << " Cmd0: " << (int)result->getCommand0() << " Cmd1: " << (int)result->getCommand1() << std::endl;
+
+                clientMetrics.onReceive(*result);
+                outboundQueue.onReceive(*result);
+                availabilityTracker.handleFrame(*result);
+                addressBook.handleFrame(*result);
+                if (result->getCommand0() == (AREQ | AF) && result->getCommand1() == AF_DATA_CONFIRM)
+                    afConfirmed(*result);
+                dispatchFrame(result.value());
+            }
+        }
 
-                // 2. Did we finish a packet?
-                if (result.has_value())
-                {
-                    ZStackFrame frame = result.value();
+        clientMetrics.setParserStats(parser.stats());
+    }
 
-                    routeFrameToParser(frame);
+    void ZStackClient::dispatchFrame(const ZStackFrame &frame)
+    {
+        // 1. Someone is blocked in waitForFrame() on exactly this frame
+        if (activeWait && !activeWait->result &&
+            frame.getCommand0() == activeWait->cmd0 && frame.getCommand1() == activeWait->cmd1)
+        {
+            activeWait->result = frame;
+            return;
+        }
 
-                    LOG_DEBUG << ">>> DEBUG PROCESS FRAME FOUND" << std::endl;
-                }
+        // 2. Oldest async request() waiting for it
+        for (auto it = pendingRequests.begin(); it != pendingRequests.end(); ++it)
+        {
+            if (frame.getCommand0() == it->second.cmd0 && frame.getCommand1() == it->second.cmd1)
+            {
+                auto handler = std::move(it->second.handler);
+                timerWheel.cancel(it->second.timer);
+                pendingRequests.erase(it);
+
+                if (handler)
+                    handler(frame);
+                return;
             }
         }
+
+        // 3. Unsolicited: hand it to the packet parsers
+        routeFrameToParser(frame);
+    }
+
+    void ZStackClient::readAttribute(
+        uint16_t targetShortAddr,
+        uint8_t endpoint,
+        uint16_t clusterID,
+        uint16_t attributeID,
+        ZclReadCallback callback)
+    {
+        readScheduler.read(targetShortAddr, endpoint, clusterID, attributeID, std::move(callback));
+    }
+
+    void ZStackClient::readAttribute(
+        uint16_t targetShortAddr,
+        uint8_t endpoint,
+        uint16_t clusterID,
+        uint16_t attributeID,
+        int maxAgeMs,
+        ZclReadCallback callback)
+    {
+        AttributeSnapshot snapshot;
+        if (maxAgeMs > 0 && attributeCache.get(targetShortAddr, endpoint, clusterID, attributeID, snapshot) &&
+            AttributeCache::nowMs() - snapshot.updatedMs <= static_cast<uint64_t>(maxAgeMs))
+        {
+            clientMetrics.onCachedRead();
+            callback(snapshot.toResult(targetShortAddr, endpoint, clusterID, attributeID));
+            return;
+        }
+
+        readScheduler.read(targetShortAddr, endpoint, clusterID, attributeID, std::move(callback));
+    }
+
+    TimerId ZStackClient::pollAttribute(
+        uint16_t targetShortAddr,
+        uint8_t endpoint,
+        uint16_t clusterID,
+        uint16_t attributeID,
+        int intervalMs,
+        ZclReadCallback callback)
+    {
+        return timerWheel.schedulePeriodic(intervalMs, [=, this]() {
+            readScheduler.read(targetShortAddr, endpoint, clusterID, attributeID, callback);
+        });
     }
 
     bool ZStackClient::registerEndpoint()
@@ -352,6 +798,12 @@ namespace ZStack
             LOG_DEBUG << "Endpoint Registered Successfully!" << std::endl;
             return true;
         }
+        else if (payloadSizeValid && ack->getPayload()[0] == 0xB8)
+        {
+            // ZApsDuplicateEntry: still registered from a previous run
+            LOG_DEBUG << "Endpoint Already Registered." << std::endl;
+            return true;
+        }
         else
         {
             LOG_DEBUG << "Failed to register endpoint." << std::endl;
@@ -371,7 +823,7 @@ namespace ZStack
         // The device will just reboot.
         ZStackFrame resetCmd(AREQ | SYS, SYS_RESET_REQ, payload);
 
-        serialPort->writeBytes(resetCmd.toSerialBytes());
+        send(resetCmd);
 
         auto confirmation = waitForFrame(AREQ | SYS, 0x80, 5000);
 
@@ -386,14 +838,16 @@ namespace ZStack
 
         LOG_DEBUG << "Dongle Reset Complete." << std::endl;
 
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        // Let the dongle settle, without going deaf meanwhile
+        runFor(1000);
     }
 
     void ZStackClient::bindDevice(
         uint16_t targetShortAddr,
         const std::vector<uint8_t> &targetIEEE, // The Sensor's IEEE
         uint16_t clusterID,
-        const std::vector<uint8_t> &myIEEE // Your Coordinator's IEEE
+        const std::vector<uint8_t> &myIEEE, // Your Coordinator's IEEE
+        uint8_t sourceEndpoint
     )
     {
         LOG_DEBUG << "Binding Cluster 0x" << std::hex << clusterID << "..." << std::endl;
@@ -412,7 +866,7 @@ namespace ZStack
 
         // 3. Source Endpoint (The Sensor's "Port")
         // Most sensors transmit from Endpoint 1.
-        payload.push_back(0x01);
+        payload.push_back(sourceEndpoint);
 
         // 4. Cluster ID (What data to send? Temp = 0x0402)
         payload.push_back(clusterID & 0xFF);
@@ -447,7 +901,7 @@ namespace ZStack
 
         ZStackFrame req(SREQ | ZDO, ZDO_ACTIVE_EP_REQ, payload);
 
-        auto ack = serialPort->writeBytes(req.toSerialBytes());
+        send(req);
     }
 
     void ZStackClient::fetchSimpleDescriptor(
@@ -472,13 +926,129 @@ namespace ZStack
 
         ZStackFrame req(SREQ | ZDO, ZDO_SIMPLE_DESC_REQ, payload);
 
-        auto ack = serialPort->writeBytes(req.toSerialBytes());
+        send(req);
+    }
+
+    void ZStackClient::fetchNeighborTable(
+        uint16_t targetShortAddr,
+        uint8_t startIndex
+    ) {
+        LOG_DEBUG << "Fetching Neighbor Table of 0x" << std::hex << targetShortAddr
+                  << " from index " << std::dec << (int)startIndex << "..." << std::endl;
+
+        std::vector<uint8_t> payload;
+
+        // 1. Target Address
+        payload.push_back(targetShortAddr & 0xFF);
+        payload.push_back((targetShortAddr >> 8) & 0xFF);
+
+        // 2. First table entry wanted
+        payload.push_back(startIndex);
+
+        ZStackFrame req(SREQ | ZDO, ZDO_MGMT_LQI_REQ, payload);
+
+        send(req);
+    }
+
+    void ZStackClient::fetchRoutingTable(
+        uint16_t targetShortAddr,
+        uint8_t startIndex
+    ) {
+        LOG_DEBUG << "Fetching Routing Table of 0x" << std::hex << targetShortAddr
+                  << " from index " << std::dec << (int)startIndex << "..." << std::endl;
+
+        std::vector<uint8_t> payload;
+
+        payload.push_back(targetShortAddr & 0xFF);
+        payload.push_back((targetShortAddr >> 8) & 0xFF);
+        payload.push_back(startIndex);
+
+        ZStackFrame req(SREQ | ZDO, ZDO_MGMT_RTG_REQ, payload);
+
+        send(req);
+    }
+
+    void ZStackClient::addGroup(uint16_t targetShortAddr, uint8_t endpoint, uint16_t groupID, const std::string &name)
+    {
+        LOG_DEBUG << "Adding 0x" << std::hex << targetShortAddr << " to Group 0x" << groupID << std::endl;
+
+        uint8_t buffer[MAX_MT_FRAME_SIZE];
+        ZclRequestBuilder builder(buffer, sizeof(buffer));
+        send(builder.addGroup({targetShortAddr, endpoint}, nextZclSequence++, groupID, name.c_str()));
+    }
+
+    void ZStackClient::removeGroup(uint16_t targetShortAddr, uint8_t endpoint, uint16_t groupID)
+    {
+        LOG_DEBUG << "Removing 0x" << std::hex << targetShortAddr << " from Group 0x" << groupID << std::endl;
+
+        uint8_t buffer[MAX_MT_FRAME_SIZE];
+        ZclRequestBuilder builder(buffer, sizeof(buffer));
+        send(builder.removeGroup({targetShortAddr, endpoint}, nextZclSequence++, groupID));
+    }
+
+    void ZStackClient::viewGroup(uint16_t targetShortAddr, uint8_t endpoint, uint16_t groupID)
+    {
+        uint8_t buffer[MAX_MT_FRAME_SIZE];
+        ZclRequestBuilder builder(buffer, sizeof(buffer));
+        send(builder.viewGroup({targetShortAddr, endpoint}, nextZclSequence++, groupID));
+    }
+
+    void ZStackClient::getGroupMembership(uint16_t targetShortAddr, uint8_t endpoint)
+    {
+        uint8_t buffer[MAX_MT_FRAME_SIZE];
+        ZclRequestBuilder builder(buffer, sizeof(buffer));
+        send(builder.getGroupMembership({targetShortAddr, endpoint}, nextZclSequence++));
+    }
+
+    void ZStackClient::sendGroupCommand(
+        uint16_t groupID,
+        uint16_t clusterID,
+        uint8_t commandID,
+        const std::vector<uint8_t> &payload
+    ) {
+        LOG_DEBUG << "Group 0x" << std::hex << groupID << " <- Cluster 0x" << clusterID
+                  << " Command 0x" << (int)commandID << std::endl;
+
+        uint8_t buffer[MAX_MT_FRAME_SIZE];
+        ZclRequestBuilder builder(buffer, sizeof(buffer));
+        send(builder.clusterCommand(ZclDestination::group(groupID), clusterID, nextZclSequence++, commandID,
+                                    payload.data(), payload.size()),
+             SendPriority::INTERACTIVE);
+    }
+
+    void ZStackClient::sendBroadcastCommand(
+        uint16_t clusterID,
+        uint8_t commandID,
+        const std::vector<uint8_t> &payload,
+        uint16_t broadcastAddr
+    ) {
+        LOG_DEBUG << "Broadcast 0x" << std::hex << broadcastAddr << " <- Cluster 0x" << clusterID
+                  << " Command 0x" << (int)commandID << std::endl;
+
+        uint8_t buffer[MAX_MT_FRAME_SIZE];
+        ZclRequestBuilder builder(buffer, sizeof(buffer));
+        send(builder.clusterCommand(ZclDestination::broadcast(broadcastAddr), clusterID, nextZclSequence++, commandID,
+                                    payload.data(), payload.size()),
+             SendPriority::INTERACTIVE);
     }
 
     void ZStackClient::routeFrameToParser(const ZStackFrame &frame)
     {
         LOG_DEBUG << "Routing Frame to Parser:" << std::endl;
 
+        // Mesh / application retries of a report we already have: drop before anyone decodes it
+        if (duplicateFilter.isDuplicate(frame))
+        {
+            LOG_DEBUG << "Duplicate AF_INCOMING_MSG dropped" << std::endl;
+            clientMetrics.onDuplicateDropped();
+            return;
+        }
+
+        for (auto &listener : frameListeners)
+        {
+            listener(frame);
+        }
+
         auto command0 = frame.getCommand0();
 
         auto subsystem = command0 & 0x1F;
@@ -488,6 +1058,13 @@ namespace ZStack
         case AF:
         {
             LOG_DEBUG << "AF Frame Detected:" << std::hex << std::setw(2) << (int)subsystem << std::endl;
+
+            // Cache first, so read callbacks already see the new value.
+            // Answers to coalesced reads go to their waiters next; the
+            // readings still flow to the AF handler below.
+            attributeCache.handleFrame(frame);
+            readScheduler.handleFrame(frame);
+
             auto afResponse = AFPacket::parseZStackFrame(frame);
 
             if (afResponse == nullptr)
@@ -501,7 +1078,18 @@ namespace ZStack
 
             if (afResponse && afPacketHandler)
             {
-                afPacketHandler(*afResponse);
+                if (handlerExecutor && afResponse->type == AFPacket::AF_INCOMING_MSG)
+                {
+                    // Same device, same worker: its packets stay in order
+                    uint16_t source = static_cast<const AFPacket::IncomingMessage &>(*afResponse).srcAddress;
+                    std::shared_ptr<AFPacket::Packet> packet = std::move(afResponse);
+                    auto handler = afPacketHandler;
+                    handlerExecutor->submit(source, [handler, packet]() { handler(*packet); });
+                }
+                else
+                {
+                    afPacketHandler(*afResponse);
+                }
             }
             break;
         }
@@ -521,7 +1109,20 @@ namespace ZStack
 
             if (zdoPacketHandler && zdoResponse)
             {
-                zdoPacketHandler(*zdoResponse);
+                if (handlerExecutor)
+                {
+                    // Same device, same shard. Frames that name no device all share one.
+                    uint16_t source = 0;
+                    if (!getZDOSourceAddress(frame.getCommand1(), frame.getPayload(), source))
+                        source = 0;
+                    std::shared_ptr<ZDOPacket::Packet> packet = std::move(zdoResponse);
+                    auto handler = zdoPacketHandler;
+                    handlerExecutor->submit(source, [handler, packet]() { handler(*packet); });
+                }
+                else
+                {
+                    zdoPacketHandler(*zdoResponse);
+                }
             }
             else
             {
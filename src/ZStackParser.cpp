@@ -13,6 +13,8 @@ namespace ZStack {
                     currentState = State::WAITING_LEN;
                     calculateChecksum = 0;
                     incomingPayload.clear();
+                } else {
+                    counters.discardedBytes++;
                 }
                 break;
             case State::WAITING_LEN:
@@ -54,10 +56,12 @@ namespace ZStack {
                 if (calculateChecksum == byte) {
                     // SUCCESS
                     currentState = State::WAITING_START;
+                    counters.frames++;
                     return ZStackFrame(incomingCmd0, incomingCmd1, incomingPayload);
                 } else {
                     // FAILED 
                     LOG_DEBUG << "[ERROR] Checksum Mismatch! Calculated: " << std::hex << (int)calculateChecksum << " Expected: " << (int)byte << std::endl;
+                    counters.checksumErrors++;
 
                     currentState = State::WAITING_START;
                 }
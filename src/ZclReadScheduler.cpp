@@ -0,0 +1,283 @@
+#include "ZclReadScheduler.h"
+#include <iomanip>
+#include <iterator>
+#include "zcl/ZclRequestBuilder.h"
+#include "af/AFPacketParser.h"
+#include "Logger.h"
+
+namespace ZStack
+{
+    ZclReadScheduler::ZclReadScheduler(TimerWheel &timers,
+                                       SendFunction sendFunction,
+                                       int coalesceWindowMs,
+                                       int responseTimeoutMs,
+                                       int maxRetries,
+                                       int retryBackoffMs)
+        : timers(timers),
+          sendFunction(std::move(sendFunction)),
+          coalesceWindowMs(coalesceWindowMs),
+          responseTimeoutMs(responseTimeoutMs),
+          maxRetries(maxRetries),
+          retryBackoffMs(retryBackoffMs),
+          nextSequence(0x40)
+    {
+    }
+
+    ZclReadScheduler::~ZclReadScheduler()
+    {
+        for (auto &entry : pending)
+            timers.cancel(entry.second.timer);
+        for (auto &entry : inFlight)
+            timers.cancel(entry.second.timer);
+    }
+
+    uint64_t ZclReadScheduler::makeKey(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID)
+    {
+        return (static_cast<uint64_t>(shortAddr) << 24) |
+               (static_cast<uint64_t>(endpoint) << 16) |
+               clusterID;
+    }
+
+    void ZclReadScheduler::read(uint16_t shortAddr, uint8_t endpoint, uint16_t clusterID,
+                                uint16_t attributeID, ZclReadCallback callback)
+    {
+        uint64_t key = makeKey(shortAddr, endpoint, clusterID);
+
+        // 1. Already on the air? Just wait for that answer.
+        auto first = inFlight.lower_bound(key << 8);
+        auto last = inFlight.upper_bound((key << 8) | 0xFF);
+        for (auto it = first; it != last; ++it)
+        {
+            auto waiter = it->second.waiters.find(attributeID);
+            if (waiter != it->second.waiters.end())
+            {
+                LOG_DEBUG << "[ReadScheduler] Joining in-flight read of 0x" << std::hex << attributeID
+                          << " on 0x" << shortAddr << std::endl;
+                waiter->second.push_back(std::move(callback));
+                return;
+            }
+        }
+
+        // 2. Otherwise merge into the pending batch for this cluster
+        auto it = pending.find(key);
+        if (it == pending.end())
+        {
+            Batch batch;
+            batch.shortAddr = shortAddr;
+            batch.endpoint = endpoint;
+            batch.clusterID = clusterID;
+            batch.sequence = 0;
+            batch.attempts = 0;
+            batch.timer = timers.schedule(coalesceWindowMs, [this, key]() {
+                auto due = pending.find(key);
+                if (due != pending.end())
+                    flush(due);
+            });
+            it = pending.emplace(key, std::move(batch)).first;
+        }
+
+        it->second.waiters[attributeID].push_back(std::move(callback));
+
+        // 3. Frame is full, no point in waiting for the window
+        if (it->second.waiters.size() >= MAX_ATTRIBUTES_PER_FRAME)
+        {
+            flush(it);
+        }
+    }
+
+    void ZclReadScheduler::flush(std::map<uint64_t, Batch>::iterator it)
+    {
+        Batch batch = std::move(it->second);
+        pending.erase(it);
+        timers.cancel(batch.timer);
+
+        // A retry merged into a pending batch can overflow one frame:
+        // the surplus goes out in a follow-up batch on the next tick
+        if (batch.waiters.size() > MAX_ATTRIBUTES_PER_FRAME)
+        {
+            uint64_t key = makeKey(batch.shortAddr, batch.endpoint, batch.clusterID);
+
+            Batch overflow;
+            overflow.shortAddr = batch.shortAddr;
+            overflow.endpoint = batch.endpoint;
+            overflow.clusterID = batch.clusterID;
+            overflow.sequence = 0;
+            overflow.attempts = 0;
+
+            auto first = std::next(batch.waiters.begin(), MAX_ATTRIBUTES_PER_FRAME);
+            overflow.waiters.insert(std::make_move_iterator(first), std::make_move_iterator(batch.waiters.end()));
+            batch.waiters.erase(first, batch.waiters.end());
+
+            overflow.timer = timers.schedule(0, [this, key]() {
+                auto due = pending.find(key);
+                if (due != pending.end())
+                    flush(due);
+            });
+            pending.emplace(key, std::move(overflow));
+        }
+
+        uint16_t attributeIDs[MAX_ATTRIBUTES_PER_FRAME];
+        size_t count = 0;
+        for (const auto &waiter : batch.waiters)
+        {
+            attributeIDs[count++] = waiter.first;
+        }
+
+        batch.sequence = nextSequence++;
+        batch.attempts++;
+
+        LOG_DEBUG << "[ReadScheduler] Reading " << std::dec << count << " attribute(s) from 0x"
+                  << std::hex << batch.shortAddr << " Cluster 0x" << batch.clusterID
+                  << " Seq 0x" << (int)batch.sequence << std::endl;
+
+        ZclRequestBuilder builder(frameBuffer, sizeof(frameBuffer));
+        ZclDestination dest{batch.shortAddr, batch.endpoint};
+        FrameView request = builder.readAttributes(dest, batch.clusterID, batch.sequence, attributeIDs, count);
+
+        uint64_t key = (makeKey(batch.shortAddr, batch.endpoint, batch.clusterID) << 8) | batch.sequence;
+        batch.timer = timers.schedule(responseTimeoutMs, [this, key]() { timeout(key); });
+        inFlight[key] = std::move(batch);
+
+        sendFunction(request);
+    }
+
+    void ZclReadScheduler::timeout(uint64_t inFlightKey)
+    {
+        auto it = inFlight.find(inFlightKey);
+        if (it == inFlight.end())
+            return;
+
+        Batch batch = std::move(it->second);
+        inFlight.erase(it);
+
+        if (batch.attempts > maxRetries)
+        {
+            LOG_DEBUG << "[ReadScheduler] Read timed out for 0x" << std::hex << batch.shortAddr
+                      << " Cluster 0x" << batch.clusterID << std::endl;
+            fail(batch, ZCL_STATUS_TIMEOUT);
+            return;
+        }
+
+        // Back off 1x, 2x, 4x... then go again. Reads queued meanwhile ride along.
+        int backoffMs = retryBackoffMs << (batch.attempts - 1);
+        LOG_DEBUG << "[ReadScheduler] No answer from 0x" << std::hex << batch.shortAddr
+                  << ", retrying in " << std::dec << backoffMs << " ms" << std::endl;
+
+        uint64_t key = makeKey(batch.shortAddr, batch.endpoint, batch.clusterID);
+        auto queued = pending.find(key);
+        if (queued != pending.end())
+        {
+            for (auto &waiter : batch.waiters)
+            {
+                auto &target = queued->second.waiters[waiter.first];
+                target.insert(target.end(), waiter.second.begin(), waiter.second.end());
+            }
+            queued->second.attempts = batch.attempts;
+            return;
+        }
+
+        batch.timer = timers.schedule(backoffMs, [this, key]() {
+            auto due = pending.find(key);
+            if (due != pending.end())
+                flush(due);
+        });
+        pending.emplace(key, std::move(batch));
+    }
+
+    bool ZclReadScheduler::handleFrame(const ZStackFrame &frame)
+    {
+        if (frame.getCommand0() != (AREQ | AF) || frame.getCommand1() != AF_INCOMING_MSG)
+            return false;
+
+        const auto &p = frame.getPayload();
+
+        // AF_INCOMING_MSG header (17) + ZCL header (3)
+        if (p.size() < 20)
+            return false;
+
+        uint16_t clusterID = p[2] | (p[3] << 8);
+        uint16_t srcAddr = p[4] | (p[5] << 8);
+        uint8_t srcEndpoint = p[6];
+        uint8_t sequence = p[18];
+        uint8_t zclCmd = p[19];
+
+        if (zclCmd != ZCL_READ_ATTRIB_RSP && zclCmd != ZCL_DEFAULT_RSP)
+            return false;
+
+        uint64_t key = (makeKey(srcAddr, srcEndpoint, clusterID) << 8) | sequence;
+        auto it = inFlight.find(key);
+        if (it == inFlight.end())
+            return false;
+
+        // Take the batch out first: callbacks are free to issue new reads
+        Batch batch = std::move(it->second);
+        inFlight.erase(it);
+        timers.cancel(batch.timer);
+
+        if (zclCmd == ZCL_DEFAULT_RSP)
+        {
+            // Default Response: [Command ID][Status], the whole read was refused
+            uint8_t status = p.size() > 21 ? p[21] : 0x01;
+            fail(batch, status == 0x00 ? 0x01 : status);
+            return true;
+        }
+
+        for (auto &record : AFPacket::parseAttributeRecords(zclCmd, p))
+        {
+            ZclReadResult result;
+            result.shortAddr = batch.shortAddr;
+            result.endpoint = batch.endpoint;
+            result.clusterID = batch.clusterID;
+            result.attributeID = record.attributeID;
+            result.status = record.status;
+            result.dataType = record.dataType;
+            result.value = std::move(record.value);
+
+            complete(batch, record.attributeID, result);
+        }
+
+        // Anything the device left out of the response is a failure
+        fail(batch, 0x86); // UNSUPPORTED_ATTRIBUTE
+
+        return true;
+    }
+
+    void ZclReadScheduler::complete(Batch &batch, uint16_t attributeID, const ZclReadResult &result)
+    {
+        auto waiter = batch.waiters.find(attributeID);
+        if (waiter == batch.waiters.end())
+            return;
+
+        auto callbacks = std::move(waiter->second);
+        batch.waiters.erase(waiter);
+
+        for (auto &callback : callbacks)
+        {
+            if (callback)
+                callback(result);
+        }
+    }
+
+    void ZclReadScheduler::fail(Batch &batch, uint8_t status)
+    {
+        auto waiters = std::move(batch.waiters);
+        batch.waiters.clear();
+
+        for (auto &waiter : waiters)
+        {
+            ZclReadResult result;
+            result.shortAddr = batch.shortAddr;
+            result.endpoint = batch.endpoint;
+            result.clusterID = batch.clusterID;
+            result.attributeID = waiter.first;
+            result.status = status;
+            result.dataType = 0x00;
+
+            for (auto &callback : waiter.second)
+            {
+                if (callback)
+                    callback(result);
+            }
+        }
+    }
+}
@@ -12,32 +12,6 @@ using namespace ZStack;
 
 namespace
 {
-    // Returns the length of the data value based on ZCL Data Type
-    // Returns -1 if variable length (like string) or unknown
-    static int getDataTypeLength(uint8_t dataType)
-    {
-        switch (dataType)
-        {
-        case 0x10: // Boolean
-        case 0x18: // Bitmap8
-        case 0x20: // Uint8
-        case 0x30: // Enum8
-            return 1;
-        case 0x21: // Uint16
-        case 0x29: // Int16
-        case 0x19: // Bitmap16
-            return 2;
-        case 0x23: // Uint32
-        case 0x2B: // Int32
-        case 0x39: // Single Precision Float
-            return 4;
-        case 0x42:     // Char String (First byte is length)
-            return -1; // Special handling needed
-        default:
-            return 0; // Unknown
-        }
-    }
-
     std::unique_ptr<AFPacket::DeviceReading> parseDeviceReadingData(uint8_t zclCmd, const uint16_t srcAddr, const uint16_t incomingClusterID, const std::vector<uint8_t> &p)
     {
         // 1. Setup Offsets
@@ -72,7 +46,7 @@ namespace
             currentIndex++; // Move past Type
 
             // Calculate Data Length
-            int dataLength = getDataTypeLength(dataType);
+            int dataLength = getZCLDataTypeLength(dataType);
 
             // Handle Variable Length Strings (0x42)
             if (dataLength == -1)
@@ -194,13 +168,50 @@ namespace AFPacket
                 LOG_DEBUG << ">>> [" << srcAddr << "] ACTION: Button Pressed (Toggle)" << std::endl;
                 auto msg = std::make_unique<IncomingMessage>();
                 msg->srcAddress = srcAddr;
+                msg->srcEndpoint = p[6];
                 msg->clusterID = incomingClusterID;
                 msg->deviceReading = std::make_unique<ButtonPressAction>();
                 return msg;
             }
 
             // ------------------------------------------------
-            // CASE C: SENSOR DATA (Report or Read Response)
+            // CASE C: GROUPS CLUSTER RESPONSE (cluster specific, so before C)
+            // ------------------------------------------------
+            else if (incomingClusterID == ZStack::GROUPS_CLUSTER && (p[dataOffset] & 0x03) == 0x01 &&
+                     p.size() > dataOffset + 3)
+            {
+                auto rsp = std::make_unique<GroupsResponse>();
+                rsp->shortAddr = srcAddr;
+                rsp->command = zclCmd;
+                rsp->status = 0x00;
+                rsp->capacity = 0;
+
+                size_t index = dataOffset + 3;
+                if (zclCmd == ZStack::ZCL_GROUPS_GET_MEMBERSHIP)
+                {
+                    // Capacity, Count, Group IDs
+                    rsp->capacity = p[index];
+                    uint8_t count = index + 1 < p.size() ? p[index + 1] : 0;
+                    for (size_t i = 0, offset = index + 2; i < count && offset + 1 < p.size(); i++, offset += 2)
+                        rsp->groups.push_back(p[offset] | (p[offset + 1] << 8));
+                }
+                else if (index + 2 < p.size())
+                {
+                    // Status, Group ID (View Group adds the name, which we ignore)
+                    rsp->status = p[index];
+                    rsp->groups.push_back(p[index + 1] | (p[index + 2] << 8));
+                }
+
+                auto msg = std::make_unique<IncomingMessage>();
+                msg->srcAddress = srcAddr;
+                msg->srcEndpoint = p[6];
+                msg->clusterID = incomingClusterID;
+                msg->deviceReading = std::move(rsp);
+                return msg;
+            }
+
+            // ------------------------------------------------
+            // CASE D: SENSOR DATA (Report or Read Response)
             // ------------------------------------------------
             else if (zclCmd == 0x0A || zclCmd == 0x01)
             {
@@ -209,6 +220,7 @@ namespace AFPacket
                 {
                     auto msg = std::make_unique<IncomingMessage>();
                     msg->srcAddress = srcAddr;
+                    msg->srcEndpoint = p[6];
                     msg->clusterID = incomingClusterID;
                     msg->deviceReading = std::move(deviceReading);
                     return msg;
@@ -223,4 +235,58 @@ namespace AFPacket
 
         return nullptr;
     }
+
+    std::vector<AttributeRecord> parseAttributeRecords(uint8_t zclCmd, const std::vector<uint8_t> &p)
+    {
+        std::vector<AttributeRecord> records;
+
+        // AF_INCOMING_MSG header (17) + ZCL header (3)
+        size_t currentIndex = 17 + 3;
+
+        while (currentIndex + 2 < p.size())
+        {
+            AttributeRecord record;
+            record.attributeID = p[currentIndex] | (p[currentIndex + 1] << 8);
+            record.status = 0x00;
+            record.dataType = 0x00;
+            currentIndex += 2;
+
+            // Read Responses carry a status byte, failed reads stop right after it
+            if (zclCmd == ZCL_READ_ATTRIB_RSP)
+            {
+                record.status = p[currentIndex];
+                currentIndex++;
+                if (record.status != 0x00)
+                {
+                    records.push_back(record);
+                    continue;
+                }
+            }
+
+            if (currentIndex >= p.size())
+                break;
+
+            record.dataType = p[currentIndex];
+            currentIndex++;
+
+            int dataLength = getZCLDataTypeLength(record.dataType);
+            if (dataLength == -1)
+            {
+                if (currentIndex >= p.size())
+                    break;
+                dataLength = p[currentIndex] + 1;
+            }
+
+            // Unknown type: we can't find the next record, stop here
+            if (dataLength == 0 || currentIndex + dataLength > p.size())
+                break;
+
+            record.value.assign(p.begin() + currentIndex, p.begin() + currentIndex + dataLength);
+            currentIndex += dataLength;
+
+            records.push_back(std::move(record));
+        }
+
+        return records;
+    }
 }
\ No newline at end of file
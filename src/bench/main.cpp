@@ -0,0 +1,414 @@
+// Microbenchmarks for the hot paths: frame encoding, byte parsing, AF / ZDO
+// decoding and the app-level helpers. Not a test: run it before and after a
+// change and compare.
+//
+//   zigbee_bench [--filter NAME] [--min-time-ms MS] [--repeat N] [--capture FILE]
+//
+// --capture feeds Parser::parseByte with recorded traffic instead of the
+// built-in synthetic stream: the RX side of a serial trace (SerialTrace.h,
+// as written by startCapture) or a raw serial dump. Numbers only mean something in an optimised
+// build (cmake -DCMAKE_BUILD_TYPE=Release).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "ZStackFrame.h"
+#include "ZStackParser.h"
+#include "af/AFPacketParser.h"
+#include "zdo/ZDOPacketParser.h"
+#include "DeviceManager.h"
+#include "TemperatureRecorder.h"
+#include "AvailabilityTracker.h"
+#include "Logger.h"
+#include "SerialTrace.h"
+
+using namespace ZStack;
+
+// 1. Allocation counting: every global new in this process goes through here
+static std::atomic<uint64_t> allocationCount{0};
+
+void *operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace
+{
+    // Keeps the optimiser from throwing away results
+    template <typename T>
+    inline void keep(const T &value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    struct Options
+    {
+        std::string filter;
+        int minTimeMs = 200;
+        int repeat = 5;
+        std::string capturePath;
+    };
+
+    struct Result
+    {
+        std::string name;
+        double nsPerItem;
+        double itemsPerSecond;
+        double allocationsPerItem;
+    };
+
+    // Runs body() (which processes itemsPerCall items) until minTimeMs has
+    // passed, `repeat` times, and keeps the median.
+    Result measure(const std::string &name, size_t itemsPerCall, const Options &options,
+                   const std::function<void()> &body)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        // Warm up and find an iteration count worth timing
+        size_t iterations = 1;
+        for (;;)
+        {
+            auto start = Clock::now();
+            for (size_t i = 0; i < iterations; i++)
+                body();
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+            if (elapsed >= options.minTimeMs / 10 || iterations >= (1u << 30))
+            {
+                double scale = elapsed > 0 ? static_cast<double>(options.minTimeMs) / elapsed : 10.0;
+                iterations = std::max<size_t>(1, static_cast<size_t>(iterations * scale));
+                break;
+            }
+            iterations *= 10;
+        }
+
+        std::vector<double> samples;
+        uint64_t allocations = 0;
+        for (int r = 0; r < options.repeat; r++)
+        {
+            uint64_t before = allocationCount.load(std::memory_order_relaxed);
+            auto start = Clock::now();
+            for (size_t i = 0; i < iterations; i++)
+                body();
+            auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            allocations = allocationCount.load(std::memory_order_relaxed) - before;
+            samples.push_back(elapsed / (static_cast<double>(iterations) * itemsPerCall));
+        }
+
+        std::sort(samples.begin(), samples.end());
+        double ns = samples[samples.size() / 2];
+
+        Result result;
+        result.name = name;
+        result.nsPerItem = ns;
+        result.itemsPerSecond = ns > 0 ? 1e9 / ns : 0;
+        result.allocationsPerItem = static_cast<double>(allocations) / (static_cast<double>(iterations) * itemsPerCall);
+        return result;
+    }
+
+    void printResult(const Result &result)
+    {
+        std::cout << std::left << std::setw(34) << result.name << std::right
+                  << std::fixed << std::setprecision(0) << std::setw(14) << result.itemsPerSecond
+                  << std::setprecision(1) << std::setw(12) << result.nsPerItem
+                  << std::setprecision(2) << std::setw(12) << result.allocationsPerItem << std::endl;
+    }
+
+    // 2. Inputs. Fixed seed so every run sees the same bytes.
+
+    ZStackFrame makeReport(uint16_t shortAddr, uint16_t clusterID, uint8_t dataType, uint16_t value, uint8_t seq)
+    {
+        // AF_INCOMING_MSG header (17) + Report Attributes with a single record (8)
+        std::vector<uint8_t> p = {0x00, 0x00,
+                                  static_cast<uint8_t>(clusterID & 0xFF), static_cast<uint8_t>(clusterID >> 8),
+                                  static_cast<uint8_t>(shortAddr & 0xFF), static_cast<uint8_t>(shortAddr >> 8),
+                                  0x01, 0x01, 0x00, 0x9C, 0x00,
+                                  0x10, 0x27, 0x00, 0x00,
+                                  0x00, 0x08,
+                                  0x18, seq, ZCL_REPORT_ATTRIB, 0x00, 0x00, dataType,
+                                  static_cast<uint8_t>(value & 0xFF), static_cast<uint8_t>(value >> 8)};
+        return ZStackFrame(AREQ | AF, AF_INCOMING_MSG, p);
+    }
+
+    ZStackFrame makeAnnounce(uint16_t shortAddr, uint64_t ieee)
+    {
+        std::vector<uint8_t> p = {static_cast<uint8_t>(shortAddr & 0xFF), static_cast<uint8_t>(shortAddr >> 8),
+                                  static_cast<uint8_t>(shortAddr & 0xFF), static_cast<uint8_t>(shortAddr >> 8)};
+        for (int i = 0; i < 8; i++)
+            p.push_back((ieee >> (8 * i)) & 0xFF);
+        p.push_back(0x80);
+        return ZStackFrame(AREQ | ZDO, ZDO_END_DEVICE_ANNCE_IND, p);
+    }
+
+    // Roughly what a busy network looks like on the wire: mostly reports,
+    // the odd data confirm and SRSP.
+    std::vector<ZStackFrame> makeTraffic(size_t count)
+    {
+        std::mt19937 rng(42);
+        std::vector<ZStackFrame> frames;
+        frames.reserve(count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            uint16_t shortAddr = 0x1000 + rng() % 1000;
+            unsigned kind = rng() % 100;
+
+            if (kind < 45)
+                frames.push_back(makeReport(shortAddr, TEMPERATURE_MEASUREMENT_CLUSTER, ZCL_INT16, 2000 + rng() % 500, i & 0xFF));
+            else if (kind < 90)
+                frames.push_back(makeReport(shortAddr, HUMIDITY_MEASUREMENT_CLUSTER, ZCL_UINT16, 4000 + rng() % 2000, i & 0xFF));
+            else if (kind < 95)
+                frames.push_back(ZStackFrame(AREQ | AF, 0x80, {0x00, 0x01, static_cast<uint8_t>(i)}));
+            else
+                frames.push_back(ZStackFrame(SRSP | AF, AF_DATA_REQUEST, {0x00}));
+        }
+        return frames;
+    }
+
+    std::vector<uint8_t> serialize(const std::vector<ZStackFrame> &frames)
+    {
+        std::vector<uint8_t> stream;
+        for (const auto &frame : frames)
+        {
+            auto bytes = frame.toSerialBytes();
+            stream.insert(stream.end(), bytes.begin(), bytes.end());
+        }
+        return stream;
+    }
+
+    std::vector<uint8_t> loadCapture(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        // A serial trace: only what the dongle sent goes through the parser
+        if (bytes.size() < 4 || std::string(bytes.begin(), bytes.begin() + 4) != "ZSTR")
+            return bytes;
+
+        TraceReader reader;
+        if (!reader.open(path))
+        {
+            std::cerr << path << " looks like a serial trace but its header is not one this build reads" << std::endl;
+            return {};
+        }
+
+        std::vector<uint8_t> stream;
+        TraceRecord record;
+        while (reader.next(record))
+        {
+            if (record.direction == TraceDirection::RX)
+                stream.insert(stream.end(), record.data.begin(), record.data.end());
+        }
+        return stream;
+    }
+
+    size_t countFrames(const std::vector<uint8_t> &stream)
+    {
+        Parser parser;
+        size_t frames = 0;
+        for (uint8_t byte : stream)
+        {
+            if (parser.parseByte(byte))
+                frames++;
+        }
+        return frames;
+    }
+
+    std::string ieeeString(uint64_t ieee)
+    {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llX", static_cast<unsigned long long>(ieee));
+        return text;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--filter" && hasValue)
+            options.filter = argv[++i];
+        else if (arg == "--min-time-ms" && hasValue)
+            options.minTimeMs = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--repeat" && hasValue)
+            options.repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--capture" && hasValue)
+            options.capturePath = argv[++i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--filter NAME] [--min-time-ms MS] [--repeat N] [--capture FILE]" << std::endl;
+            return 1;
+        }
+    }
+
+    // The decoders log at DEBUG / INFO, we only want the numbers
+    Logger::setLevel(LogLevel::NONE);
+
+    const size_t TRAFFIC_FRAMES = 1000;
+    const size_t DEVICE_COUNT = 1000;
+
+    auto traffic = makeTraffic(TRAFFIC_FRAMES);
+    std::vector<ZStackFrame> reports;
+    for (const auto &frame : traffic)
+    {
+        if (frame.getCommand1() == AF_INCOMING_MSG)
+            reports.push_back(frame);
+    }
+
+    std::vector<ZStackFrame> announcements;
+    for (size_t i = 0; i < 256; i++)
+        announcements.push_back(makeAnnounce(0x1000 + i, 0x00124B0000000000ULL + i));
+
+    std::vector<uint8_t> stream = options.capturePath.empty() ? serialize(traffic) : loadCapture(options.capturePath);
+    size_t streamFrames = countFrames(stream);
+    if (streamFrames == 0)
+    {
+        std::cerr << "No frames found in the input stream" << std::endl;
+        return 1;
+    }
+
+    // DeviceManager persists to disk, give it a scratch file of its own
+    std::string scratch = "/tmp/zigbee_bench_" + std::to_string(getpid());
+    std::string deviceFile = scratch + "_devices.txt";
+    std::string readingsFile = scratch + "_readings.txt";
+    {
+        std::ofstream file(deviceFile);
+        for (size_t i = 0; i < DEVICE_COUNT; i++)
+            file << ieeeString(0x00124B0000000000ULL + i) << "," << std::hex << (0x1000 + i) << ",Sensor " << std::dec << i << "\n";
+    }
+    // Every report refreshes its sender's last-seen time
+    TimerWheel timers;
+    AvailabilityTracker availability(timers);
+
+    std::streambuf *coutBuffer = std::cout.rdbuf(nullptr); // DeviceManager prints on load
+    DeviceManager deviceManager(deviceFile);
+    TemperatureRecorder recorder(readingsFile);
+    std::cout.rdbuf(coutBuffer);
+
+    std::vector<std::pair<std::string, std::function<Result()>>> benchmarks = {
+        {"ZStackFrame::toSerialBytes", [&]() {
+             return measure("ZStackFrame::toSerialBytes", traffic.size(), options, [&]() {
+                 for (const auto &frame : traffic)
+                 {
+                     auto bytes = frame.toSerialBytes();
+                     keep(bytes);
+                 }
+             });
+         }},
+        {"Parser::parseByte", [&]() {
+             return measure("Parser::parseByte", streamFrames, options, [&]() {
+                 Parser parser;
+                 for (uint8_t byte : stream)
+                 {
+                     auto frame = parser.parseByte(byte);
+                     keep(frame);
+                 }
+             });
+         }},
+        {"AFPacket::parseZStackFrame", [&]() {
+             return measure("AFPacket::parseZStackFrame", reports.size(), options, [&]() {
+                 for (const auto &frame : reports)
+                 {
+                     auto packet = AFPacket::parseZStackFrame(frame);
+                     keep(packet);
+                 }
+             });
+         }},
+        {"AFPacket::parseAttributeRecords", [&]() {
+             return measure("AFPacket::parseAttributeRecords", reports.size(), options, [&]() {
+                 for (const auto &frame : reports)
+                 {
+                     auto records = AFPacket::parseAttributeRecords(ZCL_REPORT_ATTRIB, frame.getPayload());
+                     keep(records);
+                 }
+             });
+         }},
+        {"ZDOPacket::parseZStackFrame", [&]() {
+             return measure("ZDOPacket::parseZStackFrame", announcements.size(), options, [&]() {
+                 for (const auto &frame : announcements)
+                 {
+                     auto packet = ZDOPacket::parseZStackFrame(frame);
+                     keep(packet);
+                 }
+             });
+         }},
+        {"AvailabilityTracker::handleFrame", [&]() {
+             return measure("AvailabilityTracker::handleFrame", reports.size(), options, [&]() {
+                 for (const auto &frame : reports)
+                     availability.handleFrame(frame);
+                 keep(availability.onlineCount());
+             });
+         }},
+        {"DeviceManager::getName", [&]() {
+             return measure("DeviceManager::getName", DEVICE_COUNT, options, [&]() {
+                 for (size_t i = 0; i < DEVICE_COUNT; i++)
+                 {
+                     auto name = deviceManager.getName(static_cast<uint16_t>(0x1000 + i));
+                     keep(name);
+                 }
+             });
+         }},
+        {"DeviceManager::getIEEE", [&]() {
+             return measure("DeviceManager::getIEEE", DEVICE_COUNT, options, [&]() {
+                 for (size_t i = 0; i < DEVICE_COUNT; i++)
+                 {
+                     auto ieee = deviceManager.getIEEE(static_cast<uint16_t>(0x1000 + i));
+                     keep(ieee);
+                 }
+             });
+         }},
+        {"TemperatureRecorder::save", [&]() {
+             return measure("TemperatureRecorder::save", 100, options, [&]() {
+                 for (int i = 0; i < 100; i++)
+                     recorder.saveTemperatureReading(21.5f + i * 0.01f);
+             });
+         }},
+    };
+
+#ifndef __OPTIMIZE__
+    std::cout << "Warning: unoptimised build, configure with -DCMAKE_BUILD_TYPE=Release" << std::endl;
+#endif
+    std::cout << "Input: " << streamFrames << " frames / " << stream.size() << " bytes"
+              << (options.capturePath.empty() ? " (synthetic)" : " (" + options.capturePath + ")") << std::endl
+              << std::endl;
+    std::cout << std::left << std::setw(34) << "Benchmark" << std::right
+              << std::setw(14) << "items/s" << std::setw(12) << "ns/item" << std::setw(12) << "allocs/item" << std::endl;
+
+    for (const auto &benchmark : benchmarks)
+    {
+        if (!options.filter.empty() && benchmark.first.find(options.filter) == std::string::npos)
+            continue;
+        printResult(benchmark.second());
+    }
+
+    std::remove(deviceFile.c_str());
+    std::remove(readingsFile.c_str());
+    return 0;
+}
@@ -4,12 +4,29 @@
 #include "TemperatureRecorder.h"
 #include <thread>
 #include <chrono>
+#include <fstream>
 #include "AFDataRequest.h"
+#include "DeviceInterviewer.h"
+#include "DeviceCatalogue.h"
+#include "ReportingTuner.h"
+#include "ReadingPublisher.h"
+#include "CoordinatorManager.h"
+#include "ReadingFilter.h"
+#include "TopologyScanner.h"
+#include "SleepyMailbox.h"
+#include "OtaServer.h"
 #include "Logger.h"
 
 using namespace std;
 using namespace ZStack; // Use our Namespace
 
+// DeviceManager key: 16 upper case hex digits
+std::string ieeeString(uint64_t ieee) {
+    std::stringstream out;
+    out << std::hex << std::uppercase << std::setw(16) << std::setfill('0') << ieee;
+    return out.str();
+}
+
 void printIEEE(const std::vector<uint8_t>& ieee) {
     LOG_DEBUG << "IEEE: ";
     for (size_t i = 0; i < ieee.size(); i++) {
@@ -39,36 +56,167 @@ string getStateName(uint8_t state) {
 #include "ZStackClient.h"
 #include "DeviceManager.h" // <--- Include this
 
-int main() {
+int main(int argc, char* argv[]) {
     Logger::setLevel(LogLevel::DEBUG);
 
     // 1. Setup Database
     DeviceManager deviceDB("devices.txt");
     TemperatureRecorder tempRecorder("temperature_readings.txt");
 
+    // Every decoded reading also goes to /dev/shm/zigbee_readings (see zigbee_tail)
+    ReadingPublisher readings;
+    readings.open("zigbee_readings");
+
+    // Only store temperatures that moved, or a heartbeat every 15 minutes
+    FilterRule temperatureRule;
+    temperatureRule.deadband = 0.2;            // C
+    temperatureRule.minIntervalMs = 30000;
+    temperatureRule.heartbeatMs = 15 * 60000;
+    ReadingFilter storageFilter;
+    storageFilter.setRule(ClusterID::TEMPERATURE_MEASUREMENT_CLUSTER, 0x0000, temperatureRule);
+
     // 2. Connect to Hardware
-    ZStackClient client("/dev/ttyUSB0");
-    if (!client.connect()) {
+    // One or more ports, comma separated (one coordinator each), e.g. the
+    // PTYs printed by zigbee_sim. Each dongle runs its own PAN.
+    std::string ports = argc > 1 ? argv[1] : "/dev/ttyUSB0";
+    CoordinatorManager coordinators;
+    std::stringstream portList(ports);
+    std::string port;
+    while (std::getline(portList, port, ',')) {
+        CoordinatorConfig config;
+        config.port = port;
+
+        // Optional raw traffic capture, replay it later with zigbee_replay
+        if (argc > 2) {
+            config.capturePath = argv[2];
+            if (ports.find(',') != std::string::npos) {
+                config.capturePath += "." + std::to_string(coordinators.size());
+            }
+        }
+        coordinators.addCoordinator(config);
+    }
+
+    // 3. Initialize Zigbee Stack
+    // Skips the reset when a dongle is already running our network
+    if (coordinators.startAll() == 0) {
         std::cerr << "Failed to connect to Serial Port" << std::endl;
         return -1;
     }
 
-    // 3. Initialize Zigbee Stack
-    client.reset();
-    client.registerEndpoint();
-    client.startNetwork();
-    std::vector<uint8_t> myIEEE = client.getDeviceState()->iEEE_address;
-    printIEEE(myIEEE);
-    
-    // 4. Open Network for Joining
-    client.permitJoin(60); 
+    // 4. Interviews run in the background, a few devices at a time (per coordinator).
+    //    Known models skip discovery and get their reporting from the catalogue.
+    DeviceCatalogue catalogue;
+    std::vector<std::unique_ptr<DeviceInterviewer>> interviewers(coordinators.size());
+    std::vector<std::unique_ptr<TopologyScanner>> scanners(coordinators.size());
+    std::vector<std::unique_ptr<SleepyMailbox>> mailboxes(coordinators.size());
+    std::vector<std::unique_ptr<OtaServer>> otaServers(coordinators.size());
+    std::vector<std::unique_ptr<ReportingTuner>> tuners(coordinators.size());
+    for (size_t i = 0; i < coordinators.size(); i++) {
+        if (!coordinators.isUp(i)) continue;
+
+        printIEEE(coordinators.coordinatorIEEE(i));
+        interviewers[i] = std::make_unique<DeviceInterviewer>(coordinators.client(i), coordinators.coordinatorIEEE(i));
+        interviewers[i]->setCatalogue(&catalogue);
+        interviewers[i]->setCompletionHandler([&, i](const InterviewResult& result) {
+            LOG_INFO << ">>> [Interview] 0x" << std::hex << result.shortAddr
+                     << (result.model.empty() ? "" : " (" + result.model + ")")
+                     << (result.success ? " ready, " : " failed, ")
+                     << std::dec << result.boundClusters.size() << " cluster(s) reporting" << std::endl;
+
+            // Offline after missing 3 of the reports it was just configured for
+            if (result.reportIntervalS > 0) {
+                coordinators.client(i).availability().setReportInterval(result.shortAddr, result.reportIntervalS * 1000);
+            }
+
+            // What it was configured with is what the tuner slows down from
+            if (tuners[i]) {
+                for (const auto& setup : result.reporting) {
+                    tuners[i]->track(result.shortAddr, setup.endpoint, setup.clusterID, setup.config);
+                }
+            }
+
+            // Refresh the cached group membership of every endpoint that has one
+            for (const auto& endpoint : result.endpoints) {
+                for (uint16_t cluster : endpoint.inputClusters) {
+                    if (cluster == GROUPS_CLUSTER) coordinators.client(i).getGroupMembership(result.shortAddr, endpoint.endpoint);
+                }
+            }
+        });
+        // A device that comes back under a new short address keeps its name;
+        // state kept per short address no longer applies
+        coordinators.client(i).addresses().setChangeHandler([&, i](uint64_t ieee, uint16_t oldShortAddr, uint16_t newShortAddr) {
+            deviceDB.addDevice(ieeeString(ieee), newShortAddr);
+            coordinators.client(i).availability().forget(oldShortAddr);
+            coordinators.client(i).attributes().forget(oldShortAddr);
+            if (mailboxes[i]) mailboxes[i]->forget(oldShortAddr);
+            if (tuners[i]) tuners[i]->forget(oldShortAddr);
+        });
+
+        // The database does not say which PAN a device is on, so it only seeds a lone coordinator
+        if (coordinators.size() == 1) {
+            // DeviceManager::load() already skipped rows with a malformed IEEE
+            for (const auto& [shortAddr, ieee] : deviceDB.getAddressMap()) {
+                coordinators.client(i).addresses().learn(shortAddr, std::stoull(ieee, nullptr, 16));
+            }
+        }
+
+        coordinators.client(i).availability().setHandler([i](uint16_t shortAddr, bool online) {
+            LOG_INFO << ">>> [Availability] #" << i << " 0x" << std::hex << shortAddr << std::dec
+                     << (online ? " is online" : " went OFFLINE") << std::endl;
+        });
+
+        // 5. Metrics for Prometheus (node_exporter textfile collector)
+        std::string metricsFile = i == 0 ? "zigbee_metrics.prom" : "zigbee_metrics_" + std::to_string(i) + ".prom";
+        ZStackClient& client = coordinators.client(i);
+        client.timers().schedulePeriodic(10000, [&client, metricsFile]() {
+            client.metrics().writePrometheusFile(metricsFile);
+        });
+
+        // 6. Mesh map every 30 minutes, paced so it never gets in the way of reports
+        std::string topologyFile = i == 0 ? "zigbee_topology.dot" : "zigbee_topology_" + std::to_string(i) + ".dot";
+        scanners[i] = std::make_unique<TopologyScanner>(client);
+        scanners[i]->setCompletionHandler([i, topologyFile](const TopologyGraph& graph) {
+            std::ofstream(topologyFile) << graph.toDot();
+            for (const auto& link : graph.weakLinks(60)) {
+                LOG_WARN << ">>> [Topology] #" << i << " weak link 0x" << std::hex << link.from << " -> 0x"
+                         << link.to << std::dec << " (LQI " << (int)link.lqi << ")" << std::endl;
+            }
+        });
+        scanners[i]->schedulePeriodic(30 * 60 * 1000);
+
+        // Commands for battery devices wait here until they wake up
+        mailboxes[i] = std::make_unique<SleepyMailbox>(client);
+
+        // Reports from the whole mesh held to 5 frames/s, rebalanced every 5 minutes
+        tuners[i] = std::make_unique<ReportingTuner>(client, 5.0, 5 * 60 * 1000, mailboxes[i].get());
+
+        // Firmware updates for devices that ask, from ./ota
+        otaServers[i] = std::make_unique<OtaServer>(client);
+        if (otaServers[i]->loadDirectory("ota") > 0) {
+            otaServers[i]->setCompletionHandler([i](uint16_t shortAddr, const OtaImage& image, bool success) {
+                LOG_INFO << ">>> [OTA] #" << i << " 0x" << std::hex << shortAddr
+                         << (success ? " upgraded to 0x" : " failed upgrading to 0x") << image.fileVersion
+                         << std::dec << std::endl;
+            });
+        }
+    }
+    coordinators.addFrameListener([&](size_t coordinator, const ZStackFrame& frame) {
+        if (interviewers[coordinator]) interviewers[coordinator]->handleFrame(frame);
+        if (scanners[coordinator]) scanners[coordinator]->handleFrame(frame);
+        if (mailboxes[coordinator]) mailboxes[coordinator]->handleFrame(frame);
+        if (otaServers[coordinator]) otaServers[coordinator]->handleFrame(frame);
+        if (tuners[coordinator]) tuners[coordinator]->handleFrame(frame);
+    });
+
+    // 7. Open Network for Joining (on the least loaded coordinator)
+    coordinators.permitJoin(60);
 
     LOG_INFO << "--- Main Loop Started ---" << std::endl;
     auto startTime = std::chrono::steady_clock::now();
     auto timeout = 100;
 
 
-    client.setZdoPacketHandler([&](const ZDOPacket::Packet& packet) {
+    coordinators.setZdoPacketHandler([&](size_t coordinator, const ZDOPacket::Packet& packet) {
         if (packet.type == ZDOPacket::DEVICE_ANNOUNCEMENT) {
             auto devAnnce = static_cast<const ZDOPacket::DeviceAnnouncementResponse&>(packet);
             LOG_INFO << ">>> [ZDO] Device Announcement Received: ";
@@ -76,24 +224,22 @@ int main() {
             LOG_INFO << " IEEE=" << std::hex << devAnnce.ieeeAddress;
             LOG_INFO << " Type: " << devAnnce.type << "\n";
 
-            client.fetchActiveEndpoints(devAnnce.srcAddress);
+            deviceDB.addDevice(ieeeString(devAnnce.ieeeAddress), devAnnce.networkAddress);
+            mailboxes[coordinator]->setSleepy(devAnnce.networkAddress, !devAnnce.rxOnWhenIdle());
+
             // Get Device Capabilities
+            interviewers[coordinator]->interview(devAnnce.networkAddress, devAnnce.ieeeAddress);
         } else if (packet.type == ZDOPacket::ACTIVE_ENDPOINTS) {
             auto activeEp = static_cast<const ZDOPacket::DeviceActiveEndpointResponse&>(packet);
             LOG_INFO << ">>> [ZDO] Active Endpoints for ShortAddr=" 
                       << std::hex << activeEp.srcAddress 
                       << ": ";
 
-            printIEEE(myIEEE);
-            size_t activeIndex = 0;
-
             if (activeEp.activeEndpoints.size() > 0) {
                 for (auto ep : activeEp.activeEndpoints) {
                     LOG_INFO << std::hex << (int)ep << " ";
                 }
                 LOG_INFO << std::dec << std::endl;  
-                client.fetchSimpleDescriptor(activeEp.srcAddress, activeEp.activeEndpoints[activeIndex++]);
-                std::this_thread::sleep_for(std::chrono::milliseconds(200));
             } else {
                 LOG_INFO << "No Active Endpoints Found" << std::dec << std::endl;
             }            
@@ -112,6 +258,11 @@ int main() {
                 LOG_INFO << std::hex << cid << " ";
             }
             LOG_INFO << "]" << std::dec << std::endl;
+        } else if (packet.type == ZDOPacket::TC_DEVICE_INDICATION) {
+            auto indication = static_cast<const ZDOPacket::TrustCenterDeviceIndication&>(packet);
+            LOG_INFO << ">>> [ZDO] Trust Center admitted IEEE=" << std::hex << indication.ieeeAddress
+                     << " as ShortAddr=" << indication.networkAddress
+                     << " via Parent=" << indication.parentAddress << std::dec << std::endl;
         } else if (packet.type == ZDOPacket::BIND_RESPONSE) {
             auto bindResp = static_cast<const ZDOPacket::BindRequestResponse&>(packet);
             LOG_INFO << ">>> [ZDO] Bind Response from ShortAddr=" 
@@ -120,7 +271,7 @@ int main() {
         }
     });
 
-    client.setAfPacketHandler([&](const AFPacket::Packet& packet) {
+    coordinators.setAfPacketHandler([&](size_t coordinator, const AFPacket::Packet& packet) {
         LOG_DEBUG << ">>> [AF] Incoming Message from " << std::hex << (int) packet.type << std::endl;
         
         if (packet.type == AFPacket::AF_INCOMING_MSG) {
@@ -128,22 +279,44 @@ int main() {
             LOG_DEBUG << ">>> [AF] Incoming Message from " 
                       << std::hex << (int) incomingMsg.srcAddress 
                       << " (Cluster " << std::hex << (int) incomingMsg.clusterID << ")" << std::endl;
+
+            // NWK addresses are per PAN, so ask the coordinator it came through
+            uint64_t ieee = coordinators.ieeeOf(coordinator, incomingMsg.srcAddress);
+            readings.publish(incomingMsg, ieee);
+
+            // Groups cluster answers keep the membership cache current
+            if (incomingMsg.deviceReading->type == AFPacket::GROUPS_RESPONSE) {
+                auto& groups = static_cast<const AFPacket::GroupsResponse&>(*incomingMsg.deviceReading);
+                if (groups.command == ZCL_GROUPS_GET_MEMBERSHIP) {
+                    deviceDB.setGroups(ieeeString(ieee), groups.groups);
+                } else if (groups.command == ZCL_GROUPS_ADD && !groups.groups.empty() &&
+                           (groups.status == 0x00 || groups.status == 0x8A)) { // 0x8A: already a member
+                    deviceDB.addToGroup(ieeeString(ieee), groups.groups[0]);
+                } else if (groups.command == ZCL_GROUPS_REMOVE && !groups.groups.empty()) {
+                    deviceDB.removeFromGroup(ieeeString(ieee), groups.groups[0]);
+                }
+            }
+
             // Save to Temperature Recorder
             if (incomingMsg.deviceReading->type == AFPacket::TEMPERATURE_SENSOR) {
                 auto& tempReading = static_cast<const AFPacket::TemperatureReading&>(*incomingMsg.deviceReading);
                 LOG_DEBUG << "    Temperature: " << std::fixed << std::setprecision(2) 
                           << tempReading.temperatureReading << " C" << std::endl;
             
-                tempRecorder.saveTemperatureReading(tempReading.temperatureReading);
+                // Unknown devices have no filter state yet: store everything
+                int slot = deviceDB.getSlot(ieee);
+                uint64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+                if (slot < 0 || storageFilter.accept(slot, incomingMsg.clusterID, 0x0000, tempReading.temperatureReading, nowMs)) {
+                    tempRecorder.saveTemperatureReading(tempReading.temperatureReading);
+                }
             }
         }
     });
 
+    // process() waits on the serial ports itself
     while(true) {
-        client.process();
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
+        coordinators.process();
     }
     
     return 0;
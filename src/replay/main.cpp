@@ -0,0 +1,155 @@
+// Replays a serial trace captured with SerialPort::startCapture through the
+// full receive path: Parser -> dispatch -> packet parsers -> handlers.
+//
+//   zigbee_replay TRACE [--realtime] [--speed X] [--verbose]
+//
+// By default RX bytes are fed as fast as possible, which makes a recorded
+// night of traffic a repeatable throughput / latency benchmark. --realtime
+// honours the recorded timing (scaled by --speed) so timers behave as they
+// did in the field. TX records are counted but not replayed.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ZStackClient.h"
+#include "SerialTrace.h"
+#include "Logger.h"
+
+using namespace ZStack;
+
+int main(int argc, char *argv[])
+{
+    std::string tracePath;
+    bool realtime = false;
+    double speed = 1.0;
+    LogLevel level = LogLevel::NONE;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--realtime")
+            realtime = true;
+        else if (arg == "--speed" && i + 1 < argc)
+            speed = std::max(0.001, std::atof(argv[++i]));
+        else if (arg == "--verbose")
+            level = LogLevel::DEBUG;
+        else if (tracePath.empty() && arg[0] != '-')
+            tracePath = arg;
+        else
+        {
+            tracePath.clear();
+            break;
+        }
+    }
+
+    if (tracePath.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " TRACE [--realtime] [--speed X] [--verbose]" << std::endl;
+        return 1;
+    }
+
+    TraceReader reader;
+    if (!reader.open(tracePath))
+        return 1;
+
+    Logger::setLevel(level);
+
+    // 1. A client that is never connected: bytes only come in through ingestBytes
+    ZStackClient client("replay");
+
+    uint64_t frames = 0;
+    uint64_t afPackets = 0;
+    uint64_t zdoPackets = 0;
+    uint64_t readings = 0;
+    std::map<std::pair<uint8_t, uint8_t>, uint64_t> frameCounts;
+
+    client.addFrameListener([&](const ZStackFrame &frame) {
+        frames++;
+        frameCounts[{frame.getCommand0(), frame.getCommand1()}]++;
+    });
+    client.setAfPacketHandler([&](const AFPacket::Packet &packet) {
+        afPackets++;
+        if (packet.type == AFPacket::AF_INCOMING_MSG &&
+            static_cast<const AFPacket::IncomingMessage &>(packet).deviceReading)
+            readings++;
+    });
+    client.setZdoPacketHandler([&](const ZDOPacket::Packet &) { zdoPackets++; });
+
+    // 2. Feed the RX side
+    uint64_t rxRecords = 0;
+    uint64_t txRecords = 0;
+    uint64_t rxBytes = 0;
+    uint64_t lastTimestampUs = 0;
+    std::vector<double> latenciesNs;
+
+    auto start = std::chrono::steady_clock::now();
+    TraceRecord record;
+
+    while (reader.next(record))
+    {
+        lastTimestampUs = record.timestampUs;
+
+        if (record.direction != TraceDirection::RX)
+        {
+            txRecords++;
+            continue;
+        }
+
+        if (realtime)
+        {
+            auto due = start + std::chrono::microseconds(static_cast<uint64_t>(record.timestampUs / speed));
+            std::this_thread::sleep_until(due);
+            client.timers().advance();
+        }
+
+        auto before = std::chrono::steady_clock::now();
+        client.ingestBytes(record.data.data(), record.data.size());
+        auto after = std::chrono::steady_clock::now();
+
+        latenciesNs.push_back(std::chrono::duration<double, std::nano>(after - before).count());
+        rxRecords++;
+        rxBytes += record.data.size();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // 3. Report
+    Logger::setLevel(LogLevel::INFO);
+    std::sort(latenciesNs.begin(), latenciesNs.end());
+    auto percentile = [&](double p) {
+        if (latenciesNs.empty())
+            return 0.0;
+        size_t index = std::min(latenciesNs.size() - 1, static_cast<size_t>(p * latenciesNs.size()));
+        return latenciesNs[index];
+    };
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "Trace:      " << tracePath << " (" << lastTimestampUs / 1e6 << " s recorded)" << std::endl
+              << "Records:    " << rxRecords << " RX / " << txRecords << " TX, " << rxBytes << " RX bytes" << std::endl
+              << "Frames:     " << frames << " (" << afPackets << " AF, " << zdoPackets << " ZDO, "
+              << readings << " readings)" << std::endl
+              << "Replay:     " << std::setprecision(3) << seconds << " s, "
+              << std::setprecision(0) << (seconds > 0 ? frames / seconds : 0) << " frames/s, "
+              << std::setprecision(2) << (seconds > 0 ? rxBytes / seconds / 1e6 : 0) << " MB/s" << std::endl
+              << "Per read:   p50 " << std::setprecision(0) << percentile(0.50) << " ns, p99 " << percentile(0.99)
+              << " ns, max " << (latenciesNs.empty() ? 0 : latenciesNs.back()) << " ns" << std::endl;
+
+    std::cout << std::endl << "Top frames:" << std::endl;
+    std::vector<std::pair<uint64_t, std::pair<uint8_t, uint8_t>>> top;
+    for (const auto &entry : frameCounts)
+        top.emplace_back(entry.second, entry.first);
+    std::sort(top.rbegin(), top.rend());
+    for (size_t i = 0; i < top.size() && i < 10; i++)
+    {
+        std::cout << "  " << std::setw(10) << top[i].first << "  "
+                  << getCommandName(top[i].second.first, top[i].second.second) << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,1167 @@
+#include "CoordinatorSimulator.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include "Logger.h"
+
+namespace ZStack
+{
+    namespace
+    {
+        void putU16(std::vector<uint8_t> &out, uint16_t value)
+        {
+            out.push_back(value & 0xFF);
+            out.push_back((value >> 8) & 0xFF);
+        }
+
+        void putU64(std::vector<uint8_t> &out, uint64_t value)
+        {
+            for (int i = 0; i < 8; i++)
+                out.push_back((value >> (8 * i)) & 0xFF);
+        }
+
+        uint16_t getU16(const std::vector<uint8_t> &p, size_t offset)
+        {
+            return p[offset] | (p[offset + 1] << 8);
+        }
+
+        const uint16_t FIRST_DEVICE_ADDR = 0x1000;
+        const uint64_t DEVICE_IEEE_BASE = 0x00124B0000000000ULL;
+        const uint8_t DEVICE_ENDPOINT = 0x01;
+        const uint8_t MT_RPC_ERR_SUBSYSTEM = 0x01;
+        const uint8_t MT_RPC_ERR_COMMAND_ID = 0x02;
+        const size_t ROUTER_SPACING = 8;
+        const size_t LQI_PAGE_SIZE = 3;
+        const size_t RTG_PAGE_SIZE = 6;
+        const int INDIRECT_TIMEOUT_MS = 7680; // Z-Stack's default indirect message timeout
+        const int AWAKE_AFTER_REPORT_MS = 300;
+        const uint32_t CHECK_IN_EVERY = 4;    // Sleepy devices check in every few wakes
+        const uint16_t OTA_MANUFACTURER = 0x1234;
+        const uint16_t OTA_IMAGE_TYPE = 0x0101;
+        const uint32_t OTA_QUERY_EVERY = 20;   // Reports between Query Next Image requests
+        const uint8_t OTA_BLOCK_SIZE = 64;
+
+        void putU32(std::vector<uint8_t> &p, uint32_t value)
+        {
+            for (int i = 0; i < 4; i++)
+                p.push_back((value >> (8 * i)) & 0xFF);
+        }
+
+        uint32_t getU32(const std::vector<uint8_t> &p, size_t offset)
+        {
+            return p[offset] | (p[offset + 1] << 8) | (p[offset + 2] << 16) |
+                   (static_cast<uint32_t>(p[offset + 3]) << 24);
+        }
+
+        // Stable, made up link quality between two nodes
+        uint8_t linkQuality(uint16_t a, uint16_t b)
+        {
+            uint32_t h = (static_cast<uint32_t>(std::min(a, b)) << 16 | std::max(a, b)) * 2654435761u;
+            return static_cast<uint8_t>(40 + (h >> 24) % 216);
+        }
+    }
+
+    CoordinatorSimulator::CoordinatorSimulator(const SimulatorConfig &config)
+        : config(config),
+          masterFd(-1),
+          running(false),
+          rng(0x5EED),
+          state(DEV_HOLD),
+          coordinatorIEEE(0x00124B00DEADBEEFULL + config.firstDevice),
+          txBudget(0),
+          framesIn(0),
+          framesOut(0),
+          reportsOut(0),
+          bytesOut(0)
+    {
+        devices.reserve(config.deviceCount);
+        for (size_t i = 0; i < config.deviceCount; i++)
+        {
+            VirtualDevice device;
+            device.shortAddr = static_cast<uint16_t>(FIRST_DEVICE_ADDR + i);
+            device.ieee = DEVICE_IEEE_BASE + config.firstDevice + i;
+            device.temperature = 2000 + static_cast<int16_t>(rng() % 500);
+            device.humidity = 4000 + static_cast<uint16_t>(rng() % 2000);
+            device.sequence = 0;
+            device.announced = false;
+            devices.push_back(device);
+        }
+    }
+
+    CoordinatorSimulator::~CoordinatorSimulator()
+    {
+        if (!config.linkPath.empty())
+            unlink(config.linkPath.c_str());
+        if (masterFd >= 0)
+            close(masterFd);
+    }
+
+    bool CoordinatorSimulator::open()
+    {
+        // 1. Grab a pseudo-terminal pair, the driver opens the slave side
+        masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+        if (masterFd < 0 || grantpt(masterFd) != 0 || unlockpt(masterFd) != 0)
+        {
+            LOG_ERROR << "[Sim] Unable to allocate a PTY: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        const char *name = ptsname(masterFd);
+        if (!name)
+            return false;
+        slaveName = name;
+
+        // 2. Raw on our side too, otherwise 0x0A / 0x0D get mangled
+        struct termios tty;
+        if (tcgetattr(masterFd, &tty) == 0)
+        {
+            cfmakeraw(&tty);
+            tcsetattr(masterFd, TCSANOW, &tty);
+        }
+
+        int flags = fcntl(masterFd, F_GETFL, 0);
+        fcntl(masterFd, F_SETFL, flags | O_NONBLOCK);
+
+        // 3. Stable name for scripts (e.g. /tmp/ttyZigbeeSim)
+        if (!config.linkPath.empty())
+        {
+            unlink(config.linkPath.c_str());
+            if (symlink(slaveName.c_str(), config.linkPath.c_str()) != 0)
+            {
+                LOG_WARN << "[Sim] Unable to link " << config.linkPath << ": " << strerror(errno) << std::endl;
+                config.linkPath.clear();
+            }
+        }
+
+        // 4. Spread the first reports over one interval so the load is even
+        auto now = Clock::now();
+        for (size_t i = 0; i < devices.size(); i++)
+        {
+            int interval = std::max(config.reportIntervalMs, 1);
+            int offset = config.jitter ? static_cast<int>(rng() % interval)
+                                       : static_cast<int>((static_cast<uint64_t>(interval) * i) / devices.size());
+            reports.push({now + std::chrono::milliseconds(offset), i, TEMPERATURE_MEASUREMENT_CLUSTER});
+            reports.push({now + std::chrono::milliseconds(offset + interval / 2), i, HUMIDITY_MEASUREMENT_CLUSTER});
+        }
+
+        lastBudgetUpdate = now;
+        return true;
+    }
+
+    void CoordinatorSimulator::run(int durationMs)
+    {
+        running = true;
+
+        auto start = Clock::now();
+        auto nextStats = start + std::chrono::milliseconds(config.statsIntervalMs);
+        uint64_t lastFramesOut = 0;
+        uint8_t readBuffer[512];
+
+        while (running)
+        {
+            auto now = Clock::now();
+            if (durationMs > 0 && now - start >= std::chrono::milliseconds(durationMs))
+                break;
+
+            // 1. Work out how long we can sleep
+            int waitMs = 100;
+            if (!reports.empty() && state == DEV_ZB_COORD)
+            {
+                auto due = std::chrono::duration_cast<std::chrono::milliseconds>(reports.top().due - now).count();
+                waitMs = std::min<int>(waitMs, std::max<int>(static_cast<int>(due), 0));
+            }
+            for (const auto &entry : delayed)
+            {
+                auto due = std::chrono::duration_cast<std::chrono::milliseconds>(entry.first - now).count();
+                waitMs = std::min<int>(waitMs, std::max<int>(static_cast<int>(due), 0));
+            }
+            if (!txQueue.empty())
+                waitMs = std::min(waitMs, 1);
+
+            struct pollfd pfd = {masterFd, POLLIN, 0};
+            poll(&pfd, 1, waitMs);
+
+            // 2. Host -> coordinator
+            if (pfd.revents & POLLIN)
+            {
+                ssize_t n;
+                while ((n = read(masterFd, readBuffer, sizeof(readBuffer))) > 0)
+                {
+                    for (ssize_t i = 0; i < n; i++)
+                    {
+                        auto frame = parser.parseByte(readBuffer[i]);
+                        if (frame)
+                        {
+                            framesIn++;
+                            handleFrame(*frame);
+                        }
+                    }
+                }
+            }
+
+            now = Clock::now();
+
+            // 3. Deferred answers (AREQs that follow an SRSP)
+            if (!delayed.empty())
+            {
+                auto ready = std::stable_partition(delayed.begin(), delayed.end(),
+                                                   [&](const auto &entry) { return entry.first <= now; });
+                std::vector<std::pair<Clock::time_point, ZStackFrame>> due(delayed.begin(), ready);
+                delayed.erase(delayed.begin(), ready);
+                for (const auto &entry : due)
+                    send(entry.second);
+            }
+
+            // 4. Sensor reports, only once the network is up
+            while (state == DEV_ZB_COORD && !reports.empty() && reports.top().due <= now)
+            {
+                Report report = reports.top();
+                reports.pop();
+                emitReport(report);
+
+                report.due += std::chrono::milliseconds(std::max(config.reportIntervalMs, 1));
+                if (report.due < now)
+                    report.due = now; // Fell behind, don't burst to catch up
+                reports.push(report);
+            }
+
+            // 5. Unicasts nobody polled for in time
+            if (indirectCount > 0)
+                expireIndirect(now);
+
+            flushTx(now);
+
+            if (config.statsIntervalMs > 0 && now >= nextStats)
+            {
+                double seconds = config.statsIntervalMs / 1000.0;
+                uint64_t sent = framesOut - lastFramesOut;
+                lastFramesOut = framesOut;
+                printStats(sent / seconds);
+                nextStats = now + std::chrono::milliseconds(config.statsIntervalMs);
+            }
+        }
+
+        running = false;
+    }
+
+    void CoordinatorSimulator::handleFrame(const ZStackFrame &frame)
+    {
+        uint8_t type = frame.getCommand0() & 0xE0;
+        uint8_t subsystem = frame.getCommand0() & 0x1F;
+
+        switch (subsystem)
+        {
+        case SYS:
+            handleSys(frame);
+            return;
+        case UTIL:
+            handleUtil(frame);
+            return;
+        case ZDO:
+            handleZdo(frame);
+            return;
+        case AF:
+            handleAf(frame);
+            return;
+        case SAPI:
+            if (frame.getCommand1() == ZB_WRITE_CONFIGURATION)
+            {
+                // Accepted and forgotten: the virtual network never re-forms
+                send(ZStackFrame(SRSP | SAPI, ZB_WRITE_CONFIGURATION, {0x00}));
+                return;
+            }
+            break;
+        }
+
+        // Unknown subsystem: RPC error, just like the real firmware
+        if (type == SREQ)
+            send(ZStackFrame(SRSP | 0x00, 0x00, {MT_RPC_ERR_SUBSYSTEM, frame.getCommand0(), frame.getCommand1()}));
+    }
+
+    void CoordinatorSimulator::handleSys(const ZStackFrame &frame)
+    {
+        switch (frame.getCommand1())
+        {
+        case SYS_RESET_REQ:
+            // Soft reset: everything volatile is gone, SYS_RESET_IND after boot
+            state = DEV_HOLD;
+            endpoints.clear();
+            delayed.clear();
+            sendLater(200, ZStackFrame(AREQ | SYS, 0x80, {0x00, 0x02, 0x01, 0x02, 0x07, 0x01}));
+            return;
+
+        case SYS_PING:
+            // Capabilities: SYS, AF, ZDO, UTIL
+            send(ZStackFrame(SRSP | SYS, SYS_PING, {0x59, 0x00}));
+            return;
+
+        case SYS_VERSION:
+            // Transport, Product, Major, Minor, Maint, Revision (4)
+            send(ZStackFrame(SRSP | SYS, SYS_VERSION, {0x02, 0x01, 0x02, 0x07, 0x01, 0x5C, 0x63, 0x34, 0x01}));
+            return;
+        }
+
+        send(ZStackFrame(SRSP | 0x00, 0x00, {MT_RPC_ERR_COMMAND_ID, frame.getCommand0(), frame.getCommand1()}));
+    }
+
+    void CoordinatorSimulator::handleUtil(const ZStackFrame &frame)
+    {
+        if (frame.getCommand1() == UTIL_GET_DEVICE_INFO)
+        {
+            // Status, IEEE(8), ShortAddr(2), DeviceType, DeviceState, NumAssocDevices
+            std::vector<uint8_t> payload = {0x00};
+            putU64(payload, coordinatorIEEE);
+            putU16(payload, 0x0000);
+            payload.push_back(0x07);
+            payload.push_back(state);
+            payload.push_back(0x00);
+            send(ZStackFrame(SRSP | UTIL, UTIL_GET_DEVICE_INFO, payload));
+            return;
+        }
+
+        send(ZStackFrame(SRSP | 0x00, 0x00, {MT_RPC_ERR_COMMAND_ID, frame.getCommand0(), frame.getCommand1()}));
+    }
+
+    void CoordinatorSimulator::handleZdo(const ZStackFrame &frame)
+    {
+        const auto &p = frame.getPayload();
+
+        switch (frame.getCommand1())
+        {
+        case ZDO_STARTUP_FROM_APP:
+        {
+            // 0x00 = restored network state, the state walk follows as AREQs
+            send(ZStackFrame(SRSP | ZDO, ZDO_STARTUP_FROM_APP, {0x00}));
+            if (state != DEV_ZB_COORD)
+            {
+                state = DEV_ZB_COORD;
+                sendLater(50, ZStackFrame(AREQ | ZDO, ZDO_STATE_CHANGE_IND, {DEV_NWK_DISC}));
+                sendLater(300, ZStackFrame(AREQ | ZDO, ZDO_STATE_CHANGE_IND, {DEV_ZB_COORD}));
+            }
+            return;
+        }
+
+        case ZDO_MGMT_PERMIT_JOIN_REQ:
+        {
+            send(ZStackFrame(SRSP | ZDO, ZDO_MGMT_PERMIT_JOIN_REQ, {0x00}));
+            sendLater(10, ZStackFrame(AREQ | ZDO, ZDO_ASYNC_MGMT_PERMIT_JOIN_REQ, {0x00, 0x00, 0x00}));
+
+            if (config.announceOnPermitJoin && p.size() >= 4 && p[3] > 0)
+            {
+                for (auto &device : devices)
+                {
+                    if (!device.announced)
+                        announce(device);
+                }
+            }
+            return;
+        }
+
+        case ZDO_IEEE_ADDR_REQ:
+        case ZDO_NWK_ADDR_REQ:
+        {
+            bool byShort = frame.getCommand1() == ZDO_IEEE_ADDR_REQ;
+            if (p.size() < (byShort ? 2u : 8u))
+                break;
+
+            send(ZStackFrame(SRSP | ZDO, frame.getCommand1(), {0x00}));
+
+            // ShortAddr(2) / IEEE(8), ReqType, StartIndex
+            uint16_t nwkAddr = byShort ? getU16(p, 0) : 0xFFFE;
+            uint64_t ieee = 0;
+            for (int i = 7; !byShort && i >= 0; i--)
+                ieee = (ieee << 8) | p[i];
+
+            VirtualDevice *device = byShort ? findDevice(nwkAddr) : nullptr;
+            for (size_t i = 0; !byShort && i < devices.size() && !device; i++)
+                device = devices[i].ieee == ieee ? &devices[i] : nullptr;
+
+            // Status, IEEE(8), NwkAddr(2), StartIndex, NumAssocDev. Failures echo the question.
+            std::vector<uint8_t> rsp;
+            rsp.push_back(device ? 0x00 : 0x81); // ZDP_DEVICE_NOT_FOUND
+            putU64(rsp, device ? device->ieee : ieee);
+            putU16(rsp, device ? device->shortAddr : nwkAddr);
+            rsp.push_back(0x00);
+            rsp.push_back(0x00);
+            sendLater(20, ZStackFrame(AREQ | ZDO, byShort ? ZDO_IEEE_ADDR_RSP : ZDO_NWK_ADDR_RSP, rsp));
+            return;
+        }
+
+        case ZDO_ACTIVE_EP_REQ:
+        {
+            if (p.size() < 4)
+                break;
+
+            uint16_t nwkAddr = getU16(p, 2);
+            send(ZStackFrame(SRSP | ZDO, ZDO_ACTIVE_EP_REQ, {0x00}));
+
+            // SrcAddr(2), Status, NwkAddr(2), Count, Endpoints...
+            std::vector<uint8_t> rsp;
+            putU16(rsp, nwkAddr);
+            if (nwkAddr == 0x0000)
+            {
+                rsp.push_back(0x00);
+                putU16(rsp, nwkAddr);
+                rsp.push_back(static_cast<uint8_t>(endpoints.size()));
+                rsp.insert(rsp.end(), endpoints.begin(), endpoints.end());
+            }
+            else if (findDevice(nwkAddr))
+            {
+                rsp.push_back(0x00);
+                putU16(rsp, nwkAddr);
+                rsp.push_back(0x01);
+                rsp.push_back(DEVICE_ENDPOINT);
+            }
+            else
+            {
+                rsp.push_back(0x80); // ZDP_INVALID_REQTYPE (device not found)
+                putU16(rsp, nwkAddr);
+                rsp.push_back(0x00);
+            }
+            sendLater(20, ZStackFrame(AREQ | ZDO, ZDO_ACTIVE_EP_RSP, rsp));
+            return;
+        }
+
+        case ZDO_SIMPLE_DESC_REQ:
+        {
+            if (p.size() < 5)
+                break;
+
+            uint16_t nwkAddr = getU16(p, 2);
+            uint8_t endpoint = p[4];
+            send(ZStackFrame(SRSP | ZDO, ZDO_SIMPLE_DESC_REQ, {0x00}));
+
+            // SrcAddr(2), Status, NwkAddr(2), Len, Endpoint, Profile(2), DeviceID(2), Version,
+            // InCount, InClusters..., OutCount, OutClusters...
+            std::vector<uint8_t> rsp;
+            putU16(rsp, nwkAddr);
+            if (findDevice(nwkAddr) && endpoint == DEVICE_ENDPOINT)
+            {
+                const uint16_t inClusters[] = {0x0000, BATTERY_LEVEL_CLUSTER, GROUPS_CLUSTER,
+                                               TEMPERATURE_MEASUREMENT_CLUSTER, HUMIDITY_MEASUREMENT_CLUSTER};
+                rsp.push_back(0x00);
+                putU16(rsp, nwkAddr);
+                rsp.push_back(8 + sizeof(inClusters));
+                rsp.push_back(endpoint);
+                putU16(rsp, 0x0104); // Home Automation
+                putU16(rsp, 0x0302); // Temperature Sensor
+                rsp.push_back(0x00);
+                rsp.push_back(sizeof(inClusters) / sizeof(inClusters[0]));
+                for (uint16_t cluster : inClusters)
+                    putU16(rsp, cluster);
+                rsp.push_back(0x00);
+            }
+            else
+            {
+                rsp.push_back(0x82); // ZDP_INVALID_EP
+                putU16(rsp, nwkAddr);
+                rsp.push_back(0x00);
+            }
+            sendLater(20, ZStackFrame(AREQ | ZDO, ZDO_SIMPLE_DESC_RSP, rsp));
+            return;
+        }
+
+        case ZDO_MGMT_LQI_REQ:
+        case ZDO_MGMT_RTG_REQ:
+        {
+            if (p.size() < 3)
+                break;
+
+            uint16_t dstAddr = getU16(p, 0);
+            uint8_t startIndex = p[2];
+            bool lqi = frame.getCommand1() == ZDO_MGMT_LQI_REQ;
+            send(ZStackFrame(SRSP | ZDO, frame.getCommand1(), {0x00}));
+
+            // SrcAddr(2), Status, Total, StartIndex, Count, Entries...
+            std::vector<uint8_t> rsp;
+            putU16(rsp, dstAddr);
+            if (isRouter(dstAddr))
+            {
+                auto table = lqi ? neighborTable(dstAddr) : routingTable(dstAddr);
+                size_t pageSize = lqi ? LQI_PAGE_SIZE : RTG_PAGE_SIZE;
+                size_t count = startIndex < table.size() ? std::min(pageSize, table.size() - startIndex) : 0;
+
+                rsp.push_back(0x00);
+                rsp.push_back(static_cast<uint8_t>(table.size()));
+                rsp.push_back(startIndex);
+                rsp.push_back(static_cast<uint8_t>(count));
+                for (size_t i = startIndex; i < startIndex + count; i++)
+                    rsp.insert(rsp.end(), table[i].begin(), table[i].end());
+            }
+            else
+            {
+                rsp.push_back(0x84); // ZDP_NOT_SUPPORTED: end devices keep no tables
+            }
+            sendLater(30, ZStackFrame(AREQ | ZDO, lqi ? ZDO_MGMT_LQI_RSP : ZDO_MGMT_RTG_RSP, rsp));
+            return;
+        }
+
+        case ZDO_BIND_REQ:
+        {
+            if (p.size() < 2)
+                break;
+
+            uint16_t dstAddr = getU16(p, 0);
+            send(ZStackFrame(SRSP | ZDO, ZDO_BIND_REQ, {0x00}));
+
+            std::vector<uint8_t> rsp;
+            putU16(rsp, dstAddr);
+            rsp.push_back(findDevice(dstAddr) ? 0x00 : 0x84); // ZDP_NOT_SUPPORTED
+            sendLater(20, ZStackFrame(AREQ | ZDO, ZDO_BIND_RSP, rsp));
+            return;
+        }
+        }
+
+        send(ZStackFrame(SRSP | ZDO, frame.getCommand1(), {0x02})); // Invalid parameter
+    }
+
+    void CoordinatorSimulator::handleAf(const ZStackFrame &frame)
+    {
+        const auto &p = frame.getPayload();
+
+        if (frame.getCommand1() == AF_REGISTER)
+        {
+            if (p.empty())
+                return;
+
+            // 0xB8 = ZApsDuplicateEntry, the driver treats it as success
+            bool duplicate = !endpoints.insert(p[0]).second;
+            send(ZStackFrame(SRSP | AF, AF_REGISTER, {static_cast<uint8_t>(duplicate ? 0xB8 : 0x00)}));
+            return;
+        }
+
+        if (frame.getCommand1() == AF_DATA_REQUEST)
+        {
+            handleDataRequest(frame);
+            return;
+        }
+
+        if (frame.getCommand1() == AF_DATA_REQUEST_EXT)
+        {
+            handleDataRequestExt(frame);
+            return;
+        }
+
+        send(ZStackFrame(SRSP | 0x00, 0x00, {MT_RPC_ERR_COMMAND_ID, frame.getCommand0(), frame.getCommand1()}));
+    }
+
+    void CoordinatorSimulator::handleDataRequest(const ZStackFrame &frame)
+    {
+        const auto &p = frame.getPayload();
+
+        // DstAddr(2), DstEp, SrcEp, Cluster(2), TransID, Options, Radius, Len, Data
+        if (p.size() < 10)
+        {
+            send(ZStackFrame(SRSP | AF, AF_DATA_REQUEST, {0x02}));
+            return;
+        }
+
+        uint16_t dstAddr = getU16(p, 0);
+        uint8_t dstEndpoint = p[2];
+        uint8_t srcEndpoint = p[3];
+        uint16_t clusterID = getU16(p, 4);
+        uint8_t transID = p[6];
+        uint8_t len = p[9];
+
+        send(ZStackFrame(SRSP | AF, AF_DATA_REQUEST, {0x00}));
+
+        // AF_DATA_CONFIRM: Status, Endpoint, TransID
+        VirtualDevice *device = findDevice(dstAddr);
+        if (!device)
+        {
+            sendLater(5, ZStackFrame(AREQ | AF, AF_DATA_CONFIRM, {0xCD, srcEndpoint, transID})); // NWK_NO_ROUTE
+            return;
+        }
+
+        std::vector<uint8_t> zcl;
+        if (p.size() >= 10u + len)
+            zcl.assign(p.begin() + 10, p.begin() + 10 + len);
+        unicast(*device, srcEndpoint, transID, dstEndpoint, clusterID, zcl);
+    }
+
+    void CoordinatorSimulator::handleDataRequestExt(const ZStackFrame &frame)
+    {
+        const auto &p = frame.getPayload();
+
+        // DstAddrMode, DstAddr(8), DstEp, DstPanID(2), SrcEp, Cluster(2), TransID, Options, Radius, Len(2), Data
+        if (p.size() < 20)
+        {
+            send(ZStackFrame(SRSP | AF, AF_DATA_REQUEST_EXT, {0x02}));
+            return;
+        }
+
+        uint8_t addrMode = p[0];
+        uint16_t dstAddr = getU16(p, 1);
+        uint8_t dstEndpoint = p[9];
+        uint8_t srcEndpoint = p[12];
+        uint16_t clusterID = getU16(p, 13);
+        uint8_t transID = p[15];
+        uint16_t len = getU16(p, 18);
+
+        send(ZStackFrame(SRSP | AF, AF_DATA_REQUEST_EXT, {0x00}));
+
+        std::vector<uint8_t> zcl;
+        if (p.size() >= 20u + len)
+            zcl.assign(p.begin() + 20, p.begin() + 20 + len);
+
+        if (addrMode == AF_ADDR_GROUP || addrMode == AF_ADDR_BROADCAST)
+        {
+            // Confirmed once it is on the air; members don't acknowledge
+            sendLater(5, ZStackFrame(AREQ | AF, AF_DATA_CONFIRM, {0x00, srcEndpoint, transID}));
+
+            for (auto &device : devices)
+            {
+                if (!device.announced || (addrMode == AF_ADDR_GROUP && !device.groups.count(dstAddr)))
+                    continue;
+                handleZcl(device, addrMode == AF_ADDR_GROUP || dstEndpoint == 0xFF ? DEVICE_ENDPOINT : dstEndpoint,
+                          clusterID, zcl, false);
+            }
+            return;
+        }
+
+        VirtualDevice *device = addrMode == AF_ADDR_16BIT ? findDevice(dstAddr) : nullptr;
+        if (!device)
+        {
+            sendLater(5, ZStackFrame(AREQ | AF, AF_DATA_CONFIRM, {0xCD, srcEndpoint, transID}));
+            return;
+        }
+        unicast(*device, srcEndpoint, transID, dstEndpoint, clusterID, zcl);
+    }
+
+    bool CoordinatorSimulator::asleep(const VirtualDevice &device, Clock::time_point now)
+    {
+        // Devices poll fast for the length of a firmware download
+        return config.sleepy && !isRouter(device.shortAddr) && !device.otaActive && now >= device.awakeUntil;
+    }
+
+    void CoordinatorSimulator::unicast(VirtualDevice &device, uint8_t srcEndpoint, uint8_t transID,
+                                       uint8_t dstEndpoint, uint16_t clusterID, const std::vector<uint8_t> &zcl)
+    {
+        auto now = Clock::now();
+        if (asleep(device, now))
+        {
+            // The parent keeps it until the device polls, or the indirect timeout
+            device.indirect.push_back(
+                {now + std::chrono::milliseconds(INDIRECT_TIMEOUT_MS), srcEndpoint, transID, dstEndpoint, clusterID, zcl});
+            indirectCount++;
+            return;
+        }
+
+        sendLater(5, ZStackFrame(AREQ | AF, AF_DATA_CONFIRM, {0x00, srcEndpoint, transID}));
+        handleZcl(device, dstEndpoint, clusterID, zcl);
+    }
+
+    void CoordinatorSimulator::wake(VirtualDevice &device, Clock::time_point now)
+    {
+        device.wakes++;
+        device.awakeUntil = std::max(device.awakeUntil, now + std::chrono::milliseconds(AWAKE_AFTER_REPORT_MS));
+
+        // Poll Control check-in: cluster specific, server -> client, disable default response
+        if (device.wakes % CHECK_IN_EVERY == 0)
+            sendIncoming(device, POLL_CONTROL_CLUSTER, {0x19, device.sequence++, ZCL_POLL_CHECK_IN});
+
+        // Data poll: the parent hands over what it kept
+        std::vector<Indirect> held;
+        held.swap(device.indirect);
+        indirectCount -= held.size();
+        for (const auto &message : held)
+        {
+            bool expired = message.expires <= now;
+            sendLater(5, ZStackFrame(AREQ | AF, AF_DATA_CONFIRM, {static_cast<uint8_t>(expired ? 0xF0 : 0x00), // MAC_TRANSACTION_EXPIRED
+                                                       message.srcEndpoint, message.transID}));
+            if (!expired)
+                handleZcl(device, message.dstEndpoint, message.clusterID, message.zcl);
+        }
+    }
+
+    void CoordinatorSimulator::expireIndirect(Clock::time_point now)
+    {
+        for (auto &device : devices)
+        {
+            auto expired = std::stable_partition(device.indirect.begin(), device.indirect.end(),
+                                                 [&](const Indirect &message) { return message.expires > now; });
+            for (auto it = expired; it != device.indirect.end(); ++it)
+                send(ZStackFrame(AREQ | AF, AF_DATA_CONFIRM, {0xF0, it->srcEndpoint, it->transID}));
+
+            indirectCount -= device.indirect.end() - expired;
+            device.indirect.erase(expired, device.indirect.end());
+        }
+    }
+
+    void CoordinatorSimulator::handleZcl(VirtualDevice &device, uint8_t endpoint, uint16_t clusterID,
+                                         const std::vector<uint8_t> &zcl, bool respond)
+    {
+        if (zcl.size() < 3 || endpoint != DEVICE_ENDPOINT)
+            return;
+
+        // Cluster specific commands: only Groups, Poll Control and OTA Upgrade are understood
+        if ((zcl[0] & 0x03) == 0x01)
+        {
+            if (clusterID == GROUPS_CLUSTER)
+                handleGroups(device, zcl, respond);
+            else if (clusterID == POLL_CONTROL_CLUSTER)
+                handlePollControl(device, zcl);
+            else if (clusterID == OTA_UPGRADE_CLUSTER && config.ota)
+                handleOta(device, zcl);
+            return;
+        }
+
+        // Otherwise only global (profile wide) commands
+        if ((zcl[0] & 0x03) != 0x00 || !respond)
+            return;
+
+        uint8_t sequence = zcl[1];
+        uint8_t command = zcl[2];
+
+        // Server -> client, disable default response
+        std::vector<uint8_t> rsp = {0x18, sequence};
+
+        if (command == ZCL_READ_ATTRIB_REQ)
+        {
+            rsp.push_back(ZCL_READ_ATTRIB_RSP);
+            for (size_t i = 3; i + 1 < zcl.size(); i += 2)
+            {
+                uint16_t attributeID = zcl[i] | (zcl[i + 1] << 8);
+                putU16(rsp, attributeID);
+
+                if (attributeID == 0x0000 && clusterID == TEMPERATURE_MEASUREMENT_CLUSTER)
+                {
+                    rsp.push_back(0x00);
+                    rsp.push_back(ZCL_INT16);
+                    putU16(rsp, static_cast<uint16_t>(device.temperature));
+                }
+                else if (attributeID == 0x0000 && clusterID == HUMIDITY_MEASUREMENT_CLUSTER)
+                {
+                    rsp.push_back(0x00);
+                    rsp.push_back(ZCL_UINT16);
+                    putU16(rsp, device.humidity);
+                }
+                else if ((attributeID == ZCL_BASIC_MANUFACTURER_NAME || attributeID == ZCL_BASIC_MODEL_IDENTIFIER) &&
+                         clusterID == BASIC_CLUSTER)
+                {
+                    // Every virtual device passes for a SNZB-02
+                    std::string text = attributeID == ZCL_BASIC_MANUFACTURER_NAME ? "eWeLink" : "TH01";
+                    rsp.push_back(0x00);
+                    rsp.push_back(ZCL_CHAR_STRING);
+                    rsp.push_back(static_cast<uint8_t>(text.size()));
+                    rsp.insert(rsp.end(), text.begin(), text.end());
+                }
+                else
+                {
+                    rsp.push_back(0x86); // UNSUPPORTED_ATTRIBUTE
+                }
+            }
+        }
+        else if (command == ZCL_CONFIG_REPORTING_REQ)
+        {
+            // One "all good" record covers every attribute
+            rsp.push_back(ZCL_CONFIG_REPORTING_RSP);
+            rsp.push_back(0x00);
+        }
+        else
+        {
+            rsp.push_back(ZCL_DEFAULT_RSP);
+            rsp.push_back(command);
+            rsp.push_back(0x82); // UNSUP_GENERAL_COMMAND
+        }
+
+        sendIncoming(device, clusterID, rsp);
+    }
+
+    void CoordinatorSimulator::handleGroups(VirtualDevice &device, const std::vector<uint8_t> &zcl, bool respond)
+    {
+        uint8_t sequence = zcl[1];
+        uint8_t command = zcl[2];
+        uint16_t groupID = zcl.size() >= 5 ? getU16(zcl, 3) : 0;
+
+        // Cluster specific, server -> client, disable default response
+        std::vector<uint8_t> rsp = {0x19, sequence, command};
+
+        switch (command)
+        {
+        case ZCL_GROUPS_ADD:
+            rsp.push_back(device.groups.insert(groupID).second ? 0x00 : 0x8A); // DUPLICATE_EXISTS
+            putU16(rsp, groupID);
+            break;
+
+        case ZCL_GROUPS_VIEW:
+            rsp.push_back(device.groups.count(groupID) ? 0x00 : 0x8B); // NOT_FOUND
+            putU16(rsp, groupID);
+            rsp.push_back(0x00); // No names kept
+            break;
+
+        case ZCL_GROUPS_GET_MEMBERSHIP:
+        {
+            // Capacity, Count, Groups. An empty request list means "all of them".
+            std::vector<uint16_t> listed;
+            uint8_t wanted = zcl.size() > 3 ? zcl[3] : 0;
+            for (uint16_t group : device.groups)
+            {
+                bool match = wanted == 0;
+                for (size_t i = 0; i < wanted && 4 + 2 * i + 1 < zcl.size(); i++)
+                    match = match || getU16(zcl, 4 + 2 * i) == group;
+                if (match)
+                    listed.push_back(group);
+            }
+            rsp.push_back(static_cast<uint8_t>(16 - std::min<size_t>(device.groups.size(), 16)));
+            rsp.push_back(static_cast<uint8_t>(listed.size()));
+            for (uint16_t group : listed)
+                putU16(rsp, group);
+            break;
+        }
+
+        case ZCL_GROUPS_REMOVE:
+            rsp.push_back(device.groups.erase(groupID) ? 0x00 : 0x8B);
+            putU16(rsp, groupID);
+            break;
+
+        case ZCL_GROUPS_REMOVE_ALL:
+            device.groups.clear();
+            return; // No response defined
+
+        default:
+            return;
+        }
+
+        if (respond)
+            sendIncoming(device, GROUPS_CLUSTER, rsp);
+    }
+
+    void CoordinatorSimulator::handlePollControl(VirtualDevice &device, const std::vector<uint8_t> &zcl)
+    {
+        uint8_t command = zcl[2];
+        auto now = Clock::now();
+
+        // Check-in Response: StartFastPolling, FastPollTimeout (quarter seconds)
+        if (command == ZCL_POLL_CHECK_IN_RSP && zcl.size() >= 6 && zcl[3])
+        {
+            uint16_t quarterSeconds = getU16(zcl, 4);
+            device.awakeUntil = now + std::chrono::milliseconds(250 * std::max<uint16_t>(quarterSeconds, 1));
+        }
+        else if (command == ZCL_POLL_FAST_POLL_STOP)
+        {
+            device.awakeUntil = now;
+        }
+    }
+
+    void CoordinatorSimulator::queryNextImage(VirtualDevice &device)
+    {
+        // Cluster specific, client -> server: FieldControl, Manufacturer, ImageType, CurrentVersion
+        std::vector<uint8_t> zcl = {0x01, device.sequence++, ZCL_OTA_QUERY_NEXT_IMAGE_REQ, 0x00};
+        putU16(zcl, OTA_MANUFACTURER);
+        putU16(zcl, OTA_IMAGE_TYPE);
+        putU32(zcl, device.firmwareVersion);
+        sendIncoming(device, OTA_UPGRADE_CLUSTER, zcl);
+    }
+
+    void CoordinatorSimulator::requestBlock(VirtualDevice &device, int delayMs)
+    {
+        // FieldControl, Manufacturer, ImageType, FileVersion, FileOffset, MaxDataSize
+        std::vector<uint8_t> zcl = {0x01, device.sequence++, ZCL_OTA_IMAGE_BLOCK_REQ, 0x00};
+        putU16(zcl, OTA_MANUFACTURER);
+        putU16(zcl, OTA_IMAGE_TYPE);
+        putU32(zcl, device.otaVersion);
+        putU32(zcl, device.otaOffset);
+        zcl.push_back(OTA_BLOCK_SIZE);
+        sendLater(delayMs, incomingFrame(device, OTA_UPGRADE_CLUSTER, zcl));
+    }
+
+    void CoordinatorSimulator::handleOta(VirtualDevice &device, const std::vector<uint8_t> &zcl)
+    {
+        uint8_t command = zcl[2];
+        uint8_t status = zcl.size() > 3 ? zcl[3] : 0xFF;
+
+        if (command == ZCL_OTA_IMAGE_NOTIFY && !device.otaActive)
+        {
+            queryNextImage(device);
+        }
+        else if (command == ZCL_OTA_QUERY_NEXT_IMAGE_RSP && status == ZCL_OTA_SUCCESS && zcl.size() >= 16 &&
+                 !device.otaActive)
+        {
+            // Status, Manufacturer, ImageType, FileVersion, ImageSize
+            device.otaActive = true;
+            device.otaVersion = getU32(zcl, 8);
+            device.otaSize = getU32(zcl, 12);
+            device.otaOffset = 0;
+            device.otaBlockPeriodMs = 0;
+            requestBlock(device, 5);
+        }
+        else if (command == ZCL_OTA_IMAGE_BLOCK_RSP && device.otaActive)
+        {
+            if (status == ZCL_OTA_SUCCESS && zcl.size() >= 17)
+            {
+                // Status, Manufacturer, ImageType, FileVersion, FileOffset, DataSize, Data
+                uint32_t offset = getU32(zcl, 12);
+                uint8_t dataSize = zcl[16];
+                if (offset == device.otaOffset && zcl.size() >= 17u + dataSize)
+                {
+                    device.otaOffset += dataSize;
+                    otaBlocks++;
+                }
+
+                if (device.otaOffset < device.otaSize)
+                {
+                    requestBlock(device, std::max(device.otaBlockPeriodMs, 5));
+                    return;
+                }
+
+                // Status, Manufacturer, ImageType, FileVersion
+                std::vector<uint8_t> end = {0x01, device.sequence++, ZCL_OTA_UPGRADE_END_REQ, ZCL_OTA_SUCCESS};
+                putU16(end, OTA_MANUFACTURER);
+                putU16(end, OTA_IMAGE_TYPE);
+                putU32(end, device.otaVersion);
+                sendLater(5, incomingFrame(device, OTA_UPGRADE_CLUSTER, end));
+            }
+            else if (status == ZCL_OTA_WAIT_FOR_DATA && zcl.size() >= 14)
+            {
+                // Status, CurrentTime, RequestTime, MinimumBlockPeriod: slow down from now on
+                uint32_t currentTime = getU32(zcl, 4);
+                uint32_t requestTime = getU32(zcl, 8);
+                device.otaBlockPeriodMs = getU16(zcl, 12);
+                uint32_t waitSeconds = currentTime == 0 ? requestTime : requestTime - std::min(requestTime, currentTime);
+                requestBlock(device, static_cast<int>(std::max<uint32_t>(waitSeconds, 1) * 1000));
+            }
+            else
+            {
+                device.otaActive = false; // Aborted: ask again later
+            }
+        }
+        else if (command == ZCL_OTA_UPGRADE_END_RSP && device.otaActive)
+        {
+            device.otaActive = false;
+            device.firmwareVersion = device.otaVersion;
+            otaDone++;
+            LOG_INFO << "[Sim] 0x" << std::hex << device.shortAddr << " now runs firmware 0x" << device.firmwareVersion
+                     << std::dec << std::endl;
+        }
+    }
+
+    void CoordinatorSimulator::announce(VirtualDevice &device)
+    {
+        // SrcAddr(2), NwkAddr(2), IEEE(8), Capabilities
+        std::vector<uint8_t> payload;
+        putU16(payload, device.shortAddr);
+        putU16(payload, device.shortAddr);
+        putU64(payload, device.ieee);
+        payload.push_back(0x80); // Battery powered end device, RxOnWhenIdle off
+
+        device.announced = true;
+        sendLater(50 + static_cast<int>(rng() % 1000), ZStackFrame(AREQ | ZDO, ZDO_END_DEVICE_ANNCE_IND, payload));
+    }
+
+    void CoordinatorSimulator::emitReport(const Report &report)
+    {
+        VirtualDevice &device = devices[report.device];
+
+        if (config.sleepy && !isRouter(device.shortAddr))
+            wake(device, Clock::now());
+
+        std::vector<uint8_t> zcl = {0x18, device.sequence++, ZCL_REPORT_ATTRIB};
+        putU16(zcl, 0x0000);
+
+        // Small random walk so deadband filters have something to chew on
+        if (report.clusterID == TEMPERATURE_MEASUREMENT_CLUSTER)
+        {
+            device.temperature += static_cast<int16_t>(rng() % 21) - 10;
+            zcl.push_back(ZCL_INT16);
+            putU16(zcl, static_cast<uint16_t>(device.temperature));
+        }
+        else
+        {
+            int humidity = device.humidity + static_cast<int>(rng() % 41) - 20;
+            device.humidity = static_cast<uint16_t>(std::clamp(humidity, 0, 10000));
+            zcl.push_back(ZCL_UINT16);
+            putU16(zcl, device.humidity);
+        }
+
+        sendIncoming(device, report.clusterID, zcl);
+        reportsOut++;
+
+        // Look for new firmware on the first report, then now and again
+        if (config.ota && !device.otaActive && device.reportsSent++ % OTA_QUERY_EVERY == 0)
+            queryNextImage(device);
+    }
+
+    void CoordinatorSimulator::sendIncoming(const VirtualDevice &device, uint16_t clusterID, const std::vector<uint8_t> &zcl)
+    {
+        send(incomingFrame(device, clusterID, zcl));
+    }
+
+    ZStackFrame CoordinatorSimulator::incomingFrame(const VirtualDevice &device, uint16_t clusterID,
+                                                    const std::vector<uint8_t> &zcl)
+    {
+        // Group(2), Cluster(2), SrcAddr(2), SrcEp, DstEp, WasBroadcast, LQI, Security, Timestamp(4), TransSeq, Len, Data
+        std::vector<uint8_t> payload;
+        payload.reserve(17 + zcl.size());
+        putU16(payload, 0x0000);
+        putU16(payload, clusterID);
+        putU16(payload, device.shortAddr);
+        payload.push_back(DEVICE_ENDPOINT);
+        payload.push_back(0x01);
+        payload.push_back(0x00);
+        payload.push_back(static_cast<uint8_t>(100 + rng() % 150));
+        payload.push_back(0x00);
+
+        uint32_t timestamp = static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count());
+        for (int i = 0; i < 4; i++)
+            payload.push_back((timestamp >> (8 * i)) & 0xFF);
+
+        payload.push_back(0x00);
+        payload.push_back(static_cast<uint8_t>(zcl.size()));
+        payload.insert(payload.end(), zcl.begin(), zcl.end());
+
+        return ZStackFrame(AREQ | AF, AF_INCOMING_MSG, payload);
+    }
+
+    void CoordinatorSimulator::send(const ZStackFrame &frame)
+    {
+        auto bytes = frame.toSerialBytes();
+        txQueue.insert(txQueue.end(), bytes.begin(), bytes.end());
+        framesOut++;
+    }
+
+    void CoordinatorSimulator::sendLater(int delayMs, const ZStackFrame &frame)
+    {
+        delayed.emplace_back(Clock::now() + std::chrono::milliseconds(delayMs), frame);
+    }
+
+    void CoordinatorSimulator::flushTx(Clock::time_point now)
+    {
+        if (txQueue.empty())
+            return;
+
+        size_t allowed = txQueue.size();
+
+        // 8N1: ten bits on the wire per byte
+        if (config.baudRate > 0)
+        {
+            double elapsed = std::chrono::duration<double>(now - lastBudgetUpdate).count();
+            double bytesPerSecond = config.baudRate / 10.0;
+            txBudget = std::min(txBudget + elapsed * bytesPerSecond, bytesPerSecond / 10.0);
+            allowed = std::min(allowed, static_cast<size_t>(txBudget));
+        }
+        lastBudgetUpdate = now;
+
+        if (allowed == 0)
+            return;
+
+        ssize_t written = write(masterFd, txQueue.data(), allowed);
+        if (written > 0)
+        {
+            txQueue.erase(txQueue.begin(), txQueue.begin() + written);
+            bytesOut += written;
+            if (config.baudRate > 0)
+                txBudget -= written;
+        }
+    }
+
+    void CoordinatorSimulator::printStats(double framesPerSecond)
+    {
+        LOG_INFO << "[Sim] In " << std::dec << framesIn << " / Out " << framesOut
+                 << " frames, " << reportsOut << " reports, " << bytesOut << " bytes, "
+                 << std::fixed << std::setprecision(1) << framesPerSecond << " frames/s, "
+                 << txQueue.size() << " bytes backlog"
+                 << (config.ota ? ", " + std::to_string(otaBlocks) + " OTA blocks, " + std::to_string(otaDone) + " upgraded" : "")
+                 << std::endl;
+    }
+
+    bool CoordinatorSimulator::isRouter(uint16_t shortAddr)
+    {
+        if (shortAddr == 0x0000)
+            return true;
+
+        VirtualDevice *device = findDevice(shortAddr);
+        return device && device->announced && (shortAddr - FIRST_DEVICE_ADDR) % ROUTER_SPACING == 0;
+    }
+
+    std::vector<std::vector<uint8_t>> CoordinatorSimulator::neighborTable(uint16_t shortAddr)
+    {
+        // ExtPanId(8), ExtAddr(8), NwkAddr(2), Type | RxOnWhenIdle << 2 | Relation << 4,
+        // PermitJoin, Depth, LQI
+        std::vector<std::vector<uint8_t>> table;
+        auto addEntry = [&](uint16_t neighbor, uint64_t ieee, uint8_t type, uint8_t relation, uint8_t depth)
+        {
+            std::vector<uint8_t> entry;
+            putU64(entry, coordinatorIEEE);
+            putU64(entry, ieee);
+            putU16(entry, neighbor);
+            entry.push_back(type | ((type == 2 ? 0 : 1) << 2) | (relation << 4));
+            entry.push_back(0x00);
+            entry.push_back(depth);
+            entry.push_back(linkQuality(shortAddr, neighbor));
+            table.push_back(entry);
+        };
+
+        if (shortAddr == 0x0000)
+        {
+            for (const auto &device : devices)
+            {
+                if (isRouter(device.shortAddr))
+                    addEntry(device.shortAddr, device.ieee, 1, 1, 1); // Router child
+            }
+            return table;
+        }
+
+        size_t index = shortAddr - FIRST_DEVICE_ADDR;
+        addEntry(0x0000, coordinatorIEEE, 0, 0, 0); // Parent
+
+        for (size_t other : {index - ROUTER_SPACING, index + ROUTER_SPACING})
+        {
+            if (other < devices.size() && isRouter(devices[other].shortAddr))
+                addEntry(devices[other].shortAddr, devices[other].ieee, 1, 2, 1); // Sibling router
+        }
+
+        for (size_t i = index + 1; i < index + ROUTER_SPACING && i < devices.size(); i++)
+        {
+            if (devices[i].announced)
+                addEntry(devices[i].shortAddr, devices[i].ieee, 2, 1, 2); // End device child
+        }
+        return table;
+    }
+
+    std::vector<std::vector<uint8_t>> CoordinatorSimulator::routingTable(uint16_t shortAddr)
+    {
+        // Dest(2), Status, NextHop(2)
+        std::vector<std::vector<uint8_t>> table;
+        auto addEntry = [&](uint16_t destination, uint16_t nextHop)
+        {
+            std::vector<uint8_t> entry;
+            putU16(entry, destination);
+            entry.push_back(0x00); // Active
+            putU16(entry, nextHop);
+            table.push_back(entry);
+        };
+
+        if (shortAddr == 0x0000)
+        {
+            // End devices are reached through their parent router
+            for (size_t i = 0; i < devices.size(); i++)
+            {
+                if (devices[i].announced && !isRouter(devices[i].shortAddr))
+                {
+                    uint16_t parent = devices[i - i % ROUTER_SPACING].shortAddr;
+                    addEntry(devices[i].shortAddr, isRouter(parent) ? parent : devices[i].shortAddr);
+                }
+            }
+            return table;
+        }
+
+        addEntry(0x0000, 0x0000);
+        return table;
+    }
+
+    CoordinatorSimulator::VirtualDevice *CoordinatorSimulator::findDevice(uint16_t shortAddr)
+    {
+        if (shortAddr < FIRST_DEVICE_ADDR || static_cast<size_t>(shortAddr - FIRST_DEVICE_ADDR) >= devices.size())
+            return nullptr;
+        return &devices[shortAddr - FIRST_DEVICE_ADDR];
+    }
+}
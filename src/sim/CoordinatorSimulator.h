@@ -0,0 +1,172 @@
+#ifndef COORDINATOR_SIMULATOR_H
+#define COORDINATOR_SIMULATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "ZStackFrame.h"
+#include "ZStackParser.h"
+
+namespace ZStack
+{
+    struct SimulatorConfig
+    {
+        size_t deviceCount = 100;       // Virtual temperature/humidity sensors
+        size_t firstDevice = 0;         // IEEE offset, so several simulators do not share devices
+        int reportIntervalMs = 10000;   // Per sensor, per attribute
+        bool jitter = true;             // Spread reports instead of sending them in lock-step
+        bool announceOnPermitJoin = false;
+        int baudRate = 0;               // 0 = as fast as the PTY goes, else emulate the UART
+        std::string linkPath;           // Optional symlink to the PTY slave
+        int statsIntervalMs = 5000;
+        bool sleepy = false;            // End devices only hear unicasts when they wake up to report
+        bool ota = false;               // Sensors ask for firmware updates (OTA Upgrade client)
+    };
+
+    // Pretends to be a CC2652P running Z-Stack 3.x behind a pseudo-terminal.
+    //
+    // Speaks enough MT for ZStackClient (SYS, UTIL, ZDO startup / interview /
+    // bind, AF register / data request, group and broadcast sends, indirect
+    // delivery to sleepy end devices, OTA Upgrade clients) and drives a population of virtual
+    // sensors that report temperature and humidity at a configurable rate.
+    // Point SerialPort at slavePath() to benchmark the driver end to end.
+    class CoordinatorSimulator
+    {
+    public:
+        explicit CoordinatorSimulator(const SimulatorConfig &config);
+        ~CoordinatorSimulator();
+
+        bool open();
+        const std::string &slavePath() const { return slaveName; }
+
+        // Runs until stop() or, if durationMs > 0, until it elapses
+        void run(int durationMs = 0);
+        void stop() { running = false; }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        // Unicast waiting at the parent for a sleepy device to poll
+        struct Indirect
+        {
+            Clock::time_point expires;
+            uint8_t srcEndpoint;
+            uint8_t transID;
+            uint8_t dstEndpoint;
+            uint16_t clusterID;
+            std::vector<uint8_t> zcl;
+        };
+
+        struct VirtualDevice
+        {
+            uint16_t shortAddr;
+            uint64_t ieee;
+            int16_t temperature; // 0.01 C
+            uint16_t humidity;   // 0.01 %
+            uint8_t sequence;
+            bool announced;
+            std::set<uint16_t> groups; // Groups cluster membership of DEVICE_ENDPOINT
+
+            // Sleepy end devices: listening until awakeUntil, otherwise the
+            // parent holds unicasts (indirect) until the next poll
+            Clock::time_point awakeUntil;
+            uint32_t wakes = 0;
+            std::vector<Indirect> indirect;
+
+            // OTA Upgrade client: fetching otaVersion block by block while otaActive
+            uint32_t firmwareVersion = 1;
+            uint32_t reportsSent = 0;
+            bool otaActive = false;
+            uint32_t otaVersion = 0;
+            uint32_t otaSize = 0;
+            uint32_t otaOffset = 0;
+            int otaBlockPeriodMs = 0;
+        };
+
+        // Next report due: (time, device index, cluster)
+        struct Report
+        {
+            Clock::time_point due;
+            size_t device;
+            uint16_t clusterID;
+            bool operator>(const Report &other) const { return due > other.due; }
+        };
+
+        SimulatorConfig config;
+        int masterFd;
+        std::string slaveName;
+        std::atomic<bool> running; // stop() is called from a signal handler
+
+        Parser parser;
+        std::mt19937 rng;
+
+        // Coordinator state
+        uint8_t state;
+        std::set<uint8_t> endpoints;
+        uint64_t coordinatorIEEE;
+
+        std::vector<VirtualDevice> devices;
+        std::priority_queue<Report, std::vector<Report>, std::greater<Report>> reports;
+        std::vector<std::pair<Clock::time_point, ZStackFrame>> delayed;
+
+        // UART emulation and stats
+        std::vector<uint8_t> txQueue;
+        double txBudget;
+        Clock::time_point lastBudgetUpdate;
+        uint64_t framesIn;
+        uint64_t framesOut;
+        uint64_t reportsOut;
+        uint64_t bytesOut;
+        uint64_t otaBlocks = 0;
+        uint64_t otaDone = 0;
+        size_t indirectCount = 0;
+
+        void handleFrame(const ZStackFrame &frame);
+        void handleSys(const ZStackFrame &frame);
+        void handleUtil(const ZStackFrame &frame);
+        void handleZdo(const ZStackFrame &frame);
+        void handleAf(const ZStackFrame &frame);
+        void handleDataRequest(const ZStackFrame &frame);
+        void handleDataRequestExt(const ZStackFrame &frame);
+        // respond = false for group / broadcast deliveries, which are never answered
+        void handleZcl(VirtualDevice &device, uint8_t endpoint, uint16_t clusterID, const std::vector<uint8_t> &zcl,
+                       bool respond = true);
+        void handleGroups(VirtualDevice &device, const std::vector<uint8_t> &zcl, bool respond);
+        void handlePollControl(VirtualDevice &device, const std::vector<uint8_t> &zcl);
+        void handleOta(VirtualDevice &device, const std::vector<uint8_t> &zcl);
+        void queryNextImage(VirtualDevice &device);
+        void requestBlock(VirtualDevice &device, int delayMs);
+
+        // Unicast to a device: delivered now, or held for a sleepy one until it polls
+        void unicast(VirtualDevice &device, uint8_t srcEndpoint, uint8_t transID, uint8_t dstEndpoint,
+                     uint16_t clusterID, const std::vector<uint8_t> &zcl);
+        bool asleep(const VirtualDevice &device, Clock::time_point now);
+        void wake(VirtualDevice &device, Clock::time_point now);
+        void expireIndirect(Clock::time_point now);
+
+        void send(const ZStackFrame &frame);
+        void sendLater(int delayMs, const ZStackFrame &frame);
+        void sendIncoming(const VirtualDevice &device, uint16_t clusterID, const std::vector<uint8_t> &zcl);
+        ZStackFrame incomingFrame(const VirtualDevice &device, uint16_t clusterID, const std::vector<uint8_t> &zcl);
+        void announce(VirtualDevice &device);
+        void emitReport(const Report &report);
+
+        void flushTx(Clock::time_point now);
+        void printStats(double framesPerSecond);
+
+        VirtualDevice *findDevice(uint16_t shortAddr);
+
+        // Mesh shape: every 8th device is a router hanging off the
+        // coordinator, the others are end devices below the router before them
+        bool isRouter(uint16_t shortAddr);
+        std::vector<std::vector<uint8_t>> neighborTable(uint16_t shortAddr);
+        std::vector<std::vector<uint8_t>> routingTable(uint16_t shortAddr);
+    };
+}
+
+#endif // COORDINATOR_SIMULATOR_H
@@ -0,0 +1,99 @@
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "CoordinatorSimulator.h"
+#include "Logger.h"
+
+using namespace ZStack;
+
+static CoordinatorSimulator *activeSimulator = nullptr;
+
+static void onSignal(int)
+{
+    if (activeSimulator)
+        activeSimulator->stop();
+}
+
+static void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "  --devices N       Virtual sensors (default 100)\n"
+              << "  --first-device N  Offset of the sensor IEEE addresses, to run several simulators\n"
+              << "  --interval-ms MS  Report interval per sensor and attribute (default 10000)\n"
+              << "  --no-jitter       Evenly spaced reports instead of random phases\n"
+              << "  --announce        Announce every sensor when permit join is opened\n"
+              << "  --sleepy          End devices sleep between reports (indirect delivery, Poll Control)\n"
+              << "  --ota             Sensors ask for firmware updates (manufacturer 0x1234, image type 0x0101)\n"
+              << "  --baud N          Throttle output to a real UART (default unlimited)\n"
+              << "  --link PATH       Symlink PATH to the PTY slave\n"
+              << "  --duration-ms MS  Stop after MS (default run until Ctrl+C)\n"
+              << "  --stats-ms MS     Stats interval, 0 disables (default 5000)\n"
+              << "  --debug           Log every frame\n";
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLevel(LogLevel::INFO);
+
+    SimulatorConfig config;
+    int durationMs = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--devices" && hasValue)
+            config.deviceCount = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--first-device" && hasValue)
+            config.firstDevice = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--interval-ms" && hasValue)
+            config.reportIntervalMs = std::atoi(argv[++i]);
+        else if (arg == "--no-jitter")
+            config.jitter = false;
+        else if (arg == "--announce")
+            config.announceOnPermitJoin = true;
+        else if (arg == "--sleepy")
+            config.sleepy = true;
+        else if (arg == "--ota")
+            config.ota = true;
+        else if (arg == "--baud" && hasValue)
+            config.baudRate = std::atoi(argv[++i]);
+        else if (arg == "--link" && hasValue)
+            config.linkPath = argv[++i];
+        else if (arg == "--duration-ms" && hasValue)
+            durationMs = std::atoi(argv[++i]);
+        else if (arg == "--stats-ms" && hasValue)
+            config.statsIntervalMs = std::atoi(argv[++i]);
+        else if (arg == "--debug")
+            Logger::setLevel(LogLevel::DEBUG);
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Short addresses are handed out from 0x1000 upwards
+    if (config.deviceCount > 0xF000)
+    {
+        std::cerr << "At most " << 0xF000 << " devices are supported" << std::endl;
+        return 1;
+    }
+
+    CoordinatorSimulator simulator(config);
+    if (!simulator.open())
+        return 1;
+
+    activeSimulator = &simulator;
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    LOG_INFO << "[Sim] Coordinator listening on " << simulator.slavePath()
+             << (config.linkPath.empty() ? "" : " (" + config.linkPath + ")") << " with "
+             << config.deviceCount << " sensor(s) every " << config.reportIntervalMs << " ms" << std::endl;
+
+    simulator.run(durationMs);
+    return 0;
+}
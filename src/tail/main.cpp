@@ -0,0 +1,88 @@
+// Example consumer of the shared memory reading ring published by zigbee_test.
+// Maps /dev/shm/<name> read-only and prints records as they arrive; no
+// broker, no sockets, and the driver never waits for this process.
+//
+//   zigbee_tail [--ring NAME] [--from-oldest] [--count N]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "ReadingRing.h"
+
+using namespace ZStack;
+
+int main(int argc, char *argv[])
+{
+    std::string name = "zigbee_readings";
+    bool fromOldest = false;
+    uint64_t limit = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--ring" && i + 1 < argc)
+            name = argv[++i];
+        else if (arg == "--from-oldest")
+            fromOldest = true;
+        else if (arg == "--count" && i + 1 < argc)
+            limit = std::strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--ring NAME] [--from-oldest] [--count N]" << std::endl;
+            return 1;
+        }
+    }
+
+    ReadingRingReader reader;
+    while (!reader.open(name, fromOldest))
+    {
+        // The driver has not created the ring yet
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    uint64_t seen = 0;
+    uint64_t lastDropped = 0;
+    ReadingRecord record;
+
+    while (limit == 0 || seen < limit)
+    {
+        if (!reader.next(record))
+        {
+            if (reader.stale())
+            {
+                std::cerr << "Ring re-initialised, reopening" << std::endl;
+
+                // The driver may still be re-creating it; a failed open leaves the reader closed
+                while (!reader.open(name, true))
+                    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+                lastDropped = 0; // Counted per open
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+
+        if (reader.dropped() != lastDropped)
+        {
+            std::cerr << "Fell behind, " << reader.dropped() - lastDropped << " record(s) lost" << std::endl;
+            lastDropped = reader.dropped();
+        }
+
+        std::cout << record.timestampUs / 1000000 << "." << std::setw(6) << std::setfill('0') << record.timestampUs % 1000000
+                  << std::setfill(' ') << std::hex << std::uppercase
+                  << "  ieee=" << std::setw(16) << std::setfill('0') << record.ieee
+                  << "  nwk=0x" << std::setw(4) << record.shortAddr
+                  << "  ep=" << std::dec << (int)record.endpoint << std::hex
+                  << "  cluster=0x" << std::setw(4) << record.clusterID
+                  << "  attr=0x" << std::setw(4) << record.attributeID
+                  << std::dec << std::setfill(' ') << std::nouppercase
+                  << "  value=" << record.value << std::endl;
+        seen++;
+    }
+
+    return 0;
+}
@@ -0,0 +1,287 @@
+#include "zcl/ZclRequestBuilder.h"
+#include "ZStackProtocol.h"
+
+namespace ZStack
+{
+    ZclRequestBuilder::ZclRequestBuilder(uint8_t *buffer, size_t capacity)
+        : buffer(buffer), capacity(capacity), arena(nullptr), extended(false)
+    {
+    }
+
+    ZclRequestBuilder::ZclRequestBuilder(FrameArena &arena)
+        : buffer(nullptr), capacity(0), arena(&arena), extended(false)
+    {
+    }
+
+    uint8_t *ZclRequestBuilder::target(size_t &available)
+    {
+        if (arena)
+        {
+            available = MAX_MT_FRAME_SIZE;
+            return arena->reserve();
+        }
+
+        available = capacity;
+        return buffer;
+    }
+
+    size_t ZclRequestBuilder::begin(FrameWriter &writer, const ZclDestination &dest, uint16_t clusterID,
+                                    uint8_t sequence, uint8_t frameControl, uint8_t commandID)
+    {
+        size_t afLengthOffset;
+        extended = dest.addrMode != AF_ADDR_16BIT;
+
+        if (!extended)
+        {
+            writer.begin(SREQ | AF, AF_DATA_REQUEST);
+
+            // 1. AF_DATA_REQUEST header
+            writer.u16(dest.shortAddr);  // Dst Address
+            writer.u8(dest.endpoint);    // Dst Endpoint
+            writer.u8(dest.srcEndpoint); // Src Endpoint
+            writer.u16(clusterID);       // Cluster
+            writer.u8(sequence);         // TransID
+            writer.u8(dest.options);     // Options
+            writer.u8(dest.radius);      // Radius
+            afLengthOffset = writer.placeholder();
+        }
+        else
+        {
+            writer.begin(SREQ | AF, AF_DATA_REQUEST_EXT);
+
+            // 1. AF_DATA_REQUEST_EXT header: the address field is always 8 bytes
+            writer.u8(dest.addrMode);    // Dst Address Mode
+            writer.u16(dest.shortAddr);  // Dst Address (group / broadcast)
+            writer.u16(0x0000);
+            writer.u32(0x00000000);
+            writer.u8(dest.endpoint);    // Dst Endpoint
+            writer.u16(0x0000);          // Dst PAN ID (0 = ours)
+            writer.u8(dest.srcEndpoint); // Src Endpoint
+            writer.u16(clusterID);       // Cluster
+            writer.u8(sequence);         // TransID
+            writer.u8(dest.options);     // Options
+            writer.u8(dest.radius);      // Radius
+            afLengthOffset = writer.placeholder();
+            writer.placeholder();        // Len is 2 bytes here
+        }
+
+        // 2. ZCL header
+        writer.u8(frameControl);
+        writer.u8(sequence);
+        writer.u8(commandID);
+
+        return afLengthOffset;
+    }
+
+    FrameView ZclRequestBuilder::end(FrameWriter &writer, size_t afLengthOffset)
+    {
+        // Everything after the AF "Len" field is the ZCL frame
+        if (!extended)
+        {
+            size_t zclLength = writer.payloadSize() - 10;
+            writer.patch(afLengthOffset, static_cast<uint8_t>(zclLength));
+        }
+        else
+        {
+            size_t zclLength = writer.payloadSize() - 20;
+            writer.patch(afLengthOffset, static_cast<uint8_t>(zclLength & 0xFF));
+            writer.patch(afLengthOffset + 1, static_cast<uint8_t>(zclLength >> 8));
+        }
+
+        FrameView frame = writer.finish();
+
+        if (arena)
+        {
+            arena->commit(frame);
+        }
+
+        return frame;
+    }
+
+    FrameView ZclRequestBuilder::readAttributes(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                                const uint16_t *attributeIDs, size_t count)
+    {
+        size_t available = 0;
+        uint8_t *memory = target(available);
+        FrameWriter writer(memory, available);
+
+        size_t afLength = begin(writer, dest, clusterID, sequence, FRAME_TYPE_GLOBAL, ZCL_READ_ATTRIB_REQ);
+        for (size_t i = 0; i < count; i++)
+        {
+            writer.u16(attributeIDs[i]);
+        }
+
+        return end(writer, afLength);
+    }
+
+    FrameView ZclRequestBuilder::readAttributes(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                                std::initializer_list<uint16_t> attributeIDs)
+    {
+        return readAttributes(dest, clusterID, sequence, attributeIDs.begin(), attributeIDs.size());
+    }
+
+    FrameView ZclRequestBuilder::writeAttributes(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                                 const ZclAttributeWrite *writes, size_t count)
+    {
+        size_t available = 0;
+        uint8_t *memory = target(available);
+        FrameWriter writer(memory, available);
+
+        size_t afLength = begin(writer, dest, clusterID, sequence, FRAME_TYPE_GLOBAL, ZCL_WRITE_ATTRIB_REQ);
+        for (size_t i = 0; i < count; i++)
+        {
+            writer.u16(writes[i].attributeID);
+            writer.u8(writes[i].dataType);
+            writer.bytes(writes[i].value, writes[i].length);
+        }
+
+        return end(writer, afLength);
+    }
+
+    FrameView ZclRequestBuilder::configureReporting(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                                    const ZclReportingConfig *configs, size_t count)
+    {
+        size_t available = 0;
+        uint8_t *memory = target(available);
+        FrameWriter writer(memory, available);
+
+        size_t afLength = begin(writer, dest, clusterID, sequence, FRAME_TYPE_GLOBAL, ZCL_CONFIG_REPORTING_REQ);
+        for (size_t i = 0; i < count; i++)
+        {
+            const auto &config = configs[i];
+
+            writer.u8(0x00); // Direction: Reported
+            writer.u16(config.attributeID);
+            writer.u8(config.dataType);
+            writer.u16(config.minInterval);
+            writer.u16(config.maxInterval);
+
+            // Reportable Change has the size of the attribute itself
+            if (isZCLAnalogDataType(config.dataType))
+            {
+                int length = getZCLDataTypeLength(config.dataType);
+                for (int b = 0; b < length; b++)
+                {
+                    writer.u8((config.reportableChange >> (8 * b)) & 0xFF);
+                }
+            }
+        }
+
+        return end(writer, afLength);
+    }
+
+    FrameView ZclRequestBuilder::configureReporting(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                                    std::initializer_list<ZclReportingConfig> configs)
+    {
+        return configureReporting(dest, clusterID, sequence, configs.begin(), configs.size());
+    }
+
+    FrameView ZclRequestBuilder::readReportingConfig(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                                     const uint16_t *attributeIDs, size_t count)
+    {
+        size_t available = 0;
+        uint8_t *memory = target(available);
+        FrameWriter writer(memory, available);
+
+        size_t afLength = begin(writer, dest, clusterID, sequence, FRAME_TYPE_GLOBAL, ZCL_READ_REPORTING_CONFIG_REQ);
+        for (size_t i = 0; i < count; i++)
+        {
+            writer.u8(0x00); // Direction: Reported
+            writer.u16(attributeIDs[i]);
+        }
+
+        return end(writer, afLength);
+    }
+
+    FrameView ZclRequestBuilder::readReportingConfig(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                                     std::initializer_list<uint16_t> attributeIDs)
+    {
+        return readReportingConfig(dest, clusterID, sequence, attributeIDs.begin(), attributeIDs.size());
+    }
+
+    FrameView ZclRequestBuilder::clusterCommand(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                                uint8_t commandID, const uint8_t *payload, size_t length)
+    {
+        size_t available = 0;
+        uint8_t *memory = target(available);
+        FrameWriter writer(memory, available);
+
+        size_t afLength = begin(writer, dest, clusterID, sequence, FRAME_TYPE_CLUSTER, commandID);
+        if (payload && length > 0)
+        {
+            writer.bytes(payload, length);
+        }
+
+        return end(writer, afLength);
+    }
+
+    FrameView ZclRequestBuilder::clusterResponse(const ZclDestination &dest, uint16_t clusterID, uint8_t sequence,
+                                                 uint8_t commandID, const uint8_t *header, size_t headerLength,
+                                                 const uint8_t *data, size_t dataLength)
+    {
+        size_t available = 0;
+        uint8_t *memory = target(available);
+        FrameWriter writer(memory, available);
+
+        uint8_t frameControl = FRAME_TYPE_CLUSTER | SERVER_TO_CLIENT | DISABLE_DEFAULT_RSP;
+        size_t afLength = begin(writer, dest, clusterID, sequence, frameControl, commandID);
+        if (header && headerLength > 0)
+        {
+            writer.bytes(header, headerLength);
+        }
+        if (data && dataLength > 0)
+        {
+            writer.bytes(data, dataLength);
+        }
+
+        return end(writer, afLength);
+    }
+
+    FrameView ZclRequestBuilder::addGroup(const ZclDestination &dest, uint8_t sequence, uint16_t groupID, const char *name)
+    {
+        size_t available = 0;
+        uint8_t *memory = target(available);
+        FrameWriter writer(memory, available);
+
+        // Group ID, then the name as a ZCL character string
+        size_t nameLength = 0;
+        while (name && name[nameLength] && nameLength < 16)
+            nameLength++;
+
+        size_t afLength = begin(writer, dest, GROUPS_CLUSTER, sequence, FRAME_TYPE_CLUSTER, ZCL_GROUPS_ADD);
+        writer.u16(groupID);
+        writer.u8(static_cast<uint8_t>(nameLength));
+        writer.bytes(reinterpret_cast<const uint8_t *>(name), nameLength);
+
+        return end(writer, afLength);
+    }
+
+    FrameView ZclRequestBuilder::viewGroup(const ZclDestination &dest, uint8_t sequence, uint16_t groupID)
+    {
+        uint8_t payload[2] = {static_cast<uint8_t>(groupID & 0xFF), static_cast<uint8_t>(groupID >> 8)};
+        return clusterCommand(dest, GROUPS_CLUSTER, sequence, ZCL_GROUPS_VIEW, payload, sizeof(payload));
+    }
+
+    FrameView ZclRequestBuilder::removeGroup(const ZclDestination &dest, uint8_t sequence, uint16_t groupID)
+    {
+        uint8_t payload[2] = {static_cast<uint8_t>(groupID & 0xFF), static_cast<uint8_t>(groupID >> 8)};
+        return clusterCommand(dest, GROUPS_CLUSTER, sequence, ZCL_GROUPS_REMOVE, payload, sizeof(payload));
+    }
+
+    FrameView ZclRequestBuilder::getGroupMembership(const ZclDestination &dest, uint8_t sequence,
+                                                    const uint16_t *groupIDs, size_t count)
+    {
+        size_t available = 0;
+        uint8_t *memory = target(available);
+        FrameWriter writer(memory, available);
+
+        size_t afLength = begin(writer, dest, GROUPS_CLUSTER, sequence, FRAME_TYPE_CLUSTER, ZCL_GROUPS_GET_MEMBERSHIP);
+        writer.u8(static_cast<uint8_t>(count));
+        for (size_t i = 0; i < count; i++)
+        {
+            writer.u16(groupIDs[i]);
+        }
+
+        return end(writer, afLength);
+    }
+}
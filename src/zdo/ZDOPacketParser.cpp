@@ -39,18 +39,37 @@ namespace ZDOPacket
         if (frame.getCommand0() == (AREQ | ZDO) && frame.getCommand1() == ZDO_TC_DEV_IND) {
             LOG_INFO << ">>> ZDO TC Device Indication Received (New Device Joining Securely)" << std::endl;
             auto p = frame.getPayload();
-            uint16_t nwkAddr = p[0] | (p[1] << 8);
-        
+            if (p.size() < 12)
+                return nullptr;
+
             std::vector<uint8_t> ieeeBytes;
             for (int i = 0; i < 8; i++) ieeeBytes.push_back(p[2 + i]);
 
-            uint16_t parentAddr = p[10] | (p[11] << 8);
+            auto indication = std::make_unique<ZDOPacket::TrustCenterDeviceIndication>();
+            indication->networkAddress = p[0] | (p[1] << 8);
+            indication->ieeeAddress = convertToInt64(ieeeBytes);
+            indication->parentAddress = p[10] | (p[11] << 8);
+
+            return indication;
+        }
+
+        if (frame.getCommand0() == (AREQ | ZDO) &&
+            (frame.getCommand1() == ZDO_NWK_ADDR_RSP || frame.getCommand1() == ZDO_IEEE_ADDR_RSP))
+        {
+            // Status, IEEEAddr(8), NwkAddr(2), StartIndex, NumAssocDev, AssocDevList
+            const auto &p = frame.getPayload();
+            if (p.size() < 11)
+                return nullptr;
+
+            std::vector<uint8_t> ieeeBytes(p.begin() + 1, p.begin() + 9);
+
+            auto addressResponse = std::make_unique<ZDOPacket::AddressResponse>();
+            addressResponse->status = p[0];
+            addressResponse->ieeeAddress = convertToInt64(ieeeBytes);
+            addressResponse->networkAddress = p[9] | (p[10] << 8);
+            addressResponse->ieeeRequest = frame.getCommand1() == ZDO_IEEE_ADDR_RSP;
 
-            // Create a struct/class for this if you want to store it
-            // LOG_INFO << "Secure Device Join - Parent: " << std::hex << parentAddr << std::endl;
-        
-            // Return your new packet type or nullptr if you just wanted to log it
-            return nullptr; 
+            return addressResponse;
         }
 
         if (frame.getCommand0() == (SRSP | ZDO) &&
@@ -80,6 +99,7 @@ namespace ZDOPacket
             deviceAnnouncement->networkAddress = networkAddr;
             deviceAnnouncement->srcAddress = srcAddr;
             deviceAnnouncement->ieeeAddress = convertToInt64(ieeeBytes);
+            deviceAnnouncement->capabilities = p.size() > 12 ? p[12] : 0x00;
 
             return deviceAnnouncement;
         }
@@ -88,6 +108,8 @@ namespace ZDOPacket
         {
 
             auto p = frame.getPayload();
+            if (p.size() < 3)
+                return nullptr;
 
             auto bindResponse = std::make_unique<ZDOPacket::BindRequestResponse>();
             bindResponse->srcAddress = p[0] | (p[1] << 8);
@@ -102,6 +124,9 @@ namespace ZDOPacket
             auto p = frame.getPayload();
             LOG_INFO << ">>> ZDO PARSER PAYLOAD LENGTH: " << std::dec << p.size() << std::endl;
 
+            if (p.size() < 6)
+                return nullptr;
+
             uint16_t srcAddr = p[0] | (p[1] << 8);
             uint8_t status = p[2];
             LOG_INFO << ">>> ZDO PARSER PAYLOAD STATUS: " << std::hex << (int)status << std::endl;
@@ -111,7 +136,7 @@ namespace ZDOPacket
             LOG_INFO << ">>> ZDO PARSER ACTIVE EP COUNT: " << std::dec << (int)endpointCount << std::endl;
 
             std::vector<uint8_t> activeEndpoints;
-            for (int i = 0; i < endpointCount; i++)
+            for (int i = 0; i < endpointCount && 6 + i < (int)p.size(); i++)
             {
                 activeEndpoints.push_back(p[6 + i]);
             }
@@ -119,6 +144,7 @@ namespace ZDOPacket
             auto activeEpResponse = std::make_unique<ZDOPacket::DeviceActiveEndpointResponse>();
             activeEpResponse->networkAddress = networkAddr;
             activeEpResponse->srcAddress = srcAddr;
+            activeEpResponse->status = status;
             activeEpResponse->activeEndpoints = activeEndpoints;
 
             return activeEpResponse;
@@ -128,9 +154,26 @@ namespace ZDOPacket
         {
 
             auto p = frame.getPayload();
+            if (p.size() < 5)
+                return nullptr;
+
             uint16_t srcAddr = p[0] | (p[1] << 8);
             uint8_t status = p[2];
             uint16_t networkAddr = p[3] | (p[4] << 8);
+
+            // Failed requests come back without a descriptor
+            if (status != 0x00 || p.size() < 13)
+            {
+                auto deviceDescResponse = std::make_unique<ZDOPacket::DeviceDescriptionResponse>();
+                deviceDescResponse->sourceAddress = srcAddr;
+                deviceDescResponse->status = status != 0x00 ? status : 0x01;
+                deviceDescResponse->networkAddress = networkAddr;
+                deviceDescResponse->endpoint = 0;
+                deviceDescResponse->profileID = 0;
+                deviceDescResponse->deviceID = 0;
+                return deviceDescResponse;
+            }
+
             uint8_t lengthOfDesc = p[5];
             uint8_t endpoint = p[6];
             uint16_t profileID = p[7] | (p[8] << 8);
@@ -139,14 +182,16 @@ namespace ZDOPacket
             uint8_t inputClusterCount = p[12];
             int inputClusterOffset = 13;
             std::vector<uint16_t> inputClusters;
-            for (int i = 0; i < inputClusterCount; i++)
+            for (int i = 0; i < inputClusterCount && inputClusterOffset + 1 + i * 2 < (int)p.size(); i++)
             {
                 inputClusters.push_back(p[inputClusterOffset + i * 2] | (p[(inputClusterOffset + 1) + i * 2] << 8));
             }
+            if (inputClusterOffset + inputClusterCount * 2 >= (int)p.size())
+                return nullptr;
             uint8_t outputClusterCount = p[inputClusterOffset + inputClusterCount * 2];
             int outputClusterOffset = inputClusterOffset + inputClusterCount * 2 + 1;
             std::vector<uint16_t> outputClusters;
-            for (int i = 0; i < outputClusterCount; i++)
+            for (int i = 0; i < outputClusterCount && outputClusterOffset + 1 + i * 2 < (int)p.size(); i++)
             {
                 outputClusters.push_back(p[outputClusterOffset + i * 2] |
                                          (p[outputClusterOffset + 1 + i * 2] << 8));
@@ -154,6 +199,7 @@ namespace ZDOPacket
 
             auto deviceDescResponse = std::make_unique<ZDOPacket::DeviceDescriptionResponse>();
             deviceDescResponse->sourceAddress = srcAddr;
+            deviceDescResponse->status = status;
             deviceDescResponse->networkAddress = networkAddr;
             deviceDescResponse->endpoint = endpoint;
             deviceDescResponse->profileID = profileID;
@@ -163,6 +209,69 @@ namespace ZDOPacket
 
             return deviceDescResponse;
         }
+        else if (frame.getCommand0() == (AREQ | ZDO) &&
+                 frame.getCommand1() == ZDO_MGMT_LQI_RSP)
+        {
+            // SrcAddr(2), Status, Total, StartIndex, Count, Count x 22 byte entries
+            const auto &p = frame.getPayload();
+            if (p.size() < 3)
+                return nullptr;
+
+            auto lqiResponse = std::make_unique<ZDOPacket::MgmtLqiResponse>();
+            lqiResponse->srcAddress = p[0] | (p[1] << 8);
+            lqiResponse->status = p[2];
+            lqiResponse->totalEntries = p.size() > 3 ? p[3] : 0;
+            lqiResponse->startIndex = p.size() > 4 ? p[4] : 0;
+
+            uint8_t count = p.size() > 5 ? p[5] : 0;
+            for (size_t i = 0, offset = 6; i < count && offset + 22 <= p.size(); i++, offset += 22)
+            {
+                NeighborEntry entry;
+                entry.extendedPanId = 0;
+                entry.ieeeAddress = 0;
+                for (int b = 7; b >= 0; b--)
+                {
+                    entry.extendedPanId = (entry.extendedPanId << 8) | p[offset + b];
+                    entry.ieeeAddress = (entry.ieeeAddress << 8) | p[offset + 8 + b];
+                }
+                entry.networkAddress = p[offset + 16] | (p[offset + 17] << 8);
+                entry.deviceType = p[offset + 18] & 0x03;
+                entry.rxOnWhenIdle = (p[offset + 18] >> 2) & 0x03;
+                entry.relationship = (p[offset + 18] >> 4) & 0x07;
+                entry.permitJoining = p[offset + 19] & 0x03;
+                entry.depth = p[offset + 20];
+                entry.lqi = p[offset + 21];
+                lqiResponse->neighbors.push_back(entry);
+            }
+
+            return lqiResponse;
+        }
+        else if (frame.getCommand0() == (AREQ | ZDO) &&
+                 frame.getCommand1() == ZDO_MGMT_RTG_RSP)
+        {
+            // SrcAddr(2), Status, Total, StartIndex, Count, Count x 5 byte entries
+            const auto &p = frame.getPayload();
+            if (p.size() < 3)
+                return nullptr;
+
+            auto rtgResponse = std::make_unique<ZDOPacket::MgmtRtgResponse>();
+            rtgResponse->srcAddress = p[0] | (p[1] << 8);
+            rtgResponse->status = p[2];
+            rtgResponse->totalEntries = p.size() > 3 ? p[3] : 0;
+            rtgResponse->startIndex = p.size() > 4 ? p[4] : 0;
+
+            uint8_t count = p.size() > 5 ? p[5] : 0;
+            for (size_t i = 0, offset = 6; i < count && offset + 5 <= p.size(); i++, offset += 5)
+            {
+                RouteEntry entry;
+                entry.destination = p[offset] | (p[offset + 1] << 8);
+                entry.status = p[offset + 2] & 0x07;
+                entry.nextHop = p[offset + 3] | (p[offset + 4] << 8);
+                rtgResponse->routes.push_back(entry);
+            }
+
+            return rtgResponse;
+        }
 
         return nullptr;
     }